@@ -3,21 +3,177 @@
 in vec3 FragPos;
 in vec2 TexCoord;
 in vec3 Normal;
+flat in uint MaterialIndex;
 out vec4 FragColor;
 
-uniform sampler2D diffuseTexture;
+// Gfx::MaterialConstants in C++.
+struct Material
+{
+    vec4 diffuse;
+    // Ks, with the specular exponent in w.
+    vec4 specular;
+    int textureArray;
+    float textureLayer;
+    // Finer mips have not streamed in yet.
+    float minLevel;
+    uint padding;
+};
+
+layout (std430, binding = 3) readonly buffer Materials
+{
+    Material materials[];
+};
+
+// Camera constants shared by every program; Gfx::FrameConstants in C++.
+layout (std140, binding = 0) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    // Tiles across, tiles up and depth slices of the light clusters.
+    uvec4 clusterGrid;
+    // Near plane, slices per unit of log depth, and tiles per pixel.
+    vec4 clusterScale;
+    // Towards the sun, and its colour times its intensity.
+    vec4 sunDirection;
+    vec4 sunColor;
+    // World space to each cascade's shadow map coordinates and depth.
+    mat4 shadowMatrices[MAX_SHADOW_CASCADES];
+    // The view depth each cascade ends at, and its world-space texel size.
+    vec4 cascadeSplits;
+    vec4 cascadeTexels;
+    // Cascades in use and the size of a shadow map texel.
+    vec4 shadowParams;
+} frame;
+
+// Umbrella::PointLight in C++.
+struct PointLight
+{
+    vec3 position;
+    float radius;
+    vec3 color;
+    float intensity;
+};
+
+layout (std430, binding = 4) readonly buffer Lights
+{
+    PointLight lights[];
+};
+
+// Where each cluster's lights start in lightIndices, and how many.
+layout (std430, binding = 5) readonly buffer LightClusters
+{
+    uvec2 clusterRanges[];
+};
+
+layout (std430, binding = 6) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+// One array per texture size, on units 0 and up. The material index is
+// the same for a whole draw, so indexing them with it is allowed.
+layout (binding = 0) uniform sampler2DArray materialTextures[MAX_TEXTURE_ARRAYS];
+
+vec4 SampleDiffuse(Material material)
+{
+    if (material.textureArray < 0) {
+        return vec4(1.0f);
+    }
+    float lod = max(
+        textureQueryLod(materialTextures[material.textureArray], TexCoord).y,
+        material.minLevel);
+    return textureLod(materialTextures[material.textureArray],
+        vec3(TexCoord, material.textureLayer), lod);
+}
+
+// Every cascade in a layer of its own, compared in hardware, on the unit
+// after the material arrays.
+layout (binding = MAX_TEXTURE_ARRAYS) uniform sampler2DArrayShadow shadowMap;
+
+// How much of the sun reaches the fragment, filtered over 3x3 taps of the
+// cascade its view depth falls in. Past the last cascade nothing is shadowed.
+float SunVisibility(float viewDepth, vec3 normal)
+{
+    uint numCascades = uint(frame.shadowParams.x);
+    uint cascade = 0;
+    while (cascade < numCascades && viewDepth > frame.cascadeSplits[cascade]) {
+        cascade++;
+    }
+    if (cascade == numCascades) {
+        return 1.0f;
+    }
+    // Looking up a texel and a half out along the normal keeps surfaces
+    // from shadowing themselves, at any cascade's texel size.
+    vec3 position = FragPos + normal * 1.5f * frame.cascadeTexels[cascade];
+    vec4 shadowPos = frame.shadowMatrices[cascade] * vec4(position, 1.0f);
+    float texel = frame.shadowParams.y;
+    float visibility = 0.0f;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            visibility += texture(shadowMap, vec4(shadowPos.xy
+                + vec2(x, y) * texel, float(cascade), shadowPos.z));
+        }
+    }
+    return visibility / 9.0f;
+}
+
+// Lambert and a Blinn-Phong highlight, only on the lit side.
+void AddLight(vec3 normal, vec3 viewDir, vec3 lightDir, vec3 radiance,
+    float specularPower, inout vec3 diffuse, inout vec3 specular)
+{
+    float nDotL = max(0.0f, dot(normal, lightDir));
+    vec3 halfDir = normalize(lightDir + viewDir);
+    float highlight = nDotL > 0.0f
+        ? pow(max(0.0f, dot(normal, halfDir)), specularPower)
+        : 0.0f;
+    diffuse += radiance * nDotL;
+    specular += radiance * highlight;
+}
+
+// The screen tile the fragment is on and the exponential depth slice it
+// falls in, as LightClusters lays them out.
+uint ClusterIndex(float viewDepth)
+{
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * frame.clusterScale.zw),
+        frame.clusterGrid.xy - 1u);
+    float slice = log(viewDepth / frame.clusterScale.x) * frame.clusterScale.y;
+    uint z = min(uint(max(slice, 0.0f)), frame.clusterGrid.z - 1u);
+    return (z * frame.clusterGrid.y + tile.y) * frame.clusterGrid.x + tile.x;
+}
 
 void main()
 {
-    vec4 objectColor = vec4(1.0f, 0.0f, 0.5f, 1.0f);
+    Material material = materials[MaterialIndex];
+    vec4 objectColor = material.diffuse * SampleDiffuse(material);
     vec3 Normal = normalize(Normal);
-    vec3 lightPos = vec3(1.0f, 2.0f, 5.0f);
-    vec3 lightDir = normalize(lightPos - FragPos);
-    float nDotL = max(0.0f, dot(Normal, lightDir));
-    
-    FragColor = objectColor *
-    (
-        vec4(vec3(0.1f), 1.0f) +
-        vec4(nDotL, nDotL, nDotL, 1.0)
-    );
+    vec3 viewDir = normalize(frame.cameraPosition.xyz - FragPos);
+    float specularPower = max(material.specular.w, 1.0f);
+
+    // Only the lights binned into this fragment's cluster can reach it.
+    float viewDepth = -(frame.view * vec4(FragPos, 1.0f)).z;
+    uvec2 range = clusterRanges[ClusterIndex(viewDepth)];
+    vec3 diffuse = vec3(0.1f);
+    vec3 specular = vec3(0.0f);
+    AddLight(Normal, viewDir, frame.sunDirection.xyz,
+        frame.sunColor.rgb * SunVisibility(viewDepth, Normal), specularPower,
+        diffuse, specular);
+    for (uint i = 0; i < range.y; i++) {
+        PointLight light = lights[lightIndices[range.x + i]];
+        vec3 toLight = light.position - FragPos;
+        float lightDistance = length(toLight);
+        // Falls to zero at the radius, so leaving the light out of the
+        // clusters beyond it changes nothing.
+        float falloff = clamp(1.0f - lightDistance * lightDistance
+            / (light.radius * light.radius), 0.0f, 1.0f);
+        vec3 radiance = light.color * light.intensity * falloff * falloff;
+
+        vec3 lightDir = toLight / max(lightDistance, 1e-4f);
+        AddLight(Normal, viewDir, lightDir, radiance, specularPower, diffuse,
+            specular);
+    }
+
+    FragColor = objectColor * vec4(diffuse, 1.0f)
+        + vec4(material.specular.rgb * specular, 0.0f);
 }
@@ -2,20 +2,91 @@
 
 layout (location = 0) in vec3 PositionAttrib;
 layout (location = 1) in vec2 TexCoordAttrib;
+#ifdef OCTAHEDRAL_NORMALS
+layout (location = 2) in vec4 NormalAttrib;
+#else
 layout (location = 2) in vec3 NormalAttrib;
+#endif
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
+// Model matrices of the instances, grouped by draw.
+layout (std430, binding = 0) readonly buffer InstanceTransforms
+{
+    mat4 instanceModels[];
+};
+
+// Per draw: where its instances start, which mesh it draws and with what
+// material.
+struct DrawRecord
+{
+    uint firstInstance;
+    uint mesh;
+    uint material;
+};
+
+layout (std430, binding = 1) readonly buffer DrawRecords
+{
+    DrawRecord drawRecords[];
+};
+
+// Maps quantized positions of each mesh back into model space.
+layout (std430, binding = 2) readonly buffer MeshDequantize
+{
+    mat4 meshDequantize[];
+};
+
+// Camera constants shared by every program; Gfx::FrameConstants in C++.
+layout (std140, binding = 0) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    // Tiles across, tiles up and depth slices of the light clusters.
+    uvec4 clusterGrid;
+    // Near plane, slices per unit of log depth, and tiles per pixel.
+    vec4 clusterScale;
+    // Towards the sun, and its colour times its intensity.
+    vec4 sunDirection;
+    vec4 sunColor;
+    // World space to each cascade's shadow map coordinates and depth.
+    mat4 shadowMatrices[MAX_SHADOW_CASCADES];
+    // The view depth each cascade ends at, and its world-space texel size.
+    vec4 cascadeSplits;
+    vec4 cascadeTexels;
+    // Cascades in use and the size of a shadow map texel.
+    vec4 shadowParams;
+} frame;
 
 out vec3 FragPos;
 out vec2 TexCoord;
 flat out vec3 Normal;
+flat out uint MaterialIndex;
+
+vec3 DecodeNormal()
+{
+#ifdef OCTAHEDRAL_NORMALS
+    vec2 e = NormalAttrib.xy;
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f) {
+        vec2 signs = mix(vec2(-1.0f), vec2(1.0f), greaterThanEqual(e, vec2(0.0f)));
+        n.xy = (1.0f - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+#else
+    return NormalAttrib;
+#endif
+}
 
 void main()
 {
-    gl_Position = uProjection * uView * uModel * vec4(PositionAttrib, 1.0f);
-    FragPos = vec3(uModel * vec4(PositionAttrib, 1.0f));
+    DrawRecord draw = drawRecords[gl_DrawID];
+    mat4 model = instanceModels[draw.firstInstance + gl_InstanceID];
+
+    vec4 position = model * meshDequantize[draw.mesh] * vec4(PositionAttrib, 1.0f);
+    gl_Position = frame.viewProjection * position;
+    FragPos = vec3(position);
     TexCoord = TexCoordAttrib;
-    Normal = NormalAttrib;
+    // Instances are only rotated, translated and uniformly scaled.
+    Normal = mat3(model) * DecodeNormal();
+    MaterialIndex = draw.material;
 }
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace Umbrella::Bench {
+
+using BenchArgs = std::span<char const* const>;
+
+// Runs fn() `iterations` times and returns the median wall time in
+// milliseconds.
+template <typename Fn> double MedianMs(int iterations, Fn&& fn)
+{
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(
+            std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::ranges::sort(samples);
+    return samples[samples.size() / 2];
+}
+
+// Silences log output from the code under measurement.
+class ScopedLogLevel {
+public:
+    explicit ScopedLogLevel(spdlog::level::level_enum level)
+        : m_previous(spdlog::get_level())
+    {
+        spdlog::set_level(level);
+    }
+    ~ScopedLogLevel() { spdlog::set_level(m_previous); }
+
+private:
+    spdlog::level::level_enum m_previous;
+};
+
+// Returns the meshes named on the command line, or every OBJ in meshes/.
+std::vector<std::string> MeshPaths(BenchArgs args);
+
+int RunCullBench(BenchArgs args);
+int RunImportBench(BenchArgs args);
+int RunJobBench(BenchArgs args);
+int RunLightBench(BenchArgs args);
+int RunLodBench(BenchArgs args);
+int RunMaterialBench(BenchArgs args);
+int RunMeshCacheBench(BenchArgs args);
+int RunMeshOptimizerBench(BenchArgs args);
+int RunMeshletBench(BenchArgs args);
+int RunOcclusionBench(BenchArgs args);
+int RunPackBench(BenchArgs args);
+int RunPacingBench(BenchArgs args);
+int RunProfilerBench(BenchArgs args);
+int RunRenderQueueBench(BenchArgs args);
+int RunRenderThreadBench(BenchArgs args);
+int RunSceneBench(BenchArgs args);
+int RunShadowBench(BenchArgs args);
+int RunTextureBench(BenchArgs args);
+int RunTransformBench(BenchArgs args);
+int RunVertexLayoutBench(BenchArgs args);
+int RunWeldBench(BenchArgs args);
+
+} // namespace Umbrella::Bench
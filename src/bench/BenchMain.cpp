@@ -0,0 +1,106 @@
+#include "Bench.h"
+
+#include <filesystem>
+#include <string_view>
+
+namespace Umbrella::Bench {
+
+std::vector<std::string> MeshPaths(BenchArgs args)
+{
+    std::vector<std::string> paths(args.begin(), args.end());
+    if (paths.empty()) {
+        std::error_code error;
+        for (auto const& entry :
+            std::filesystem::directory_iterator("meshes", error)) {
+            if (entry.path().extension() == ".obj") {
+                paths.push_back(entry.path().generic_string());
+            }
+        }
+        std::ranges::sort(paths);
+    }
+    return paths;
+}
+
+} // namespace Umbrella::Bench
+
+namespace {
+
+struct BenchEntry {
+    std::string_view name;
+    std::string_view description;
+    int (*run)(Umbrella::Bench::BenchArgs args);
+};
+
+constexpr BenchEntry benches[] = {
+    {"import", "Parallel OBJ importer against tinyobj::LoadObj",
+        Umbrella::Bench::RunImportBench},
+    {"meshcache", "Baked .umesh cache against importing and welding",
+        Umbrella::Bench::RunMeshCacheBench},
+    {"meshopt", "Vertex cache, overdraw and fetch ordering, ACMR and ATVR",
+        Umbrella::Bench::RunMeshOptimizerBench},
+    {"pack", "LZ4 and .upak packs against loose files, through the VFS",
+        Umbrella::Bench::RunPackBench},
+    {"layout", "Compact vertex layouts, memory and round-trip error",
+        Umbrella::Bench::RunVertexLayoutBench},
+    {"meshlets", "Meshlet clustering, and frustum and normal cone culling",
+        Umbrella::Bench::RunMeshletBench},
+    {"cull", "Scalar, SSE and AVX frustum culling of 1M bounding spheres",
+        Umbrella::Bench::RunCullBench},
+    {"lod", "LOD chain simplification and screen-space error selection",
+        Umbrella::Bench::RunLodBench},
+    {"occlusion", "CPU occluder rasterization and hierarchical depth tests",
+        Umbrella::Bench::RunOcclusionBench},
+    {"lights", "Clustered light binning of 1k and 10k point lights",
+        Umbrella::Bench::RunLightBench},
+    {"shadows", "Cached shadow cascades along a walking camera path",
+        Umbrella::Bench::RunShadowBench},
+    {"transforms", "SoA transform hierarchy updates of 100k nodes",
+        Umbrella::Bench::RunTransformBench},
+    {"scene", "Instanced indirect draw list building for 1k-100k instances",
+        Umbrella::Bench::RunSceneBench},
+    {"material", "Per-material shape ranges through LODs and draw lists",
+        Umbrella::Bench::RunMaterialBench},
+    {"texture", "BC1, BC3 and BC7 encoding throughput, PSNR and caching",
+        Umbrella::Bench::RunTextureBench},
+    {"jobs", "Job system scheduling, dependencies and a loading graph",
+        Umbrella::Bench::RunJobBench},
+    {"queue", "Radix-sorted render queue and state cache on a mock GL",
+        Umbrella::Bench::RunRenderQueueBench},
+    {"render", "Render thread frame packets against a serial frame loop",
+        Umbrella::Bench::RunRenderThreadBench},
+    {"pacing", "Fixed timestep, sleep and spin frame limiter, mouse input",
+        Umbrella::Bench::RunPacingBench},
+    {"profiler", "Profiler zone cost outside and inside a capture",
+        Umbrella::Bench::RunProfilerBench},
+    {"weld", "Flat parallel vertex welder against the unordered_map one",
+        Umbrella::Bench::RunWeldBench},
+};
+
+void PrintUsage()
+{
+    spdlog::info("Usage: UmbrellaBench <bench> [args...], run from data/");
+    for (BenchEntry const& bench : benches) {
+        spdlog::info("  {:<12} {}", bench.name, bench.description);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string_view name = argv[1];
+    for (BenchEntry const& bench : benches) {
+        if (bench.name == name) {
+            return bench.run({argv + 2, argv + argc});
+        }
+    }
+
+    spdlog::error("Unknown bench '{}'", name);
+    PrintUsage();
+    return 1;
+}
@@ -0,0 +1,110 @@
+#include "Bench.h"
+
+#include <cstdlib>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "systems/FrustumCulling.h"
+#include "util/Simd.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    using CullFn = void (*)(
+        Frustum const&, BoundingSpheres const&, std::span<uint8_t>);
+
+    struct CullCase {
+        char const* name;
+        CullFn fn;
+        bool supported;
+    };
+
+    // Cameras at the center of the cloud of spheres, looking along a few
+    // directions, including straight down the axes where planes have zero
+    // components.
+    std::vector<Frustum> MakeFrusta()
+    {
+        glm::mat4 projection = glm::perspective(
+            glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+        std::vector<Frustum> frusta;
+        for (glm::vec3 direction : {glm::vec3(0.0f, 0.0f, -1.0f),
+                 glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.3f, -0.2f, 0.9f),
+                 glm::vec3(-0.7f, 0.1f, -0.7f)}) {
+            glm::vec3 up = std::abs(direction.y) > 0.9f
+                ? glm::vec3(1.0f, 0.0f, 0.0f)
+                : glm::vec3(0.0f, 1.0f, 0.0f);
+            frusta.push_back(ExtractFrustum(projection
+                * glm::lookAt(glm::vec3(0.0f), direction, up)));
+        }
+        return frusta;
+    }
+
+} // namespace
+
+int RunCullBench(BenchArgs args)
+{
+    size_t count = 1'000'000;
+    if (!args.empty()) {
+        count = std::strtoull(args.front(), nullptr, 10);
+    }
+
+    // Spheres scattered through a cube twice the far plane wide, so some
+    // sit on every plane of the frustum. One more than a multiple of eight
+    // to exercise the scalar tails.
+    count = count / 8 * 8 + 1;
+    BoundingSpheres spheres;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> radius(0.1f, 20.0f);
+    for (size_t i = 0; i < count; i++) {
+        spheres.Push({position(random), position(random), position(random)},
+            radius(random));
+    }
+
+    CullCase const cases[] = {
+        {"scalar", CullSpheresScalar, true},
+        {"sse", CullSpheresSse, true},
+        {"avx", CullSpheresAvx, Util::HasAvx()},
+    };
+
+    spdlog::info("{} spheres", count);
+    spdlog::info("{:<8} {:<8} {:>8} {:>10} {:>12} {:>8} {:>6}", "frustum",
+        "path", "visible", "ms", "Mspheres/s", "speedup", "same");
+
+    std::vector<Frustum> frusta = MakeFrusta();
+    bool allSame = true;
+    for (size_t f = 0; f < frusta.size(); f++) {
+        std::vector<uint8_t> reference(count);
+        double referenceMs = 0.0;
+        for (CullCase const& cullCase : cases) {
+            if (!cullCase.supported) {
+                spdlog::info("{:<8} {:<8} not supported on this CPU", f,
+                    cullCase.name);
+                continue;
+            }
+
+            std::vector<uint8_t> visible(count);
+            double ms = MedianMs(9,
+                [&]() { cullCase.fn(frusta[f], spheres, visible); });
+            if (cullCase.fn == CullSpheresScalar) {
+                reference = visible;
+                referenceMs = ms;
+            }
+
+            bool same = visible == reference;
+            allSame &= same;
+            size_t numVisible
+                = static_cast<size_t>(std::ranges::count(visible, 1));
+            spdlog::info("{:<8} {:<8} {:>7.2f}% {:>10.3f} {:>12.1f} {:>7.2f}x "
+                         "{:>6}",
+                f, cullCase.name, 100.0 * numVisible / count, ms,
+                count / (ms * 1000.0), referenceMs / ms, same ? "yes" : "NO");
+        }
+    }
+
+    return allSame ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
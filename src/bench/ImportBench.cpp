@@ -0,0 +1,104 @@
+#include "Bench.h"
+
+#include <cstring>
+
+#include "assets/ObjImporter.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    template <typename T>
+    bool SameBits(std::vector<T> const& a, std::vector<T> const& b)
+    {
+        return a.size() == b.size()
+            && (a.empty()
+                || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+
+    bool SameIndices(std::vector<tinyobj::index_t> const& a,
+        std::vector<tinyobj::index_t> const& b)
+    {
+        return std::ranges::equal(a, b, [](auto const& x, auto const& y) {
+            return x.vertex_index == y.vertex_index
+                && x.normal_index == y.normal_index
+                && x.texcoord_index == y.texcoord_index;
+        });
+    }
+
+    bool SameObj(Assets::ObjData const& a, Assets::ObjData const& b)
+    {
+        if (!SameBits(a.attrib.vertices, b.attrib.vertices)
+            || !SameBits(a.attrib.vertex_weights, b.attrib.vertex_weights)
+            || !SameBits(a.attrib.normals, b.attrib.normals)
+            || !SameBits(a.attrib.texcoords, b.attrib.texcoords)
+            || !SameBits(a.attrib.texcoord_ws, b.attrib.texcoord_ws)
+            || !SameBits(a.attrib.colors, b.attrib.colors)
+            || a.shapes.size() != b.shapes.size()
+            || a.materials.size() != b.materials.size()) {
+            return false;
+        }
+
+        for (size_t s = 0; s < a.shapes.size(); s++) {
+            tinyobj::shape_t const& sa = a.shapes[s];
+            tinyobj::shape_t const& sb = b.shapes[s];
+            if (sa.name != sb.name
+                || !SameIndices(sa.mesh.indices, sb.mesh.indices)
+                || !SameBits(sa.mesh.num_face_vertices,
+                    sb.mesh.num_face_vertices)
+                || !SameBits(sa.mesh.material_ids, sb.mesh.material_ids)
+                || !SameBits(sa.mesh.smoothing_group_ids,
+                    sb.mesh.smoothing_group_ids)
+                || !SameIndices(sa.lines.indices, sb.lines.indices)
+                || !SameIndices(sa.points.indices, sb.points.indices)) {
+                return false;
+            }
+        }
+
+        for (size_t m = 0; m < a.materials.size(); m++) {
+            if (a.materials[m].name != b.materials[m].name) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+} // namespace
+
+int RunImportBench(BenchArgs args)
+{
+    constexpr int iterations = 9;
+
+    bool allIdentical = true;
+    spdlog::info("{:<32} {:>12} {:>12} {:>8} {:>10}", "mesh", "tinyobj ms",
+        "import ms", "speedup", "identical");
+    for (std::string const& path : MeshPaths(args)) {
+        Assets::ObjData reference;
+        std::optional<Assets::ObjData> imported;
+        double tinyobjMs, importMs;
+        {
+            ScopedLogLevel quiet(spdlog::level::off);
+            tinyobjMs = MedianMs(iterations, [&]() {
+                std::string warn, err;
+                reference = {};
+                tinyobj::LoadObj(&reference.attrib, &reference.shapes,
+                    &reference.materials, &warn, &err, path.c_str(),
+                    "meshes/");
+            });
+            importMs = MedianMs(iterations, [&]() {
+                imported = Assets::ImportObj(path.c_str(), "meshes/");
+            });
+        }
+
+        bool identical = imported && SameObj(reference, *imported);
+        allIdentical &= identical;
+        spdlog::info("{:<32} {:>12.3f} {:>12.3f} {:>7.2f}x {:>10}", path,
+            tinyobjMs, importMs, tinyobjMs / importMs,
+            identical ? "yes" : "NO");
+    }
+
+    return allIdentical ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
@@ -0,0 +1,219 @@
+#include "Bench.h"
+
+#include <atomic>
+#include <thread>
+
+#include "util/JobSystem.h"
+#include "util/Profiler.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    // Stands in for parsing or decoding: busy work the compiler cannot
+    // drop, roughly `micros` long.
+    uint64_t Work(uint32_t micros)
+    {
+        auto end = std::chrono::steady_clock::now()
+            + std::chrono::microseconds(micros);
+        uint64_t state = micros;
+        while (std::chrono::steady_clock::now() < end) {
+            for (int i = 0; i < 64; i++) {
+                state = state * 6364136223846793005ull + 1442695040888963407ull;
+            }
+        }
+        return state;
+    }
+
+    // Many tiny independent jobs, to measure the scheduling overhead.
+    bool RunFanOut(Util::JobSystem& jobs)
+    {
+        constexpr size_t numJobs = 20000;
+        std::atomic<size_t> numRun = 0;
+        double ms = MedianMs(5, [&]() {
+            numRun = 0;
+            std::vector<Util::JobHandle> handles;
+            handles.reserve(numJobs);
+            for (size_t j = 0; j < numJobs; j++) {
+                handles.push_back(jobs.Schedule("fan", [&]() { numRun++; }));
+            }
+            jobs.Wait(handles);
+        });
+        bool passed = numRun == numJobs;
+        spdlog::info("{:<12} {:>8} {:>10.2f} {:>12.0f} {:>6}", "fan-out",
+            numJobs, ms, static_cast<double>(numJobs) / ms * 1e3,
+            passed ? "yes" : "NO");
+        return passed;
+    }
+
+    // Layers of jobs that each depend on two jobs of the layer above, some
+    // of them main thread only. Every job has to start after its
+    // dependencies finished, and main thread jobs on the main thread.
+    bool RunGraph(Util::JobSystem& jobs)
+    {
+        constexpr size_t width = 16;
+        constexpr size_t depth = 32;
+        constexpr size_t numJobs = width * depth;
+        std::vector<size_t> started(numJobs), finished(numJobs);
+        std::atomic<size_t> clock = 0;
+        std::atomic<bool> affinityOk = true;
+        std::thread::id mainThread = std::this_thread::get_id();
+
+        double ms = MedianMs(5, [&]() {
+            std::vector<Util::JobHandle> handles(numJobs);
+            for (size_t layer = 0; layer < depth; layer++) {
+                for (size_t x = 0; x < width; x++) {
+                    size_t j = layer * width + x;
+                    std::vector<Util::JobHandle> dependencies;
+                    if (layer > 0) {
+                        dependencies.push_back(handles[j - width]);
+                        dependencies.push_back(
+                            handles[(layer - 1) * width + (x + 1) % width]);
+                    }
+                    bool onMain = x % 4 == 0;
+                    handles[j] = jobs.Schedule(
+                        "graph",
+                        [&, j, onMain]() {
+                            started[j] = clock++;
+                            Work(20);
+                            if (onMain
+                                && std::this_thread::get_id() != mainThread) {
+                                affinityOk = false;
+                            }
+                            finished[j] = clock++;
+                        },
+                        dependencies,
+                        onMain ? Util::JobAffinity::MainThread
+                               : Util::JobAffinity::Any);
+                }
+            }
+            jobs.Wait(handles);
+        });
+
+        bool orderOk = true;
+        for (size_t j = width; j < numJobs; j++) {
+            size_t layer = j / width;
+            size_t x = j % width;
+            size_t right = (layer - 1) * width + (x + 1) % width;
+            orderOk &= started[j] > finished[j - width]
+                && started[j] > finished[right];
+        }
+        bool passed = orderOk && affinityOk;
+        spdlog::info("{:<12} {:>8} {:>10.2f} {:>12.0f} {:>6}", "graph",
+            numJobs, ms, static_cast<double>(numJobs) / ms * 1e3,
+            passed ? "yes" : "NO");
+        return passed;
+    }
+
+    // Jobs that schedule and wait on jobs of their own, as ParallelFor does
+    // inside asset jobs. Waiting has to run other work instead of blocking
+    // the worker, or this deadlocks once every worker waits.
+    bool RunNested(Util::JobSystem& jobs)
+    {
+        constexpr size_t numOuter = 32;
+        constexpr size_t numInner = 16;
+        std::atomic<size_t> numRun = 0;
+        double ms = MedianMs(5, [&]() {
+            numRun = 0;
+            std::vector<Util::JobHandle> outer;
+            for (size_t o = 0; o < numOuter; o++) {
+                outer.push_back(jobs.Schedule("outer", [&]() {
+                    std::vector<Util::JobHandle> inner;
+                    for (size_t i = 0; i < numInner; i++) {
+                        inner.push_back(jobs.Schedule("inner", [&]() {
+                            Work(10);
+                            numRun++;
+                        }));
+                    }
+                    jobs.Wait(inner);
+                }));
+            }
+            jobs.Wait(outer);
+        });
+        bool passed = numRun == numOuter * numInner;
+        spdlog::info("{:<12} {:>8} {:>10.2f} {:>12.0f} {:>6}", "nested",
+            numOuter * numInner, ms,
+            static_cast<double>(numOuter * numInner) / ms * 1e3,
+            passed ? "yes" : "NO");
+        return passed;
+    }
+
+    // The shape of Prepare(): shaders and meshes load side by side, meshes
+    // are packed once all have loaded, and the GL work waits on both. Run
+    // serially and as a graph, to show how startup scales with the cores.
+    bool RunLoadGraph(Util::JobSystem& jobs, char const* tracePath)
+    {
+        constexpr size_t numMeshes = 12;
+        constexpr uint32_t meshMicros = 4000;
+        constexpr uint32_t shaderMicros = 3000;
+        constexpr uint32_t textureMicros = 6000;
+        constexpr uint32_t packMicros = 1000;
+        constexpr uint32_t uploadMicros = 500;
+
+        double serialMs = MedianMs(3, [&]() {
+            Work(shaderMicros);
+            for (size_t m = 0; m < numMeshes; m++) {
+                Work(meshMicros);
+            }
+            Work(textureMicros);
+            Work(packMicros);
+            Work(uploadMicros);
+        });
+
+        auto runGraph = [&]() {
+            Util::JobHandle shaders = jobs.Schedule(
+                "Compile shaders", [&]() { Work(shaderMicros); });
+            Util::JobHandle texture = jobs.Schedule(
+                "Decode texture", [&]() { Work(textureMicros); });
+            std::vector<Util::JobHandle> meshes;
+            for (size_t m = 0; m < numMeshes; m++) {
+                meshes.push_back(jobs.Schedule("Load mesh " + std::to_string(m),
+                    [&]() { Work(meshMicros); }));
+            }
+            Util::JobHandle pack = jobs.Schedule(
+                "Pack meshes", [&]() { Work(packMicros); }, meshes);
+            Util::JobHandle const uploadDependencies[] = {shaders, pack};
+            Util::JobHandle upload = jobs.Schedule(
+                "Upload meshes", [&]() { Work(uploadMicros); },
+                uploadDependencies, Util::JobAffinity::MainThread);
+            Util::JobHandle const all[] = {upload, texture};
+            jobs.Wait(all);
+        };
+        double graphMs = MedianMs(3, runGraph);
+
+        bool traceOk = true;
+        if (tracePath) {
+            Util::Profiler& profiler = Util::Profiler::Instance();
+            profiler.BeginCapture();
+            runGraph();
+            traceOk = profiler.EndCapture(tracePath);
+        }
+
+        spdlog::info("{:<12} {:>8} {:>10.2f} {:>12} {:>6}", "load serial",
+            numMeshes + 4, serialMs, "-", "yes");
+        spdlog::info("{:<12} {:>8} {:>10.2f} {:>11.2f}x {:>6}", "load graph",
+            numMeshes + 4, graphMs, serialMs / graphMs,
+            traceOk ? "yes" : "NO");
+        return traceOk;
+    }
+
+} // namespace
+
+int RunJobBench(BenchArgs args)
+{
+    char const* tracePath = args.empty() ? nullptr : args[0];
+
+    Util::JobSystem& jobs = Util::JobSystem::Instance();
+    Util::Profiler::Instance().SetThreadName("main");
+    spdlog::info("{} workers besides the main thread", jobs.NumWorkers());
+    spdlog::info("{:<12} {:>8} {:>10} {:>12} {:>6}", "case", "jobs", "ms",
+        "jobs/s", "ok");
+
+    bool allPassed = RunFanOut(jobs);
+    allPassed &= RunGraph(jobs);
+    allPassed &= RunNested(jobs);
+    allPassed &= RunLoadGraph(jobs, tracePath);
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
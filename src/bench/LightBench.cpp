@@ -0,0 +1,215 @@
+#include "Bench.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <optional>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "systems/LightClusters.h"
+#include "util/Parallel.h"
+#include "util/Simd.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    constexpr float viewportWidth = 1920.0f;
+    constexpr float viewportHeight = 1080.0f;
+
+    ClusterView MakeView()
+    {
+        return {
+            .view = glm::lookAt(glm::vec3(0.0f, 2.0f, 10.0f),
+                glm::vec3(0.0f, 0.0f, -50.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+            .verticalFov = glm::radians(45.0f),
+            .aspect = viewportWidth / viewportHeight,
+            .nearPlane = 0.1f,
+            .farPlane = 1000.0f,
+        };
+    }
+
+    // A street's worth of small lights in front of the camera, some of
+    // them off screen.
+    std::vector<PointLight> MakeLights(size_t count)
+    {
+        std::mt19937 random(static_cast<uint32_t>(count));
+        std::uniform_real_distribution<float> x(-80.0f, 80.0f);
+        std::uniform_real_distribution<float> y(-10.0f, 30.0f);
+        std::uniform_real_distribution<float> z(-200.0f, 0.0f);
+        std::uniform_real_distribution<float> radius(1.0f, 6.0f);
+        std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+        std::vector<PointLight> lights(count);
+        for (PointLight& light : lights) {
+            light = {
+                .position = {x(random), y(random), z(random)},
+                .radius = radius(random),
+                .color = {channel(random), channel(random), channel(random)},
+                .intensity = 1.0f,
+            };
+        }
+        return lights;
+    }
+
+    struct Binned {
+        std::vector<ClusterRange> clusters;
+        std::vector<uint32_t> indices;
+        LightBinStats stats;
+
+        bool operator==(Binned const& other) const
+        {
+            return std::ranges::equal(clusters, other.clusters,
+                       [](ClusterRange a, ClusterRange b) {
+                           return a.offset == b.offset && a.count == b.count;
+                       })
+                && std::equal(indices.begin(),
+                    indices.begin() + stats.numIndices, other.indices.begin(),
+                    other.indices.begin() + other.stats.numIndices);
+        }
+    };
+
+    Binned Bin(LightClusters& clusters, std::span<PointLight const> lights,
+        double& medianMs)
+    {
+        Binned binned {
+            .clusters = std::vector<ClusterRange>(clusters.NumClusters()),
+            .indices = std::vector<uint32_t>(clusters.MaxLightIndices()),
+            .stats = {},
+        };
+        ClusterView view = MakeView();
+        medianMs = MedianMs(5, [&]() {
+            binned.stats = clusters.BinLights(
+                view, lights, {binned.clusters, binned.indices});
+        });
+        return binned;
+    }
+
+    // Finds the cluster of points on screen the way the fragment shader
+    // does, and checks that every light reaching a point is in its
+    // cluster's list.
+    bool CheckCoverage(LightClusters const& clusters, Binned const& binned,
+        std::span<PointLight const> lights)
+    {
+        ClusterView view = MakeView();
+        ClusterLookup lookup
+            = clusters.Lookup(view, viewportWidth, viewportHeight);
+        glm::mat4 viewToWorld = glm::inverse(view.view);
+        float halfHeight = std::tan(0.5f * view.verticalFov);
+
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> ndc(-0.999f, 0.999f);
+        std::uniform_real_distribution<float> depth(1.0f, 250.0f);
+        uint64_t checked = 0;
+        uint64_t missing = 0;
+        for (int p = 0; p < 20000; p++) {
+            glm::vec2 screen(ndc(random), ndc(random));
+            float d = depth(random);
+            glm::vec3 world = viewToWorld
+                * glm::vec4(screen.x * d * halfHeight * view.aspect,
+                    screen.y * d * halfHeight, -d, 1.0f);
+
+            glm::vec2 fragCoord = (screen * 0.5f + 0.5f)
+                * glm::vec2(viewportWidth, viewportHeight);
+            glm::uvec3 cluster(
+                glm::min(glm::uvec2(fragCoord * glm::vec2(lookup.scale.z,
+                                        lookup.scale.w)),
+                    glm::uvec2(lookup.grid) - 1u),
+                std::min(static_cast<uint32_t>(std::max(
+                             std::log(d / lookup.scale.x) * lookup.scale.y,
+                             0.0f)),
+                    lookup.grid.z - 1));
+            ClusterRange range = binned.clusters[(cluster.z * lookup.grid.y
+                                                     + cluster.y)
+                    * lookup.grid.x
+                + cluster.x];
+            auto listed = std::span(binned.indices)
+                              .subspan(range.offset, range.count);
+
+            for (uint32_t l = 0; l < lights.size(); l++) {
+                // A hair inside the radius, so rounding in the view
+                // transform cannot decide it.
+                if (glm::distance(world, lights[l].position)
+                    >= lights[l].radius * 0.999f) {
+                    continue;
+                }
+                checked++;
+                missing += std::ranges::find(listed, l) == listed.end();
+            }
+        }
+        spdlog::info("{} lit points checked against their clusters, {} "
+                     "lights missing",
+            checked, missing);
+        return checked > 0 && missing == 0;
+    }
+
+    bool RunCount(size_t count)
+    {
+        std::vector<PointLight> lights = MakeLights(count);
+        // Enough room that nothing overflows, so coverage can be checked.
+        LightClusterOptions options {.maxLightsPerCluster = 1024};
+
+        struct BinCase {
+            char const* name;
+            LightBinMethod method;
+            bool parallel;
+            bool supported;
+        };
+        BinCase const cases[] = {
+            {"scalar", LightBinMethod::Scalar, false, true},
+            {"sse", LightBinMethod::Sse, false, true},
+            {"avx", LightBinMethod::Avx, false, Util::HasAvx()},
+            {"widest, mt", LightBinMethod::Widest, true, true},
+        };
+
+        spdlog::info("{} lights, {} workers", count, Util::WorkerCount());
+        spdlog::info("{:<12} {:>9} {:>8} {:>10} {:>9} {:>6} {:>8} {:>6}",
+            "path", "ms", "speedup", "visible", "avg/clu", "max", "overflow",
+            "same");
+        std::optional<Binned> reference;
+        double referenceMs = 0.0;
+        bool allPassed = true;
+        for (BinCase const& binCase : cases) {
+            if (!binCase.supported) {
+                spdlog::info("{:<12} not supported on this CPU", binCase.name);
+                continue;
+            }
+            options.method = binCase.method;
+            options.parallel = binCase.parallel;
+            LightClusters clusters(options);
+            double ms = 0.0;
+            Binned binned = Bin(clusters, lights, ms);
+            if (!reference) {
+                reference = binned;
+                referenceMs = ms;
+                allPassed &= CheckCoverage(clusters, binned, lights);
+            }
+            bool same = binned == *reference;
+            allPassed &= same;
+            LightBinStats const& stats = binned.stats;
+            spdlog::info(
+                "{:<12} {:>9.3f} {:>7.2f}x {:>10} {:>9.1f} {:>6} {:>8} {:>6}",
+                binCase.name, ms, referenceMs / ms, stats.numVisible,
+                stats.AverageLightsPerCluster(), stats.maxPerCluster,
+                stats.numOverflowed, same ? "yes" : "NO");
+        }
+        return allPassed;
+    }
+
+} // namespace
+
+int RunLightBench(BenchArgs args)
+{
+    std::vector<size_t> counts = {1000, 10000};
+    if (!args.empty()) {
+        counts = {
+            std::max<size_t>(std::strtoull(args.front(), nullptr, 10), 1)};
+    }
+    bool allPassed = true;
+    for (size_t count : counts) {
+        allPassed &= RunCount(count);
+    }
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
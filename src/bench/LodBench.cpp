@@ -0,0 +1,117 @@
+#include "Bench.h"
+
+#include <cmath>
+
+#include "assets/MeshBuilder.h"
+#include "assets/MeshSimplifier.h"
+#include "systems/LodSelector.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    bool RunMesh(std::string const& name, Assets::MeshData const& source)
+    {
+        constexpr int iterations = 3;
+
+        Assets::MeshData mesh;
+        double buildMs = MedianMs(iterations, [&]() {
+            mesh = source;
+            Assets::BuildLodChain(mesh);
+        });
+
+        float diagonal = glm::length(mesh.bounds.max - mesh.bounds.min);
+        uint32_t fullTriangles = mesh.lods.front().indexCount / 3;
+        for (size_t l = 0; l < mesh.lods.size(); l++) {
+            Assets::MeshLod const& lod = mesh.lods[l];
+            spdlog::info("{:<28} lod {:<2} {:>9} {:>7.1f}% {:>10.5f} "
+                         "{:>8.3f}%",
+                name, l, lod.indexCount / 3,
+                100.0 * lod.indexCount / 3 / fullTriangles, lod.error,
+                diagonal > 0.0f ? 100.0f * lod.error / diagonal : 0.0f);
+        }
+
+        // Fly the camera away and back, as Render() would see it at 1080p,
+        // and count triangles drawn against always drawing LOD 0.
+        LodView view {
+            .cameraPosition = {},
+            .verticalFov = glm::radians(45.0f),
+            .viewportHeight = 1080.0f,
+        };
+        glm::vec3 center = 0.5f * (mesh.bounds.min + mesh.bounds.max);
+        float radius = 0.5f * diagonal;
+
+        LodSelector selector;
+        constexpr int numFrames = 2000;
+        uint64_t drawn = 0;
+        int switches = 0;
+        size_t previous = 0;
+        for (int frame = 0; frame < numFrames; frame++) {
+            float t = static_cast<float>(frame) / (numFrames - 1);
+            // Out to 200 radii and back, with a little jitter so hysteresis
+            // has something to absorb.
+            float distance = radius
+                * (1.5f + 200.0f * (1.0f - std::abs(2.0f * t - 1.0f)))
+                * (1.0f + 0.01f * std::sin(static_cast<float>(frame)));
+            view.cameraPosition = center + glm::vec3(0.0f, 0.0f, distance);
+
+            size_t lod = selector.Select(mesh.lods, center, radius, view);
+            drawn += mesh.lods[lod].indexCount / 3;
+            switches += frame > 0 && lod != previous;
+            previous = lod;
+        }
+
+        uint64_t full = uint64_t(fullTriangles) * numFrames;
+        spdlog::info("{:<28} built in {:.3f} ms; sweep draws {:.0f} triangles "
+                     "per frame instead of {}, {:.1f}% saved, {} LOD switches",
+            name, buildMs, static_cast<double>(drawn) / numFrames,
+            fullTriangles, full == 0 ? 0.0 : 100.0 * (full - drawn) / full,
+            switches);
+
+        // Without flip-flopping, the sweep passes each LOD boundary once on
+        // the way out and once on the way back.
+        int maxSwitches = 2 * static_cast<int>(mesh.lods.size() - 1);
+        if (switches > maxSwitches) {
+            spdlog::info("{:<28} LOD flip-flopped: {} switches, expected at "
+                         "most {}",
+                name, switches, maxSwitches);
+            return false;
+        }
+
+        // Coarser LODs must be smaller and no more accurate.
+        bool monotonic = true;
+        for (size_t l = 1; l < mesh.lods.size(); l++) {
+            monotonic &= mesh.lods[l].indexCount < mesh.lods[l - 1].indexCount
+                && mesh.lods[l].error >= mesh.lods[l - 1].error;
+        }
+        return monotonic;
+    }
+
+} // namespace
+
+int RunLodBench(BenchArgs args)
+{
+    spdlog::info("{:<28} {:<6} {:>9} {:>8} {:>10} {:>9}", "mesh", "lod",
+        "triangles", "of lod0", "error", "of diag");
+
+    bool allPassed = true;
+    for (std::string const& path : MeshPaths(args)) {
+        std::optional<Assets::ObjData> obj;
+        {
+            ScopedLogLevel quiet(spdlog::level::off);
+            obj = Assets::ImportObj(path.c_str(), "meshes/");
+        }
+        Assets::MeshData mesh;
+        if (!obj
+            || Assets::BuildMesh(*obj, mesh)
+                != Assets::MeshBuildResult::BuildOk) {
+            spdlog::info("{:<28} skipped, not a renderable mesh", path);
+            continue;
+        }
+        allPassed &= RunMesh(path, mesh);
+    }
+
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
@@ -0,0 +1,250 @@
+#include "Bench.h"
+
+#include <cstring>
+#include <filesystem>
+#include <set>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "assets/MeshBuilder.h"
+#include "assets/MeshOptimizer.h"
+#include "assets/MeshSimplifier.h"
+#include "assets/ObjImporter.h"
+#include "systems/Scene.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    constexpr uint32_t gridSize = 64;
+    // Rows of quads in the middle that have no material.
+    constexpr uint32_t stripeBegin = 28;
+    constexpr uint32_t stripeEnd = 36;
+
+    // Left half material 0, right half material 1, with a stripe across
+    // both that falls back to the default material.
+    int RegionMaterial(float x, float y)
+    {
+        float stripeY0 = static_cast<float>(stripeBegin) / gridSize;
+        float stripeY1 = static_cast<float>(stripeEnd) / gridSize;
+        if (y >= stripeY0 && y < stripeY1) {
+            return -1;
+        }
+        return x < 0.5f ? 0 : 1;
+    }
+
+    // A flat grid in one OBJ shape, its faces split between two materials
+    // and none.
+    Assets::ObjData MakeGrid()
+    {
+        Assets::ObjData obj;
+        obj.materialBaseDir = "meshes/";
+        for (uint32_t y = 0; y <= gridSize; y++) {
+            for (uint32_t x = 0; x <= gridSize; x++) {
+                float u = static_cast<float>(x) / gridSize;
+                float v = static_cast<float>(y) / gridSize;
+                obj.attrib.vertices.insert(
+                    obj.attrib.vertices.end(), {u, v, 0.0f});
+                obj.attrib.texcoords.insert(
+                    obj.attrib.texcoords.end(), {u, v});
+            }
+        }
+        obj.attrib.normals = {0.0f, 0.0f, 1.0f};
+
+        for (char const* texture : {"capsule.jpg", ""}) {
+            tinyobj::material_t material {};
+            material.diffuse[0] = material.diffuse[1] = material.diffuse[2]
+                = 1.0f;
+            material.dissolve = 1.0f;
+            material.diffuse_texname = texture;
+            obj.materials.push_back(material);
+        }
+
+        tinyobj::shape_t shape;
+        auto corner = [&](uint32_t x, uint32_t y) {
+            int index = static_cast<int>(y * (gridSize + 1) + x);
+            return tinyobj::index_t {index, 0, index};
+        };
+        for (uint32_t y = 0; y < gridSize; y++) {
+            for (uint32_t x = 0; x < gridSize; x++) {
+                int material = RegionMaterial(
+                    (static_cast<float>(x) + 0.5f) / gridSize,
+                    (static_cast<float>(y) + 0.5f) / gridSize);
+                shape.mesh.indices.insert(shape.mesh.indices.end(),
+                    {corner(x, y), corner(x + 1, y), corner(x + 1, y + 1),
+                        corner(x, y), corner(x + 1, y + 1),
+                        corner(x, y + 1)});
+                shape.mesh.num_face_vertices.insert(
+                    shape.mesh.num_face_vertices.end(), {3, 3});
+                shape.mesh.material_ids.insert(
+                    shape.mesh.material_ids.end(), {material, material});
+            }
+        }
+        obj.shapes.push_back(std::move(shape));
+        return obj;
+    }
+
+    // Every LOD has to be covered by its shape ranges without gaps, and
+    // every triangle of a range has to lie in the region of its material.
+    bool CheckRanges(Assets::MeshData const& mesh, uint32_t defaultMaterial)
+    {
+        bool allPassed = true;
+        spdlog::info("{:<6} {:>10} {:>8} {:>10}", "lod", "triangles",
+            "ranges", "ok");
+        for (size_t l = 0; l < mesh.lods.size(); l++) {
+            Assets::MeshLod const& lod = mesh.lods[l];
+            bool ok = lod.numShapes > 0;
+            uint32_t next = lod.firstIndex;
+            for (uint32_t s = lod.firstShape;
+                s < lod.firstShape + lod.numShapes; s++) {
+                Assets::MeshShapeRange const& shape = mesh.shapes[s];
+                ok &= shape.firstIndex == next;
+                next = shape.firstIndex + shape.indexCount;
+                for (uint32_t i = shape.firstIndex; i < next; i += 3) {
+                    glm::vec2 centroid(0.0f);
+                    for (uint32_t c = 0; c < 3; c++) {
+                        Assets::Vertex const& v
+                            = mesh.vertices[mesh.indices[i + c]];
+                        centroid += glm::vec2(v.x, v.y) / 3.0f;
+                    }
+                    int expected = RegionMaterial(centroid.x, centroid.y);
+                    ok &= shape.material
+                        == (expected < 0 ? defaultMaterial
+                                         : static_cast<uint32_t>(expected));
+                }
+            }
+            ok &= next == lod.firstIndex + lod.indexCount;
+            spdlog::info("{:<6} {:>10} {:>8} {:>10}", l, lod.indexCount / 3,
+                lod.numShapes, ok ? "yes" : "NO");
+            allPassed &= ok;
+        }
+        return allPassed;
+    }
+
+    // The scene draws whichever LOD it picks with one command per range of
+    // it, all of them over the same instances.
+    bool CheckDrawList(Assets::MeshData const& mesh)
+    {
+        Assets::MeshView view = ViewOf(mesh);
+        SceneGeometry geometry = PackSceneGeometry({&view, 1}, {});
+        size_t numMaterials = geometry.materials.size();
+        Scene scene(std::move(geometry.meshes));
+        constexpr uint32_t numInstances = 4;
+        for (uint32_t i = 0; i < numInstances; i++) {
+            scene.AddInstance(glm::mat4(1.0f), 0);
+        }
+
+        glm::vec3 eye(0.5f, 0.5f, 1.5f);
+        glm::mat4 viewProjection
+            = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f)
+            * glm::lookAt(eye, glm::vec3(0.5f, 0.5f, 0.0f),
+                glm::vec3(0.0f, 1.0f, 0.0f));
+        std::vector<DrawCommand> commands(scene.MaxDraws());
+        std::vector<DrawRecord> records(scene.MaxDraws());
+        std::vector<glm::mat4> transforms(scene.NumInstances());
+        DrawListStats stats = scene.BuildDrawList(
+            {
+                .viewProjection = viewProjection,
+                .lod = {
+                    .cameraPosition = eye,
+                    .verticalFov = glm::radians(45.0f),
+                    .viewportHeight = 1080.0f,
+                },
+            },
+            {commands, records, transforms});
+
+        auto drawn = std::ranges::find_if(
+            mesh.lods, [&](Assets::MeshLod const& lod) {
+                return uint64_t {lod.indexCount} / 3 * numInstances
+                    == stats.numTriangles;
+            });
+        if (drawn == mesh.lods.end()) {
+            spdlog::error("The draw list matches none of the LODs");
+            return false;
+        }
+        bool ok = stats.numDraws == drawn->numShapes;
+        uint32_t indices = 0;
+        for (uint32_t d = 0; d < stats.numDraws; d++) {
+            ok &= commands[d].instanceCount == numInstances
+                && records[d].firstInstance == 0
+                && records[d].material < numMaterials;
+            indices += commands[d].count;
+        }
+        ok &= indices == drawn->indexCount;
+        spdlog::info("{} instances of LOD {} drawn in {} commands, one per "
+                     "range: {}",
+            numInstances, drawn - mesh.lods.begin(), stats.numDraws,
+            ok ? "yes" : "NO");
+        return ok;
+    }
+
+    // What the OBJ files on disk use: materials, the ranges they split the
+    // shapes into, and the distinct textures behind them.
+    bool ReportMeshes(BenchArgs args)
+    {
+        bool allFound = true;
+        spdlog::info("{:<28} {:>10} {:>8} {:>9}", "mesh", "materials",
+            "ranges", "textures");
+        for (std::string const& path : MeshPaths(args)) {
+            std::optional<Assets::ObjData> obj;
+            {
+                ScopedLogLevel quiet(spdlog::level::err);
+                obj = Assets::ImportObj(path.c_str(), "meshes/");
+            }
+            Assets::MeshData mesh;
+            if (!obj
+                || Assets::BuildMesh(*obj, mesh)
+                    != Assets::MeshBuildResult::BuildOk) {
+                spdlog::info("{:<28} skipped, not a renderable mesh", path);
+                continue;
+            }
+
+            std::set<std::string> textures;
+            for (Assets::MeshMaterial const& material : mesh.materials) {
+                std::string texture(material.diffuseTexture);
+                if (texture.empty()) {
+                    continue;
+                }
+                textures.insert(texture);
+                if (!std::filesystem::is_regular_file(texture)) {
+                    spdlog::error("{} names missing texture {}", path, texture);
+                    allFound = false;
+                }
+            }
+            spdlog::info("{:<28} {:>10} {:>8} {:>9}", path,
+                mesh.materials.size(), mesh.shapes.size(), textures.size());
+        }
+        return allFound;
+    }
+
+} // namespace
+
+int RunMaterialBench(BenchArgs args)
+{
+    constexpr int iterations = 5;
+    Assets::ObjData obj = MakeGrid();
+
+    Assets::MeshData mesh;
+    bool built = true;
+    double buildMs = MedianMs(iterations, [&]() {
+        built &= Assets::BuildMesh(obj, mesh)
+            == Assets::MeshBuildResult::BuildOk;
+    });
+    double lodMs = MedianMs(1, [&]() { Assets::BuildLodChain(mesh); });
+    Assets::OptimizeMesh(mesh);
+    spdlog::info("{}x{} grid with {} materials: built and split in {:.3f} "
+                 "ms, {} LODs in {:.3f} ms",
+        gridSize, gridSize, mesh.materials.size(), buildMs, mesh.lods.size(),
+        lodMs);
+
+    uint32_t defaultMaterial = static_cast<uint32_t>(obj.materials.size());
+    bool allPassed = built && mesh.materials.size() == 3 && mesh.lods.size() > 1
+        && std::strcmp(mesh.materials[0].diffuseTexture, "meshes/capsule.jpg")
+            == 0;
+    allPassed &= CheckRanges(mesh, defaultMaterial);
+    allPassed &= CheckDrawList(mesh);
+    allPassed &= ReportMeshes(args);
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
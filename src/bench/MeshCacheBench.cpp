@@ -0,0 +1,133 @@
+#include "Bench.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "assets/MeshBuilder.h"
+#include "assets/MeshCache.h"
+#include "assets/ObjImporter.h"
+#include "systems/Scene.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    bool SameMesh(Assets::MeshView a, Assets::MeshView b)
+    {
+        return std::ranges::equal(a.vertices, b.vertices)
+            && std::ranges::equal(a.indices, b.indices)
+            && a.shapes.size() == b.shapes.size()
+            && std::memcmp(a.shapes.data(), b.shapes.data(),
+                   a.shapes.size_bytes())
+            == 0
+            && a.lods.size() == b.lods.size()
+            && std::memcmp(a.lods.data(), b.lods.data(), a.lods.size_bytes())
+            == 0
+            && a.materials.size() == b.materials.size()
+            && std::memcmp(a.materials.data(), b.materials.data(),
+                   a.materials.size_bytes())
+            == 0
+            && a.meshlets.size() == b.meshlets.size()
+            && std::memcmp(a.meshlets.data(), b.meshlets.data(),
+                   a.meshlets.size_bytes())
+            == 0
+            && a.bounds.min == b.bounds.min && a.bounds.max == b.bounds.max;
+    }
+
+} // namespace
+
+int RunMeshCacheBench(BenchArgs args)
+{
+    constexpr int iterations = 9;
+
+    bool allIdentical = true;
+    spdlog::info("{:<32} {:>12} {:>12} {:>10} {:>10} {:>10}", "mesh",
+        "import ms", "cache ms", "encode ms", "append ms", "identical");
+    for (std::string const& path : MeshPaths(args)) {
+        std::optional<Assets::ObjData> obj;
+        Assets::MeshData mesh;
+        bool built = false;
+        double importMs = MedianMs(iterations, [&]() {
+            ScopedLogLevel quiet(spdlog::level::off);
+            obj = Assets::ImportObj(path.c_str(), "meshes/");
+            built = obj
+                && Assets::BuildMesh(*obj, mesh)
+                    == Assets::MeshBuildResult::BuildOk;
+        });
+        if (!built) {
+            spdlog::info("{:<32} skipped, not a renderable mesh", path);
+            continue;
+        }
+
+        if (!Assets::WriteMeshCache(
+                path.c_str(), obj->materialLibraries, ViewOf(mesh), {})) {
+            spdlog::error("Could not write the mesh cache for {}", path);
+            return 1;
+        }
+
+        bool identical = true;
+        double cacheMs = MedianMs(iterations, [&]() {
+            std::optional<Assets::CachedMesh> cached
+                = Assets::OpenMeshCache(path.c_str());
+            identical &= cached && SameMesh(cached->View(), ViewOf(mesh));
+        });
+
+        // Packing the mapped mesh appends its baked buffers, which must be
+        // what encoding its vertices again would give.
+        std::optional<Assets::CachedMesh> cached
+            = Assets::OpenMeshCache(path.c_str());
+        if (!cached) {
+            spdlog::error("Could not open the mesh cache for {}", path);
+            return 1;
+        }
+        Assets::MeshView view = cached->View();
+        std::optional<Assets::EncodedMesh> encoded = cached->Encoded();
+        SceneGeometry reencoded;
+        double encodeMs = MedianMs(iterations,
+            [&]() { reencoded = PackSceneGeometry({&view, 1}, {}); });
+        SceneGeometry appended;
+        double appendMs = MedianMs(iterations, [&]() {
+            appended = PackSceneGeometry({&view, 1}, {}, {&encoded, 1});
+        });
+        identical &= appended.layout == reencoded.layout
+            && appended.indexFormat == reencoded.indexFormat
+            && appended.vertexData == reencoded.vertexData
+            && appended.indexData == reencoded.indexData;
+
+        allIdentical &= identical;
+        spdlog::info("{:<32} {:>12.3f} {:>12.3f} {:>10.3f} {:>10.3f} {:>10}",
+            path, importMs, cacheMs, encodeMs, appendMs,
+            identical ? "yes" : "NO");
+    }
+
+    // The index buffer ends the file, so its last index is the last four
+    // bytes. Pointing it past the vertices has to be caught as corruption.
+    bool corruptRejected = true;
+    for (std::string const& path : MeshPaths(args)) {
+        std::string cachePath = Assets::MeshCachePath(path.c_str());
+        if (!std::filesystem::exists(cachePath)) {
+            continue;
+        }
+        {
+            std::fstream stream(
+                cachePath, std::ios::in | std::ios::out | std::ios::binary);
+            stream.seekp(-4, std::ios::end);
+            uint32_t const badIndex = 0xffffffffu;
+            stream.write(
+                reinterpret_cast<char const*>(&badIndex), sizeof(badIndex));
+        }
+        ScopedLogLevel quiet(spdlog::level::off);
+        corruptRejected &= !Assets::OpenMeshCache(path.c_str());
+        std::filesystem::remove(cachePath);
+    }
+    // Absolute sources are cached inside cache/ as well.
+    corruptRejected &= Assets::MeshCachePath("/abs/meshes/a.obj")
+        == "cache/abs/meshes/a.umesh";
+    spdlog::info("Out of range indices and absolute paths handled: {}",
+        corruptRejected ? "yes" : "NO");
+
+    return allIdentical && corruptRejected ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
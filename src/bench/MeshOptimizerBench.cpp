@@ -0,0 +1,139 @@
+#include "Bench.h"
+
+#include <array>
+#include <cstring>
+
+#include "assets/MeshBuilder.h"
+#include "assets/MeshOptimizer.h"
+#include "util/Hash.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    // Order-independent fingerprint of the triangles, so reordering can be
+    // checked to neither lose, add nor flip any of them.
+    std::vector<uint64_t> TriangleHashes(Assets::MeshData const& mesh)
+    {
+        std::vector<uint64_t> hashes;
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            Assets::Vertex corners[3] = {
+                mesh.vertices[mesh.indices[t + 0]],
+                mesh.vertices[mesh.indices[t + 1]],
+                mesh.vertices[mesh.indices[t + 2]],
+            };
+            // Rotate the corners so the same triangle always hashes the same.
+            auto first = std::ranges::min_element(corners,
+                [](Assets::Vertex const& a, Assets::Vertex const& b) {
+                    return std::memcmp(&a, &b, sizeof(a)) < 0;
+                });
+            std::ranges::rotate(corners, first);
+            hashes.push_back(Util::HashBytes(corners, sizeof(corners)));
+        }
+        std::ranges::sort(hashes);
+        return hashes;
+    }
+
+    // A regular grid with its triangles shuffled, which is what a mesh out
+    // of a careless exporter looks like to the vertex cache.
+    Assets::MeshData ShuffledGrid(uint32_t size)
+    {
+        Assets::MeshData mesh;
+        for (uint32_t y = 0; y <= size; y++) {
+            for (uint32_t x = 0; x <= size; x++) {
+                mesh.vertices.push_back({static_cast<float>(x),
+                    static_cast<float>(y), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+                    1.0f});
+            }
+        }
+
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (uint32_t y = 0; y < size; y++) {
+            for (uint32_t x = 0; x < size; x++) {
+                uint32_t i = y * (size + 1) + x;
+                triangles.push_back({i, i + 1, i + size + 1});
+                triangles.push_back({i + 1, i + size + 2, i + size + 1});
+            }
+        }
+        uint32_t state = 12345;
+        for (size_t i = triangles.size() - 1; i > 0; i--) {
+            state = state * 1664525u + 1013904223u;
+            std::swap(triangles[i], triangles[state % (i + 1)]);
+        }
+        for (auto const& triangle : triangles) {
+            mesh.indices.insert(
+                mesh.indices.end(), triangle.begin(), triangle.end());
+        }
+
+        mesh.shapes.push_back(
+            {0, static_cast<uint32_t>(mesh.indices.size()), 0});
+        mesh.lods.push_back(
+            {0, static_cast<uint32_t>(mesh.indices.size()), 0.0f, 0, 1});
+        return mesh;
+    }
+
+    bool RunMesh(std::string const& name, Assets::MeshData const& source)
+    {
+        constexpr int iterations = 5;
+
+        auto runStage = [&](char const* stage,
+                            Assets::MeshOptimizeOptions options,
+                            bool optimize) {
+            Assets::MeshData mesh;
+            double ms = 0.0;
+            if (optimize) {
+                ms = MedianMs(iterations, [&]() {
+                    mesh = source;
+                    (void)Assets::OptimizeMesh(mesh, options);
+                });
+            } else {
+                mesh = source;
+            }
+
+            Assets::VertexCacheStats stats
+                = Assets::AnalyzeVertexCache(mesh.indices, options.cacheSize);
+            bool preserved = TriangleHashes(mesh) == TriangleHashes(source);
+            spdlog::info(
+                "{:<28} {:<10} {:>9} {:>8.3f} {:>8.3f} {:>9.3f} {:>10}", name,
+                stage, mesh.indices.size() / 3, stats.acmr, stats.atvr, ms,
+                preserved ? "yes" : "NO");
+            return preserved;
+        };
+
+        bool preserved = runStage("original", {}, false);
+        preserved &= runStage("vcache", {.optimizeOverdraw = false}, true);
+        preserved &= runStage("overdraw", {}, true);
+        return preserved;
+    }
+
+} // namespace
+
+int RunMeshOptimizerBench(BenchArgs args)
+{
+    spdlog::info("{:<28} {:<10} {:>9} {:>8} {:>8} {:>9} {:>10}", "mesh",
+        "stage", "triangles", "ACMR", "ATVR", "ms", "preserved");
+
+    bool allPreserved = true;
+    for (std::string const& path : MeshPaths(args)) {
+        std::optional<Assets::ObjData> obj;
+        {
+            ScopedLogLevel quiet(spdlog::level::off);
+            obj = Assets::ImportObj(path.c_str(), "meshes/");
+        }
+        Assets::MeshData mesh;
+        if (!obj
+            || Assets::BuildMesh(*obj, mesh)
+                != Assets::MeshBuildResult::BuildOk) {
+            spdlog::info("{:<28} skipped, not a renderable mesh", path);
+            continue;
+        }
+        allPreserved &= RunMesh(path, mesh);
+    }
+    if (args.empty()) {
+        allPreserved &= RunMesh("synthetic/grid", ShuffledGrid(256));
+    }
+
+    return allPreserved ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
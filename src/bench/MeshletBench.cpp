@@ -0,0 +1,415 @@
+#include "Bench.h"
+
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "assets/MeshBuilder.h"
+#include "assets/MeshOptimizer.h"
+#include "assets/MeshletBuilder.h"
+#include "systems/MeshletCulling.h"
+#include "systems/Scene.h"
+#include "util/Hash.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    constexpr int numCameras = 256;
+
+    glm::vec3 PositionOf(Assets::Vertex const& vertex)
+    {
+        return {vertex.x, vertex.y, vertex.z};
+    }
+
+    // Order-independent fingerprint of the triangles, so meshlets can be
+    // checked to neither lose, add nor flip any of them.
+    std::vector<uint64_t> TriangleHashes(Assets::MeshData const& mesh)
+    {
+        std::vector<uint64_t> hashes;
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            Assets::Vertex corners[3] = {
+                mesh.vertices[mesh.indices[t + 0]],
+                mesh.vertices[mesh.indices[t + 1]],
+                mesh.vertices[mesh.indices[t + 2]],
+            };
+            auto first = std::ranges::min_element(corners,
+                [](Assets::Vertex const& a, Assets::Vertex const& b) {
+                    return std::memcmp(&a, &b, sizeof(a)) < 0;
+                });
+            std::ranges::rotate(corners, first);
+            hashes.push_back(Util::HashBytes(corners, sizeof(corners)));
+        }
+        std::ranges::sort(hashes);
+        return hashes;
+    }
+
+    // A finely tessellated sphere, standing in for a dense scan. Its seam
+    // splits vertices, which meshlets have to grow across.
+    Assets::MeshData DenseSphere(uint32_t rings, uint32_t segments)
+    {
+        Assets::MeshData mesh;
+        for (uint32_t r = 0; r <= rings; r++) {
+            float theta = std::numbers::pi_v<float> * static_cast<float>(r)
+                / static_cast<float>(rings);
+            // Exactly on the poles, so the triangles there are degenerate
+            // rather than slivers with a normal made of rounding error.
+            float ringRadius
+                = r == 0 || r == rings ? 0.0f : std::sin(theta);
+            for (uint32_t s = 0; s <= segments; s++) {
+                float phi = 2.0f * std::numbers::pi_v<float>
+                    * static_cast<float>(s) / static_cast<float>(segments);
+                glm::vec3 n(ringRadius * std::cos(phi), std::cos(theta),
+                    ringRadius * std::sin(phi));
+                mesh.vertices.push_back({n.x, n.y, n.z,
+                    static_cast<float>(s) / static_cast<float>(segments),
+                    static_cast<float>(r) / static_cast<float>(rings), n.x,
+                    n.y, n.z});
+            }
+        }
+        for (uint32_t r = 0; r < rings; r++) {
+            for (uint32_t s = 0; s < segments; s++) {
+                uint32_t i = r * (segments + 1) + s;
+                uint32_t below = i + segments + 1;
+                // Counter-clockwise seen from outside.
+                mesh.indices.insert(mesh.indices.end(), {i, i + 1, below});
+                mesh.indices.insert(
+                    mesh.indices.end(), {i + 1, below + 1, below});
+            }
+        }
+        auto count = static_cast<uint32_t>(mesh.indices.size());
+        mesh.shapes.push_back({0, count, 0});
+        mesh.lods.push_back({0, count, 0.0f, 0, 1});
+        mesh.bounds = {glm::vec3(-1.0f), glm::vec3(1.0f)};
+        return mesh;
+    }
+
+    // Meshlets stay within the limits and tile the shape ranges of LOD 0 in
+    // order, without gaps.
+    bool CheckLayout(
+        Assets::MeshData const& mesh, Assets::MeshletOptions const& options)
+    {
+        Assets::MeshLod const& lod0 = mesh.lods.front();
+        uint32_t shape = 0;
+        uint32_t cursor = mesh.shapes[lod0.firstShape].firstIndex;
+        for (Assets::Meshlet const& meshlet : mesh.meshlets) {
+            if (meshlet.shape != shape) {
+                Assets::MeshShapeRange const& done
+                    = mesh.shapes[lod0.firstShape + shape];
+                if (meshlet.shape != shape + 1
+                    || cursor != done.firstIndex + done.indexCount) {
+                    return false;
+                }
+                shape = meshlet.shape;
+                cursor = mesh.shapes[lod0.firstShape + shape].firstIndex;
+            }
+            std::vector<uint32_t> unique(
+                mesh.indices.begin() + meshlet.firstIndex,
+                mesh.indices.begin() + meshlet.firstIndex + meshlet.indexCount);
+            std::ranges::sort(unique);
+            unique.erase(std::ranges::unique(unique).begin(), unique.end());
+            if (meshlet.firstIndex != cursor || meshlet.indexCount % 3 != 0
+                || meshlet.indexCount / 3 > options.maxTriangles
+                || unique.size() > options.maxVertices
+                || unique.size() != meshlet.numVertices) {
+                return false;
+            }
+            // The sphere holds every vertex.
+            for (uint32_t index : unique) {
+                float distance = glm::length(
+                    PositionOf(mesh.vertices[index]) - meshlet.center);
+                if (distance > meshlet.radius * 1.0001f + 1e-6f) {
+                    return false;
+                }
+            }
+            cursor += meshlet.indexCount;
+        }
+        Assets::MeshShapeRange const& last
+            = mesh.shapes[lod0.firstShape + lod0.numShapes - 1];
+        return shape + 1 == lod0.numShapes
+            && cursor == last.firstIndex + last.indexCount;
+    }
+
+    struct CullResult {
+        uint64_t numTriangles {};
+        // Triangles the cones drop with the frustum test off, and those
+        // facing away one by one, the most any backface test could drop.
+        uint64_t coneCulled {};
+        uint64_t backfacing {};
+        MeshletCullStats stats;
+        uint64_t runs {};
+        double cullMs {};
+        // Triangles dropped while facing the camera inside the frustum, or
+        // drawn twice.
+        uint64_t wronglyCulled {};
+    };
+
+    // Views the mesh, placed with a rotation and uniform scale, from
+    // cameras all around it at random distances and angles, and checks
+    // every triangle that culling dropped against the camera itself.
+    CullResult Cull(Assets::MeshData const& mesh)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), {3.0f, 1.0f, -5.0f})
+            * glm::rotate(glm::mat4(1.0f), 0.7f, {1.0f, 2.0f, 3.0f})
+            * glm::scale(glm::mat4(1.0f), glm::vec3(1.5f));
+        std::vector<glm::vec3> world(mesh.vertices.size());
+        for (size_t v = 0; v < world.size(); v++) {
+            world[v] = model * glm::vec4(PositionOf(mesh.vertices[v]), 1.0f);
+        }
+        glm::vec3 center
+            = model * glm::vec4(0.5f * (mesh.bounds.min + mesh.bounds.max), 1);
+        float radius
+            = 0.75f * glm::length(mesh.bounds.max - mesh.bounds.min);
+        glm::mat4 projection
+            = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1e3f);
+
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> distance(1.2f, 4.0f);
+        auto randomDirection = [&]() {
+            glm::vec3 direction;
+            do {
+                direction = {unit(random), unit(random), unit(random)};
+            } while (glm::length(direction) < 0.1f
+                || glm::length(direction) > 1.0f);
+            return glm::normalize(direction);
+        };
+
+        CullResult result;
+        std::vector<MeshletRun> runs(mesh.meshlets.size());
+        std::vector<uint8_t> drawn;
+        MeshletCullingOptions const coneOnly {.frustum = false};
+        MeshletCullingOptions const both {};
+        for (int c = 0; c < numCameras; c++) {
+            glm::vec3 camera
+                = center + randomDirection() * distance(random) * radius;
+            glm::vec3 target = center + 0.5f * radius * randomDirection();
+            glm::mat4 viewProjection = projection
+                * glm::lookAt(camera, target, glm::vec3(0.0f, 1.0f, 0.0f));
+            MeshletView view = MeshletViewOf(viewProjection, camera, model);
+
+            MeshletCullStats coneStats;
+            (void)CullMeshlets(mesh.meshlets, view, coneOnly, runs, coneStats);
+            result.coneCulled += coneStats.culledTriangles;
+
+            size_t numRuns = 0;
+            result.cullMs += MedianMs(5, [&]() {
+                MeshletCullStats stats;
+                numRuns = CullMeshlets(mesh.meshlets, view, both, runs, stats);
+            });
+            (void)CullMeshlets(mesh.meshlets, view, both, runs, result.stats);
+            result.runs += numRuns;
+
+            // Every triangle left out of the runs must face away or lie
+            // wholly outside one plane of the frustum.
+            drawn.assign(mesh.indices.size() / 3, 0);
+            for (size_t r = 0; r < numRuns; r++) {
+                for (uint32_t i = runs[r].firstIndex;
+                    i < runs[r].firstIndex + runs[r].indexCount; i += 3) {
+                    drawn[i / 3]++;
+                }
+            }
+            Frustum frustum = ExtractFrustum(viewProjection);
+            uint32_t lod0End = mesh.lods.front().indexCount;
+            for (uint32_t i = 0; i < lod0End; i += 3) {
+                glm::vec3 a = world[mesh.indices[i]];
+                glm::vec3 b = world[mesh.indices[i + 1]];
+                glm::vec3 d = world[mesh.indices[i + 2]];
+                glm::vec3 normal = glm::cross(b - a, d - a);
+                // Edge-on within rounding counts as facing away.
+                bool facingAway = glm::dot(normal, camera - a)
+                    <= 1e-3f * glm::length(normal) * glm::length(camera - a);
+                result.numTriangles++;
+                result.backfacing += facingAway;
+                if (drawn[i / 3] > 1) {
+                    result.wronglyCulled++;
+                }
+                if (drawn[i / 3] == 1 || facingAway) {
+                    continue;
+                }
+                bool outside = std::ranges::any_of(
+                    frustum.planes, [&](glm::vec4 const& plane) {
+                        auto distanceTo = [&](glm::vec3 p) {
+                            return glm::dot(glm::vec3(plane), p) + plane.w;
+                        };
+                        return distanceTo(a) < 0.0f && distanceTo(b) < 0.0f
+                            && distanceTo(d) < 0.0f;
+                    });
+                result.wronglyCulled += !outside;
+            }
+        }
+        return result;
+    }
+
+    bool RunMesh(std::string const& name, Assets::MeshData const& source)
+    {
+        Assets::MeshData optimized = source;
+        (void)Assets::OptimizeMesh(optimized);
+        std::vector<uint64_t> triangles = TriangleHashes(optimized);
+        Assets::VertexCacheStats optimizedCache = Assets::AnalyzeVertexCache(
+            {optimized.indices.data(), optimized.lods.front().indexCount});
+
+        bool allPassed = true;
+        for (float coneWeight : {0.0f, 0.5f, 2.0f}) {
+            Assets::MeshletOptions options {.coneWeight = coneWeight};
+            Assets::MeshData mesh;
+            Assets::MeshletStats stats;
+            double buildMs = MedianMs(3, [&]() {
+                mesh = optimized;
+                stats = Assets::BuildMeshlets(mesh, options);
+            });
+            Assets::VertexCacheStats cache = Assets::AnalyzeVertexCache(
+                {mesh.indices.data(), mesh.lods.front().indexCount});
+
+            CullResult result = Cull(mesh);
+            bool valid = CheckLayout(mesh, options)
+                && TriangleHashes(mesh) == triangles
+                && result.wronglyCulled == 0
+                && result.stats.numTriangles == result.numTriangles;
+            allPassed &= valid;
+
+            auto percent = [&](uint64_t count) {
+                return 100.0 * static_cast<double>(count)
+                    / static_cast<double>(std::max<uint64_t>(
+                        result.numTriangles, 1));
+            };
+            spdlog::info("{:<28} {:>6.1f} {:>8} {:>6.1f} {:>6.1f} {:>7} "
+                         "{:>8.2f} {:>6.3f} {:>6.3f} {:>7.1f}% {:>7.1f}% "
+                         "{:>7.1f}% {:>6.1f} {:>8.2f} {:>6}",
+                name, coneWeight, stats.numMeshlets, stats.AverageTriangles(),
+                stats.AverageVertices(), stats.numWithoutCone, buildMs,
+                optimizedCache.acmr, cache.acmr, percent(result.coneCulled),
+                percent(result.backfacing),
+                100.0 * result.stats.CulledFraction(),
+                static_cast<double>(result.runs) / numCameras,
+                1000.0 * result.cullMs / numCameras, valid ? "yes" : "NO");
+        }
+        return allPassed;
+    }
+
+    // A grid of instances in front of the camera, more than the scene culls
+    // meshlet by meshlet, drawn with meshlet culling off and on. Every
+    // command has to stay inside a LOD of its mesh and use its own
+    // transform slot, and the commands must add up to the triangles the
+    // stats report.
+    bool RunScene(Assets::MeshData const& source)
+    {
+        Assets::MeshData mesh = source;
+        (void)Assets::OptimizeMesh(mesh);
+        (void)Assets::BuildMeshlets(mesh);
+        Assets::MeshView meshView = ViewOf(mesh);
+        SceneGeometry geometry = PackSceneGeometry({&meshView, 1}, {});
+        SceneMesh const& packed = geometry.meshes.front();
+
+        glm::vec3 cameraPosition(0.0f);
+        float verticalFov = glm::radians(45.0f);
+        SceneView view {
+            .viewProjection
+            = glm::perspective(verticalFov, 16.0f / 9.0f, 0.1f, 1000.0f)
+                * glm::lookAt(cameraPosition, glm::vec3(0.0f, 0.0f, -1.0f),
+                    glm::vec3(0.0f, 1.0f, 0.0f)),
+            .lod = {
+                .cameraPosition = cameraPosition,
+                .verticalFov = verticalFov,
+                .viewportHeight = 1080.0f,
+            },
+        };
+
+        bool valid = true;
+        for (bool enabled : {false, true}) {
+            Scene scene(geometry.meshes,
+                {
+                    .lod = {},
+                    .occlusion = {.enabled = false},
+                    .meshlets = {.enabled = enabled},
+                });
+            for (int y = 0; y < 10; y++) {
+                for (int x = 0; x < 10; x++) {
+                    glm::vec3 position(2.0f * static_cast<float>(x) - 9.0f,
+                        2.0f * static_cast<float>(y) - 9.0f, -20.0f);
+                    scene.AddInstance(
+                        glm::translate(glm::mat4(1.0f), position), 0);
+                }
+            }
+            std::vector<DrawCommand> commands(scene.MaxDraws());
+            std::vector<DrawRecord> records(scene.MaxDraws());
+            std::vector<glm::mat4> transforms(scene.NumInstances());
+            DrawListTargets targets {commands, records, transforms};
+
+            DrawListStats stats;
+            double ms = MedianMs(
+                15, [&]() { stats = scene.BuildDrawList(view, targets); });
+
+            uint64_t triangles = 0;
+            for (uint32_t d = 0; d < stats.numDraws; d++) {
+                DrawCommand const& command = commands[d];
+                bool inLod = std::ranges::any_of(
+                    packed.lods, [&](Assets::MeshLod const& lod) {
+                        return command.firstIndex >= lod.firstIndex
+                            && command.firstIndex + command.count
+                            <= lod.firstIndex + lod.indexCount;
+                    });
+                valid &= inLod && command.baseVertex == packed.baseVertex
+                    && records[d].firstInstance == command.baseInstance
+                    && command.baseInstance + command.instanceCount
+                        <= stats.numInstances;
+                triangles
+                    += uint64_t(command.count / 3) * command.instanceCount;
+            }
+            uint32_t numVisible = static_cast<uint32_t>(
+                std::ranges::count(scene.Visibility(), 1));
+            MeshletCullStats const& meshlets = stats.meshlets;
+            valid &= triangles == stats.numTriangles
+                && meshlets.numInstances
+                    == (enabled ? std::min(numVisible, 64u) : 0u);
+            spdlog::info("Scene of {} instances, meshlet culling {}: {} "
+                         "draws, {} triangles, {:.1f}% of those of {} "
+                         "instances culled, {:.3f} ms",
+                scene.NumInstances(), enabled ? "on" : "off",
+                stats.numDraws, stats.numTriangles,
+                100.0 * meshlets.CulledFraction(), meshlets.numInstances, ms);
+        }
+        return valid;
+    }
+
+} // namespace
+
+int RunMeshletBench(BenchArgs args)
+{
+    spdlog::info("{} cameras around each mesh; cone % culls without the "
+                 "frustum, best % faces away triangle by triangle",
+        numCameras);
+    spdlog::info("{:<28} {:>6} {:>8} {:>6} {:>6} {:>7} {:>8} {:>6} {:>6} "
+                 "{:>8} {:>8} {:>8} {:>6} {:>8} {:>6}",
+        "mesh", "weight", "meshlets", "tris", "verts", "no cone", "build ms",
+        "ACMR", "after", "cone %", "best %", "culled %", "runs", "cull us",
+        "valid");
+
+    bool allPassed = true;
+    for (std::string const& path : MeshPaths(args)) {
+        std::optional<Assets::ObjData> obj;
+        {
+            ScopedLogLevel quiet(spdlog::level::off);
+            obj = Assets::ImportObj(path.c_str(), "meshes/");
+        }
+        Assets::MeshData mesh;
+        if (!obj
+            || Assets::BuildMesh(*obj, mesh)
+                != Assets::MeshBuildResult::BuildOk) {
+            spdlog::info("{:<28} skipped, not a renderable mesh", path);
+            continue;
+        }
+        allPassed &= RunMesh(path, mesh);
+    }
+    if (args.empty()) {
+        allPassed &= RunMesh("synthetic/dense sphere", DenseSphere(256, 512));
+    }
+    allPassed &= RunScene(DenseSphere(128, 256));
+
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
@@ -0,0 +1,222 @@
+#include "Bench.h"
+
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "assets/MeshBuilder.h"
+#include "assets/MeshSimplifier.h"
+#include "systems/OcclusionCulling.h"
+#include "systems/Scene.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    // A camera at the origin looking down -z, matching the 2:1 buffer.
+    glm::mat4 ViewProjection()
+    {
+        return glm::perspective(glm::radians(45.0f), 2.0f, 0.1f, 1000.0f)
+            * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+                glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    // A 20x20 wall 20 units away, with spheres that are certainly behind
+    // it, certainly in front of it and certainly beside it.
+    bool RunWall()
+    {
+        OcclusionBuffer buffer;
+        buffer.Begin(ViewProjection());
+        glm::vec3 const wall[] = {{-10.0f, -10.0f, -20.0f},
+            {10.0f, -10.0f, -20.0f}, {10.0f, 10.0f, -20.0f},
+            {-10.0f, 10.0f, -20.0f}};
+        uint32_t const wallIndices[] = {0, 1, 2, 0, 2, 3};
+        buffer.AddOccluder(wall, wallIndices, glm::mat4(1.0f));
+        buffer.Rasterize();
+
+        struct Group {
+            char const* name;
+            float z;
+            float minX, maxX;
+            bool hidden;
+        };
+        constexpr Group groups[] = {
+            {"behind", -40.0f, -12.0f, 12.0f, true},
+            {"in front", -10.0f, -3.0f, 3.0f, false},
+            {"beside", -40.0f, 24.0f, 30.0f, false},
+        };
+
+        bool correct = true;
+        for (Group const& group : groups) {
+            uint32_t tested = 0;
+            uint32_t rejected = 0;
+            for (float x = group.minX; x <= group.maxX; x += 0.5f) {
+                for (float y = -12.0f; y <= 12.0f; y += 0.5f) {
+                    tested++;
+                    rejected += buffer.IsOccluded({x, y, group.z}, 0.5f);
+                }
+            }
+            bool groupCorrect = rejected == (group.hidden ? tested : 0);
+            correct &= groupCorrect;
+            spdlog::info("wall: {:<9} {:>5} of {:>5} spheres rejected, "
+                         "expected {:>5} {}",
+                group.name, rejected, tested, group.hidden ? tested : 0,
+                groupCorrect ? "yes" : "NO");
+        }
+        return correct;
+    }
+
+    // A buffer taller than wide, with a wall over its lower half. Footprints
+    // must reach up to the height, not the width, or a sphere peeking over
+    // the wall is clamped down behind it.
+    bool RunTallBuffer()
+    {
+        OcclusionBuffer buffer({.width = 64, .height = 256});
+        buffer.Begin(
+            glm::perspective(glm::radians(45.0f), 0.25f, 0.1f, 1000.0f));
+        glm::vec3 const wall[] = {{-10.0f, -10.0f, -20.0f},
+            {10.0f, -10.0f, -20.0f}, {10.0f, 0.0f, -20.0f},
+            {-10.0f, 0.0f, -20.0f}};
+        uint32_t const wallIndices[] = {0, 1, 2, 0, 2, 3};
+        buffer.AddOccluder(wall, wallIndices, glm::mat4(1.0f));
+        buffer.Rasterize();
+
+        bool peekingVisible = !buffer.IsOccluded({0.0f, 0.0f, -40.0f}, 2.0f);
+        bool belowHidden = buffer.IsOccluded({0.0f, -8.0f, -40.0f}, 2.0f);
+        bool correct = peekingVisible && belowHidden;
+        spdlog::info("tall: peeking over the wall visible {}, below it "
+                     "hidden {}",
+            peekingVisible ? "yes" : "NO", belowHidden ? "yes" : "NO");
+        return correct;
+    }
+
+    std::vector<SceneMesh> LoadMeshes(BenchArgs args)
+    {
+        std::vector<Assets::MeshData> meshData;
+        for (std::string const& path : MeshPaths(args)) {
+            std::optional<Assets::ObjData> obj;
+            {
+                ScopedLogLevel quiet(spdlog::level::off);
+                obj = Assets::ImportObj(path.c_str(), "meshes/");
+            }
+            Assets::MeshData mesh;
+            if (!obj
+                || Assets::BuildMesh(*obj, mesh)
+                    != Assets::MeshBuildResult::BuildOk
+                || mesh.indices.size() < 3 * 64) {
+                continue;
+            }
+            Assets::BuildLodChain(mesh);
+            meshData.push_back(std::move(mesh));
+        }
+
+        std::vector<Assets::MeshView> views;
+        for (Assets::MeshData const& mesh : meshData) {
+            views.push_back(ViewOf(mesh));
+        }
+        return PackSceneGeometry(views, {}).meshes;
+    }
+
+} // namespace
+
+int RunOcclusionBench(BenchArgs args)
+{
+    bool correct = RunWall();
+    correct &= RunTallBuffer();
+
+    std::vector<SceneMesh> meshes = LoadMeshes(args);
+    if (meshes.empty()) {
+        spdlog::error("No occluder meshes");
+        return 1;
+    }
+
+    // Spheres to test, spread through the view behind the occluders.
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<glm::vec4> spheres;
+    for (int i = 0; i < 100'000; i++) {
+        float z = -10.0f - 40.0f * (unit(random) + 1.0f);
+        spheres.emplace_back(0.8f * z * unit(random), 0.4f * z * unit(random),
+            z, 0.25f + 0.5f * (unit(random) + 1.0f));
+    }
+
+    struct RasterCase {
+        char const* name;
+        OcclusionOptions options;
+    };
+    RasterCase const cases[] = {
+        {"scalar", {.simd = false, .parallel = false}},
+        {"simd", {.simd = true, .parallel = false}},
+        {"simd mt", {.simd = true, .parallel = true}},
+    };
+
+    spdlog::info("{:<9} {:<8} {:>10} {:>10} {:>9} {:>9} {:>9} {:>6}",
+        "occluders", "path", "triangles", "raster ms", "rejected", "test ms",
+        "ns/test", "same");
+    for (uint32_t numOccluders : {4u, 16u, 64u}) {
+        // Occluders on a grid 6 to 12 units in front of the camera.
+        std::vector<glm::mat4> transforms;
+        uint32_t side = static_cast<uint32_t>(
+            std::ceil(std::sqrt(static_cast<float>(numOccluders))));
+        for (uint32_t i = 0; i < numOccluders; i++) {
+            float u = (static_cast<float>(i % side) + 0.5f)
+                / static_cast<float>(side);
+            float v = (static_cast<float>(i / side) + 0.5f)
+                / static_cast<float>(side);
+            glm::vec3 position(
+                16.0f * (u - 0.5f), 8.0f * (v - 0.5f), -6.0f - 6.0f * v);
+            transforms.push_back(
+                glm::scale(glm::translate(glm::mat4(1.0f), position),
+                    glm::vec3(6.0f / static_cast<float>(side))));
+        }
+
+        std::vector<float> referenceDepth;
+        for (RasterCase const& rasterCase : cases) {
+            OcclusionBuffer buffer(rasterCase.options);
+            double rasterMs = MedianMs(9, [&]() {
+                buffer.Begin(ViewProjection());
+                for (uint32_t i = 0; i < numOccluders; i++) {
+                    SceneMesh const& mesh = meshes[i % meshes.size()];
+                    buffer.AddOccluder(mesh.occluderPositions,
+                        mesh.occluderIndices, transforms[i]);
+                }
+                buffer.Rasterize();
+            });
+
+            uint32_t rejected = 0;
+            double testMs = MedianMs(5, [&]() {
+                rejected = 0;
+                for (glm::vec4 const& sphere : spheres) {
+                    rejected += buffer.IsOccluded(glm::vec3(sphere), sphere.w);
+                }
+            });
+
+            // The hierarchy must give the per-pixel answer, and every path
+            // the same depth buffer.
+            bool same = true;
+            for (glm::vec4 const& sphere : spheres) {
+                same &= buffer.IsOccluded(glm::vec3(sphere), sphere.w)
+                    == buffer.IsOccludedReference(glm::vec3(sphere), sphere.w);
+            }
+            std::vector<float> depth(
+                buffer.Depth().begin(), buffer.Depth().end());
+            if (referenceDepth.empty()) {
+                referenceDepth = depth;
+            }
+            same &= depth == referenceDepth;
+            correct &= same;
+
+            spdlog::info("{:<9} {:<8} {:>10} {:>10.3f} {:>8.1f}% {:>9.3f} "
+                         "{:>9.1f} {:>6}",
+                numOccluders, rasterCase.name,
+                buffer.Stats().trianglesRasterized, rasterMs,
+                100.0 * rejected / spheres.size(), testMs,
+                1e6 * testMs / static_cast<double>(spheres.size()),
+                same ? "yes" : "NO");
+        }
+    }
+
+    return correct ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
@@ -0,0 +1,127 @@
+#include "Bench.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+
+#include "systems/Camera.h"
+#include "systems/FramePacer.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    // Ten seconds of jittery 144 Hz frames against 120 Hz steps, then a
+    // one second hitch that has to be clamped.
+    bool RunTimestep()
+    {
+        constexpr double stepRate = 120.0;
+        constexpr uint32_t maxSteps = 8;
+        FixedTimestep timestep(1.0 / stepRate, maxSteps);
+        std::mt19937 random(144);
+        std::uniform_real_distribution<double> jitter(0.8, 1.2);
+
+        double elapsed = 0.0;
+        uint64_t numSteps = 0;
+        bool alphaOk = true;
+        while (elapsed < 10.0) {
+            double dt = jitter(random) / 144.0;
+            elapsed += dt;
+            numSteps += timestep.Advance(dt);
+            alphaOk &= timestep.Alpha() >= 0.0f && timestep.Alpha() < 1.0f;
+        }
+        double expected = elapsed * stepRate;
+        bool stepsOk = std::abs(static_cast<double>(numSteps) - expected) < 1.0;
+        uint32_t hitchSteps = timestep.Advance(1.0);
+        bool hitchOk = hitchSteps == maxSteps && timestep.Alpha() <= 1.0f;
+
+        bool passed = stepsOk && alphaOk && hitchOk;
+        spdlog::info("timestep: {} steps in {:.3f} s (expected {:.1f}), a 1 s "
+                     "hitch ran {} steps: {}",
+            numSteps, elapsed, expected, hitchSteps, passed ? "yes" : "NO");
+        return passed;
+    }
+
+    // Frame intervals against the target, with and without spinning
+    // through the end of each wait, and what the waiting cost in CPU time.
+    bool RunLimiter(double fps, double spinMs)
+    {
+        constexpr uint32_t numFrames = 240;
+        FrameLimiter limiter(fps, spinMs);
+        limiter.Wait();
+        auto last = std::chrono::steady_clock::now();
+        std::clock_t cpuStart = std::clock();
+        double target = 1e3 / fps;
+        double sumError = 0.0;
+        double maxError = 0.0;
+        for (uint32_t frame = 0; frame < numFrames; frame++) {
+            limiter.Wait();
+            auto now = std::chrono::steady_clock::now();
+            double error = std::abs(
+                std::chrono::duration<double, std::milli>(now - last).count()
+                - target);
+            sumError += error;
+            maxError = std::max(maxError, error);
+            last = now;
+        }
+        double cpuMs = 1e3 * static_cast<double>(std::clock() - cpuStart)
+            / CLOCKS_PER_SEC;
+        spdlog::info("{:<8.0f} {:>8.1f} {:>12.3f} {:>12.3f} {:>10.1f}", fps,
+            spinMs, sumError / numFrames, maxError, cpuMs);
+        return true;
+    }
+
+    // A 1000 Hz mouse delivers several events a frame. Turning the camera
+    // on every one of them costs trig per event; adding up the motion and
+    // turning once per frame does not.
+    bool RunMouse()
+    {
+        constexpr uint32_t numFrames = 10000;
+        constexpr uint32_t eventsPerFrame = 16;
+        double x = 0.0;
+
+        Camera perEvent(glm::vec3(0.0f));
+        double perEventMs = MedianMs(3, [&]() {
+            for (uint32_t e = 0; e < numFrames * eventsPerFrame; e++) {
+                x += 1.0;
+                perEvent.ProcessMouse(x, 0.5 * x);
+                perEvent.ApplyLook();
+            }
+        });
+        Camera perFrame(glm::vec3(0.0f));
+        double perFrameMs = MedianMs(3, [&]() {
+            for (uint32_t f = 0; f < numFrames; f++) {
+                for (uint32_t e = 0; e < eventsPerFrame; e++) {
+                    x += 1.0;
+                    perFrame.ProcessMouse(x, 0.5 * x);
+                }
+                perFrame.ApplyLook();
+            }
+        });
+        spdlog::info("mouse: {} events a frame, {:.1f} ns per frame turning "
+                     "per event, {:.1f} ns turning per frame",
+            eventsPerFrame, perEventMs * 1e6 / numFrames,
+            perFrameMs * 1e6 / numFrames);
+        return true;
+    }
+
+} // namespace
+
+int RunPacingBench(BenchArgs args)
+{
+    double fps = args.empty() ? 240.0 : std::strtod(args.front(), nullptr);
+    if (!(fps > 0.0)) {
+        fps = 240.0;
+    }
+
+    bool allPassed = RunTimestep();
+    spdlog::info("{:<8} {:>8} {:>12} {:>12} {:>10}", "fps", "spin ms",
+        "mean err ms", "max err ms", "cpu ms");
+    allPassed &= RunLimiter(fps, 0.0);
+    allPassed &= RunLimiter(fps, 1.5);
+    allPassed &= RunMouse();
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
@@ -0,0 +1,448 @@
+#include "Bench.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <utility>
+
+#include "assets/MeshBuilder.h"
+#include "assets/ObjImporter.h"
+#include "assets/TextureCache.h"
+#include "gfx/TextureStreamer.h"
+#include "util/File.h"
+#include "util/JobSystem.h"
+#include "util/Lz4.h"
+#include "util/PackArchive.h"
+#include "util/VirtualFileSystem.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    constexpr char const* packPath = "cache/bench.upak";
+
+    std::vector<std::byte> BytesOf(std::string_view text)
+    {
+        auto const* begin = reinterpret_cast<std::byte const*>(text.data());
+        return {begin, begin + text.size()};
+    }
+
+    // Every file below data/ but the cache, as asset paths.
+    std::vector<std::string> AssetPaths()
+    {
+        std::vector<std::string> paths;
+        std::error_code error;
+        auto it = std::filesystem::recursive_directory_iterator(".", error);
+        for (; !error && it != std::filesystem::recursive_directory_iterator();
+             it.increment(error)) {
+            std::string name = it->path().filename().string();
+            if (name == "cache" || name.starts_with('.')) {
+                it.disable_recursion_pending();
+                continue;
+            }
+            if (it->is_regular_file()) {
+                paths.push_back(
+                    it->path().lexically_relative(".").generic_string());
+            }
+        }
+        std::ranges::sort(paths);
+        return paths;
+    }
+
+    // Round trips inputs around the edges of the block format, and checks
+    // that damaged blocks are rejected rather than overrun.
+    bool RunLz4Cases(std::span<std::byte const> text)
+    {
+        std::mt19937 random(5);
+        std::vector<std::byte> noise(1 << 20);
+        for (std::byte& byte : noise) {
+            byte = static_cast<std::byte>(random());
+        }
+        std::vector<std::byte> zeros(300000);
+        // Repeats further apart than the largest offset, which must not be
+        // matched.
+        std::vector<std::byte> farRepeat(noise.begin(), noise.begin() + 70000);
+        farRepeat.insert(farRepeat.end(), noise.begin(), noise.begin() + 100);
+
+        struct Lz4Case {
+            char const* name;
+            std::span<std::byte const> input;
+        };
+        Lz4Case const cases[] = {
+            {"empty", {}},
+            {"1 byte", std::span(noise).first(1)},
+            {"12 bytes", std::span(zeros).first(12)},
+            {"13 bytes", std::span(zeros).first(13)},
+            {"300k zeros", zeros},
+            {"1M noise", noise},
+            {"far repeat", farRepeat},
+            {"assets", text},
+        };
+
+        constexpr int iterations = 5;
+        bool allPassed = true;
+        spdlog::info("{:<12} {:>10} {:>10} {:>8} {:>10} {:>10} {:>6}",
+            "input", "bytes", "packed", "ratio", "comp MB/s", "dec MB/s",
+            "ok");
+        for (Lz4Case const& lz4Case : cases) {
+            std::vector<std::byte> packed(
+                Util::Lz4CompressBound(lz4Case.input.size()));
+            size_t packedSize = 0;
+            double compressMs = MedianMs(iterations, [&]() {
+                packedSize = Util::Lz4Compress(lz4Case.input, packed);
+            });
+            packed.resize(packedSize);
+
+            std::vector<std::byte> unpacked(lz4Case.input.size());
+            bool decoded = false;
+            double decompressMs = MedianMs(iterations, [&]() {
+                decoded = Util::Lz4Decompress(packed, unpacked);
+            });
+            bool passed
+                = decoded && std::ranges::equal(unpacked, lz4Case.input);
+
+            // Truncated blocks, and blocks decoded into the wrong size, fail.
+            if (!packed.empty()) {
+                passed &= !Util::Lz4Decompress(
+                    std::span(packed).first(packed.size() - 1), unpacked);
+            }
+            std::vector<std::byte> wrongSize(lz4Case.input.size() + 1);
+            passed &= !Util::Lz4Decompress(packed, wrongSize);
+            // Random damage may decode, but only ever within bounds.
+            for (int d = 0; d < 64 && !packed.empty(); d++) {
+                std::vector<std::byte> damaged = packed;
+                damaged[random() % damaged.size()]
+                    = static_cast<std::byte>(random());
+                (void)Util::Lz4Decompress(damaged, unpacked);
+            }
+            allPassed &= passed;
+
+            double megabytes
+                = static_cast<double>(lz4Case.input.size()) / 1e6;
+            spdlog::info("{:<12} {:>10} {:>10} {:>7.2f}x {:>10.0f} {:>10.0f} "
+                         "{:>6}",
+                lz4Case.name, lz4Case.input.size(), packedSize,
+                static_cast<double>(lz4Case.input.size())
+                    / static_cast<double>(std::max<size_t>(packedSize, 1)),
+                megabytes / compressMs * 1e3, megabytes / decompressMs * 1e3,
+                passed ? "yes" : "NO");
+        }
+        return allPassed;
+    }
+
+    bool RunReadFileCases()
+    {
+        struct ReadCase {
+            std::string_view contents;
+            std::string_view expected;
+        };
+        constexpr ReadCase cases[] = {
+            {"", ""},
+            {"\n", ""},
+            {"a", "a"},
+            {"line\n", "line"},
+            {"two\n\n", "two\n"},
+        };
+        std::filesystem::create_directories("cache");
+        bool allPassed = true;
+        for (ReadCase const& readCase : cases) {
+            char const* path = "cache/bench_read.txt";
+            {
+                std::ofstream stream(path, std::ios::out | std::ios::binary);
+                stream << readCase.contents;
+            }
+            std::optional<std::string> read = Util::ReadFile(path);
+            allPassed &= read && *read == readCase.expected;
+            std::filesystem::remove(path);
+        }
+        allPassed &= !Util::ReadFile("cache/missing.txt");
+        spdlog::info("ReadFile of empty and newline-only files: {}",
+            allPassed ? "ok" : "FAILED");
+        return allPassed;
+    }
+
+    // Checks every asset reads back from the pack as it is on disk, with
+    // the same stamp, and without a copy unless it was compressed.
+    bool CheckPack(Util::VirtualFileSystem const& packed,
+        Util::VirtualFileSystem const& loose,
+        std::span<std::string const> paths, bool compressed)
+    {
+        bool allPassed = true;
+        for (std::string const& path : paths) {
+            std::optional<Util::AssetFile> fromPack = packed.Open(path);
+            std::optional<Util::AssetFile> fromDisk = loose.Open(path);
+            std::optional<Util::AssetStamp> packStamp = packed.Stat(path);
+            std::optional<Util::AssetStamp> diskStamp = loose.Stat(path);
+            bool passed = fromPack && fromDisk
+                && fromPack->View() == fromDisk->View() && packStamp
+                && diskStamp && packStamp->size == diskStamp->size
+                && packStamp->writeTime == diskStamp->writeTime
+                && (compressed || !fromPack->Copied())
+                && (fromPack->Copied()
+                    || reinterpret_cast<uintptr_t>(fromPack->Data()) % 64
+                        == 0);
+            if (!passed) {
+                spdlog::error("{} does not read back from the pack", path);
+            }
+            allPassed &= passed;
+        }
+        allPassed &= !packed.Open("meshes/missing.obj")
+            && !packed.Stat("meshes/missing.obj");
+        // Paths are normalized before they are looked up.
+        allPassed &= packed.Exists("./meshes//teapot.obj")
+            && packed.Exists("meshes\\teapot.obj");
+        return allPassed;
+    }
+
+    // Truncated packs and damaged indices must not mount.
+    bool CheckCorruptPacks()
+    {
+        std::optional<Util::MappedFile> file = Util::MappedFile::Open(packPath);
+        if (!file) {
+            return false;
+        }
+        std::string contents(file->View());
+        file.reset();
+
+        char const* damagedPath = "cache/bench_damaged.upak";
+        auto opens = [&](std::string const& damaged) {
+            {
+                std::ofstream stream(
+                    damagedPath, std::ios::out | std::ios::binary);
+                stream << damaged;
+            }
+            bool opened = Util::PackArchive::Open(damagedPath).has_value();
+            std::filesystem::remove(damagedPath);
+            return opened;
+        };
+
+        ScopedLogLevel quiet(spdlog::level::off);
+        bool allPassed = opens(contents);
+        allPassed &= !opens(contents.substr(0, contents.size() - 1));
+        allPassed &= !opens(contents.substr(0, 16));
+        // The first entry's path hash, and then its stored size.
+        std::string damaged = contents;
+        damaged[64] ^= 1;
+        allPassed &= !opens(damaged);
+        damaged = contents;
+        damaged[64 + 16 + 7] = 0x7f;
+        allPassed &= !opens(damaged);
+        return allPassed;
+    }
+
+    // Packs a textured mesh under a directory that exists nowhere on disk,
+    // mounts it on the shared file system, and checks that its material
+    // textures are found and decoded the way the texture streamer would.
+    bool CheckPackOnlyTextures()
+    {
+        constexpr char const* sourceRoot = "cache/bench_packonly";
+        constexpr char const* packOnlyPath = "cache/bench_packonly.upak";
+        constexpr char const* meshFiles[] = {
+            "capsule.obj", "capsule.mtl", "capsule.jpg"};
+
+        std::error_code error;
+        std::filesystem::path meshDir
+            = std::filesystem::path(sourceRoot) / "packonly/meshes";
+        std::filesystem::create_directories(meshDir, error);
+        for (char const* file : meshFiles) {
+            std::filesystem::copy_file(std::filesystem::path("meshes") / file,
+                meshDir / file,
+                std::filesystem::copy_options::overwrite_existing, error);
+        }
+        std::optional<Util::PackStats> stats
+            = Util::WritePack(sourceRoot, packOnlyPath, {});
+        std::filesystem::remove_all(sourceRoot, error);
+        if (error || !stats || std::filesystem::exists("packonly")
+            || !Util::VirtualFileSystem::Instance().MountPack(packOnlyPath)) {
+            spdlog::error("Could not build the pack-only mesh");
+            return false;
+        }
+
+        Assets::MeshData mesh;
+        std::optional<Assets::ObjData> obj = Assets::ImportObj(
+            "packonly/meshes/capsule.obj", "packonly/meshes/");
+        bool passed = obj
+            && Assets::BuildMesh(*obj, mesh)
+                == Assets::MeshBuildResult::BuildOk;
+        size_t numTextures = 0;
+        for (Assets::MeshMaterial const& material : mesh.materials) {
+            std::string path(material.diffuseTexture,
+                strnlen(material.diffuseTexture,
+                    sizeof(material.diffuseTexture)));
+            if (path.empty()) {
+                continue;
+            }
+            numTextures++;
+            passed &= !std::filesystem::exists(path)
+                && Gfx::TextureStreamer::Exists(path)
+                && Assets::LoadTexture(
+                    path.c_str(), Assets::TextureFormat::Rgba8);
+        }
+        passed &= numTextures > 0;
+        spdlog::info("Found {} material textures only in a pack: {}",
+            numTextures, passed ? "ok" : "FAILED");
+        return passed;
+    }
+
+} // namespace
+
+int RunPackBench(BenchArgs)
+{
+    constexpr int iterations = 9;
+
+    std::vector<std::string> paths = AssetPaths();
+    if (paths.empty()) {
+        spdlog::error("No assets found, run from data/");
+        return 1;
+    }
+
+    // Every text asset in one buffer, as a realistic input for the codec.
+    std::string text;
+    for (std::string const& path : paths) {
+        if (!path.ends_with(".jpg")) {
+            text += Util::ReadFile(path.c_str()).value_or("");
+        }
+    }
+    bool allPassed = RunLz4Cases(BytesOf(text));
+    allPassed &= RunReadFileCases();
+
+    Util::VirtualFileSystem loose;
+    if (!loose.MountDirectory("")) {
+        return 1;
+    }
+
+    uint64_t looseChecksum = 0;
+    for (std::string const& path : paths) {
+        if (std::optional<Util::AssetFile> file = loose.Open(path)) {
+            for (char c : file->View()) {
+                looseChecksum += static_cast<unsigned char>(c);
+            }
+        }
+    }
+
+    std::filesystem::create_directories("cache");
+    spdlog::info("{:<10} {:>6} {:>6} {:>10} {:>10} {:>9} {:>9} {:>9} {:>6}",
+        "pack", "files", "lz4", "raw KiB", "pack KiB", "write ms", "open ms",
+        "read ms", "ok");
+    for (bool compress : {false, true}) {
+        Util::PackOptions options;
+        options.compress = compress;
+        options.exclude = {"cache"};
+        std::optional<Util::PackStats> stats;
+        double writeMs = MedianMs(3, [&]() {
+            ScopedLogLevel quiet(spdlog::level::warn);
+            stats = Util::WritePack(".", packPath, options);
+        });
+        Util::VirtualFileSystem packed;
+        if (!stats || !packed.MountPack(packPath)) {
+            spdlog::error("Could not write and mount {}", packPath);
+            return 1;
+        }
+        bool passed = stats->numFiles == paths.size()
+            && CheckPack(packed, loose, paths, compress);
+
+        // Opening touches the index, or the directory, and maps or
+        // decompresses; reading sums every byte, as a parser would.
+        double openMs = MedianMs(iterations, [&]() {
+            for (std::string const& path : paths) {
+                (void)packed.Open(path);
+            }
+        });
+        uint64_t checksum = 0;
+        double readMs = MedianMs(iterations, [&]() {
+            checksum = 0;
+            for (std::string const& path : paths) {
+                if (std::optional<Util::AssetFile> file = packed.Open(path)) {
+                    for (char c : file->View()) {
+                        checksum += static_cast<unsigned char>(c);
+                    }
+                }
+            }
+        });
+        passed &= checksum == looseChecksum;
+        allPassed &= passed;
+
+        spdlog::info("{:<10} {:>6} {:>6} {:>10.1f} {:>10.1f} {:>9.2f} "
+                     "{:>9.3f} {:>9.3f} {:>6}",
+            compress ? "lz4" : "stored", stats->numFiles, stats->numCompressed,
+            static_cast<double>(stats->rawBytes) / 1024.0,
+            static_cast<double>(stats->fileSize) / 1024.0, writeMs, openMs,
+            readMs, passed ? "yes" : "NO");
+    }
+
+    double looseOpenMs = MedianMs(iterations, [&]() {
+        for (std::string const& path : paths) {
+            (void)loose.Open(path);
+        }
+    });
+    spdlog::info("{:<10} {:>6} {:>6} {:>10} {:>10} {:>9} {:>9.3f}", "loose",
+        paths.size(), "-", "-", "-", "-", looseOpenMs);
+
+    bool corruptRejected = CheckCorruptPacks();
+    spdlog::info("Corrupt packs rejected: {}", corruptRejected ? "yes" : "NO");
+    allPassed &= corruptRejected;
+
+    // Asynchronous reads of everything at once, through the job system.
+    Util::VirtualFileSystem packed;
+    if (!packed.MountPack(packPath)) {
+        return 1;
+    }
+    std::atomic<size_t> numRead {};
+    std::atomic<uint64_t> bytesRead {};
+    std::vector<Util::JobHandle> reads;
+    double asyncMs = MedianMs(iterations, [&]() {
+        reads.clear();
+        for (std::string const& path : paths) {
+            reads.push_back(packed.ReadAsync(
+                path, [&](std::optional<Util::AssetFile> file) {
+                    if (file) {
+                        numRead++;
+                        bytesRead += file->Size();
+                    }
+                }));
+        }
+        reads.push_back(packed.ReadAsync(
+            "meshes/missing.obj", [&](std::optional<Util::AssetFile> file) {
+                numRead += file.has_value();
+            }));
+        Util::JobSystem::Instance().Wait(reads);
+    });
+    bool asyncOk = numRead == paths.size() * iterations;
+    spdlog::info("Read {} files asynchronously in {:.3f} ms: {}",
+        paths.size(), asyncMs, asyncOk ? "ok" : "FAILED");
+    allPassed &= asyncOk;
+
+    // The importers read through the shared file system, so meshes and
+    // their materials load from the pack once it shadows data/.
+    std::vector<std::string> meshPaths = MeshPaths({});
+    auto importCounts = [](std::string const& path) {
+        ScopedLogLevel quiet(spdlog::level::off);
+        std::optional<Assets::ObjData> obj
+            = Assets::ImportObj(path.c_str(), "meshes/");
+        return obj ? std::pair(obj->attrib.vertices.size(),
+                         obj->materials.size())
+                   : std::pair<size_t, size_t>();
+    };
+    std::vector<std::pair<size_t, size_t>> looseCounts;
+    for (std::string const& path : meshPaths) {
+        looseCounts.push_back(importCounts(path));
+    }
+    Util::VirtualFileSystem& shared = Util::VirtualFileSystem::Instance();
+    if (!shared.MountPack(packPath)) {
+        return 1;
+    }
+    bool importsMatch = true;
+    for (size_t m = 0; m < meshPaths.size(); m++) {
+        importsMatch &= importCounts(meshPaths[m]) == looseCounts[m];
+    }
+    spdlog::info("Imported {} meshes from the pack: {}", meshPaths.size(),
+        importsMatch ? "ok" : "FAILED");
+    allPassed &= importsMatch;
+    allPassed &= CheckPackOnlyTextures();
+
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
@@ -0,0 +1,60 @@
+#include "Bench.h"
+
+#include <filesystem>
+
+#include "util/Profiler.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    // Nanoseconds per zone around a trivial body.
+    double ZoneNs(size_t numZones, uint64_t& sink)
+    {
+        double ms = MedianMs(1, [&]() {
+            for (size_t i = 0; i < numZones; i++) {
+                UMBRELLA_PROFILE_ZONE("zone");
+                sink += i;
+            }
+        });
+        return ms * 1e6 / static_cast<double>(numZones);
+    }
+
+} // namespace
+
+int RunProfilerBench(BenchArgs args)
+{
+    std::string path = args.empty()
+        ? (std::filesystem::temp_directory_path() / "umbrella-profile.json")
+              .string()
+        : args[0];
+    Util::Profiler& profiler = Util::Profiler::Instance();
+    profiler.SetThreadName("main");
+
+    // A capture keeps every zone, so record fewer of them.
+    constexpr size_t numZones = 1000000;
+    constexpr size_t numCapturedZones = 100000;
+
+    uint64_t sink = 0;
+    double baselineMs = MedianMs(1, [&]() {
+        for (size_t i = 0; i < numZones; i++) {
+            sink += i;
+        }
+    });
+    double baselineNs = baselineMs * 1e6 / static_cast<double>(numZones);
+    double idleNs = ZoneNs(numZones, sink);
+
+    profiler.BeginCapture();
+    double capturingNs = ZoneNs(numCapturedZones, sink);
+    UMBRELLA_PROFILE_COUNTER("sink", sink % 1000);
+    bool written = profiler.EndCapture(path.c_str());
+
+    spdlog::info("{:<16} {:>10}", "zones", "ns each");
+    spdlog::info("{:<16} {:>10.2f}", "no zone", baselineNs);
+    spdlog::info("{:<16} {:>10.2f}", "not capturing", idleNs);
+    spdlog::info("{:<16} {:>10.2f}", "capturing", capturingNs);
+    spdlog::info("Capture written to {}: {}", path, written ? "yes" : "NO");
+    return written ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
@@ -0,0 +1,226 @@
+#include "Bench.h"
+
+#include <cstdlib>
+#include <numeric>
+#include <random>
+
+#include "gfx/RenderQueue.h"
+#include "gfx/StateCache.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    constexpr uint32_t depthTest
+        = static_cast<uint32_t>(Gfx::RenderFlags::DepthTest);
+    constexpr uint32_t blend = static_cast<uint32_t>(Gfx::RenderFlags::Blend);
+    constexpr uint32_t cullFace
+        = static_cast<uint32_t>(Gfx::RenderFlags::CullFace);
+
+    // Stands in for GL: counts calls, tracks what is bound, and checks
+    // every draw against the item it came from, whose index travels in the
+    // indirect offset.
+    struct MockGl {
+        uint64_t stateCalls {};
+        uint64_t draws {};
+        GLuint program {};
+        GLuint vertexArray {};
+        GLuint texture {};
+        uint32_t flags {};
+        std::span<Gfx::DrawItem const> items;
+        bool stateOk = true;
+    };
+    MockGl mock;
+
+    uint32_t FlagOf(GLenum capability)
+    {
+        switch (capability) {
+        case GL_DEPTH_TEST:
+            return depthTest;
+        case GL_BLEND:
+            return blend;
+        default:
+            return cullFace;
+        }
+    }
+
+    Gfx::GlApi const mockGl {
+        .useProgram =
+            [](GLuint program) {
+                mock.stateCalls++;
+                mock.program = program;
+            },
+        .bindVertexArray =
+            [](GLuint vertexArray) {
+                mock.stateCalls++;
+                mock.vertexArray = vertexArray;
+            },
+        .bindTextureUnit =
+            [](GLuint unit, GLuint texture) {
+                mock.stateCalls++;
+                if (unit == 0) {
+                    mock.texture = texture;
+                }
+            },
+        .enable =
+            [](GLenum capability) {
+                mock.stateCalls++;
+                mock.flags |= FlagOf(capability);
+            },
+        .disable =
+            [](GLenum capability) {
+                mock.stateCalls++;
+                mock.flags &= ~FlagOf(capability);
+            },
+        .multiDrawElementsIndirect =
+            [](GLenum, GLenum, void const* indirect, GLsizei, GLsizei) {
+                mock.draws++;
+                Gfx::DrawItem const& item
+                    = mock.items[reinterpret_cast<uintptr_t>(indirect)];
+                mock.stateOk &= mock.program == item.program
+                    && mock.vertexArray == item.vertexArray
+                    && mock.texture == item.textures.front()
+                    && mock.flags == item.flags;
+            },
+    };
+
+    // What the items' texture spans point into: name i at index i, for
+    // the materials 1 to 256 below.
+    std::vector<GLuint> const textureNames = []() {
+        std::vector<GLuint> names(257);
+        std::iota(names.begin(), names.end(), 0u);
+        return names;
+    }();
+
+    // Draws spread over a few programs, many materials and a handful of
+    // vertex arrays, in the order a scene walk would produce them.
+    void FillQueue(Gfx::RenderQueue& queue, size_t count)
+    {
+        constexpr uint32_t numPrograms = 8;
+        constexpr uint32_t numMaterials = 256;
+        constexpr uint32_t numVertexArrays = 16;
+        std::mt19937 random(static_cast<uint32_t>(count));
+        std::uniform_int_distribution<uint32_t> program(1, numPrograms);
+        std::uniform_int_distribution<uint32_t> material(1, numMaterials);
+        std::uniform_int_distribution<uint32_t> vertexArray(1, numVertexArrays);
+        std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+        std::bernoulli_distribution transparent(0.1);
+
+        queue.Clear();
+        for (size_t i = 0; i < count; i++) {
+            Gfx::RenderPass pass = transparent(random)
+                ? Gfx::RenderPass::Transparent
+                : Gfx::RenderPass::Opaque;
+            uint32_t texture = material(random);
+            Gfx::DrawItem item {
+                .program = program(random),
+                .vertexArray = vertexArray(random),
+                .textures = {&textureNames[texture], 1},
+                .flags = depthTest
+                    | (pass == Gfx::RenderPass::Transparent ? blend
+                                                            : cullFace),
+                .indirectOffset = static_cast<GLintptr>(i),
+                .drawCount = 1,
+            };
+            item.key = Gfx::MakeDrawKey({
+                .pass = pass,
+                .program = item.program,
+                .material = texture,
+                .vertexArray = item.vertexArray,
+                .depth = depth(random),
+            });
+            queue.Push(item);
+        }
+    }
+
+    // What submission costs without a cache: every draw sets all of its
+    // state.
+    void SubmitNaive(Gfx::RenderQueue const& queue)
+    {
+        for (uint32_t index : queue.Order()) {
+            Gfx::DrawItem const& item = queue.Items()[index];
+            mockGl.enable(GL_DEPTH_TEST);
+            (item.flags & blend ? mockGl.enable : mockGl.disable)(GL_BLEND);
+            (item.flags & cullFace ? mockGl.enable
+                                   : mockGl.disable)(GL_CULL_FACE);
+            mockGl.useProgram(item.program);
+            mockGl.bindVertexArray(item.vertexArray);
+            mockGl.bindTextureUnit(0, item.textures.front());
+            mockGl.multiDrawElementsIndirect(item.mode, item.indexType,
+                reinterpret_cast<void const*>(item.indirectOffset),
+                item.drawCount, 0);
+        }
+    }
+
+    bool Report(char const* name, size_t count, double sortMs,
+        double submitMs, uint64_t skipped)
+    {
+        bool passed = mock.stateOk && mock.draws == count;
+        spdlog::info("{:<16} {:>10} {:>10} {:>10.3f} {:>10.3f} {:>6}", name,
+            mock.stateCalls, skipped, sortMs, submitMs, passed ? "yes" : "NO");
+        return passed;
+    }
+
+    bool RunCount(size_t count)
+    {
+        Gfx::RenderQueue queue;
+        FillQueue(queue, count);
+        mock = {.items = queue.Items()};
+        spdlog::info("{} draws", count);
+        spdlog::info("{:<16} {:>10} {:>10} {:>10} {:>10} {:>6}", "case",
+            "GL calls", "skipped", "sort ms", "submit ms", "ok");
+
+        double naiveMs = MedianMs(1, [&]() { SubmitNaive(queue); });
+        bool allPassed = Report("naive", count, 0.0, naiveMs, 0);
+
+        mock = {.items = queue.Items()};
+        Gfx::StateCache unsortedState(mockGl);
+        double unsortedMs = MedianMs(1, [&]() { queue.Submit(unsortedState); });
+        allPassed &= Report("cached", count, 0.0, unsortedMs,
+            unsortedState.Stats().Skipped());
+
+        // The radix sort against std::stable_sort on the same keys.
+        std::vector<std::pair<uint64_t, uint32_t>> keys;
+        double stdSortMs = MedianMs(5, [&]() {
+            keys.clear();
+            for (uint32_t i = 0; i < count; i++) {
+                keys.emplace_back(queue.Items()[i].key, i);
+            }
+            std::ranges::stable_sort(keys, {}, [](auto const& k) {
+                return k.first;
+            });
+        });
+        double sortMs = MedianMs(5, [&]() { queue.Sort(); });
+        bool orderOk = true;
+        for (size_t i = 0; i < count; i++) {
+            orderOk &= queue.Order()[i] == keys[i].second;
+        }
+
+        mock = {.items = queue.Items()};
+        Gfx::StateCache sortedState(mockGl);
+        double sortedMs = MedianMs(1, [&]() { queue.Submit(sortedState); });
+        allPassed &= Report("sorted, cached", count, sortMs, sortedMs,
+            sortedState.Stats().Skipped());
+        spdlog::info("{:<16} {:>10} {:>10} {:>10.3f} {:>10} {:>6}",
+            "std::stable_sort", "-", "-", stdSortMs, "-",
+            orderOk ? "yes" : "NO");
+        return allPassed && orderOk;
+    }
+
+} // namespace
+
+int RunRenderQueueBench(BenchArgs args)
+{
+    std::vector<size_t> counts = {1000, 20000};
+    if (!args.empty()) {
+        counts = {
+            std::max<size_t>(std::strtoull(args.front(), nullptr, 10), 1)};
+    }
+    bool allPassed = true;
+    for (size_t count : counts) {
+        allPassed &= RunCount(count);
+    }
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
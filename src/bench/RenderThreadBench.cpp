@@ -0,0 +1,149 @@
+#include "Bench.h"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+#include "gfx/RenderThread.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    // Building a frame keeps the main thread busy; submitting it mostly
+    // waits, the way a driver or a blocking swap does.
+    constexpr uint32_t buildMicros = 1500;
+    constexpr uint32_t submitMicros = 2000;
+    // Every eighth frame submits this much slower, to show what the third
+    // packet buys.
+    constexpr uint32_t spikeMicros = 6000;
+
+    void Busy(uint32_t micros)
+    {
+        auto end = std::chrono::steady_clock::now()
+            + std::chrono::microseconds(micros);
+        while (std::chrono::steady_clock::now() < end) {
+        }
+    }
+
+    uint32_t SubmitMicros(uint32_t frame)
+    {
+        return frame % 8 == 7 ? spikeMicros : submitMicros;
+    }
+
+    struct Packet {
+        uint32_t frame {};
+        // Set while the producer writes the packet and while it renders,
+        // to catch either side touching a packet the other one owns.
+        std::atomic<bool> writing {};
+        std::atomic<bool> rendering {};
+    };
+
+    void Report(char const* name, uint32_t numFrames, double ms, bool passed)
+    {
+        spdlog::info("{:<12} {:>10.2f} {:>10.3f} {:>8.1f} {:>6}", name, ms,
+            ms / numFrames, numFrames / ms * 1e3, passed ? "yes" : "NO");
+    }
+
+    bool RunSerial(uint32_t numFrames)
+    {
+        double ms = MedianMs(1, [&]() {
+            for (uint32_t frame = 0; frame < numFrames; frame++) {
+                Busy(buildMicros);
+                std::this_thread::sleep_for(
+                    std::chrono::microseconds(SubmitMicros(frame)));
+            }
+        });
+        Report("serial", numFrames, ms, true);
+        return true;
+    }
+
+    bool RunThreaded(uint32_t numFrames, uint32_t numPackets)
+    {
+        std::array<Packet, Gfx::RenderThread::maxPackets> packets;
+        std::atomic<bool> ownershipOk = true;
+        std::atomic<bool> orderOk = true;
+        std::atomic<uint32_t> nextRendered = 0;
+        std::atomic<bool> begun = false;
+        std::atomic<bool> ended = false;
+
+        double ms = MedianMs(1, [&]() {
+            Gfx::RenderThread renderThread(numPackets,
+                {
+                    .begin = [&]() { begun = true; },
+                    .render =
+                        [&](uint32_t slot) {
+                            Packet& packet = packets[slot];
+                            packet.rendering = true;
+                            if (packet.writing) {
+                                ownershipOk = false;
+                            }
+                            if (packet.frame != nextRendered++) {
+                                orderOk = false;
+                            }
+                            std::this_thread::sleep_for(
+                                std::chrono::microseconds(
+                                    SubmitMicros(packet.frame)));
+                            packet.rendering = false;
+                        },
+                    .end = [&]() { ended = true; },
+                });
+            for (uint32_t frame = 0; frame < numFrames; frame++) {
+                uint32_t slot = renderThread.Acquire();
+                // Now and then a frame is skipped, as while the window is
+                // minimized; the packet it gives back comes out next.
+                if (frame % 16 == 5) {
+                    renderThread.Release(slot);
+                    if (renderThread.Acquire() != slot) {
+                        orderOk = false;
+                    }
+                }
+                Packet& packet = packets[slot];
+                packet.writing = true;
+                if (packet.rendering) {
+                    ownershipOk = false;
+                }
+                packet.frame = frame;
+                Busy(buildMicros);
+                packet.writing = false;
+                renderThread.Submit(
+                    static_cast<uint32_t>(&packet - packets.data()));
+            }
+            renderThread.Flush();
+            if (nextRendered != numFrames) {
+                orderOk = false;
+            }
+        });
+
+        bool passed = ownershipOk && orderOk && begun && ended;
+        std::string name = std::to_string(numPackets) + " packets";
+        Report(name.c_str(), numFrames, ms, passed);
+        return passed;
+    }
+
+} // namespace
+
+int RunRenderThreadBench(BenchArgs args)
+{
+    uint32_t numFrames = 300;
+    if (!args.empty()) {
+        numFrames = static_cast<uint32_t>(
+            std::max(std::strtoul(args.front(), nullptr, 10), 1ul));
+    }
+
+    spdlog::info("{} frames, {} us to build, {} us to submit, every eighth "
+                 "{} us",
+        numFrames, buildMicros, submitMicros, spikeMicros);
+    spdlog::info("{:<12} {:>10} {:>10} {:>8} {:>6}", "case", "ms", "ms/frame",
+        "fps", "ok");
+
+    bool allPassed = RunSerial(numFrames);
+    for (uint32_t numPackets = Gfx::RenderThread::minPackets;
+        numPackets <= Gfx::RenderThread::maxPackets; numPackets++) {
+        allPassed &= RunThreaded(numFrames, numPackets);
+    }
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
@@ -0,0 +1,208 @@
+#include "Bench.h"
+
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <utility>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "assets/MeshBuilder.h"
+#include "assets/MeshOptimizer.h"
+#include "assets/MeshSimplifier.h"
+#include "systems/Scene.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    // Instances of every mesh in a cube in front of the camera, like the
+    // application's stress scene.
+    Scene MakeScene(std::vector<SceneMesh> const& meshes, uint32_t count,
+        OcclusionOptions occlusion)
+    {
+        Scene scene(meshes,
+            {
+                .lod = {},
+                .occlusion = occlusion,
+                .meshlets = {},
+            });
+        constexpr float spacing = 3.0f;
+        uint32_t side = static_cast<uint32_t>(
+            std::ceil(std::cbrt(static_cast<float>(count))));
+        std::mt19937 random(count);
+        std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 cell(static_cast<float>(i % side),
+                static_cast<float>(i / side % side),
+                -static_cast<float>(i / (side * side)));
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f),
+                spacing * cell
+                    - glm::vec3(0.5f * spacing * static_cast<float>(side)));
+            transform = glm::rotate(
+                transform, angle(random), glm::vec3(0.0f, 1.0f, 0.0f));
+            scene.AddInstance(
+                transform, i % static_cast<uint32_t>(meshes.size()));
+        }
+        return scene;
+    }
+
+    // Every instance has to come out exactly once, in a command of its own
+    // mesh, and the commands must tile the transforms.
+    bool Verify(Scene const& scene, DrawListStats const& stats,
+        std::span<DrawCommand const> commands,
+        std::span<DrawRecord const> records,
+        std::span<glm::mat4 const> transforms)
+    {
+        uint32_t next = 0;
+        for (uint32_t d = 0; d < stats.numDraws; d++) {
+            SceneMesh const& mesh = scene.Meshes()[records[d].mesh];
+            bool knownLod = std::ranges::any_of(
+                mesh.lods, [&](Assets::MeshLod const& lod) {
+                    return lod.firstIndex == commands[d].firstIndex
+                        && lod.indexCount == commands[d].count;
+                });
+            if (!knownLod || commands[d].baseInstance != next
+                || records[d].firstInstance != next
+                || commands[d].baseVertex != mesh.baseVertex) {
+                return false;
+            }
+            next += commands[d].instanceCount;
+        }
+        std::span<uint8_t const> visible = scene.Visibility();
+        size_t numVisible = static_cast<size_t>(std::ranges::count(visible, 1));
+        if (next != numVisible || stats.numInstances != next
+            || stats.numCulled + stats.numOccluded
+                != scene.NumInstances() - numVisible) {
+            return false;
+        }
+
+        // The transforms of the visible instances may only be reordered.
+        std::vector<glm::mat4> expected;
+        for (size_t i = 0; i < scene.NumInstances(); i++) {
+            if (visible[i]) {
+                expected.push_back(scene.Transforms()[i]);
+            }
+        }
+        auto translations = [](std::span<glm::mat4 const> matrices) {
+            std::vector<std::tuple<float, float, float>> result;
+            for (glm::mat4 const& matrix : matrices) {
+                result.emplace_back(matrix[3].x, matrix[3].y, matrix[3].z);
+            }
+            std::ranges::sort(result);
+            return result;
+        };
+        return translations(transforms.subspan(0, next))
+            == translations(expected);
+    }
+
+    // Occlusion off, on when the occluders cover enough of the screen, and
+    // on however little they cover.
+    struct OcclusionCase {
+        char const* name;
+        OcclusionOptions options;
+    };
+
+} // namespace
+
+int RunSceneBench(BenchArgs args)
+{
+    std::vector<Assets::MeshData> meshData;
+    for (std::string const& path : MeshPaths(args)) {
+        std::optional<Assets::ObjData> obj;
+        {
+            ScopedLogLevel quiet(spdlog::level::off);
+            obj = Assets::ImportObj(path.c_str(), "meshes/");
+        }
+        Assets::MeshData mesh;
+        if (!obj
+            || Assets::BuildMesh(*obj, mesh)
+                != Assets::MeshBuildResult::BuildOk) {
+            continue;
+        }
+        Assets::BuildLodChain(mesh);
+        (void)Assets::OptimizeMesh(mesh);
+        meshData.push_back(std::move(mesh));
+    }
+    if (meshData.empty()) {
+        spdlog::error("No renderable meshes");
+        return 1;
+    }
+
+    std::vector<Assets::MeshView> views;
+    for (Assets::MeshData const& mesh : meshData) {
+        views.push_back(ViewOf(mesh));
+    }
+    SceneGeometry geometry = PackSceneGeometry(views, {});
+    spdlog::info("{} meshes packed into {} vertex and {} index bytes, {}-bit "
+                 "indices",
+        geometry.meshes.size(), geometry.vertexData.size(),
+        geometry.indexData.size(),
+        geometry.indexFormat == Assets::IndexFormat::Uint16 ? 16 : 32);
+
+    spdlog::info("{:>10} {:>9} {:>7} {:>8} {:>8} {:>10} {:>12} {:>10} {:>9} "
+                 "{:>6}",
+        "instances", "occlusion", "draws", "culled", "occluded", "ms/frame",
+        "ns/instance", "MiB/frame", "saved", "ok");
+
+    // The application's default camera, looking down -z at 16:9.
+    glm::vec3 cameraPosition(0.0f, 0.0f, 7.0f);
+    float verticalFov = glm::radians(45.0f);
+    SceneView view {
+        .viewProjection
+        = glm::perspective(verticalFov, 16.0f / 9.0f, 0.1f, 1000.0f)
+            * glm::lookAt(cameraPosition,
+                cameraPosition - glm::vec3(0.0f, 0.0f, 1.0f),
+                glm::vec3(0.0f, 1.0f, 0.0f)),
+        .lod = {
+            .cameraPosition = cameraPosition,
+            .verticalFov = verticalFov,
+            .viewportHeight = 1080.0f,
+        },
+    };
+
+    OcclusionCase const occlusionCases[] = {
+        {"off", {.enabled = false}},
+        {"auto", {.enabled = true}},
+        {"always", {.enabled = true, .minOccluderCoverage = 0.0f}},
+    };
+    bool allValid = true;
+    for (uint32_t count : {1'000u, 10'000u, 30'000u, 100'000u}) {
+        for (OcclusionCase const& occlusion : occlusionCases) {
+            Scene scene
+                = MakeScene(geometry.meshes, count, occlusion.options);
+            std::vector<DrawCommand> commands(scene.MaxDraws());
+            std::vector<DrawRecord> records(scene.MaxDraws());
+            std::vector<glm::mat4> transforms(scene.NumInstances());
+            DrawListTargets targets {commands, records, transforms};
+
+            DrawListStats stats;
+            double ms = MedianMs(
+                15, [&]() { stats = scene.BuildDrawList(view, targets); });
+
+            bool valid = Verify(scene, stats, commands, records, transforms);
+            allValid &= valid;
+
+            double mib = static_cast<double>(
+                             stats.numInstances * sizeof(glm::mat4)
+                             + stats.numDraws
+                                 * (sizeof(DrawCommand) + sizeof(DrawRecord)))
+                / (1024.0 * 1024.0);
+            double saved = stats.fullTriangles == 0
+                ? 0.0
+                : static_cast<double>(
+                      stats.fullTriangles - stats.numTriangles)
+                    / static_cast<double>(stats.fullTriangles);
+            spdlog::info("{:>10} {:>9} {:>7} {:>8} {:>8} {:>10.3f} {:>12.1f} "
+                         "{:>10.2f} {:>8.1f}% {:>6}",
+                count, occlusion.name, stats.numDraws, stats.numCulled,
+                stats.numOccluded, ms, 1e6 * ms / count, mib, 100.0 * saved,
+                valid ? "yes" : "NO");
+        }
+    }
+
+    return allValid ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
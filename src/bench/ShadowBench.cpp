@@ -0,0 +1,227 @@
+#include "Bench.h"
+
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "systems/ShadowCascades.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    constexpr float verticalFov = glm::radians(45.0f);
+    constexpr float aspect = 16.0f / 9.0f;
+    constexpr float nearPlane = 0.1f;
+
+    // Walking pace at 60 fps, looking around a little as it goes.
+    ShadowView PathView(uint32_t frame)
+    {
+        float t = static_cast<float>(frame);
+        glm::vec3 position(0.0f, 1.7f, -0.05f * t);
+        float yaw = 0.3f * std::sin(0.01f * t);
+        glm::vec3 direction(std::sin(yaw), -0.1f, -std::cos(yaw));
+        return {
+            .view = glm::lookAt(position, position + direction,
+                glm::vec3(0.0f, 1.0f, 0.0f)),
+            .verticalFov = verticalFov,
+            .aspect = aspect,
+            .nearPlane = nearPlane,
+        };
+    }
+
+    DirectionalLight const sun {
+        .direction = glm::normalize(glm::vec3(1.0f, 2.0f, 5.0f)),
+        .color = glm::vec3(1.0f),
+        .intensity = 1.0f,
+    };
+    CasterBounds const casters {
+        .center = glm::vec3(0.0f, 0.0f, -20.0f),
+        .radius = 60.0f,
+    };
+
+    // Every corner of the cascade's slice of the view lands inside its
+    // clip box, so nothing on screen samples outside its shadow map.
+    bool SliceContained(ShadowView const& view, ShadowCascade const& cascade,
+        float sliceNear)
+    {
+        glm::mat4 viewToClip
+            = cascade.viewProjection * glm::inverse(view.view);
+        float tanHalf = std::tan(0.5f * view.verticalFov);
+        for (float depth : {sliceNear, cascade.splitDepth}) {
+            for (float sx : {-1.0f, 1.0f}) {
+                for (float sy : {-1.0f, 1.0f}) {
+                    glm::vec4 clip = viewToClip
+                        * glm::vec4(sx * depth * tanHalf * view.aspect,
+                            sy * depth * tanHalf, -depth, 1.0f);
+                    constexpr float slack = 1e-4f;
+                    if (std::abs(clip.x) > 1.0f + slack
+                        || std::abs(clip.y) > 1.0f + slack
+                        || std::abs(clip.z) > 1.0f + slack) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // The world origin lands on a texel corner, so texels sit at the same
+    // spots of the world however the cascade was fitted.
+    bool Snapped(ShadowCascade const& cascade, uint32_t resolution)
+    {
+        glm::vec4 origin = cascade.viewProjection * glm::vec4(0, 0, 0, 1);
+        float texels = origin.x * 0.5f * static_cast<float>(resolution);
+        float texelsY = origin.y * 0.5f * static_cast<float>(resolution);
+        return std::abs(texels - std::round(texels)) < 1e-2f
+            && std::abs(texelsY - std::round(texelsY)) < 1e-2f;
+    }
+
+    struct PathResult {
+        uint64_t renders {};
+        uint64_t refits {};
+        std::array<double, maxShadowCascades> rates {};
+        bool contained = true;
+        bool snapped = true;
+    };
+
+    PathResult RunPath(ShadowCascadeOptions const& options, uint32_t frames)
+    {
+        ShadowCascades cascades(options);
+        PathResult result;
+        for (uint32_t f = 0; f < frames; f++) {
+            ShadowView view = PathView(f);
+            std::span<ShadowCascade const> fitted
+                = cascades.Update(view, sun, casters);
+            float sliceNear = view.nearPlane;
+            for (ShadowCascade const& cascade : fitted) {
+                result.contained &= SliceContained(view, cascade, sliceNear);
+                result.snapped &= Snapped(cascade, options.resolution);
+                sliceNear = cascade.splitDepth;
+            }
+        }
+        std::span<CascadeStats const> stats = cascades.Stats();
+        for (size_t c = 0; c < stats.size(); c++) {
+            result.renders += stats[c].renders;
+            result.refits += stats[c].refits;
+            result.rates[c] = stats[c].UpdateRate();
+        }
+        return result;
+    }
+
+    // Which cascades the next Update() redraws.
+    std::vector<bool> Redrawn(ShadowCascades& cascades, ShadowView const& view)
+    {
+        std::vector<bool> redrawn;
+        for (ShadowCascade const& cascade :
+            cascades.Update(view, sun, casters)) {
+            redrawn.push_back(cascade.render);
+        }
+        return redrawn;
+    }
+
+    // Something moving near the camera redraws the nearest cascade,
+    // something far ahead only the furthest ones, something outside all of
+    // them none; and each redraw happens once.
+    bool CheckInvalidation(ShadowCascadeOptions const& options)
+    {
+        ShadowCascades cascades(options);
+        ShadowView view = PathView(0);
+        (void)cascades.Update(view, sun, casters);
+        glm::mat4 viewToWorld = glm::inverse(view.view);
+        glm::vec3 nearCamera
+            = viewToWorld * glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+        glm::vec3 farAhead
+            = viewToWorld * glm::vec4(0.0f, 0.0f, -70.0f, 1.0f);
+
+        cascades.Invalidate(nearCamera, 0.5f);
+        std::vector<bool> nearRedrawn = Redrawn(cascades, view);
+        std::vector<bool> settled = Redrawn(cascades, view);
+        cascades.Invalidate(farAhead, 0.5f);
+        std::vector<bool> farRedrawn = Redrawn(cascades, view);
+        cascades.Invalidate(glm::vec3(1e4f), 1.0f);
+        std::vector<bool> outside = Redrawn(cascades, view);
+
+        auto list = [](std::vector<bool> const& redrawn) {
+            std::string listed;
+            for (size_t c = 0; c < redrawn.size(); c++) {
+                listed += redrawn[c] ? std::to_string(c) : "-";
+            }
+            return listed;
+        };
+        spdlog::info("Cascades redrawn: near the camera {}, 70 m ahead {}, "
+                     "outside every cascade {}, nothing moved {}",
+            list(nearRedrawn), list(farRedrawn), list(outside),
+            list(settled));
+        auto none = [](std::vector<bool> const& redrawn) {
+            return std::ranges::none_of(redrawn, [](bool r) { return r; });
+        };
+        return nearRedrawn.front() && farRedrawn.back()
+            && !farRedrawn.front() && none(outside) && none(settled);
+    }
+
+} // namespace
+
+int RunShadowBench(BenchArgs args)
+{
+    uint32_t frames = 600;
+    if (!args.empty()) {
+        frames = std::max<uint32_t>(
+            static_cast<uint32_t>(std::strtoul(args.front(), nullptr, 10)),
+            1u);
+    }
+
+    struct ShadowCase {
+        char const* name;
+        bool cache;
+        float margin;
+    };
+    ShadowCase const cases[] = {
+        {"naive", false, 0.15f},
+        {"margin 0", true, 0.0f},
+        {"margin .15", true, 0.15f},
+        {"margin .3", true, 0.3f},
+    };
+
+    spdlog::info("{} frames, {} cascades", frames, maxShadowCascades);
+    spdlog::info("{:<11} {:>6} {:>6} {:>6} {:>6} {:>8} {:>7} {:>7} {:>9} "
+                 "{:>6}",
+        "cache", "c0 %", "c1 %", "c2 %", "c3 %", "renders", "saved", "refits",
+        "us/frame", "valid");
+    bool allPassed = true;
+    uint64_t naiveRenders = 0;
+    uint64_t cachedRenders = 0;
+    for (ShadowCase const& shadowCase : cases) {
+        ShadowCascadeOptions options {
+            .cacheMargin = shadowCase.margin,
+            .cache = shadowCase.cache,
+        };
+        PathResult result;
+        double ms = MedianMs(3, [&]() { result = RunPath(options, frames); });
+        if (!shadowCase.cache) {
+            naiveRenders = result.renders;
+        } else if (shadowCase.margin == 0.15f) {
+            cachedRenders = result.renders;
+        }
+        bool valid = result.contained && result.snapped;
+        allPassed &= valid;
+        double saved = naiveRenders == 0 ? 0.0
+                                         : 1.0
+                - static_cast<double>(result.renders)
+                    / static_cast<double>(naiveRenders);
+        spdlog::info("{:<11} {:>6.1f} {:>6.1f} {:>6.1f} {:>6.1f} {:>8} "
+                     "{:>6.1f}% {:>7} {:>9.2f} {:>6}",
+            shadowCase.name, 100.0 * result.rates[0], 100.0 * result.rates[1],
+            100.0 * result.rates[2], 100.0 * result.rates[3], result.renders,
+            100.0 * saved, result.refits, 1000.0 * ms / frames,
+            valid ? "yes" : "NO");
+    }
+    allPassed &= cachedRenders < naiveRenders;
+    allPassed &= CheckInvalidation({});
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
@@ -0,0 +1,177 @@
+#include "Bench.h"
+
+#include <cmath>
+#include <filesystem>
+#include <random>
+
+#include "assets/TextureCache.h"
+#include "assets/TextureCompressor.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    // Lowest acceptable level 0 PSNR in dB. Mode 6 BC7 should always beat
+    // BC1, which has 16-bit endpoints and only four colours per block.
+    struct FormatCase {
+        char const* name;
+        Assets::TextureFormat format;
+        double minPsnr;
+        bool withAlpha;
+    };
+    constexpr FormatCase formatCases[] = {
+        {"bc1", Assets::TextureFormat::Bc1, 30.0, false},
+        {"bc3", Assets::TextureFormat::Bc3, 30.0, true},
+        {"bc7", Assets::TextureFormat::Bc7, 36.0, true},
+    };
+
+    // Gradients, hard edges, noise and a varying alpha channel, so every
+    // part of the encoders is exercised.
+    Assets::Image SyntheticImage(uint32_t width, uint32_t height)
+    {
+        Assets::ImageLevel level {
+            .width = width,
+            .height = height,
+            .pixels = std::vector<uint8_t>(size_t(width) * height * 4),
+        };
+        std::mt19937 random(width ^ height);
+        std::uniform_int_distribution<int> noise(-6, 6);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                uint8_t* texel
+                    = level.pixels.data() + (size_t(y) * width + x) * 4;
+                bool checker = (x / 32 + y / 32) % 2 == 0;
+                int r = static_cast<int>(255 * x / width);
+                int g = checker ? 200 : 40;
+                int b = static_cast<int>(
+                    127.5 + 127.5 * std::sin(0.05 * double(x + y)));
+                int a = static_cast<int>(255 * y / height);
+                int values[4] = {r, g, b, a};
+                for (int c = 0; c < 4; c++) {
+                    texel[c] = static_cast<uint8_t>(
+                        std::clamp(values[c] + noise(random), 0, 255));
+                }
+            }
+        }
+
+        Assets::Image image;
+        image.levels.push_back(std::move(level));
+        Assets::BuildMipChain(image);
+        return image;
+    }
+
+    size_t TexelCount(Assets::Image const& image)
+    {
+        size_t count = 0;
+        for (Assets::ImageLevel const& level : image.levels) {
+            count += size_t(level.width) * level.height;
+        }
+        return count;
+    }
+
+    size_t ByteCount(Assets::Image const& image)
+    {
+        size_t bytes = 0;
+        for (Assets::ImageLevel const& level : image.levels) {
+            bytes += level.pixels.size();
+        }
+        return bytes;
+    }
+
+    bool SameImage(Assets::Image const& a, Assets::Image const& b)
+    {
+        if (a.format != b.format || a.levels.size() != b.levels.size()) {
+            return false;
+        }
+        for (size_t l = 0; l < a.levels.size(); l++) {
+            if (a.levels[l].width != b.levels[l].width
+                || a.levels[l].height != b.levels[l].height
+                || a.levels[l].pixels != b.levels[l].pixels) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Encodes the image in every format, checks quality against the
+    // original and, for files, that the cache reads back what was written.
+    bool RunImage(std::string const& name, Assets::Image const& image,
+        char const* sourcePath)
+    {
+        constexpr int iterations = 3;
+
+        double megaTexels = static_cast<double>(TexelCount(image)) / 1e6;
+        size_t rgbaBytes = ByteCount(image);
+        bool allPassed = true;
+        for (FormatCase const& formatCase : formatCases) {
+            Assets::Image compressed;
+            double encodeMs = MedianMs(iterations, [&]() {
+                compressed = Assets::CompressImage(image, formatCase.format);
+            });
+            Assets::Image decoded;
+            double decodeMs = MedianMs(iterations,
+                [&]() { decoded = Assets::DecompressImage(compressed); });
+
+            double psnr = Assets::Psnr(
+                image.levels[0], decoded.levels[0], formatCase.withAlpha);
+            bool passed = psnr >= formatCase.minPsnr;
+
+            bool cacheOk = true;
+            if (sourcePath) {
+                cacheOk = Assets::WriteTextureCache(sourcePath, compressed);
+                std::optional<Assets::Image> cached
+                    = Assets::OpenTextureCache(sourcePath, formatCase.format);
+                cacheOk &= cached && SameImage(*cached, compressed);
+                passed &= cacheOk;
+            }
+            allPassed &= passed;
+
+            spdlog::info("{:<24} {:<6} {:>10.1f} {:>10.1f} {:>10.2f} {:>8.1f}x "
+                         "{:>8.2f} {:>6} {:>6}",
+                name, formatCase.name, encodeMs, megaTexels / encodeMs * 1e3,
+                decodeMs,
+                static_cast<double>(rgbaBytes)
+                    / static_cast<double>(ByteCount(compressed)),
+                psnr, sourcePath ? (cacheOk ? "yes" : "NO") : "-",
+                passed ? "yes" : "NO");
+        }
+        return allPassed;
+    }
+
+} // namespace
+
+int RunTextureBench(BenchArgs args)
+{
+    std::vector<std::string> paths(args.begin(), args.end());
+    if (paths.empty()) {
+        std::error_code error;
+        for (auto const& entry :
+            std::filesystem::directory_iterator("meshes", error)) {
+            std::string extension = entry.path().extension().string();
+            if (extension == ".jpg" || extension == ".png") {
+                paths.push_back(entry.path().generic_string());
+            }
+        }
+        std::ranges::sort(paths);
+    }
+
+    spdlog::info("{:<24} {:<6} {:>10} {:>10} {:>10} {:>9} {:>8} {:>6} {:>6}",
+        "image", "format", "enc ms", "Mtex/s", "dec ms", "ratio", "PSNR",
+        "cache", "ok");
+
+    bool allPassed = RunImage("synthetic 1024x512",
+        SyntheticImage(1024, 512), nullptr);
+    for (std::string const& path : paths) {
+        std::optional<Assets::Image> image = Assets::LoadImage(path.c_str());
+        if (!image) {
+            spdlog::info("{:<24} skipped, not a readable image", path);
+            continue;
+        }
+        Assets::BuildMipChain(*image);
+        allPassed &= RunImage(path, *image, path.c_str());
+    }
+
+    return allPassed ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
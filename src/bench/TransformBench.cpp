@@ -0,0 +1,173 @@
+#include "Bench.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "systems/TransformHierarchy.h"
+#include "util/Parallel.h"
+#include "util/Simd.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    // Each node hangs off a random earlier one, after a few roots: about
+    // ln(count) levels deep, and added out of depth order, so the
+    // hierarchy has to sort itself.
+    void BuildTree(TransformHierarchy& hierarchy, size_t count)
+    {
+        std::mt19937 random(static_cast<uint32_t>(count));
+        std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> scale(0.8f, 1.2f);
+        auto randomLocal = [&]() {
+            return LocalTransform {
+                .translation = {offset(random), offset(random), offset(random)},
+                .rotation = glm::normalize(glm::quat(
+                    unit(random), unit(random), unit(random), unit(random))),
+                .scale = scale(random),
+            };
+        };
+
+        constexpr size_t numRoots = 64;
+        for (size_t i = 0; i < count; i++) {
+            NodeId parent = noParent;
+            if (i >= numRoots) {
+                parent = std::uniform_int_distribution<NodeId>(
+                    0, static_cast<NodeId>(i - 1))(random);
+            }
+            (void)hierarchy.AddNode(randomLocal(), parent);
+        }
+    }
+
+    // The textbook way, one node at a time, for checking the SIMD result.
+    glm::mat4 ReferenceWorld(TransformHierarchy const& hierarchy, NodeId node)
+    {
+        LocalTransform local = hierarchy.Local(node);
+        glm::mat4 matrix = glm::translate(glm::mat4(1.0f), local.translation)
+            * glm::mat4_cast(local.rotation)
+            * glm::scale(glm::mat4(1.0f), glm::vec3(local.scale));
+        NodeId parent = hierarchy.Parent(node);
+        return parent == noParent ? matrix
+                                  : hierarchy.World(parent) * matrix;
+    }
+
+    struct UpdateCase {
+        char const* name;
+        TransformUpdateMethod method;
+        bool parallel;
+        bool supported;
+    };
+
+    bool RunCount(size_t count)
+    {
+        UpdateCase const cases[] = {
+            {"scalar", TransformUpdateMethod::Scalar, false, true},
+            {"sse", TransformUpdateMethod::Sse, false, true},
+            {"avx", TransformUpdateMethod::Avx, false, Util::HasAvx()},
+            {"widest, mt", TransformUpdateMethod::Widest, true, true},
+        };
+
+        // The same nodes are touched for every path: either all of them,
+        // or 1% at random, whose subtrees come along.
+        std::vector<NodeId> all(count);
+        for (size_t i = 0; i < count; i++) {
+            all[i] = static_cast<NodeId>(i);
+        }
+        std::vector<NodeId> some;
+        std::mt19937 random(1);
+        std::uniform_int_distribution<size_t> pick(0, count - 1);
+        for (size_t i = 0; i < count / 100; i++) {
+            some.push_back(static_cast<NodeId>(pick(random)));
+        }
+        struct DirtyCase {
+            char const* name;
+            std::span<NodeId const> nodes;
+        };
+        DirtyCase const dirtyCases[] = {{"1%", some}, {"100%", all}};
+
+        spdlog::info("{} nodes, {} workers", count, Util::WorkerCount());
+        spdlog::info("{:<6} {:<12} {:>9} {:>8} {:>9} {:>7} {:>6}", "dirty",
+            "path", "ms", "speedup", "updated", "levels", "same");
+        bool allPassed = true;
+        for (DirtyCase const& dirtyCase : dirtyCases) {
+            std::vector<glm::mat4> reference;
+            double referenceMs = 0.0;
+            for (UpdateCase const& updateCase : cases) {
+                if (!updateCase.supported) {
+                    spdlog::info("{:<6} {:<12} not supported on this CPU",
+                        dirtyCase.name, updateCase.name);
+                    continue;
+                }
+                TransformHierarchy hierarchy({
+                    .method = updateCase.method,
+                    .parallel = updateCase.parallel,
+                });
+                BuildTree(hierarchy, count);
+                (void)hierarchy.Update();
+
+                // Only Update() is timed, not the touching.
+                TransformUpdateStats stats;
+                std::vector<double> samples;
+                for (int run = 0; run < 5; run++) {
+                    for (NodeId node : dirtyCase.nodes) {
+                        hierarchy.SetLocal(node, hierarchy.Local(node));
+                    }
+                    stats = hierarchy.Update();
+                    samples.push_back(stats.updateMs);
+                }
+                std::ranges::sort(samples);
+                double ms = samples[samples.size() / 2];
+
+                std::vector<glm::mat4> worlds(count);
+                for (size_t i = 0; i < count; i++) {
+                    worlds[i] = hierarchy.World(static_cast<NodeId>(i));
+                }
+                bool same = true;
+                if (reference.empty()) {
+                    reference = worlds;
+                    referenceMs = ms;
+                    // Against glm, which rounds differently, only close.
+                    float worst = 0.0f;
+                    for (size_t i = 0; i < count; i++) {
+                        glm::mat4 expected = ReferenceWorld(
+                            hierarchy, static_cast<NodeId>(i));
+                        for (int c = 0; c < 4; c++) {
+                            glm::vec4 error
+                                = glm::abs(expected[c] - worlds[i][c]);
+                            worst = std::max({worst, error.x, error.y,
+                                error.z, error.w});
+                        }
+                    }
+                    same = worst < 1e-3f;
+                    spdlog::info("Largest difference from glm: {:.2e}", worst);
+                } else {
+                    same = std::memcmp(worlds.data(), reference.data(),
+                               count * sizeof(glm::mat4))
+                        == 0;
+                }
+                allPassed &= same;
+                spdlog::info("{:<6} {:<12} {:>9.3f} {:>7.2f}x {:>9} {:>7} "
+                             "{:>6}",
+                    dirtyCase.name, updateCase.name, ms, referenceMs / ms,
+                    stats.numUpdated, stats.numLevels, same ? "yes" : "NO");
+            }
+        }
+        return allPassed;
+    }
+
+} // namespace
+
+int RunTransformBench(BenchArgs args)
+{
+    size_t count = 100000;
+    if (!args.empty()) {
+        count = std::max<size_t>(std::strtoull(args.front(), nullptr, 10), 1);
+    }
+    return RunCount(count) ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
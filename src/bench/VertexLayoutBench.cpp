@@ -0,0 +1,155 @@
+#include "Bench.h"
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "assets/MeshBuilder.h"
+#include "assets/MeshOptimizer.h"
+#include "assets/VertexLayout.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    // 10-bit octahedral normals stay within about 0.16 degrees; the bound
+    // leaves some room for float rounding.
+    constexpr double maxNormalErrorDegrees = 0.25;
+
+    struct RoundTripError {
+        double position {};
+        double texCoord {};
+        double normalDegrees {};
+        bool withinBounds = true;
+    };
+
+    RoundTripError MeasureRoundTrip(Assets::MeshData const& mesh,
+        Assets::VertexLayout const& layout, std::vector<std::byte> const& data)
+    {
+        glm::vec3 extent = mesh.bounds.max - mesh.bounds.min;
+        double maxExtent = std::max({extent.x, extent.y, extent.z});
+        double positionBound
+            = layout.position.format == Assets::AttribFormat::Unorm16x4
+            ? 0.5 * maxExtent / 65535.0 + 1e-6
+            : 0.0;
+
+        RoundTripError error;
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            Assets::Vertex const& original = mesh.vertices[i];
+            Assets::Vertex decoded = Assets::DecodeVertex(
+                data.data() + i * layout.stride, layout, mesh.bounds);
+
+            double position = std::max({std::abs(decoded.x - original.x),
+                std::abs(decoded.y - original.y),
+                std::abs(decoded.z - original.z)});
+
+            double texCoord = std::max(std::abs(decoded.u - original.u),
+                std::abs(decoded.v - original.v));
+            double texCoordBound = 0.0;
+            if (layout.texCoord.format == Assets::AttribFormat::Unorm16x2) {
+                texCoordBound = 0.5 / 65535.0 + 1e-7;
+            } else if (layout.texCoord.format
+                == Assets::AttribFormat::Float16x2) {
+                // Half floats keep 11 significant bits.
+                double magnitude = std::max(
+                    {std::abs(original.u), std::abs(original.v), 6.1e-5f});
+                texCoordBound = magnitude / 2048.0;
+            }
+
+            glm::dvec3 a = glm::normalize(
+                glm::dvec3(original.nx, original.ny, original.nz));
+            glm::dvec3 b = glm::normalize(
+                glm::dvec3(decoded.nx, decoded.ny, decoded.nz));
+            double normalDegrees = glm::degrees(
+                std::acos(std::clamp(glm::dot(a, b), -1.0, 1.0)));
+
+            error.position = std::max(error.position, position);
+            error.texCoord = std::max(error.texCoord, texCoord);
+            error.normalDegrees = std::max(error.normalDegrees, normalDegrees);
+            error.withinBounds &= position <= positionBound
+                && texCoord <= texCoordBound
+                && normalDegrees <= maxNormalErrorDegrees;
+        }
+        return error;
+    }
+
+    bool RunMesh(std::string const& name, Assets::MeshData const& mesh)
+    {
+        constexpr int iterations = 9;
+
+        struct LayoutCase {
+            char const* name;
+            Assets::VertexLayoutOptions options;
+        };
+        constexpr LayoutCase cases[] = {
+            {"full", {.compact = false}},
+            {"compact", {.compact = true, .quantizePositions = false}},
+            {"quantized", {.compact = true, .quantizePositions = true}},
+        };
+
+        size_t fullBytes = mesh.vertices.size() * sizeof(Assets::Vertex)
+            + mesh.indices.size() * sizeof(uint32_t);
+
+        bool allWithinBounds = true;
+        for (LayoutCase const& layoutCase : cases) {
+            Assets::VertexLayout layout
+                = Assets::ChooseVertexLayout(ViewOf(mesh), layoutCase.options);
+            Assets::IndexFormat indexFormat = layoutCase.options.compact
+                ? Assets::ChooseIndexFormat(mesh.vertices.size())
+                : Assets::IndexFormat::Uint32;
+
+            std::vector<std::byte> vertexData;
+            double encodeMs = MedianMs(iterations, [&]() {
+                vertexData = Assets::EncodeVertices(
+                    mesh.vertices, layout, mesh.bounds);
+            });
+            std::vector<std::byte> indexData
+                = Assets::EncodeIndices(mesh.indices, indexFormat);
+
+            RoundTripError error = MeasureRoundTrip(mesh, layout, vertexData);
+            allWithinBounds &= error.withinBounds;
+
+            size_t totalBytes = vertexData.size() + indexData.size();
+            spdlog::info("{:<28} {:<10} {:>6} {:>6} {:>10.1f} {:>6.1f}% "
+                         "{:>10.2e} {:>10.2e} {:>8.4f} {:>8.3f} {:>6}",
+                name, layoutCase.name, layout.stride,
+                indexFormat == Assets::IndexFormat::Uint16 ? 16 : 32,
+                totalBytes / 1024.0,
+                fullBytes == 0 ? 0.0 : 100.0 * totalBytes / fullBytes,
+                error.position, error.texCoord, error.normalDegrees, encodeMs,
+                error.withinBounds ? "yes" : "NO");
+        }
+        return allWithinBounds;
+    }
+
+} // namespace
+
+int RunVertexLayoutBench(BenchArgs args)
+{
+    spdlog::info("{:<28} {:<10} {:>6} {:>6} {:>10} {:>7} {:>10} {:>10} {:>8} "
+                 "{:>8} {:>6}",
+        "mesh", "layout", "stride", "index", "KiB", "size", "pos err",
+        "uv err", "nrm deg", "enc ms", "ok");
+
+    bool allWithinBounds = true;
+    for (std::string const& path : MeshPaths(args)) {
+        std::optional<Assets::ObjData> obj;
+        {
+            ScopedLogLevel quiet(spdlog::level::off);
+            obj = Assets::ImportObj(path.c_str(), "meshes/");
+        }
+        Assets::MeshData mesh;
+        if (!obj
+            || Assets::BuildMesh(*obj, mesh)
+                != Assets::MeshBuildResult::BuildOk) {
+            spdlog::info("{:<28} skipped, not a renderable mesh", path);
+            continue;
+        }
+        (void)Assets::OptimizeMesh(mesh);
+        allWithinBounds &= RunMesh(path, mesh);
+    }
+
+    return allWithinBounds ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
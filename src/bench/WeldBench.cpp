@@ -0,0 +1,323 @@
+#include "Bench.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "assets/ObjImporter.h"
+#include "assets/VertexWelder.h"
+#include "util/Hash.h"
+
+namespace Umbrella::Bench {
+
+namespace {
+
+    size_t liveBytes = 0;
+    size_t peakBytes = 0;
+
+    // Tracks the bytes held by the legacy welder's node-based map.
+    template <typename T> struct CountingAllocator {
+        using value_type = T;
+
+        CountingAllocator() = default;
+        template <typename U> CountingAllocator(CountingAllocator<U> const&) {}
+
+        T* allocate(size_t count)
+        {
+            liveBytes += count * sizeof(T);
+            peakBytes = std::max(peakBytes, liveBytes);
+            return std::allocator<T>().allocate(count);
+        }
+
+        void deallocate(T* pointer, size_t count)
+        {
+            liveBytes -= count * sizeof(T);
+            std::allocator<T>().deallocate(pointer, count);
+        }
+
+        friend bool operator==(CountingAllocator, CountingAllocator)
+        {
+            return true;
+        }
+    };
+
+    // The welder BuildMesh used before VertexWelder. XOR-ing the component
+    // hashes makes every permutation of the same values collide.
+    struct LegacyHasher {
+        size_t operator()(Assets::Vertex const& va) const
+        {
+            return std::hash<float>()(va.x) ^ std::hash<float>()(va.y)
+                ^ std::hash<float>()(va.z) ^ std::hash<float>()(va.u)
+                ^ std::hash<float>()(va.v) ^ std::hash<float>()(va.nx)
+                ^ std::hash<float>()(va.ny) ^ std::hash<float>()(va.nz);
+        }
+    };
+
+    using LegacyMap = std::unordered_map<Assets::Vertex, size_t, LegacyHasher,
+        std::equal_to<>,
+        CountingAllocator<std::pair<Assets::Vertex const, size_t>>>;
+
+    Assets::WeldResult LegacyWeld(
+        std::span<Assets::Vertex const> corners, LegacyMap& seenVertices)
+    {
+        Assets::WeldResult result;
+        seenVertices.clear();
+        for (Assets::Vertex const& corner : corners) {
+            auto seenIt = seenVertices.find(corner);
+            if (seenIt != seenVertices.end()) {
+                result.indices.push_back(static_cast<uint32_t>(seenIt->second));
+            } else {
+                seenVertices[corner] = result.vertices.size();
+                result.indices.push_back(
+                    static_cast<uint32_t>(result.vertices.size()));
+                result.vertices.push_back(corner);
+            }
+        }
+        return result;
+    }
+
+    struct WeldInput {
+        std::string name;
+        std::vector<Assets::Vertex> corners {};
+        std::vector<size_t> shapeStarts {};
+    };
+
+    std::optional<WeldInput> GatherCorners(std::string const& path)
+    {
+        std::optional<Assets::ObjData> obj;
+        {
+            ScopedLogLevel quiet(spdlog::level::off);
+            obj = Assets::ImportObj(path.c_str(), "meshes/");
+        }
+        if (!obj) {
+            return {};
+        }
+
+        tinyobj::attrib_t const& attrib = obj->attrib;
+        WeldInput input {.name = path};
+        for (auto& shape : obj->shapes) {
+            input.shapeStarts.push_back(input.corners.size());
+            for (auto& i : shape.mesh.indices) {
+                if (i.vertex_index == -1 || i.normal_index == -1) {
+                    return {};
+                }
+                bool hasTexCoords = i.texcoord_index != -1;
+                input.corners.push_back({
+                    .x = attrib.vertices[3 * i.vertex_index + 0],
+                    .y = attrib.vertices[3 * i.vertex_index + 1],
+                    .z = attrib.vertices[3 * i.vertex_index + 2],
+                    .u = hasTexCoords
+                        ? attrib.texcoords[2 * i.texcoord_index + 0]
+                        : -1.0f,
+                    .v = hasTexCoords
+                        ? attrib.texcoords[2 * i.texcoord_index + 1]
+                        : -1.0f,
+                    .nx = attrib.normals[3 * i.normal_index + 0],
+                    .ny = attrib.normals[3 * i.normal_index + 1],
+                    .nz = attrib.normals[3 * i.normal_index + 2],
+                });
+            }
+        }
+        return input;
+    }
+
+    // Every vertex appears with its position components in all six orders,
+    // which is the worst case for the XOR hash. Corners are shuffled so the
+    // stream does not hit the same slot over and over.
+    WeldInput PermutedCorners(size_t numGroups)
+    {
+        WeldInput input {.name = "synthetic/permuted"};
+        input.shapeStarts.push_back(0);
+
+        std::vector<Assets::Vertex> unique;
+        for (size_t g = 0; g < numGroups; g++) {
+            float a = static_cast<float>(g % 97) * 0.25f;
+            float b = static_cast<float>(g / 97 % 89) * 0.5f + 100.0f;
+            float c = static_cast<float>(g / 97 / 89) + 1000.0f;
+            float values[3] = {a, b, c};
+            std::ranges::sort(values);
+            do {
+                unique.push_back({values[0], values[1], values[2], 0.0f, 0.0f,
+                    0.0f, 0.0f, 1.0f});
+            } while (std::ranges::next_permutation(values).found);
+        }
+
+        for (int copy = 0; copy < 6; copy++) {
+            input.corners.insert(
+                input.corners.end(), unique.begin(), unique.end());
+        }
+        uint32_t state = 12345;
+        for (size_t i = input.corners.size() - 1; i > 0; i--) {
+            state = state * 1664525u + 1013904223u;
+            std::swap(input.corners[i], input.corners[state % (i + 1)]);
+        }
+        return input;
+    }
+
+    // Fraction of unique vertices whose full hash matches another one's.
+    template <typename HashFn>
+    double HashCollisionRate(
+        std::span<Assets::Vertex const> vertices, HashFn&& hash)
+    {
+        std::unordered_set<uint64_t> hashes;
+        for (Assets::Vertex const& vertex : vertices) {
+            hashes.insert(hash(vertex));
+        }
+        return vertices.empty()
+            ? 0.0
+            : 1.0 - static_cast<double>(hashes.size()) / vertices.size();
+    }
+
+    bool SameWeld(Assets::WeldResult const& a, Assets::WeldResult const& b)
+    {
+        return std::ranges::equal(a.vertices, b.vertices)
+            && a.indices == b.indices;
+    }
+
+    struct WeldRow {
+        char const* welder;
+        size_t numVertices;
+        double ms;
+        double lookupCollisionRate;
+        double hashCollisionRate;
+        size_t peakBytes;
+        char const* identical;
+    };
+
+    void PrintRow(WeldInput const& input, WeldRow const& row)
+    {
+        double mcps = row.ms > 0.0 ? input.corners.size() / row.ms / 1000.0 : 0;
+        spdlog::info("{:<28} {:<12} {:>9} {:>9} {:>9.3f} {:>8.1f} {:>8.2f}% "
+                     "{:>8.2f}% {:>10.1f} {:>9}",
+            input.name, row.welder, input.corners.size(), row.numVertices,
+            row.ms, mcps, 100.0 * row.lookupCollisionRate,
+            100.0 * row.hashCollisionRate, row.peakBytes / 1024.0,
+            row.identical);
+    }
+
+    bool RunInput(WeldInput const& input)
+    {
+        constexpr int iterations = 5;
+        std::span<Assets::Vertex const> corners = input.corners;
+
+        // Legacy unordered_map welder.
+        LegacyMap seenVertices;
+        Assets::WeldResult legacy;
+        peakBytes = liveBytes;
+        size_t baseBytes = liveBytes;
+        double legacyMs = MedianMs(iterations, [&]() {
+            LegacyMap map;
+            legacy = LegacyWeld(corners, map);
+        });
+        size_t legacyPeak = peakBytes - baseBytes;
+
+        // A lookup collides if its bucket also holds a different vertex.
+        legacy = LegacyWeld(corners, seenVertices);
+        size_t legacyCollisions = 0;
+        for (Assets::Vertex const& corner : corners) {
+            legacyCollisions
+                += seenVertices.bucket_size(seenVertices.bucket(corner)) > 1;
+        }
+
+        PrintRow(input,
+            {
+                .welder = "legacy",
+                .numVertices = legacy.vertices.size(),
+                .ms = legacyMs,
+                .lookupCollisionRate = corners.empty()
+                    ? 0.0
+                    : static_cast<double>(legacyCollisions) / corners.size(),
+                .hashCollisionRate
+                = HashCollisionRate(legacy.vertices, LegacyHasher()),
+                .peakBytes = legacyPeak,
+                .identical = "-",
+            });
+
+        double flatHashCollisionRate
+            = HashCollisionRate(legacy.vertices, [](Assets::Vertex const& v) {
+                  return Util::HashBytes(&v, sizeof(v));
+              });
+        auto flatRow = [&](char const* welder, Assets::WeldResult const& result,
+                           double ms, char const* identical) {
+            Assets::WeldStats const& stats = result.stats;
+            return WeldRow {
+                .welder = welder,
+                .numVertices = result.vertices.size(),
+                .ms = ms,
+                .lookupCollisionRate = stats.numLookups == 0
+                    ? 0.0
+                    : static_cast<double>(stats.numCollisions)
+                        / stats.numLookups,
+                .hashCollisionRate = flatHashCollisionRate,
+                .peakBytes = stats.peakTableBytes,
+                .identical = identical,
+            };
+        };
+
+        // One flat table on the calling thread.
+        Assets::WeldResult serial;
+        double serialMs = MedianMs(iterations, [&]() {
+            Assets::VertexWelder welder(corners.size());
+            serial.indices.clear();
+            serial.indices.reserve(corners.size());
+            for (Assets::Vertex const& corner : corners) {
+                serial.indices.push_back(welder.Insert(corner));
+            }
+            serial.vertices = std::move(welder.Vertices());
+            serial.stats = welder.Stats();
+        });
+        bool serialIdentical = SameWeld(serial, legacy);
+        PrintRow(input,
+            flatRow("flat", serial, serialMs, serialIdentical ? "yes" : "NO"));
+
+        // Partitioned across all cores and merged.
+        Assets::WeldResult parallel;
+        double parallelMs = MedianMs(iterations, [&]() {
+            parallel = Assets::WeldVertices(corners, input.shapeStarts);
+        });
+        bool parallelIdentical = SameWeld(parallel, legacy);
+        PrintRow(input,
+            flatRow("parallel", parallel, parallelMs,
+                parallelIdentical ? "yes" : "NO"));
+
+        // Near-equal vertices merged, so the output is expected to differ.
+        Assets::WeldResult nearEqual;
+        double nearEqualMs = MedianMs(iterations, [&]() {
+            nearEqual = Assets::WeldVertices(corners, input.shapeStarts,
+                {.positionEpsilon = 1e-5f, .normalEpsilon = 1e-3f});
+        });
+        PrintRow(input, flatRow("epsilon", nearEqual, nearEqualMs, "-"));
+
+        return serialIdentical && parallelIdentical;
+    }
+
+} // namespace
+
+int RunWeldBench(BenchArgs args)
+{
+    std::vector<WeldInput> inputs;
+    for (std::string const& path : MeshPaths(args)) {
+        std::optional<WeldInput> input = GatherCorners(path);
+        if (!input) {
+            spdlog::info("{:<28} skipped, not a renderable mesh", path);
+            continue;
+        }
+        inputs.push_back(std::move(*input));
+    }
+    if (args.empty()) {
+        inputs.push_back(PermutedCorners(40000));
+    }
+
+    spdlog::info("{:<28} {:<12} {:>9} {:>9} {:>9} {:>8} {:>9} {:>9} {:>10} "
+                 "{:>9}",
+        "input", "welder", "corners", "vertices", "ms", "Mc/s", "collide",
+        "hash dup", "peak KiB", "identical");
+
+    bool allIdentical = true;
+    for (WeldInput const& input : inputs) {
+        allIdentical &= RunInput(input);
+    }
+
+    return allIdentical ? 0 : 1;
+}
+
+} // namespace Umbrella::Bench
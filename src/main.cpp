@@ -1,9 +1,82 @@
+#include <cstdlib>
+#include <string_view>
+
 #include "umbrella/UmbrellaApplication.h"
 
-int main(int, char*[])
+int main(int argc, char* argv[])
 {
-    Umbrella::UmbrellaApplication app;
-    app.Run();
+    Umbrella::ApplicationOptions options;
+    auto benchmark = [&]() -> Umbrella::BenchmarkOptions& {
+        if (!options.benchmark) {
+            options.benchmark.emplace();
+        }
+        return *options.benchmark;
+    };
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--stress" && hasValue) {
+            options.stressInstances
+                = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--lights" && hasValue) {
+            options.numLights
+                = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--shadow-margin" && hasValue) {
+            options.shadows.cacheMargin = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--no-shadow-cache") {
+            options.shadows.cache = false;
+        } else if (arg == "--no-meshlet-culling") {
+            options.meshlets.enabled = false;
+        } else if (arg == "--no-occlusion") {
+            options.occlusion.enabled = false;
+        } else if (arg == "--occlusion") {
+            options.occlusion.enabled = true;
+        } else if (arg == "--pack" && hasValue) {
+            options.packPath = argv[++i];
+        } else if (arg == "--trace-load" && hasValue) {
+            options.loadTracePath = argv[++i];
+        } else if (arg == "--profile" && hasValue) {
+            options.profilePath = argv[++i];
+            options.profileFromStart = true;
+        } else if (arg == "--no-render-thread") {
+            options.renderThread = false;
+        } else if (arg == "--frame-packets" && hasValue) {
+            options.framePackets
+                = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--uncapped") {
+            options.pacing.presentMode = Umbrella::PresentMode::Uncapped;
+        } else if (arg == "--fps-limit" && hasValue) {
+            options.pacing.fpsLimit = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--sim-rate" && hasValue) {
+            double rate = std::strtod(argv[++i], nullptr);
+            if (rate > 0.0) {
+                options.pacing.simulationRate = rate;
+            }
+        } else if (arg == "--record-camera" && hasValue) {
+            options.recordCameraPath = argv[++i];
+        } else if (arg == "--benchmark" && hasValue) {
+            benchmark().frames
+                = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--warmup" && hasValue) {
+            benchmark().warmupFrames
+                = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--size" && hasValue) {
+            char* end = nullptr;
+            int width = static_cast<int>(std::strtol(argv[++i], &end, 10));
+            int height = *end == 'x' ? std::atoi(end + 1) : 0;
+            if (width > 0 && height > 0) {
+                benchmark().width = width;
+                benchmark().height = height;
+            }
+        } else if (arg == "--camera-path" && hasValue) {
+            benchmark().cameraPath = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            benchmark().jsonPath = argv[++i];
+        } else if (arg == "--csv" && hasValue) {
+            benchmark().csvPath = argv[++i];
+        }
+    }
 
-    return 0;
+    Umbrella::UmbrellaApplication app(options);
+    return app.Run() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,48 @@
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+#include "util/PackArchive.h"
+
+// Packs a directory of assets, data/ usually, into a .upak archive for the
+// application's --pack option. The cache and hidden files are left out.
+int main(int argc, char* argv[])
+{
+    Umbrella::Util::PackOptions options;
+    options.exclude.push_back("cache");
+    char const* directory = nullptr;
+    char const* packPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--store") {
+            options.compress = false;
+        } else if (arg == "--exclude" && hasValue) {
+            options.exclude.push_back(argv[++i]);
+        } else if (!directory) {
+            directory = argv[i];
+        } else if (!packPath) {
+            packPath = argv[i];
+        }
+    }
+    if (!directory || !packPath) {
+        spdlog::info("Usage: UmbrellaPack <directory> <pack.upak> [--store] "
+                     "[--exclude <name>]...");
+        return EXIT_FAILURE;
+    }
+
+    std::optional<Umbrella::Util::PackStats> stats
+        = Umbrella::Util::WritePack(directory, packPath, options);
+    if (!stats) {
+        spdlog::error("Could not pack {} into {}", directory, packPath);
+        return EXIT_FAILURE;
+    }
+    spdlog::info("Packed {} files, {} of them compressed, {:.1f} KiB into "
+                 "{:.1f} KiB",
+        stats->numFiles, stats->numCompressed,
+        static_cast<double>(stats->rawBytes) / 1024.0,
+        static_cast<double>(stats->fileSize) / 1024.0);
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,13 @@
 #include "UmbrellaApplication.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <thread>
 #include <vector>
 
 #define GLFW_INCLUDE_NONE
@@ -8,18 +15,220 @@
 #include <glad/gl.h>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
 #include <spdlog/spdlog.h>
-#include <stb_image.h>
-#include <tiny_obj_loader.h>
 
+#include "assets/MeshBuilder.h"
+#include "assets/MeshCache.h"
+#include "assets/MeshOptimizer.h"
+#include "assets/MeshSimplifier.h"
+#include "assets/MeshletBuilder.h"
+#include "assets/ObjImporter.h"
+#include "assets/VertexLayout.h"
+#include "gfx/FrameConstants.h"
+#include "gfx/GpuProfiler.h"
+#include "gfx/GpuTimer.h"
+#include "gfx/RenderQueue.h"
+#include "gfx/RenderThread.h"
 #include "gfx/ShaderProgram.h"
-#include "util/File.h"
+#include "gfx/StateCache.h"
+#include "gfx/StreamBuffer.h"
+#include "gfx/TextureStreamer.h"
+#include "gfx/VertexAttribs.h"
+#include "systems/FramePacket.h"
+#include "systems/FrameReport.h"
+#include "systems/LightClusters.h"
+#include "systems/Scene.h"
 #include "util/Framework.h"
+#include "util/JobSystem.h"
+#include "util/Profiler.h"
+#include "util/VirtualFileSystem.h"
 
 namespace Umbrella {
 
+namespace {
+
+    // Shader storage bindings, as declared in VertexShader.glsl.
+    constexpr GLuint instanceTransformsBinding = 0;
+    constexpr GLuint drawRecordsBinding = 1;
+    constexpr GLuint meshDequantizeBinding = 2;
+    constexpr GLuint materialsBinding = 3;
+    // And in FragShader.glsl.
+    constexpr GLuint lightsBinding = 4;
+    constexpr GLuint lightClustersBinding = 5;
+    constexpr GLuint lightIndicesBinding = 6;
+
+    static_assert(maxShadowCascades <= Gfx::frameShadowCascades);
+
+    constexpr uint32_t noInstance = std::numeric_limits<uint32_t>::max();
+
+    // Prefers the baked mesh, and only imports the OBJ when the cache is
+    // missing or stale. view points into cached or built.
+    PrepareResult LoadMesh(char const* meshPath,
+        Assets::VertexLayoutOptions layoutOptions,
+        std::optional<Assets::CachedMesh>& cached, Assets::MeshData& built,
+        Assets::MeshView& view)
+    {
+        cached = Assets::OpenMeshCache(meshPath);
+        if (cached) {
+            view = cached->View();
+            return PrepareResult::PrepareOk;
+        }
+
+        std::optional<Assets::ObjData> objData
+            = Assets::ImportObj(meshPath, "meshes/");
+        if (!objData) {
+            return PrepareResult::ObjLoadFail;
+        }
+
+        if (Assets::BuildMesh(*objData, built)
+            != Assets::MeshBuildResult::BuildOk) {
+            return PrepareResult::ObjMissingAttrib;
+        }
+
+        Assets::BuildLodChain(built);
+        spdlog::info("Built {} LODs for {}", built.lods.size(), meshPath);
+
+        // Reorder for the vertex cache, overdraw and vertex fetch once, so
+        // the cache stores the optimized buffers.
+        Assets::MeshOptimizeStats optimizeStats = Assets::OptimizeMesh(built);
+        spdlog::info(
+            "Optimized {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+            meshPath, optimizeStats.before.acmr, optimizeStats.after.acmr,
+            optimizeStats.before.atvr, optimizeStats.after.atvr);
+
+        // Meshlets regroup the triangles of LOD 0, growing from the order
+        // the optimizer left, and are baked into the cache with it.
+        Assets::MeshletStats meshletStats = Assets::BuildMeshlets(built);
+        spdlog::info("Split {} into {} meshlets of {:.1f} triangles and {:.1f} "
+                     "vertices on average, {} without a cone",
+            meshPath, meshletStats.numMeshlets,
+            meshletStats.AverageTriangles(), meshletStats.AverageVertices(),
+            meshletStats.numWithoutCone);
+
+        if (!Assets::WriteMeshCache(meshPath, objData->materialLibraries,
+                ViewOf(built), layoutOptions)) {
+            spdlog::warn("Could not write the mesh cache for {}", meshPath);
+        }
+        view = ViewOf(built);
+        return PrepareResult::PrepareOk;
+    }
+
+    struct PlacedInstance {
+        NodeId node;
+        uint32_t mesh;
+    };
+
+    // Without a stress count the scene is the single mesh it has always
+    // been. Otherwise instances of every mesh fill a cube in front of the
+    // camera, each turned at random, grouped under a node per layer.
+    std::vector<PlacedInstance> PlaceInstances(TransformHierarchy& hierarchy,
+        uint32_t numMeshes, uint32_t stressInstances)
+    {
+        glm::vec3 const up(0.0f, 1.0f, 0.0f);
+        NodeId root = hierarchy.AddNode({});
+        if (stressInstances == 0) {
+            LocalTransform turned {
+                .rotation = glm::angleAxis(glm::radians(20.0f), up),
+            };
+            return {{hierarchy.AddNode(turned, root), 0}};
+        }
+
+        constexpr float spacing = 3.0f;
+        uint32_t side = static_cast<uint32_t>(
+            std::ceil(std::cbrt(static_cast<float>(stressInstances))));
+        glm::vec3 origin = -0.5f * spacing
+            * glm::vec3(static_cast<float>(side - 1),
+                static_cast<float>(side - 1), static_cast<float>(2 * side));
+
+        std::mt19937 random(stressInstances);
+        std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+        std::vector<NodeId> layers;
+        std::vector<PlacedInstance> placed;
+        for (uint32_t i = 0; i < stressInstances; i++) {
+            uint32_t layer = i / (side * side);
+            if (layer == layers.size()) {
+                LocalTransform layerOrigin {
+                    .translation = origin
+                        + glm::vec3(0.0f, 0.0f,
+                            spacing * static_cast<float>(layer)),
+                };
+                layers.push_back(hierarchy.AddNode(layerOrigin, root));
+            }
+            glm::vec3 cell(static_cast<float>(i % side),
+                static_cast<float>(i / side % side), 0.0f);
+            LocalTransform local {
+                .translation = spacing * cell,
+                .rotation = glm::angleAxis(angle(random), up),
+            };
+            placed.push_back(
+                {hierarchy.AddNode(local, layers[layer]), i % numMeshes});
+        }
+        return placed;
+    }
+
+    // numLights small lights scattered at random around the instances.
+    std::vector<PointLight> PlaceLights(Scene const& scene, uint32_t numLights)
+    {
+        std::vector<PointLight> lights;
+        if (numLights == 0) {
+            return lights;
+        }
+
+        glm::vec3 low(std::numeric_limits<float>::max());
+        glm::vec3 high(std::numeric_limits<float>::lowest());
+        for (glm::mat4 const& transform : scene.Transforms()) {
+            low = glm::min(low, glm::vec3(transform[3]));
+            high = glm::max(high, glm::vec3(transform[3]));
+        }
+        low -= 2.0f;
+        high += 2.0f;
+
+        std::mt19937 random(numLights);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::uniform_real_distribution<float> radius(1.0f, 4.0f);
+        for (uint32_t i = 0; i < numLights; i++) {
+            glm::vec3 position(unit(random), unit(random), unit(random));
+            glm::vec3 color(unit(random), unit(random), unit(random));
+            lights.push_back({
+                .position = glm::mix(low, high, position),
+                .radius = radius(random),
+                .color = color / std::max(glm::length(color), 0.1f),
+                .intensity = 1.0f,
+            });
+        }
+        return lights;
+    }
+
+    // A sphere around every instance's bounds. It only has to be
+    // conservative: cascades extend towards the light to cover it.
+    CasterBounds EnclosingBounds(BoundingSpheres const& bounds)
+    {
+        if (bounds.Size() == 0) {
+            return {};
+        }
+        glm::vec3 low(std::numeric_limits<float>::max());
+        glm::vec3 high(std::numeric_limits<float>::lowest());
+        for (size_t i = 0; i < bounds.Size(); i++) {
+            glm::vec3 center(bounds.x[i], bounds.y[i], bounds.z[i]);
+            low = glm::min(low, center - bounds.radius[i]);
+            high = glm::max(high, center + bounds.radius[i]);
+        }
+        return {
+            .center = 0.5f * (low + high),
+            .radius = 0.5f * glm::length(high - low),
+        };
+    }
+
+} // namespace
+
+UmbrellaApplication::UmbrellaApplication(ApplicationOptions options)
+    : m_options(options)
+    , m_shadows(options.shadows)
+{
+}
+
 InitializeResult UmbrellaApplication::Initialize()
 {
     if (!glfwInit()) {
@@ -36,8 +245,16 @@ InitializeResult UmbrellaApplication::Initialize()
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
 #endif
 
-    constexpr int defaultWidth = 640;
-    constexpr int defaultHeight = 480;
+    // Benchmarks render into a hidden window of a fixed size, or into an
+    // OSMesa buffer in headless builds.
+    int defaultWidth = 640;
+    int defaultHeight = 480;
+    if (m_options.benchmark) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        defaultWidth = m_options.benchmark->width;
+        defaultHeight = m_options.benchmark->height;
+    }
     m_window = glfwCreateWindow(
         defaultWidth, defaultHeight, "Umbrella", nullptr, nullptr);
     if (!m_window) {
@@ -48,29 +265,44 @@ InitializeResult UmbrellaApplication::Initialize()
 
     m_windowWidth = defaultWidth;
     m_windowHeight = defaultHeight;
+    m_viewportWidth = defaultWidth;
+    m_viewportHeight = defaultHeight;
 
-    // Resize the Viewport, in case the window size changes
+    // The new size goes out with the next frame packet, and the viewport
+    // follows on whichever thread has the context.
     glfwSetWindowUserPointer(m_window, this);
     glfwSetWindowSizeCallback(
         m_window, [](GLFWwindow* window, int width, int height) {
             auto app = static_cast<UmbrellaApplication*>(
                 glfwGetWindowUserPointer(window));
-            app->m_windowWidth = width;
-            app->m_windowHeight = height;
-            glViewport(0, 0, width, height);
+            app->m_minimized = width == 0 || height == 0;
+            if (!app->m_minimized) {
+                app->m_windowWidth = width;
+                app->m_windowHeight = height;
+            }
         });
 
-    glfwSetKeyCallback(m_window, ProcessKeys);
+    // The camera follows a path in benchmarks, not the input.
+    if (!m_options.benchmark) {
+        glfwSetKeyCallback(m_window, ProcessKeys);
 
-    glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwSetCursorPosCallback(m_window, ProcessMouse);
+        // Raw motion skips the desktop's pointer acceleration and scaling.
+        glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        if (glfwRawMouseMotionSupported()) {
+            glfwSetInputMode(m_window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+        }
+        glfwSetCursorPosCallback(m_window, ProcessMouse);
+    }
 
     if (!gladLoadGL(glfwGetProcAddress)) {
         Stop();
         return InitializeResult::GLADLoaderFail;
     }
 
-    glfwSwapInterval(1);
+    // Without vsync a benchmark frame costs what it costs.
+    bool vsync = !m_options.benchmark
+        && m_options.pacing.presentMode == PresentMode::Vsync;
+    glfwSwapInterval(vsync ? 1 : 0);
 
     return InitializeResult::InitializeOk;
 }
@@ -97,106 +329,282 @@ PrepareResult UmbrellaApplication::Prepare()
 
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
-    std::optional<std::string> vertexSrc, fragSrc;
-    vertexSrc = Umbrella::Util::ReadFile("shaders/VertexShader.glsl");
-    fragSrc = Umbrella::Util::ReadFile("shaders/FragShader.glsl");
-    if (!vertexSrc || !fragSrc) {
+    // Loading runs as a graph of jobs: files are read, parsed and packed on
+    // the workers, while everything that touches GL runs on this thread as
+    // soon as its inputs are ready. Each job only writes its own results,
+    // which are checked once the whole graph has finished.
+    Util::JobSystem& jobs = Util::JobSystem::Instance();
+    auto prepareStart = std::chrono::steady_clock::now();
+
+    // A pack shadows the loose files it was built from, so every asset
+    // below is read from one mapping.
+    Util::VirtualFileSystem& files = Util::VirtualFileSystem::Instance();
+    if (!m_options.packPath.empty()
+        && !files.MountPack(m_options.packPath.c_str())) {
         return PrepareResult::SourceReadFail;
     }
 
-    std::optional<GLuint> shaderProgram
-        = Umbrella::Gfx::CompileProgram(*vertexSrc, *fragSrc);
-    if (shaderProgram) {
-        m_shaderProgram = *shaderProgram;
-    } else {
-        return PrepareResult::ShaderBuildFail;
+    // The vertex shader has to decode normals the way the layout stores them.
+    constexpr Assets::VertexLayoutOptions layoutOptions {};
+    // The shadow pass runs the same vertex shader, so both programs agree
+    // on where instances are.
+    std::vector<Gfx::ProgramSource> programSources;
+    std::optional<Gfx::ProgramBatch> programBatch;
+    constexpr char const* shaderPaths[] = {
+        "shaders/VertexShader.glsl",
+        "shaders/FragShader.glsl",
+        "shaders/ShadowFragShader.glsl",
+    };
+    std::optional<Util::AssetFile> shaderFiles[std::size(shaderPaths)];
+    std::vector<Util::JobHandle> readShaderFiles;
+    for (size_t s = 0; s < std::size(shaderPaths); s++) {
+        readShaderFiles.push_back(files.ReadAsync(shaderPaths[s],
+            [&shaderFiles, s](std::optional<Util::AssetFile> file) {
+                shaderFiles[s] = std::move(file);
+            }));
     }
+    Util::JobHandle readShaders = jobs.Schedule(
+        "Read shaders",
+        [&]() {
+            auto& [vertexFile, fragFile, shadowFile] = shaderFiles;
+            if (!vertexFile || !fragFile || !shadowFile) {
+                return;
+            }
+            std::vector<std::string> defines;
+            if (layoutOptions.compact) {
+                defines.push_back("OCTAHEDRAL_NORMALS");
+            }
+            defines.push_back("MAX_TEXTURE_ARRAYS "
+                + std::to_string(Gfx::TextureStreamer::maxArrays));
+            defines.push_back("MAX_SHADOW_CASCADES "
+                + std::to_string(Gfx::frameShadowCascades));
+            programSources.push_back({
+                .vsSource = std::string(vertexFile->View()),
+                .fsSource = std::string(fragFile->View()),
+                .defines = defines,
+            });
+            programSources.push_back({
+                .vsSource = std::string(vertexFile->View()),
+                .fsSource = std::string(shadowFile->View()),
+                .defines = std::move(defines),
+            });
+        },
+        readShaderFiles);
+    // Shaders compile in the background while the meshes load.
+    Util::JobHandle compileShaders = jobs.Schedule(
+        "Compile shaders",
+        [&]() {
+            if (!programSources.empty()) {
+                programBatch.emplace(programSources);
+            }
+        },
+        {&readShaders, 1}, Util::JobAffinity::MainThread);
 
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string objWarn, objError;
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &objWarn, &objError,
-            "meshes/suzanne_smooth.obj", "meshes/")) {
-        if (!objError.empty()) {
-            spdlog::error("TinyObjLoader error: {}", objError);
-        }
-        return PrepareResult::ObjLoadFail;
-    }
-    if (!objWarn.empty()) {
-        spdlog::warn("TinyObjLoader warning: {}", objWarn);
+    // Every mesh the scene places instances of.
+    constexpr char const* meshPaths[] = {
+        "meshes/suzanne_smooth.obj",
+        "meshes/capsule.obj",
+        "meshes/teapot_smooth.obj",
+    };
+    constexpr size_t numMeshes = std::size(meshPaths);
+    std::vector<std::optional<Assets::CachedMesh>> cachedMeshes(numMeshes);
+    std::vector<Assets::MeshData> builtMeshes(numMeshes);
+    std::vector<Assets::MeshView> meshes(numMeshes);
+    std::vector<PrepareResult> meshResults(numMeshes);
+    std::vector<Util::JobHandle> loadMeshes;
+    for (size_t m = 0; m < numMeshes; m++) {
+        loadMeshes.push_back(jobs.Schedule(
+            std::string("Load ") + meshPaths[m], [&, m]() {
+                meshResults[m] = LoadMesh(meshPaths[m], layoutOptions,
+                    cachedMeshes[m], builtMeshes[m], meshes[m]);
+            }));
     }
 
-    struct VertexAttributes {
-        float x, y, z;
-        float u, v;
-        float nx, ny, nz;
+    // Pack every mesh into one VBO and EBO, in the compact layout and the
+    // narrowest index type. Cached meshes were encoded when they were baked,
+    // so their mapped buffers are only appended.
+    bool meshesLoaded = false;
+    SceneGeometry geometry;
+    std::vector<glm::mat4> dequantize;
+    Util::JobHandle packMeshes = jobs.Schedule(
+        "Pack meshes",
+        [&]() {
+            meshesLoaded = std::ranges::all_of(meshResults,
+                [](PrepareResult r) { return r == PrepareResult::PrepareOk; });
+            if (!meshesLoaded) {
+                return;
+            }
+            std::vector<std::optional<Assets::EncodedMesh>> encoded(numMeshes);
+            for (size_t m = 0; m < numMeshes; m++) {
+                if (cachedMeshes[m]) {
+                    encoded[m] = cachedMeshes[m]->Encoded();
+                }
+            }
+            geometry = PackSceneGeometry(meshes, layoutOptions, encoded);
+            for (SceneMesh const& mesh : geometry.meshes) {
+                dequantize.push_back(mesh.dequantize);
+            }
+        },
+        loadMeshes);
 
-        bool operator==(const VertexAttributes& other) const
-        {
-            return x == other.x && y == other.y && z == other.z && u == other.u
-                && v == other.v && nx == other.nx && ny == other.ny
-                && nz == other.nz;
-        }
-    };
+    Util::JobHandle uploadMeshes = jobs.Schedule(
+        "Upload meshes",
+        [&]() {
+            if (!meshesLoaded) {
+                return;
+            }
+            m_indexType = Gfx::IndexType(geometry.indexFormat);
+            spdlog::info("Uploading {} meshes: {} bytes per vertex, {} vertex "
+                         "bytes, {} index bytes",
+                numMeshes, geometry.layout.stride, geometry.vertexData.size(),
+                geometry.indexData.size());
+            UploadGeometry(geometry, dequantize);
+        },
+        {&packMeshes, 1}, Util::JobAffinity::MainThread);
 
-    struct VertexAttributesHasher {
-        size_t operator()(const VertexAttributes& va) const
-        {
-            return std::hash<float>()(va.x) ^ std::hash<float>()(va.y)
-                ^ std::hash<float>()(va.z) ^ std::hash<float>()(va.u)
-                ^ std::hash<float>()(va.v) ^ std::hash<float>()(va.nx)
-                ^ std::hash<float>()(va.ny) ^ std::hash<float>()(va.nz);
-        }
-    };
+    Util::JobHandle placeInstances = jobs.Schedule(
+        "Place instances",
+        [&]() {
+            if (!meshesLoaded) {
+                return;
+            }
+            m_scene = std::make_unique<Scene>(std::move(geometry.meshes),
+                SceneOptions {
+                    .lod = {},
+                    .occlusion = m_options.occlusion,
+                    .meshlets = m_options.meshlets,
+                });
+            std::vector<PlacedInstance> placed = PlaceInstances(m_hierarchy,
+                static_cast<uint32_t>(numMeshes), m_options.stressInstances);
+            (void)m_hierarchy.Update();
+            m_nodeInstances.assign(m_hierarchy.NumNodes(), noInstance);
+            for (PlacedInstance const& instance : placed) {
+                m_nodeInstances[instance.node] = m_scene->AddInstance(
+                    m_hierarchy.World(instance.node), instance.mesh);
+            }
+            m_lights = PlaceLights(*m_scene, m_options.numLights);
+            m_sun = {
+                .direction = glm::normalize(glm::vec3(1.0f, 2.0f, 5.0f)),
+                .color = glm::vec3(1.0f),
+                .intensity = 1.0f,
+            };
+            spdlog::info("Scene has {} instances of {} meshes and {} lights",
+                m_scene->NumInstances(), numMeshes, m_lights.size());
+        },
+        {&packMeshes, 1});
 
-    std::vector<int> vertexIndices;
-    std::vector<VertexAttributes> vertexBuffer;
-    std::unordered_map<VertexAttributes, size_t, VertexAttributesHasher>
-        seenVertices;
-    for (auto& shape : shapes) {
-        m_numVertices += shape.mesh.indices.size();
-        for (auto& i : shape.mesh.indices) {
-            bool hasPosition = i.vertex_index != -1;
-            bool hasTexCoords = i.texcoord_index != -1;
-            bool hasNormals = i.normal_index != -1;
-
-            if (!hasPosition || !hasNormals) {
-                // Bail if a Vertex does not have one of the necessary
-                // attributes.
-                return PrepareResult::ObjMissingAttrib;
+    // Transforms, draw records, materials, commands, light clusters and
+    // the casters of each shadow cascade are rewritten every frame into a
+    // persistently mapped ring sized for the scene. The lights themselves
+    // stay put.
+    Util::JobHandle createFrameStream = jobs.Schedule(
+        "Create frame stream",
+        [&]() {
+            if (m_scene) {
+                CreateFrameStream(geometry.materials.size());
+                UploadLights();
+                m_shadowMap = Gfx::ShadowMap::Create(
+                    m_shadows.Options().resolution,
+                    m_shadows.Options().numCascades);
             }
+        },
+        {&placeInstances, 1}, Util::JobAffinity::MainThread);
 
-            VertexAttributes attribute {
-                .x = attrib.vertices[3 * i.vertex_index + 0],
-                .y = attrib.vertices[3 * i.vertex_index + 1],
-                .z = attrib.vertices[3 * i.vertex_index + 2],
-                .u = hasTexCoords ? attrib.texcoords[2 * i.texcoord_index + 0]
-                                  : -1.0f,
-                .v = hasTexCoords ? attrib.texcoords[2 * i.texcoord_index + 1]
-                                  : -1.0f,
-                .nx
-                = hasNormals ? attrib.normals[3 * i.normal_index + 0] : -1.0f,
-                .ny
-                = hasNormals ? attrib.normals[3 * i.normal_index + 1] : -1.0f,
-                .nz
-                = hasNormals ? attrib.normals[3 * i.normal_index + 2] : -1.0f,
-            };
+    // The textures the materials name decode in jobs of their own and
+    // stream in over the first frames; until then materials draw with
+    // their colour alone.
+    Util::JobHandle requestTextures = jobs.Schedule(
+        "Request textures",
+        [&]() {
+            m_textures = Gfx::TextureStreamer::Create();
+            if (m_textures && meshesLoaded) {
+                m_materials.emplace(geometry.materials, *m_textures);
+            }
+        },
+        {&packMeshes, 1}, Util::JobAffinity::MainThread);
 
-            auto seenIt = seenVertices.find(attribute);
-            if (seenIt != seenVertices.end()) {
-                // An equal vertex attribute was found, this means we already
-                // have an index for it.
-                vertexIndices.push_back(narrow_into<int>(seenIt->second));
-            } else {
-                // A new index must be created for this vertex attribute.
-                seenVertices[attribute] = vertexBuffer.size();
-                vertexIndices.push_back(narrow_into<int>(vertexBuffer.size()));
-                vertexBuffer.push_back(attribute);
+    // Where the driver compiles on threads of its own, the programs are
+    // collected only once Poll() says they are done, and until then the
+    // main thread runs whichever GL jobs are ready. Without that Poll() is
+    // true right away and Finish() does the waiting.
+    Util::JobHandle collectShaders = jobs.Schedule(
+        "Collect shaders",
+        [&]() {
+            if (!programBatch) {
+                return;
+            }
+            bool compiling = false;
+            while (!programBatch->Poll()) {
+                compiling = true;
+                if (jobs.RunMainThreadJobs() == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            if (compiling && uploadMeshes->Done()) {
+                spdlog::debug(
+                    "Meshes loaded before the shaders finished compiling");
             }
+            std::vector<std::optional<Gfx::Program>> programs
+                = programBatch->Finish();
+            m_program = std::move(programs[0]);
+            m_shadowProgram = std::move(programs[1]);
+        },
+        {&compileShaders, 1}, Util::JobAffinity::MainThread);
+
+    Util::JobHandle const graph[] = {collectShaders, uploadMeshes,
+        createFrameStream, requestTextures};
+    jobs.Wait(graph);
+    spdlog::info("Prepared in {:.1f} ms on {} workers",
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - prepareStart)
+            .count(),
+        jobs.NumWorkers());
+
+    if (programSources.empty()) {
+        return PrepareResult::SourceReadFail;
+    }
+    for (PrepareResult result : meshResults) {
+        if (result != PrepareResult::PrepareOk) {
+            return result;
         }
     }
+    if (!m_program || !m_shadowProgram) {
+        return PrepareResult::ShaderBuildFail;
+    }
+
+    // The frame constants and vertex inputs are laid out by C++, so a shader
+    // that disagrees would read garbage.
+    constexpr Gfx::InputBinding vertexInputs[] = {
+        {"PositionAttrib", 0},
+        {"TexCoordAttrib", 1},
+        {"NormalAttrib", 2},
+    };
+    if (!m_program->ValidateBlock(Gfx::frameConstantsLayout)
+        || !m_program->ValidateInputs(vertexInputs)
+        || !m_shadowProgram->ValidateBlock(Gfx::frameConstantsLayout)
+        || !m_shadowProgram->ValidateInputs(vertexInputs)) {
+        return PrepareResult::ShaderLayoutMismatch;
+    }
+
+    if (!m_frameStream || !m_textures) {
+        return PrepareResult::StreamBufferFail;
+    }
+    if (!m_shadowMap) {
+        return PrepareResult::ShadowMapFail;
+    }
+    if (!m_materials->TexturesFound()) {
+        return PrepareResult::TexLoadFail;
+    }
+    spdlog::info("Scene has {} materials", m_materials->Size());
+    m_gpuProfiler.emplace();
+    m_packets.resize(1);
 
+    return PrepareResult::PrepareOk;
+}
+
+void UmbrellaApplication::UploadGeometry(
+    SceneGeometry const& geometry, std::span<glm::mat4 const> dequantize)
+{
     // Create VAO, VBO and EBO.
     GLuint VAO, VBO, EBO;
 
@@ -209,103 +617,625 @@ PrepareResult UmbrellaApplication::Prepare()
     // Upload mesh vertices into the VBO.
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER,
-        narrow_into<GLsizeiptr>(sizeof(VertexAttributes) * vertexBuffer.size()),
-        vertexBuffer.data(), GL_STATIC_DRAW);
+        narrow_into<GLsizeiptr>(geometry.vertexData.size()),
+        geometry.vertexData.data(), GL_STATIC_DRAW);
 
     // Upload mesh indices into the EBO.
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-        narrow_into<GLsizei>(sizeof(int) * vertexIndices.size()),
-        vertexIndices.data(), GL_STATIC_DRAW);
+        narrow_into<GLsizeiptr>(geometry.indexData.size()),
+        geometry.indexData.data(), GL_STATIC_DRAW);
 
-    // Declare Position attribute in the VAO.
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes),
-        reinterpret_cast<void*>(offsetof(VertexAttributes, x)));
-
-    // Declare UV attribute in the VAO.
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes),
-        reinterpret_cast<void*>(offsetof(VertexAttributes, u)));
-
-    // Declare Normal attribute in the VAO.
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes),
-        reinterpret_cast<void*>(offsetof(VertexAttributes, nx)));
+    // Declare the Position, UV and Normal attributes in the VAO.
+    Gfx::SetupVertexAttribs(geometry.layout);
 
     m_VAO = VAO;
 
-    // Create the texture for the mesh.
-    GLuint meshTexture;
-    glGenTextures(1, &meshTexture);
-    glBindTexture(GL_TEXTURE_2D, meshTexture);
-
-    // Set texture wrapping and filtering parameters.
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Load the texture for the mesh.
-    int width, height, nChannels;
-    unsigned char* textureData
-        = stbi_load("meshes/capsule.jpg", &width, &height, &nChannels, 4);
-    if (textureData) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-            GL_UNSIGNED_BYTE, textureData);
-    } else {
-        return PrepareResult::TexLoadFail;
-    }
-    stbi_image_free(textureData);
-
-    m_meshTexture = meshTexture;
-
-    // Unbind texture before use.
-    glBindTexture(GL_TEXTURE_2D, 0);
+    // The dequantization matrices never change, so they live in a plain
+    // immutable SSBO.
+    glGenBuffers(1, &m_meshBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_meshBuffer);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+        narrow_into<GLsizeiptr>(dequantize.size() * sizeof(glm::mat4)),
+        dequantize.data(), 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
     // Unbind VAO, VBO and EBO before use.
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
 
-    glEnable(GL_DEPTH_TEST);
+void UmbrellaApplication::CreateFrameStream(size_t numMaterials)
+{
+    GLint ssboAlignment;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssboAlignment);
+    m_ssboAlignment = static_cast<size_t>(std::max(ssboAlignment, 1));
+    GLint uboAlignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlignment);
+    m_uboAlignment = static_cast<size_t>(std::max(uboAlignment, 1));
+    size_t frameBytes = m_scene->NumInstances() * sizeof(glm::mat4)
+        + m_scene->MaxDraws() * (sizeof(DrawRecord) + sizeof(DrawCommand))
+        + std::max<size_t>(numMaterials, 1) * sizeof(Gfx::MaterialConstants)
+        + m_lightClusters.NumClusters() * sizeof(ClusterRange)
+        + std::max<size_t>(m_lightClusters.MaxLightIndices(), 1)
+            * sizeof(uint32_t)
+        + 6 * m_ssboAlignment + sizeof(Gfx::FrameConstants) + m_uboAlignment;
+    // Every cascade may render in the same frame, each with its own casters
+    // and constants.
+    size_t cascadeBytes = m_scene->NumInstances() * sizeof(glm::mat4)
+        + m_scene->MaxDraws() * (sizeof(DrawRecord) + sizeof(DrawCommand))
+        + 3 * m_ssboAlignment + sizeof(Gfx::FrameConstants) + m_uboAlignment;
+    frameBytes += m_shadows.Options().numCascades * cascadeBytes;
+    m_frameStream = Gfx::StreamBuffer::Create(frameBytes);
+}
 
-    return PrepareResult::PrepareOk;
+void UmbrellaApplication::UploadLights()
+{
+    glGenBuffers(1, &m_lightBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightBuffer);
+    // Empty buffers cannot be bound, so without lights it keeps one that
+    // no cluster points at.
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+        narrow_into<GLsizeiptr>(
+            std::max<size_t>(m_lights.size(), 1) * sizeof(PointLight)),
+        m_lights.empty() ? nullptr : m_lights.data(), 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-void UmbrellaApplication::Render()
+void UmbrellaApplication::BuildFrame(FramePacket& packet)
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Pass MVP into the Vertex Shader.
-    GLint projectionIdx = glGetUniformLocation(m_shaderProgram, "uProjection");
-    GLint viewIdx = glGetUniformLocation(m_shaderProgram, "uView");
-    GLint modelIdx = glGetUniformLocation(m_shaderProgram, "uModel");
-
-    // The Model has to follow the Scale-Rotate-Translate order.
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-    model
-        = glm::rotate(model, glm::radians(20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-    glm::mat4 view = glm::lookAt(m_currentCamera->m_position,
-        m_currentCamera->m_position + m_currentCamera->m_direction,
+    UMBRELLA_PROFILE_ZONE("Build frame");
+    packet.frame = m_frame++;
+    packet.width = m_windowWidth;
+    packet.height = m_windowHeight;
+    // Between the last two simulation steps, by how far the clock has got
+    // into the next one.
+    packet.cameraPosition
+        = m_currentCamera->InterpolatedPosition(m_interpolation);
+    packet.view = glm::lookAt(packet.cameraPosition,
+        packet.cameraPosition + m_currentCamera->m_direction,
         m_currentCamera->m_up);
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f),
-        static_cast<float>(m_windowWidth) / static_cast<float>(m_windowHeight),
-        0.1f, 100.0f);
+    ClusterView clusterView {
+        .view = packet.view,
+        .verticalFov = glm::radians(45.0f),
+        .aspect = static_cast<float>(m_windowWidth)
+            / static_cast<float>(m_windowHeight),
+        .nearPlane = 0.1f,
+        .farPlane = 1000.0f,
+    };
+    float verticalFov = clusterView.verticalFov;
+    packet.projection = glm::perspective(verticalFov, clusterView.aspect,
+        clusterView.nearPlane, clusterView.farPlane);
+    packet.viewProjection = packet.projection * packet.view;
+
+    // Only nodes under something that moved are rebuilt, and only their
+    // instances are re-bounded for culling and shadows.
+    (void)m_hierarchy.Update();
+    for (NodeId node : m_hierarchy.Changed()) {
+        uint32_t instance = m_nodeInstances[node];
+        if (instance != noInstance) {
+            m_scene->SetTransform(instance, m_hierarchy.World(node));
+        }
+    }
+
+    // Cull instances outside the view or behind occluders, pick the
+    // coarsest LOD of the rest whose error stays below a pixel, and group
+    // them by mesh and LOD into indirect commands. The packet keeps its
+    // storage, so this only allocates when the scene grows.
+    packet.commands.resize(m_scene->MaxDraws());
+    packet.records.resize(m_scene->MaxDraws());
+    packet.transforms.resize(m_scene->NumInstances());
+    packet.stats = m_scene->BuildDrawList(
+        {
+            .viewProjection = packet.viewProjection,
+            .lod = {
+                .cameraPosition = packet.cameraPosition,
+                .verticalFov = verticalFov,
+                .viewportHeight = static_cast<float>(m_windowHeight),
+            },
+        },
+        {
+            .commands = packet.commands,
+            .records = packet.records,
+            .transforms = packet.transforms,
+        });
+    packet.occlusion = m_scene->LastOcclusionStats();
+
+    // Bin the lights into the clusters of the view, so fragments only loop
+    // over the few that can reach them.
+    packet.clusters.resize(m_lightClusters.NumClusters());
+    packet.lightIndices.resize(m_lightClusters.MaxLightIndices());
+    packet.lights = m_lightClusters.BinLights(clusterView, m_lights,
+        {
+            .clusters = packet.clusters,
+            .lightIndices = packet.lightIndices,
+        });
+    packet.clusterLookup = m_lightClusters.Lookup(clusterView,
+        static_cast<float>(m_windowWidth), static_cast<float>(m_windowHeight));
+
+    // Cascades keep their shadows over frames. Anything that moved redraws
+    // the cascades it left and entered, and may widen what casts into them.
+    BoundingSpheres const& moved = m_scene->MovedBounds();
+    if (moved.Size() > 0) {
+        for (size_t i = 0; i < moved.Size(); i++) {
+            m_shadows.Invalidate(
+                {moved.x[i], moved.y[i], moved.z[i]}, moved.radius[i]);
+        }
+        m_casterBounds = EnclosingBounds(m_scene->Bounds());
+        m_scene->ClearMovedBounds();
+    }
+    std::span<ShadowCascade const> cascades = m_shadows.Update(
+        {
+            .view = packet.view,
+            .verticalFov = verticalFov,
+            .aspect = clusterView.aspect,
+            .nearPlane = clusterView.nearPlane,
+        },
+        m_sun, m_casterBounds);
+    packet.sun = m_sun;
+    packet.cascades.resize(cascades.size());
+    for (size_t c = 0; c < cascades.size(); c++) {
+        CascadePacket& target = packet.cascades[c];
+        target.cascade = cascades[c];
+        target.updates = m_shadows.Stats()[c];
+        if (!target.cascade.render) {
+            target.stats = {};
+            continue;
+        }
+        // LODs coarser than a shadow map texel would not show.
+        target.commands.resize(m_scene->MaxDraws());
+        target.records.resize(m_scene->MaxDraws());
+        target.transforms.resize(m_scene->NumInstances());
+        target.stats = m_scene->BuildCasterList(
+            {
+                .viewProjection = target.cascade.viewProjection,
+                .maxError = target.cascade.texelSize,
+            },
+            {
+                .commands = target.commands,
+                .records = target.records,
+                .transforms = target.transforms,
+            });
+    }
+}
+
+void UmbrellaApplication::SubmitFrame(FramePacket const& packet)
+{
+    UMBRELLA_PROFILE_ZONE("Render");
+    m_gpuProfiler->BeginFrame();
+    bool timed = m_gpuTimer && m_gpuTimer->Begin(packet.frame);
+    auto submitStart = std::chrono::steady_clock::now();
+    {
+        UMBRELLA_PROFILE_GPU_ZONE(*m_gpuProfiler, "Frame");
 
-    glUseProgram(m_shaderProgram);
-    glBindVertexArray(m_VAO);
-    glBindTexture(GL_TEXTURE_2D, m_meshTexture);
+        if (packet.width != m_viewportWidth
+            || packet.height != m_viewportHeight) {
+            m_viewportWidth = packet.width;
+            m_viewportHeight = packet.height;
+            glViewport(0, 0, m_viewportWidth, m_viewportHeight);
+        }
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // Never waits: uploads whose staging space is still in use by the
+        // GPU are left for a later frame. Uploads bind textures of their
+        // own and may move textures into bigger arrays, so the state cache
+        // starts the frame knowing nothing.
+        m_textures->Update();
+        m_stateCache.Invalidate();
+        m_stateCache.ResetStats();
+
+        // Only what the draw list uses is copied into the frame's region.
+        // Empty ranges cannot be bound, so every range keeps one element.
+        DrawListStats const& stats = packet.stats;
+        size_t numInstances = std::max<size_t>(stats.numInstances, 1);
+        size_t numDraws = std::max<size_t>(stats.numDraws, 1);
+        size_t numMaterials = std::max<size_t>(m_materials->Size(), 1);
+        size_t numLightIndices
+            = std::max<size_t>(packet.lights.numIndices, 1);
+        m_frameStream->BeginFrame();
+        std::optional<Gfx::StreamBuffer::Allocation> frameConstants
+            = m_frameStream->Allocate(
+                sizeof(Gfx::FrameConstants), m_uboAlignment);
+        std::optional<Gfx::StreamBuffer::Allocation> transforms
+            = m_frameStream->Allocate(
+                numInstances * sizeof(glm::mat4), m_ssboAlignment);
+        std::optional<Gfx::StreamBuffer::Allocation> records
+            = m_frameStream->Allocate(
+                numDraws * sizeof(DrawRecord), m_ssboAlignment);
+        std::optional<Gfx::StreamBuffer::Allocation> materials
+            = m_frameStream->Allocate(
+                numMaterials * sizeof(Gfx::MaterialConstants),
+                m_ssboAlignment);
+        std::optional<Gfx::StreamBuffer::Allocation> commands
+            = m_frameStream->Allocate(
+                numDraws * sizeof(DrawCommand), alignof(DrawCommand));
+        std::optional<Gfx::StreamBuffer::Allocation> clusters
+            = m_frameStream->Allocate(
+                packet.clusters.size() * sizeof(ClusterRange),
+                m_ssboAlignment);
+        std::optional<Gfx::StreamBuffer::Allocation> lightIndices
+            = m_frameStream->Allocate(
+                numLightIndices * sizeof(uint32_t), m_ssboAlignment);
+        if (!frameConstants || !transforms || !records || !materials
+            || !commands || !clusters || !lightIndices) {
+            spdlog::error(
+                "The frame stream buffer is too small for the scene");
+            m_frameStream->EndFrame();
+            return;
+        }
+        std::memcpy(transforms->data, packet.transforms.data(),
+            stats.numInstances * sizeof(glm::mat4));
+        std::memcpy(records->data, packet.records.data(),
+            stats.numDraws * sizeof(DrawRecord));
+        std::memcpy(commands->data, packet.commands.data(),
+            stats.numDraws * sizeof(DrawCommand));
+        // Textures move as they stream in, so the materials are rewritten
+        // every frame too; there are only a handful.
+        m_materials->Write(
+            {reinterpret_cast<Gfx::MaterialConstants*>(materials->data),
+                m_materials->Size()});
+        std::memcpy(clusters->data, packet.clusters.data(),
+            packet.clusters.size() * sizeof(ClusterRange));
+        std::memcpy(lightIndices->data, packet.lightIndices.data(),
+            packet.lights.numIndices * sizeof(uint32_t));
 
-    // Uniforms must be set after a program is bound.
-    glUniformMatrix4fv(modelIdx, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewIdx, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projectionIdx, 1, GL_FALSE, glm::value_ptr(projection));
+        // Cascades that are still valid keep their layer from an earlier
+        // frame; only the others are drawn before the scene samples them.
+        GLuint stream = m_frameStream->Buffer();
+        glBindBufferBase(
+            GL_SHADER_STORAGE_BUFFER, meshDequantizeBinding, m_meshBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stream);
+        uint32_t cascadesDrawn = 0;
+        for (uint32_t c = 0; c < packet.cascades.size(); c++) {
+            if (!packet.cascades[c].cascade.render) {
+                continue;
+            }
+            if (!DrawCascade(c, packet.cascades[c])) {
+                spdlog::error(
+                    "The frame stream buffer is too small for the scene");
+                m_frameStream->EndFrame();
+                return;
+            }
+            cascadesDrawn++;
+        }
+        if (cascadesDrawn > 0) {
+            glViewport(0, 0, m_viewportWidth, m_viewportHeight);
+        }
+        m_shadowMap->CollectTimings();
+
+        // The camera goes into the frame's uniform block once, for every
+        // program; model matrices come from the instance transforms.
+        Gfx::FrameConstants constants {
+            .view = packet.view,
+            .projection = packet.projection,
+            .viewProjection = packet.viewProjection,
+            .cameraPosition = glm::vec4(packet.cameraPosition, 1.0f),
+            .clusterGrid = packet.clusterLookup.grid,
+            .clusterScale = packet.clusterLookup.scale,
+            .sunDirection = glm::vec4(packet.sun.direction, 0.0f),
+            .sunColor
+            = glm::vec4(packet.sun.color * packet.sun.intensity, 1.0f),
+            .shadowMatrices = {},
+            .cascadeSplits = glm::vec4(0.0f),
+            .cascadeTexels = glm::vec4(0.0f),
+            .shadowParams
+            = glm::vec4(static_cast<float>(packet.cascades.size()),
+                1.0f / static_cast<float>(m_shadowMap->Resolution()), 0.0f,
+                0.0f),
+        };
+        // Clip space to shadow map coordinates and depth, all in [0, 1].
+        glm::mat4 clipToShadowMap
+            = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)),
+                glm::vec3(0.5f));
+        for (size_t c = 0; c < packet.cascades.size(); c++) {
+            ShadowCascade const& cascade = packet.cascades[c].cascade;
+            constants.shadowMatrices[c]
+                = clipToShadowMap * cascade.viewProjection;
+            constants.cascadeSplits[static_cast<int>(c)] = cascade.splitDepth;
+            constants.cascadeTexels[static_cast<int>(c)] = cascade.texelSize;
+        }
+        std::memcpy(frameConstants->data, &constants, sizeof(constants));
+
+        glBindBufferRange(GL_UNIFORM_BUFFER, Gfx::frameConstantsBinding,
+            stream, frameConstants->offset, sizeof(Gfx::FrameConstants));
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, instanceTransformsBinding,
+            stream, transforms->offset,
+            narrow_into<GLsizeiptr>(numInstances * sizeof(glm::mat4)));
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, drawRecordsBinding,
+            stream, records->offset,
+            narrow_into<GLsizeiptr>(numDraws * sizeof(DrawRecord)));
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, materialsBinding, stream,
+            materials->offset,
+            narrow_into<GLsizeiptr>(
+                numMaterials * sizeof(Gfx::MaterialConstants)));
+        glBindBufferBase(
+            GL_SHADER_STORAGE_BUFFER, lightsBinding, m_lightBuffer);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, lightClustersBinding,
+            stream, clusters->offset,
+            narrow_into<GLsizeiptr>(
+                packet.clusters.size() * sizeof(ClusterRange)));
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, lightIndicesBinding,
+            stream, lightIndices->offset,
+            narrow_into<GLsizeiptr>(numLightIndices * sizeof(uint32_t)));
+
+        // Every mesh shares the VAO and program, and materials are looked
+        // up per draw with every texture array bound at once, so the whole
+        // scene is one item. Draws go through the queue and the state
+        // cache, which only touch GL where state actually changes.
+        std::span<GLuint const> arrays = m_textures->Arrays();
+        m_sceneTextures.assign(Gfx::TextureStreamer::maxArrays + 1, 0);
+        std::ranges::copy(arrays, m_sceneTextures.begin());
+        m_sceneTextures.back() = m_shadowMap->Texture();
+        m_renderQueue.Clear();
+        m_renderQueue.Push({
+            .key = Gfx::MakeDrawKey({
+                .pass = Gfx::RenderPass::Opaque,
+                .program = m_program->Id(),
+                .vertexArray = m_VAO,
+            }),
+            .program = m_program->Id(),
+            .vertexArray = m_VAO,
+            .textures = m_sceneTextures,
+            .flags = static_cast<uint32_t>(Gfx::RenderFlags::DepthTest),
+            .mode = GL_TRIANGLES,
+            .indexType = m_indexType,
+            .indirectOffset = commands->offset,
+            .drawCount = narrow_into<GLsizei>(stats.numDraws),
+        });
+        m_renderQueue.Sort();
+        {
+            UMBRELLA_PROFILE_GPU_ZONE(*m_gpuProfiler, "Draw scene");
+            m_renderQueue.Submit(m_stateCache);
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        Gfx::StateChangeStats const& stateStats = m_stateCache.Stats();
+        UMBRELLA_PROFILE_COUNTER("State changes", stateStats.issued);
+        UMBRELLA_PROFILE_COUNTER("State changes skipped", stateStats.Skipped());
+        m_stateRequested += stateStats.requested;
+        m_stateIssued += stateStats.issued;
+        UMBRELLA_PROFILE_COUNTER("Draws", stats.numDraws);
+        UMBRELLA_PROFILE_COUNTER("Triangles", stats.numTriangles);
+        UMBRELLA_PROFILE_COUNTER("Meshlet triangles culled %",
+            100.0 * stats.meshlets.CulledFraction());
+        UMBRELLA_PROFILE_COUNTER(
+            "Lights per cluster", packet.lights.AverageLightsPerCluster());
+        UMBRELLA_PROFILE_COUNTER("Shadow cascades drawn", cascadesDrawn);
+        UMBRELLA_PROFILE_COUNTER("Stream bytes", m_frameStream->BytesUsed());
+        m_frameStream->EndFrame();
+    }
+    if (timed) {
+        m_gpuTimer->End();
+    }
+    if (m_gpuTimer) {
+        m_gpuTimer->Collect(m_gpuResults);
+    }
 
-    glDrawElements(GL_TRIANGLES, narrow_into<GLsizei>(m_numVertices),
-        GL_UNSIGNED_INT, nullptr);
+    auto submitEnd = std::chrono::steady_clock::now();
+    m_submitMs
+        += std::chrono::duration<double, std::milli>(submitEnd - submitStart)
+               .count();
+}
+
+bool UmbrellaApplication::DrawCascade(
+    uint32_t cascade, CascadePacket const& packet)
+{
+    DrawListStats const& stats = packet.stats;
+    size_t numInstances = std::max<size_t>(stats.numInstances, 1);
+    size_t numDraws = std::max<size_t>(stats.numDraws, 1);
+    std::optional<Gfx::StreamBuffer::Allocation> frameConstants
+        = m_frameStream->Allocate(sizeof(Gfx::FrameConstants), m_uboAlignment);
+    std::optional<Gfx::StreamBuffer::Allocation> transforms
+        = m_frameStream->Allocate(
+            numInstances * sizeof(glm::mat4), m_ssboAlignment);
+    std::optional<Gfx::StreamBuffer::Allocation> records
+        = m_frameStream->Allocate(
+            numDraws * sizeof(DrawRecord), m_ssboAlignment);
+    std::optional<Gfx::StreamBuffer::Allocation> commands
+        = m_frameStream->Allocate(
+            numDraws * sizeof(DrawCommand), alignof(DrawCommand));
+    if (!frameConstants || !transforms || !records || !commands) {
+        return false;
+    }
+    std::memcpy(transforms->data, packet.transforms.data(),
+        stats.numInstances * sizeof(glm::mat4));
+    std::memcpy(records->data, packet.records.data(),
+        stats.numDraws * sizeof(DrawRecord));
+    std::memcpy(commands->data, packet.commands.data(),
+        stats.numDraws * sizeof(DrawCommand));
+    // The vertex shader only reads the view projection.
+    Gfx::FrameConstants constants {};
+    constants.viewProjection = packet.cascade.viewProjection;
+    std::memcpy(frameConstants->data, &constants, sizeof(constants));
+
+    GLuint stream = m_frameStream->Buffer();
+    glBindBufferRange(GL_UNIFORM_BUFFER, Gfx::frameConstantsBinding, stream,
+        frameConstants->offset, sizeof(Gfx::FrameConstants));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, instanceTransformsBinding,
+        stream, transforms->offset,
+        narrow_into<GLsizeiptr>(numInstances * sizeof(glm::mat4)));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, drawRecordsBinding, stream,
+        records->offset,
+        narrow_into<GLsizeiptr>(numDraws * sizeof(DrawRecord)));
+
+    constexpr char const* zoneNames[] = {
+        "Shadow cascade 0",
+        "Shadow cascade 1",
+        "Shadow cascade 2",
+        "Shadow cascade 3",
+    };
+    static_assert(std::size(zoneNames) == maxShadowCascades);
+    m_shadowMap->BeginCascade(cascade);
+    // Slope-scaled offset keeps lit surfaces from shadowing themselves
+    // where they turn away from the light.
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+    {
+        UMBRELLA_PROFILE_GPU_ZONE(*m_gpuProfiler, zoneNames[cascade]);
+        m_renderQueue.Clear();
+        m_renderQueue.Push({
+            .key = Gfx::MakeDrawKey({
+                .pass = Gfx::RenderPass::Opaque,
+                .program = m_shadowProgram->Id(),
+                .vertexArray = m_VAO,
+            }),
+            .program = m_shadowProgram->Id(),
+            .vertexArray = m_VAO,
+            .textures = {},
+            .flags = static_cast<uint32_t>(Gfx::RenderFlags::DepthTest),
+            .mode = GL_TRIANGLES,
+            .indexType = m_indexType,
+            .indirectOffset = commands->offset,
+            .drawCount = narrow_into<GLsizei>(stats.numDraws),
+        });
+        m_renderQueue.Sort();
+        m_renderQueue.Submit(m_stateCache);
+    }
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    m_shadowMap->EndCascade();
+    return true;
+}
+
+FramePacket& UmbrellaApplication::AcquirePacket()
+{
+    if (m_renderThread) {
+        return m_packets[m_renderThread->Acquire()];
+    }
+    return m_packets.front();
+}
+
+void UmbrellaApplication::ReleasePacket(FramePacket& packet)
+{
+    if (m_renderThread) {
+        m_renderThread->Release(
+            static_cast<uint32_t>(&packet - m_packets.data()));
+    }
+}
+
+DrawListStats UmbrellaApplication::Frame(FramePacket& packet, double& cpuMs)
+{
+    auto cpuStart = std::chrono::steady_clock::now();
+    BuildFrame(packet);
+    DrawListStats stats = packet.stats;
+    if (m_renderThread) {
+        cpuMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - cpuStart)
+                    .count();
+        m_renderThread->Submit(
+            static_cast<uint32_t>(&packet - m_packets.data()));
+        return stats;
+    }
+
+    SubmitFrame(packet);
+    cpuMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - cpuStart)
+                .count();
+    {
+        UMBRELLA_PROFILE_ZONE("Swap buffers");
+        glfwSwapBuffers(m_window);
+    }
+    Presented(packet);
+    return stats;
+}
+
+void UmbrellaApplication::Presented(FramePacket const& packet)
+{
+    // The swap returning is as close to the display as the CPU can see.
+    double latencyMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - packet.inputTime)
+                           .count();
+    UMBRELLA_PROFILE_COUNTER("Input to present ms", latencyMs);
+    m_latencyMs += latencyMs;
+    m_maxLatencyMs = std::max(m_maxLatencyMs, latencyMs);
+
+    if (++m_submitFrames == 300) {
+        DrawListStats const& stats = packet.stats;
+        OcclusionStats const& occlusion = packet.occlusion;
+        spdlog::info("Submitted {} instances in {} draws, {:.3f} ms CPU per "
+                     "frame; {} of {} triangles, {} saved per frame",
+            stats.numInstances, stats.numDraws, m_submitMs / m_submitFrames,
+            stats.numTriangles, stats.fullTriangles,
+            stats.fullTriangles - stats.numTriangles);
+        spdlog::info("Culled {} outside the frustum; {} occluders drew {} "
+                     "triangles in {:.3f} ms and hid {} of {} tested in {:.3f} "
+                     "ms",
+            stats.numCulled, occlusion.occludersDrawn,
+            occlusion.trianglesRasterized, occlusion.rasterMs,
+            occlusion.objectsRejected, occlusion.objectsTested,
+            occlusion.testMs);
+        MeshletCullStats const& meshlets = stats.meshlets;
+        spdlog::info("Culled {} of {} meshlets of {} instances outside the "
+                     "frustum and {} facing away: {:.1f}% of their triangles",
+            meshlets.frustumCulled, meshlets.numMeshlets,
+            meshlets.numInstances, meshlets.coneCulled,
+            100.0 * meshlets.CulledFraction());
+        LightBinStats const& lights = packet.lights;
+        spdlog::info("Binned {} of {} lights into {} clusters in {:.3f} ms, "
+                     "{:.1f} per lit cluster and {} at most",
+            lights.numVisible, lights.numLights, lights.nonEmptyClusters,
+            lights.binMs, lights.AverageLightsPerCluster(),
+            lights.maxPerCluster);
+        // Renders are counted since launch; GPU times as they come back.
+        std::span<Gfx::CascadeTiming const> timings = m_shadowMap->Timings();
+        for (size_t c = 0; c < packet.cascades.size(); c++) {
+            CascadeStats const& updates = packet.cascades[c].updates;
+            spdlog::info("Shadow cascade {} to {:.1f} m rendered in {:.1f}% "
+                         "of frames ({} refits, {} invalidations), {:.3f} ms "
+                         "GPU per render",
+                c, packet.cascades[c].cascade.splitDepth,
+                100.0 * updates.UpdateRate(), updates.refits,
+                updates.invalidations, timings[c].AverageMs());
+        }
+        spdlog::info("Input to present {:.2f} ms on average, {:.2f} ms at "
+                     "most; {} of {} state changes skipped",
+            m_latencyMs / m_submitFrames, m_maxLatencyMs,
+            m_stateRequested - m_stateIssued, m_stateRequested);
+        m_submitMs = 0.0;
+        m_stateRequested = 0;
+        m_stateIssued = 0;
+        m_latencyMs = 0.0;
+        m_maxLatencyMs = 0.0;
+        m_submitFrames = 0;
+    }
+}
+
+void UmbrellaApplication::StartRenderThread()
+{
+    // GLFW keeps window and input handling on the main thread, but the
+    // context can move: the main thread lets go of it and the render thread
+    // takes it for as long as it runs.
+    m_packets.resize(
+        std::clamp(m_options.framePackets, Gfx::RenderThread::minPackets,
+            Gfx::RenderThread::maxPackets));
+    glfwMakeContextCurrent(nullptr);
+    m_renderThread = std::make_unique<Gfx::RenderThread>(
+        static_cast<uint32_t>(m_packets.size()),
+        Gfx::RenderThreadHooks {
+            .begin = [this]() { glfwMakeContextCurrent(m_window); },
+            .render =
+                [this](uint32_t slot) {
+                    SubmitFrame(m_packets[slot]);
+                    {
+                        UMBRELLA_PROFILE_ZONE("Swap buffers");
+                        glfwSwapBuffers(m_window);
+                    }
+                    Presented(m_packets[slot]);
+                },
+            .end = []() { glfwMakeContextCurrent(nullptr); },
+        });
+    spdlog::info("Rendering on a render thread with {} frame packets",
+        m_packets.size());
+}
+
+void UmbrellaApplication::StopRenderThread()
+{
+    if (!m_renderThread) {
+        return;
+    }
+    m_renderThread.reset();
+    glfwMakeContextCurrent(m_window);
+    m_packets.resize(1);
 }
 
 void UmbrellaApplication::ProcessKeys(
@@ -326,6 +1256,11 @@ void UmbrellaApplication::ProcessKeys(
     case GLFW_KEY_ESCAPE:
         glfwSetWindowShouldClose(app->m_window, true);
         break;
+    case GLFW_KEY_F9:
+        if (action == GLFW_PRESS) {
+            app->ToggleProfileCapture();
+        }
+        break;
     default:
         break;
     }
@@ -339,41 +1274,255 @@ void UmbrellaApplication::ProcessMouse(
     app->m_currentCamera->ProcessMouse(x, y);
 }
 
-void UmbrellaApplication::Tick(float dt)
+void UmbrellaApplication::Tick()
+{
+    UMBRELLA_PROFILE_ZONE("Tick");
+    // Every wait comes before the input is read, so each frame goes out
+    // with the freshest input it can.
+    m_limiter->Wait();
+    FramePacket& packet = AcquirePacket();
+    {
+        UMBRELLA_PROFILE_ZONE("Poll input");
+        glfwPollEvents();
+    }
+    // A minimized window has no framebuffer to draw into, and nothing
+    // paces the loop without swaps, so it sleeps until the window changes.
+    // The time spent there is not simulated.
+    if (m_minimized) {
+        ReleasePacket(packet);
+        glfwWaitEvents();
+        m_lastTick = glfwGetTime();
+        return;
+    }
+    packet.inputTime = std::chrono::steady_clock::now();
+
+    double currentTick = glfwGetTime();
+    double dt = currentTick - m_lastTick;
+    m_lastTick = currentTick;
+
+    // The mouse turns the camera once per frame, and movement runs in
+    // fixed steps so it does not depend on the frame rate.
+    m_currentCamera->ApplyLook();
+    uint32_t numSteps = m_timestep->Advance(dt);
+    for (uint32_t step = 0; step < numSteps; step++) {
+        m_currentCamera->Tick(m_timestep->Step());
+    }
+    m_interpolation = m_timestep->Alpha();
+    if (m_recordedPath) {
+        m_recordedTime += static_cast<float>(dt);
+        m_recordedPath->Append(
+            {.time = m_recordedTime, .pose = m_currentCamera->Pose()});
+    }
+
+    double cpuMs = 0.0;
+    (void)Frame(packet, cpuMs);
+}
+
+void UmbrellaApplication::ToggleProfileCapture()
 {
-    m_currentCamera->Tick(dt);
-    Render();
-    glfwSwapBuffers(m_window);
-    glfwPollEvents();
+    Util::Profiler& profiler = Util::Profiler::Instance();
+    if (Util::Profiler::Capturing()) {
+        (void)profiler.EndCapture(m_options.profilePath.c_str());
+    } else {
+        spdlog::info("Capturing a profile, F9 again to write it");
+        profiler.BeginCapture();
+    }
 }
 
 void UmbrellaApplication::Stop()
 {
     spdlog::info("Stopping...");
+    // The mapped buffer has to go while its context is still alive, and
+    // current on this thread.
+    StopRenderThread();
+    m_frameStream.reset();
+    m_program.reset();
+    m_shadowProgram.reset();
+    m_shadowMap.reset();
+    m_textures.reset();
+    m_gpuProfiler.reset();
     glfwTerminate();
 }
 
-void UmbrellaApplication::Run()
+bool UmbrellaApplication::RunBenchmark()
+{
+    BenchmarkOptions const& options = *m_options.benchmark;
+
+    std::optional<CameraPath> path;
+    if (!options.cameraPath.empty()) {
+        path = CameraPath::Load(options.cameraPath.c_str());
+        if (!path) {
+            return false;
+        }
+    } else {
+        // Circles the instances once, from a little above, far enough out
+        // to see all of them.
+        std::span<glm::mat4 const> transforms = m_scene->Transforms();
+        glm::vec3 center(0.0f);
+        for (glm::mat4 const& transform : transforms) {
+            center += glm::vec3(transform[3]);
+        }
+        center /= static_cast<float>(std::max<size_t>(transforms.size(), 1));
+        float radius = 0.0f;
+        for (glm::mat4 const& transform : transforms) {
+            radius = std::max(
+                radius, glm::distance(center, glm::vec3(transform[3])));
+        }
+        float distance = 2.0f * radius + 7.0f;
+        float seconds = static_cast<float>(options.frames) * options.timeStep;
+        path = CameraPath::Orbit(
+            center, distance, 0.3f * distance, std::max(seconds, 1.0f));
+    }
+
+    // Streaming textures would make the first frames cheaper than the rest
+    // and vary between runs, so they finish before anything is measured.
+    // Idle() has to be asked on the thread that updates the streamer, so
+    // the warmup runs before the render thread starts.
+    m_currentCamera->SetPose(path->Sample(0.0f));
+    constexpr uint32_t maxStreamingFrames = 100000;
+    uint32_t numWarmup = 0;
+    double cpuMs = 0.0;
+    while (numWarmup < options.warmupFrames
+        || (!m_textures->Idle() && numWarmup < maxStreamingFrames)) {
+        FramePacket& packet = AcquirePacket();
+        packet.inputTime = std::chrono::steady_clock::now();
+        (void)Frame(packet, cpuMs);
+        glfwPollEvents();
+        numWarmup++;
+    }
+    glFinish();
+    spdlog::info("Measuring {} frames after {} warmup frames",
+        options.frames, numWarmup);
+
+    // Frames are numbered from zero again, so GPU results map straight
+    // onto samples.
+    m_frame = 0;
+    m_gpuTimer.emplace();
+    m_gpuResults.clear();
+    if (m_options.renderThread) {
+        StartRenderThread();
+    }
+    std::vector<FrameSample> samples;
+    samples.reserve(options.frames);
+    for (uint32_t frame = 0; frame < options.frames; frame++) {
+        auto frameStart = std::chrono::steady_clock::now();
+        FramePacket& packet = AcquirePacket();
+        m_currentCamera->SetPose(path->Sample(
+            static_cast<float>(frame) * options.timeStep));
+        packet.inputTime = std::chrono::steady_clock::now();
+        DrawListStats draws = Frame(packet, cpuMs);
+        glfwPollEvents();
+        auto frameEnd = std::chrono::steady_clock::now();
+
+        samples.push_back({
+            .frame = frame,
+            .cpuMs = cpuMs,
+            .frameMs = std::chrono::duration<double, std::milli>(
+                frameEnd - frameStart)
+                           .count(),
+            .gpuMs = {},
+            .draws = draws,
+        });
+    }
+    uint32_t framePackets = m_renderThread
+        ? static_cast<uint32_t>(m_packets.size())
+        : 0;
+    StopRenderThread();
+    glFinish();
+    m_gpuTimer->Collect(m_gpuResults, true);
+    m_gpuTimer.reset();
+    for (auto const& [frame, ms] : m_gpuResults) {
+        samples[frame].gpuMs = ms;
+    }
+
+    LogFrameReport(samples);
+    FrameReportInfo info {
+        .renderer = reinterpret_cast<char const*>(glGetString(GL_RENDERER)),
+        .version = reinterpret_cast<char const*>(glGetString(GL_VERSION)),
+        .width = m_windowWidth,
+        .height = m_windowHeight,
+        .numInstances = m_scene->NumInstances(),
+        .timeStep = options.timeStep,
+        .framePackets = framePackets,
+        .cameraPath = options.cameraPath.empty() ? "orbit"
+                                                 : options.cameraPath,
+    };
+    bool written = true;
+    if (!options.jsonPath.empty()) {
+        written
+            &= WriteFrameReportJson(options.jsonPath.c_str(), info, samples);
+    }
+    if (!options.csvPath.empty()) {
+        written &= WriteFrameReportCsv(options.csvPath.c_str(), samples);
+    }
+    return written;
+}
+
+bool UmbrellaApplication::Run()
 {
     spdlog::info("Started Umbrella.");
+    Util::Profiler& profiler = Util::Profiler::Instance();
+    profiler.SetThreadName("main");
+    if (m_options.profileFromStart) {
+        profiler.BeginCapture();
+    }
 
     if (Initialize() != InitializeResult::InitializeOk) {
         spdlog::error("Initialize() != InitializeResult::InitializeOk");
-        return;
+        return false;
     }
 
-    if (Prepare() != PrepareResult::PrepareOk) {
+    // Loading gets a capture of its own unless one already runs.
+    bool traceLoad
+        = !m_options.loadTracePath.empty() && !Util::Profiler::Capturing();
+    if (traceLoad) {
+        profiler.BeginCapture();
+    }
+    PrepareResult prepared;
+    {
+        UMBRELLA_PROFILE_ZONE("Prepare");
+        prepared = Prepare();
+    }
+    if (traceLoad) {
+        (void)profiler.EndCapture(m_options.loadTracePath.c_str());
+    }
+    if (prepared != PrepareResult::PrepareOk) {
         spdlog::error("Prepare() != PrepareResult::PrepareOk");
-        return;
+        Stop();
+        return false;
     }
 
+    if (m_options.benchmark) {
+        bool succeeded = RunBenchmark();
+        if (Util::Profiler::Capturing()) {
+            succeeded &= profiler.EndCapture(m_options.profilePath.c_str());
+        }
+        Stop();
+        return succeeded;
+    }
+
+    if (!m_options.recordCameraPath.empty()) {
+        m_recordedPath.emplace();
+    }
+    FramePacingOptions const& pacing = m_options.pacing;
+    m_timestep.emplace(1.0 / pacing.simulationRate, pacing.maxStepsPerFrame);
+    m_limiter.emplace(pacing.fpsLimit, pacing.spinMs);
+    if (m_options.renderThread) {
+        StartRenderThread();
+    }
+    m_lastTick = glfwGetTime();
     while (!glfwWindowShouldClose(m_window)) {
-        double currentTick = glfwGetTime();
-        Tick(currentTick - m_lastTick);
-        m_lastTick = currentTick;
+        Tick();
+    }
+    if (m_recordedPath) {
+        (void)m_recordedPath->Save(m_options.recordCameraPath.c_str());
+    }
+    if (Util::Profiler::Capturing()) {
+        (void)profiler.EndCapture(m_options.profilePath.c_str());
     }
 
     Stop();
+    return true;
 }
 
 } // namespace Umbrella
@@ -2,9 +2,32 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
 #include <glad/gl.h>
+#include <glm/glm.hpp>
 
+#include "gfx/GpuProfiler.h"
+#include "gfx/GpuTimer.h"
+#include "gfx/MaterialTable.h"
+#include "gfx/Program.h"
+#include "gfx/RenderQueue.h"
+#include "gfx/RenderThread.h"
+#include "gfx/ShadowMap.h"
+#include "gfx/StateCache.h"
+#include "gfx/StreamBuffer.h"
+#include "gfx/TextureStreamer.h"
 #include "systems/Camera.h"
+#include "systems/CameraPath.h"
+#include "systems/FramePacer.h"
+#include "systems/FramePacket.h"
+#include "systems/LightClusters.h"
+#include "systems/Scene.h"
+#include "systems/ShadowCascades.h"
+#include "systems/TransformHierarchy.h"
 
 struct GLFWwindow;
 
@@ -24,18 +47,105 @@ enum class [[nodiscard]] PrepareResult : uint8_t {
     ObjLoadFail = 3,
     ObjParseFail = 4,
     ObjMissingAttrib = 5,
-    TexLoadFail = 6
+    TexLoadFail = 6,
+    StreamBufferFail = 7,
+    ShaderLayoutMismatch = 8,
+    ShadowMapFail = 9
+};
+
+// Renders a fixed number of frames along a camera path, offscreen and
+// without vsync, and reports what each frame cost.
+struct BenchmarkOptions {
+    uint32_t frames = 1000;
+    // Rendered and thrown away before measuring, after the textures have
+    // finished streaming in.
+    uint32_t warmupFrames = 60;
+    // The camera path advances by this much every frame, however long the
+    // frame took, so every run draws the same frames.
+    float timeStep = 1.0f / 60.0f;
+    int width = 1280;
+    int height = 720;
+    // Orbits the scene when empty.
+    std::string cameraPath;
+    std::string jsonPath;
+    std::string csvPath;
+};
+
+struct ApplicationOptions {
+    // Replaces the single mesh with this many instances, to measure how
+    // submission scales.
+    uint32_t stressInstances = 0;
+    // Scatters this many point lights of random colours through the scene,
+    // besides the sun that always lights it.
+    uint32_t numLights = 0;
+    // The sun's shadow cascades, and how long each is kept.
+    ShadowCascadeOptions shadows;
+    // How nearby instances of dense meshes are culled meshlet by meshlet.
+    MeshletCullingOptions meshlets;
+    // Whether instances hidden behind the biggest ones are culled, and when
+    // that is worth the rasterization.
+    OcclusionOptions occlusion;
+    // A .upak built by UmbrellaPack, mounted over the working directory so
+    // the assets it holds are read from it.
+    std::string packPath;
+    // Writes a profile capture of Prepare() here.
+    std::string loadTracePath;
+    // Where F9 writes profile captures, as Chrome traces. With
+    // profileFromStart a capture runs from launch until F9 or exit.
+    std::string profilePath = "profile.json";
+    bool profileFromStart {};
+    std::optional<BenchmarkOptions> benchmark;
+    // Records the camera of an interactive run, for replaying it with
+    // BenchmarkOptions::cameraPath.
+    std::string recordCameraPath;
+    // Submits and presents frames on a render thread, while the main thread
+    // handles input and builds the next frame. Without it the main thread
+    // does everything, a frame behind the input at most.
+    bool renderThread = true;
+    // Frame packets between the threads, 2 or 3. The third lets the main
+    // thread run one more frame ahead, trading latency for throughput.
+    uint32_t framePackets = Gfx::RenderThread::minPackets;
+    // Interactive runs only; benchmarks render uncapped at a fixed step.
+    FramePacingOptions pacing;
 };
 
 class UmbrellaApplication {
 public:
-    void Run();
+    explicit UmbrellaApplication(ApplicationOptions options = {});
+
+    // Returns false when the application failed to start, or the benchmark
+    // failed to run or write its report.
+    bool Run();
 
 protected:
     InitializeResult Initialize();
     PrepareResult Prepare();
-    void Tick(float dt);
-    void Render();
+    void UploadGeometry(
+        SceneGeometry const& geometry, std::span<glm::mat4 const> dequantize);
+    void CreateFrameStream(size_t numMaterials);
+    void UploadLights();
+    void Tick();
+    // Main thread half of a frame: camera matrices and the draw list.
+    void BuildFrame(FramePacket& packet);
+    // GL half of a frame, on the render thread when there is one.
+    void SubmitFrame(FramePacket const& packet);
+    // Draws a cascade's casters into its layer of the shadow map, from
+    // inside SubmitFrame's stream frame. False when the stream is full.
+    bool DrawCascade(uint32_t cascade, CascadePacket const& packet);
+    // Waits for a free packet when there is a render thread.
+    FramePacket& AcquirePacket();
+    // Gives an acquired packet back without building it.
+    void ReleasePacket(FramePacket& packet);
+    // Builds the acquired packet and submits it, or hands it to the render
+    // thread. cpuMs is the time the main thread spent on it, without the
+    // swap.
+    DrawListStats Frame(FramePacket& packet, double& cpuMs);
+    // After the packet's swap, on the thread that made it.
+    void Presented(FramePacket const& packet);
+    void StartRenderThread();
+    void StopRenderThread();
+    bool RunBenchmark();
+    void ToggleProfileCapture();
     void Stop();
 
     static void ProcessKeys(
@@ -44,15 +154,69 @@ protected:
 
 private:
     GLFWwindow* m_window {};
+    // The last size with any area; a minimized window keeps the size it
+    // had, and so the aspect its cascades and clusters were built for.
     int m_windowWidth {};
     int m_windowHeight {};
+    bool m_minimized {};
 
-    GLuint m_shaderProgram {};
+    std::optional<Gfx::Program> m_program;
+    // Depth only, for the shadow cascades.
+    std::optional<Gfx::Program> m_shadowProgram;
     GLuint m_VAO {};
-    GLuint m_meshTexture {};
-    size_t m_numVertices {};
+    GLenum m_indexType {GL_UNSIGNED_INT};
+    GLuint m_meshBuffer {};
+    GLuint m_lightBuffer {};
+
+    ApplicationOptions m_options;
+    std::unique_ptr<Scene> m_scene;
+    // Where every instance sits; only nodes that changed reach the scene.
+    TransformHierarchy m_hierarchy;
+    // The instance each node places; group nodes place none.
+    std::vector<uint32_t> m_nodeInstances;
+    std::optional<Gfx::StreamBuffer> m_frameStream;
+    std::unique_ptr<Gfx::TextureStreamer> m_textures;
+    std::optional<Gfx::MaterialTable> m_materials;
+    std::optional<Gfx::GpuProfiler> m_gpuProfiler;
+    std::vector<PointLight> m_lights;
+    LightClusters m_lightClusters;
+    DirectionalLight m_sun {};
+    ShadowCascades m_shadows;
+    // Around every instance; kept until an instance moves.
+    CasterBounds m_casterBounds {};
+    size_t m_ssboAlignment {1};
+    size_t m_uboAlignment {1};
+
+    // One packet per slot of the render thread, or one without it.
+    std::vector<FramePacket> m_packets;
+    std::unique_ptr<Gfx::RenderThread> m_renderThread;
+    uint32_t m_frame {};
+
+    // Only touched by whichever thread owns the GL context.
+    int m_viewportWidth {};
+    int m_viewportHeight {};
+    Gfx::RenderQueue m_renderQueue;
+    Gfx::StateCache m_stateCache;
+    std::unique_ptr<Gfx::ShadowMap> m_shadowMap;
+    // What the scene draws with: the material arrays, then the shadow map.
+    std::vector<GLuint> m_sceneTextures;
+    double m_submitMs {};
+    double m_latencyMs {};
+    double m_maxLatencyMs {};
+    uint64_t m_stateRequested {};
+    uint64_t m_stateIssued {};
+    uint32_t m_submitFrames {};
+    // Set while a benchmark measures.
+    std::optional<Gfx::GpuTimer> m_gpuTimer;
+    std::vector<std::pair<uint32_t, double>> m_gpuResults;
 
     double m_lastTick {};
+    std::optional<FixedTimestep> m_timestep;
+    std::optional<FrameLimiter> m_limiter;
+    // How far between the last two simulation steps frames render.
+    float m_interpolation {1.0f};
+    std::optional<CameraPath> m_recordedPath;
+    float m_recordedTime {};
 
     std::unique_ptr<Camera> m_currentCamera = std::make_unique<Camera>(glm::vec3(0.0f, 0.0f, 7.0f));
 };
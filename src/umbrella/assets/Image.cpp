@@ -0,0 +1,137 @@
+#include "assets/Image.h"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+
+#include <stb_image.h>
+
+#include "util/Profiler.h"
+#include "util/VirtualFileSystem.h"
+
+namespace Umbrella::Assets {
+
+uint32_t BlockDim(TextureFormat format)
+{
+    return format == TextureFormat::Rgba8 ? 1 : 4;
+}
+
+uint32_t BytesPerBlock(TextureFormat format)
+{
+    switch (format) {
+    case TextureFormat::Rgba8:
+        return 4;
+    case TextureFormat::Bc1:
+        return 8;
+    case TextureFormat::Bc3:
+    case TextureFormat::Bc7:
+        return 16;
+    }
+    return 0;
+}
+
+size_t Image::RowBytes(uint32_t level) const
+{
+    uint32_t dim = BlockDim(format);
+    return size_t((levels[level].width + dim - 1) / dim)
+        * BytesPerBlock(format);
+}
+
+uint32_t Image::NumRows(uint32_t level) const
+{
+    uint32_t dim = BlockDim(format);
+    return (levels[level].height + dim - 1) / dim;
+}
+
+std::optional<Image> LoadImage(char const* path)
+{
+    UMBRELLA_PROFILE_ZONE("Load image");
+    std::optional<Util::AssetFile> file
+        = Util::VirtualFileSystem::Instance().Open(path);
+    if (!file || file->Size() > size_t(INT_MAX)) {
+        return {};
+    }
+
+    int width, height, numChannels;
+    stbi_uc* pixels = stbi_load_from_memory(
+        reinterpret_cast<stbi_uc const*>(file->Data()),
+        static_cast<int>(file->Size()), &width, &height, &numChannels, 4);
+    if (!pixels) {
+        return {};
+    }
+
+    ImageLevel level {
+        .width = static_cast<uint32_t>(width),
+        .height = static_cast<uint32_t>(height),
+        .pixels = {},
+    };
+    level.pixels.assign(
+        pixels, pixels + size_t(level.width) * level.height * 4);
+    stbi_image_free(pixels);
+
+    Image image;
+    image.levels.push_back(std::move(level));
+    return image;
+}
+
+uint32_t MipCount(uint32_t width, uint32_t height)
+{
+    return static_cast<uint32_t>(std::bit_width(std::max({width, height, 1u})));
+}
+
+void BuildMipChain(Image& image)
+{
+    UMBRELLA_PROFILE_ZONE("Build mip chain");
+    if (image.levels.empty() || image.format != TextureFormat::Rgba8) {
+        return;
+    }
+    image.levels.resize(1);
+    uint32_t numLevels
+        = MipCount(image.levels[0].width, image.levels[0].height);
+
+    for (uint32_t l = 1; l < numLevels; l++) {
+        ImageLevel const& source = image.levels[l - 1];
+        size_t sourceRowBytes = image.RowBytes(l - 1);
+        ImageLevel level {
+            .width = std::max(source.width / 2, 1u),
+            .height = std::max(source.height / 2, 1u),
+            .pixels = {},
+        };
+        size_t rowBytes = size_t(level.width) * 4;
+        level.pixels.resize(rowBytes * level.height);
+
+        // Each texel averages the source texels that map onto it: 2x2
+        // normally, 3 wide or tall where an odd last row or column folds in.
+        for (uint32_t y = 0; y < level.height; y++) {
+            uint32_t y0 = std::min(2 * y, source.height - 1);
+            uint32_t y1 = y + 1 == level.height ? source.height : y0 + 2;
+            y1 = std::max(y1, y0 + 1);
+            for (uint32_t x = 0; x < level.width; x++) {
+                uint32_t x0 = std::min(2 * x, source.width - 1);
+                uint32_t x1 = x + 1 == level.width ? source.width : x0 + 2;
+                x1 = std::max(x1, x0 + 1);
+
+                uint32_t sum[4] = {};
+                for (uint32_t sy = y0; sy < y1; sy++) {
+                    uint8_t const* row
+                        = source.pixels.data() + sy * sourceRowBytes;
+                    for (uint32_t sx = x0; sx < x1; sx++) {
+                        for (uint32_t c = 0; c < 4; c++) {
+                            sum[c] += row[4 * sx + c];
+                        }
+                    }
+                }
+                uint32_t count = (y1 - y0) * (x1 - x0);
+                uint8_t* texel
+                    = level.pixels.data() + y * rowBytes + 4 * x;
+                for (uint32_t c = 0; c < 4; c++) {
+                    texel[c] = static_cast<uint8_t>(
+                        (sum[c] + count / 2) / count);
+                }
+            }
+        }
+        image.levels.push_back(std::move(level));
+    }
+}
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace Umbrella::Assets {
+
+enum class TextureFormat : uint8_t {
+    Rgba8 = 0,
+    // Block-compressed formats, in 4x4 texel blocks.
+    Bc1 = 1,
+    Bc3 = 2,
+    Bc7 = 3,
+};
+
+// Texels per side of a block: 1 for uncompressed formats.
+uint32_t BlockDim(TextureFormat format);
+uint32_t BytesPerBlock(TextureFormat format);
+
+// Tightly packed texels or blocks, rows top to bottom. Block formats store
+// partial blocks at the right and bottom edges whole.
+struct ImageLevel {
+    uint32_t width {};
+    uint32_t height {};
+    std::vector<uint8_t> pixels;
+};
+
+// Level 0 first, each level half the size of the one before down to 1x1.
+struct Image {
+    TextureFormat format {};
+    std::vector<ImageLevel> levels;
+
+    // Bytes in one row of texels, or of blocks for block formats.
+    size_t RowBytes(uint32_t level) const;
+    // Rows of texels or blocks in a level.
+    uint32_t NumRows(uint32_t level) const;
+};
+
+// Decodes the asset at path, in any format stb_image reads, into a single
+// RGBA8 level. Safe to call from several threads at once.
+std::optional<Image> LoadImage(char const* path);
+
+uint32_t MipCount(uint32_t width, uint32_t height);
+
+// Replaces every level after the first with a 2x2 box-filtered chain. Only
+// for RGBA8 images.
+// Odd sizes round down, and the last row or column is folded into the one
+// before it.
+void BuildMipChain(Image& image);
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Umbrella::Assets {
+
+// Interleaved vertex as uploaded into the VBO.
+struct Vertex {
+    float x, y, z;
+    float u, v;
+    float nx, ny, nz;
+
+    bool operator==(Vertex const& other) const
+    {
+        return x == other.x && y == other.y && z == other.z && u == other.u
+            && v == other.v && nx == other.nx && ny == other.ny
+            && nz == other.nz;
+    }
+};
+
+struct MeshBounds {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Surface of a shape, from its .mtl material. Fixed size, so the mesh
+// cache stores it as it is.
+struct MeshMaterial {
+    // Kd, with the dissolve in alpha.
+    glm::vec4 diffuse;
+    // Ks, with the Ns exponent in w.
+    glm::vec4 specular;
+    // map_Kd relative to the working directory; empty when there is none.
+    char diffuseTexture[240];
+};
+
+// What faces without a material are drawn with.
+inline MeshMaterial DefaultMaterial()
+{
+    return {
+        .diffuse = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f),
+        .specular = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+        .diffuseTexture = {},
+    };
+}
+
+// Range of the index buffer that belongs to one OBJ shape, or to the faces
+// of a shape that share a material when it has several. Every range is
+// drawn with a single material.
+struct MeshShapeRange {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // Into the mesh's materials.
+    uint32_t material;
+};
+
+// Range of the index buffer holding one level of detail. LOD 0 is the full
+// mesh; every further LOD is a coarser copy of the whole mesh. Each LOD is
+// split into its own shape ranges, which cover it without gaps. error is
+// how far, in model units, the LOD surface may lie from the original.
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+    uint32_t firstShape;
+    uint32_t numShapes;
+};
+
+// A small cluster of LOD 0 triangles, stored as a contiguous range of the
+// index buffer inside one of its shape ranges. The sphere bounds its
+// vertices. Every triangle faces away from a camera at p when
+// dot(normalize(coneApex - p), coneAxis) > coneCutoff; a cutoff of 1 or more
+// means the normals spread too far for that to ever hold.
+struct Meshlet {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // Into the shape ranges of LOD 0.
+    uint32_t shape;
+    uint32_t numVertices;
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+    glm::vec3 coneApex;
+};
+
+// A welded, GPU-ready mesh.
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshShapeRange> shapes;
+    std::vector<MeshLod> lods;
+    std::vector<MeshMaterial> materials;
+    // LOD 0 split up, in index buffer order; empty until BuildMeshlets().
+    std::vector<Meshlet> meshlets;
+    MeshBounds bounds {};
+};
+
+// Non-owning view of a mesh, either in memory or inside a mapped cache file.
+struct MeshView {
+    std::span<Vertex const> vertices;
+    std::span<uint32_t const> indices;
+    std::span<MeshShapeRange const> shapes;
+    std::span<MeshLod const> lods;
+    std::span<MeshMaterial const> materials;
+    std::span<Meshlet const> meshlets;
+    MeshBounds bounds {};
+};
+
+inline MeshView ViewOf(MeshData const& mesh)
+{
+    return {mesh.vertices, mesh.indices, mesh.shapes, mesh.lods,
+        mesh.materials, mesh.meshlets, mesh.bounds};
+}
+
+} // namespace Umbrella::Assets
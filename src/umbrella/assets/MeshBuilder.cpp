@@ -0,0 +1,163 @@
+#include "assets/MeshBuilder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <spdlog/spdlog.h>
+
+#include "util/Framework.h"
+
+namespace Umbrella::Assets {
+
+namespace {
+
+    MeshMaterial ConvertMaterial(
+        tinyobj::material_t const& material, std::string const& baseDir)
+    {
+        MeshMaterial converted {
+            .diffuse = glm::vec4(material.diffuse[0], material.diffuse[1],
+                material.diffuse[2], material.dissolve),
+            .specular = glm::vec4(material.specular[0], material.specular[1],
+                material.specular[2], material.shininess),
+            .diffuseTexture = {},
+        };
+        if (material.diffuse_texname.empty()) {
+            return converted;
+        }
+        std::string path = baseDir + material.diffuse_texname;
+        if (path.size() >= sizeof(converted.diffuseTexture)) {
+            spdlog::warn("Texture path {} is too long, ignoring it", path);
+            return converted;
+        }
+        std::memcpy(converted.diffuseTexture, path.data(), path.size());
+        return converted;
+    }
+
+} // namespace
+
+MeshBuildResult BuildMesh(
+    ObjData const& obj, MeshData& mesh, WeldOptions options)
+{
+    tinyobj::attrib_t const& attrib = obj.attrib;
+
+    mesh = {};
+
+    size_t numCorners = 0;
+    for (auto& shape : obj.shapes) {
+        numCorners += shape.mesh.indices.size();
+    }
+
+    // Materials keep their OBJ indices; faces without one share a default
+    // material after them.
+    for (tinyobj::material_t const& material : obj.materials) {
+        mesh.materials.push_back(
+            ConvertMaterial(material, obj.materialBaseDir));
+    }
+    uint32_t const defaultMaterial
+        = narrow_into<uint32_t>(obj.materials.size());
+    auto materialOf = [&](tinyobj::shape_t const& shape, size_t face) {
+        int id = face < shape.mesh.material_ids.size()
+            ? shape.mesh.material_ids[face]
+            : -1;
+        return id >= 0 && static_cast<size_t>(id) < obj.materials.size()
+            ? static_cast<uint32_t>(id)
+            : defaultMaterial;
+    };
+
+    // Gather every face corner first, so welding can run over the whole
+    // stream at once. A shape with several materials is split into one
+    // range per material, in the order they first appear.
+    std::vector<Vertex> corners;
+    std::vector<size_t> shapeStarts;
+    std::vector<uint32_t> shapeMaterials;
+    corners.reserve(numCorners);
+    shapeStarts.reserve(obj.shapes.size());
+    for (auto& shape : obj.shapes) {
+        size_t numFaces = shape.mesh.indices.size() / 3;
+        shapeMaterials.clear();
+        for (size_t face = 0; face < numFaces; face++) {
+            uint32_t material = materialOf(shape, face);
+            if (std::ranges::find(shapeMaterials, material)
+                == shapeMaterials.end()) {
+                shapeMaterials.push_back(material);
+            }
+        }
+
+        for (uint32_t material : shapeMaterials) {
+            mesh.shapes.push_back({
+                .firstIndex = narrow_into<uint32_t>(corners.size()),
+                .indexCount = 0,
+                .material = material,
+            });
+            shapeStarts.push_back(corners.size());
+
+            for (size_t face = 0; face < numFaces; face++) {
+                if (materialOf(shape, face) != material) {
+                    continue;
+                }
+                for (size_t c = 3 * face; c < 3 * face + 3; c++) {
+                    tinyobj::index_t const& i = shape.mesh.indices[c];
+                    bool hasPosition = i.vertex_index != -1;
+                    bool hasTexCoords = i.texcoord_index != -1;
+                    bool hasNormals = i.normal_index != -1;
+
+                    if (!hasPosition || !hasNormals) {
+                        // Bail if a Vertex does not have one of the
+                        // necessary attributes.
+                        return MeshBuildResult::MissingAttrib;
+                    }
+
+                    corners.push_back({
+                        .x = attrib.vertices[3 * i.vertex_index + 0],
+                        .y = attrib.vertices[3 * i.vertex_index + 1],
+                        .z = attrib.vertices[3 * i.vertex_index + 2],
+                        .u = hasTexCoords
+                            ? attrib.texcoords[2 * i.texcoord_index + 0]
+                            : -1.0f,
+                        .v = hasTexCoords
+                            ? attrib.texcoords[2 * i.texcoord_index + 1]
+                            : -1.0f,
+                        .nx = attrib.normals[3 * i.normal_index + 0],
+                        .ny = attrib.normals[3 * i.normal_index + 1],
+                        .nz = attrib.normals[3 * i.normal_index + 2],
+                    });
+                }
+            }
+            mesh.shapes.back().indexCount = narrow_into<uint32_t>(
+                corners.size() - mesh.shapes.back().firstIndex);
+        }
+    }
+    if (std::ranges::any_of(mesh.shapes, [&](MeshShapeRange const& shape) {
+            return shape.material == defaultMaterial;
+        })) {
+        mesh.materials.push_back(DefaultMaterial());
+    }
+
+    WeldResult welded = WeldVertices(corners, shapeStarts, options);
+    mesh.vertices = std::move(welded.vertices);
+    mesh.indices = std::move(welded.indices);
+    mesh.lods.push_back({
+        .firstIndex = 0,
+        .indexCount = narrow_into<uint32_t>(mesh.indices.size()),
+        .error = 0.0f,
+        .firstShape = 0,
+        .numShapes = narrow_into<uint32_t>(mesh.shapes.size()),
+    });
+
+    mesh.bounds.min = glm::vec3(std::numeric_limits<float>::max());
+    mesh.bounds.max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (Vertex const& vertex : mesh.vertices) {
+        glm::vec3 position(vertex.x, vertex.y, vertex.z);
+        mesh.bounds.min = glm::min(mesh.bounds.min, position);
+        mesh.bounds.max = glm::max(mesh.bounds.max, position);
+    }
+
+    if (mesh.vertices.empty()) {
+        mesh.bounds = {};
+    }
+
+    return MeshBuildResult::BuildOk;
+}
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+#include "assets/Mesh.h"
+#include "assets/ObjImporter.h"
+#include "assets/VertexWelder.h"
+
+namespace Umbrella::Assets {
+
+enum class [[nodiscard]] MeshBuildResult : uint8_t {
+    BuildOk = 0,
+    MissingAttrib = 1
+};
+
+// Welds the per-face OBJ attributes into a single indexed vertex buffer.
+MeshBuildResult BuildMesh(
+    ObjData const& obj, MeshData& mesh, WeldOptions options = {});
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,426 @@
+#include "assets/MeshCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "util/Hash.h"
+#include "util/Profiler.h"
+#include "util/VirtualFileSystem.h"
+
+namespace Umbrella::Assets {
+
+namespace {
+
+    constexpr char umeshMagic[4] = {'U', 'M', 'S', 'H'};
+    constexpr uint32_t umeshVersion = 6;
+    constexpr size_t umeshAlignment = 16;
+
+    // On-disk layout: header, source table, shape ranges, LOD ranges,
+    // meshlets, materials, encoded vertices and indices, then the full
+    // vertices and indices. Every section starts on a 16-byte boundary.
+    struct UMeshHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t fileSize;
+        uint64_t sourceHash;
+
+        uint32_t numSources;
+        uint32_t numShapes;
+        uint32_t numVertices;
+        uint32_t numIndices;
+        uint32_t vertexStride;
+        uint32_t numLods;
+        uint32_t numMaterials;
+        uint32_t numMeshlets;
+        uint32_t indexFormat;
+        VertexLayout layout;
+
+        float boundsMin[3];
+        float boundsMax[3];
+
+        uint64_t sourceOffset;
+        uint64_t shapeOffset;
+        uint64_t lodOffset;
+        uint64_t meshletOffset;
+        uint64_t materialOffset;
+        uint64_t encodedVertexOffset;
+        uint64_t encodedIndexOffset;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+    };
+
+    // A file the mesh was baked from. Size and write time let an unchanged
+    // source be recognised without hashing it again.
+    struct UMeshSource {
+        char path[240];
+        uint64_t size;
+        int64_t writeTime;
+    };
+
+    uint64_t AlignUp(uint64_t offset)
+    {
+        return (offset + umeshAlignment - 1) & ~uint64_t(umeshAlignment - 1);
+    }
+
+    std::optional<UMeshSource> StampSource(std::string const& path)
+    {
+        UMeshSource source {};
+        if (path.size() >= sizeof(source.path)) {
+            return {};
+        }
+        std::memcpy(source.path, path.data(), path.size());
+
+        std::optional<Util::AssetStamp> stamp
+            = Util::VirtualFileSystem::Instance().Stat(path);
+        if (!stamp) {
+            return {};
+        }
+        source.size = stamp->size;
+        source.writeTime = stamp->writeTime;
+        return source;
+    }
+
+    std::optional<uint64_t> HashSources(std::span<UMeshSource const> sources)
+    {
+        uint64_t hash = 0;
+        for (UMeshSource const& source : sources) {
+            std::optional<Util::AssetFile> file
+                = Util::VirtualFileSystem::Instance().Open(source.path);
+            if (!file) {
+                return {};
+            }
+            hash = Util::HashBytes(file->Data(), file->Size(), hash);
+        }
+        return hash;
+    }
+
+    bool SectionFits(UMeshHeader const& header, uint64_t offset,
+        uint64_t count, uint64_t elementSize)
+    {
+        return offset % umeshAlignment == 0 && offset <= header.fileSize
+            && count <= (header.fileSize - offset) / elementSize;
+    }
+
+    uint32_t MaxIndex(EncodedMesh const& mesh)
+    {
+        uint32_t maxIndex = 0;
+        if (mesh.indexFormat == IndexFormat::Uint16) {
+            auto const* indices
+                = reinterpret_cast<uint16_t const*>(mesh.indexData.data());
+            for (size_t i = 0; i < mesh.indexData.size() / 2; i++) {
+                maxIndex = std::max<uint32_t>(maxIndex, indices[i]);
+            }
+        } else {
+            auto const* indices
+                = reinterpret_cast<uint32_t const*>(mesh.indexData.data());
+            for (size_t i = 0; i < mesh.indexData.size() / 4; i++) {
+                maxIndex = std::max(maxIndex, indices[i]);
+            }
+        }
+        return maxIndex;
+    }
+
+} // namespace
+
+std::string MeshCachePath(char const* objPath)
+{
+    // Appending an absolute path would replace "cache" rather than extend
+    // it, so only the relative part is kept.
+    std::filesystem::path path = std::filesystem::path("cache")
+        / std::filesystem::path(objPath).relative_path();
+    path.replace_extension(".umesh");
+    return path.generic_string();
+}
+
+std::optional<CachedMesh> OpenMeshCache(char const* objPath)
+{
+    UMBRELLA_PROFILE_ZONE("Open mesh cache");
+    std::string cachePath = MeshCachePath(objPath);
+    std::optional<Util::MappedFile> file
+        = Util::MappedFile::Open(cachePath.c_str());
+    if (!file) {
+        return {};
+    }
+
+    // Structural checks only, so a truncated or foreign file is rejected
+    // without touching the payload.
+    UMeshHeader header;
+    if (file->Size() < sizeof(header)) {
+        spdlog::warn("Mesh cache {} is corrupt, rebuilding", cachePath);
+        return {};
+    }
+    std::memcpy(&header, file->Data(), sizeof(header));
+    if (std::memcmp(header.magic, umeshMagic, sizeof(umeshMagic)) != 0
+        || header.version != umeshVersion || header.fileSize != file->Size()
+        || header.vertexStride != sizeof(Vertex)
+        || header.indexFormat > uint32_t(IndexFormat::Uint32)
+        || !IsWellFormed(header.layout)
+        || !SectionFits(header, header.sourceOffset, header.numSources,
+            sizeof(UMeshSource))
+        || !SectionFits(header, header.shapeOffset, header.numShapes,
+            sizeof(MeshShapeRange))
+        || !SectionFits(header, header.lodOffset, header.numLods,
+            sizeof(MeshLod))
+        || !SectionFits(header, header.meshletOffset, header.numMeshlets,
+            sizeof(Meshlet))
+        || !SectionFits(header, header.materialOffset, header.numMaterials,
+            sizeof(MeshMaterial))
+        || !SectionFits(header, header.encodedVertexOffset,
+            header.numVertices, header.layout.stride)
+        || !SectionFits(header, header.encodedIndexOffset, header.numIndices,
+            IndexSize(static_cast<IndexFormat>(header.indexFormat)))
+        || !SectionFits(header, header.vertexOffset, header.numVertices,
+            sizeof(Vertex))
+        || !SectionFits(header, header.indexOffset, header.numIndices,
+            sizeof(uint32_t))) {
+        spdlog::warn("Mesh cache {} is corrupt or outdated, rebuilding",
+            cachePath);
+        return {};
+    }
+
+    std::vector<UMeshSource> sources(header.numSources);
+    std::memcpy(sources.data(), file->Data() + header.sourceOffset,
+        sources.size() * sizeof(UMeshSource));
+
+    // Sources with the recorded size and write time are trusted as they
+    // are; anything else has to hash to the recorded content hash.
+    bool stampsMatch = true;
+    for (UMeshSource& source : sources) {
+        source.path[sizeof(source.path) - 1] = '\0';
+        std::optional<UMeshSource> current = StampSource(source.path);
+        if (!current) {
+            return {};
+        }
+        if (current->size != source.size
+            || current->writeTime != source.writeTime) {
+            stampsMatch = false;
+            source = *current;
+        }
+    }
+
+    if (!stampsMatch) {
+        std::optional<uint64_t> sourceHash = HashSources(sources);
+        if (!sourceHash || *sourceHash != header.sourceHash) {
+            spdlog::info("Mesh cache {} is stale, rebuilding", cachePath);
+            return {};
+        }
+
+        // Same content with new stamps, so only the source table changes.
+        // The file is unmapped first, as Windows refuses to write to a file
+        // that is still mapped.
+        file.reset();
+        {
+            std::fstream stream(cachePath,
+                std::ios::in | std::ios::out | std::ios::binary);
+            stream.seekp(static_cast<std::streamoff>(header.sourceOffset));
+            stream.write(reinterpret_cast<char const*>(sources.data()),
+                static_cast<std::streamsize>(
+                    sources.size() * sizeof(UMeshSource)));
+            stream.flush();
+            // The baked mesh is still current either way; the sources are
+            // only hashed again next time.
+            if (!stream) {
+                spdlog::warn("Could not update the source stamps of {}",
+                    cachePath);
+            }
+        }
+
+        file = Util::MappedFile::Open(cachePath.c_str());
+        if (!file || file->Size() != header.fileSize) {
+            return {};
+        }
+    }
+
+    char const* data = file->Data();
+    MeshView view {
+        .vertices = {reinterpret_cast<Vertex const*>(
+                         data + header.vertexOffset),
+            header.numVertices},
+        .indices = {reinterpret_cast<uint32_t const*>(
+                        data + header.indexOffset),
+            header.numIndices},
+        .shapes = {reinterpret_cast<MeshShapeRange const*>(
+                       data + header.shapeOffset),
+            header.numShapes},
+        .lods = {reinterpret_cast<MeshLod const*>(data + header.lodOffset),
+            header.numLods},
+        .materials = {reinterpret_cast<MeshMaterial const*>(
+                          data + header.materialOffset),
+            header.numMaterials},
+        .meshlets = {reinterpret_cast<Meshlet const*>(
+                         data + header.meshletOffset),
+            header.numMeshlets},
+        .bounds = {
+            .min = glm::vec3(header.boundsMin[0], header.boundsMin[1],
+                header.boundsMin[2]),
+            .max = glm::vec3(header.boundsMax[0], header.boundsMax[1],
+                header.boundsMax[2]),
+        },
+    };
+    auto indexFormat = static_cast<IndexFormat>(header.indexFormat);
+    EncodedMesh encoded {
+        .layout = header.layout,
+        .indexFormat = indexFormat,
+        .vertexData = {reinterpret_cast<std::byte const*>(
+                           data + header.encodedVertexOffset),
+            size_t(header.numVertices) * header.layout.stride},
+        .indexData = {reinterpret_cast<std::byte const*>(
+                          data + header.encodedIndexOffset),
+            size_t(header.numIndices) * IndexSize(indexFormat)},
+    };
+
+    // Shape ranges are drawn directly, so they must stay inside the indices
+    // and point at materials that exist.
+    bool rangesFit = true;
+    for (MeshShapeRange const& shape : view.shapes) {
+        rangesFit &= uint64_t(shape.firstIndex) + shape.indexCount
+                <= header.numIndices
+            && shape.material < header.numMaterials;
+    }
+    for (MeshLod const& lod : view.lods) {
+        rangesFit &= uint64_t(lod.firstIndex) + lod.indexCount
+                <= header.numIndices
+            && uint64_t(lod.firstShape) + lod.numShapes <= header.numShapes;
+    }
+    for (Meshlet const& meshlet : view.meshlets) {
+        rangesFit &= uint64_t(meshlet.firstIndex) + meshlet.indexCount
+                <= header.numIndices
+            && meshlet.shape < std::max(header.numShapes, 1u);
+    }
+    // Indices go straight to the simplifier, the occluders and the GPU, so
+    // every one of them must name a vertex.
+    uint32_t maxIndex = 0;
+    for (uint32_t index : view.indices) {
+        maxIndex = std::max(maxIndex, index);
+    }
+    rangesFit &= view.indices.empty()
+        || (maxIndex < header.numVertices
+            && MaxIndex(encoded) < header.numVertices);
+    if (!rangesFit) {
+        spdlog::warn("Mesh cache {} is corrupt, rebuilding", cachePath);
+        return {};
+    }
+
+    return CachedMesh(std::move(*file), view, encoded);
+}
+
+bool WriteMeshCache(char const* objPath,
+    std::span<std::string const> materialLibraries, MeshView mesh,
+    VertexLayoutOptions layoutOptions)
+{
+    std::vector<std::string> paths = {objPath};
+    paths.insert(
+        paths.end(), materialLibraries.begin(), materialLibraries.end());
+
+    std::vector<UMeshSource> sources;
+    for (std::string const& path : paths) {
+        std::optional<UMeshSource> source = StampSource(path);
+        if (!source) {
+            return false;
+        }
+        sources.push_back(*source);
+    }
+
+    std::optional<uint64_t> sourceHash = HashSources(sources);
+    if (!sourceHash) {
+        return false;
+    }
+
+    VertexLayout layout = ChooseVertexLayout(mesh, layoutOptions);
+    IndexFormat indexFormat = ChooseIndexFormat(mesh.vertices.size());
+    std::vector<std::byte> encodedVertices
+        = EncodeVertices(mesh.vertices, layout, mesh.bounds);
+    std::vector<std::byte> encodedIndices
+        = EncodeIndices(mesh.indices, indexFormat);
+
+    UMeshHeader header {};
+    std::memcpy(header.magic, umeshMagic, sizeof(umeshMagic));
+    header.version = umeshVersion;
+    header.sourceHash = *sourceHash;
+    header.numSources = static_cast<uint32_t>(sources.size());
+    header.numShapes = static_cast<uint32_t>(mesh.shapes.size());
+    header.numLods = static_cast<uint32_t>(mesh.lods.size());
+    header.numMaterials = static_cast<uint32_t>(mesh.materials.size());
+    header.numMeshlets = static_cast<uint32_t>(mesh.meshlets.size());
+    header.numVertices = static_cast<uint32_t>(mesh.vertices.size());
+    header.numIndices = static_cast<uint32_t>(mesh.indices.size());
+    header.vertexStride = sizeof(Vertex);
+    header.indexFormat = static_cast<uint32_t>(indexFormat);
+    header.layout = layout;
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = mesh.bounds.min[i];
+        header.boundsMax[i] = mesh.bounds.max[i];
+    }
+    header.sourceOffset = AlignUp(sizeof(UMeshHeader));
+    header.shapeOffset = AlignUp(
+        header.sourceOffset + sources.size() * sizeof(UMeshSource));
+    header.lodOffset = AlignUp(
+        header.shapeOffset + mesh.shapes.size() * sizeof(MeshShapeRange));
+    header.meshletOffset
+        = AlignUp(header.lodOffset + mesh.lods.size() * sizeof(MeshLod));
+    header.materialOffset = AlignUp(
+        header.meshletOffset + mesh.meshlets.size() * sizeof(Meshlet));
+    header.encodedVertexOffset = AlignUp(header.materialOffset
+        + mesh.materials.size() * sizeof(MeshMaterial));
+    header.encodedIndexOffset
+        = AlignUp(header.encodedVertexOffset + encodedVertices.size());
+    header.vertexOffset
+        = AlignUp(header.encodedIndexOffset + encodedIndices.size());
+    header.indexOffset = AlignUp(
+        header.vertexOffset + mesh.vertices.size() * sizeof(Vertex));
+    header.fileSize
+        = header.indexOffset + mesh.indices.size() * sizeof(uint32_t);
+
+    // Write next to the final file and rename it into place, so a crash
+    // never leaves a half-written cache behind.
+    std::string cachePath = MeshCachePath(objPath);
+    std::string tempPath = cachePath + ".tmp";
+    std::error_code error;
+    std::filesystem::create_directories(
+        std::filesystem::path(cachePath).parent_path(), error);
+
+    {
+        std::ofstream stream(tempPath, std::ios::out | std::ios::binary);
+        auto writeSection = [&](uint64_t offset, void const* bytes,
+                                size_t size) {
+            static constexpr char padding[umeshAlignment] {};
+            stream.write(padding,
+                static_cast<std::streamsize>(offset - stream.tellp()));
+            stream.write(static_cast<char const*>(bytes),
+                static_cast<std::streamsize>(size));
+        };
+
+        stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        writeSection(header.sourceOffset, sources.data(),
+            sources.size() * sizeof(UMeshSource));
+        writeSection(header.shapeOffset, mesh.shapes.data(),
+            mesh.shapes.size_bytes());
+        writeSection(
+            header.lodOffset, mesh.lods.data(), mesh.lods.size_bytes());
+        writeSection(header.meshletOffset, mesh.meshlets.data(),
+            mesh.meshlets.size_bytes());
+        writeSection(header.materialOffset, mesh.materials.data(),
+            mesh.materials.size_bytes());
+        writeSection(header.encodedVertexOffset, encodedVertices.data(),
+            encodedVertices.size());
+        writeSection(header.encodedIndexOffset, encodedIndices.data(),
+            encodedIndices.size());
+        writeSection(header.vertexOffset, mesh.vertices.data(),
+            mesh.vertices.size_bytes());
+        writeSection(header.indexOffset, mesh.indices.data(),
+            mesh.indices.size_bytes());
+        if (!stream) {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempPath, cachePath, error);
+    return !error;
+}
+
+} // namespace Umbrella::Assets
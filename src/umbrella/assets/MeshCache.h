@@ -0,0 +1,50 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+
+#include "assets/Mesh.h"
+#include "assets/VertexLayout.h"
+#include "util/MappedFile.h"
+
+namespace Umbrella::Assets {
+
+// A baked .umesh file mapped into memory. The full vertices are there for
+// the CPU; the encoded buffers can be handed to glBufferData as they are.
+class CachedMesh {
+public:
+    MeshView View() const { return m_view; }
+    EncodedMesh const& Encoded() const { return m_encoded; }
+
+private:
+    friend std::optional<CachedMesh> OpenMeshCache(char const* objPath);
+
+    CachedMesh(Util::MappedFile file, MeshView view, EncodedMesh encoded)
+        : m_file(std::move(file))
+        , m_view(view)
+        , m_encoded(encoded)
+    {
+    }
+
+    Util::MappedFile m_file;
+    MeshView m_view;
+    EncodedMesh m_encoded;
+};
+
+// Location of the .umesh file baked from objPath.
+std::string MeshCachePath(char const* objPath);
+
+// Maps the baked mesh of objPath. Returns nothing when there is no cache, when
+// it is corrupt, or when the .obj/.mtl sources no longer match the content
+// hash it was baked from.
+std::optional<CachedMesh> OpenMeshCache(char const* objPath);
+
+// Bakes mesh into the cache for objPath, keyed by a content hash of the
+// .obj and of the .mtl files it uses, along with its vertices in the layout
+// layoutOptions pick for it and its indices in the narrowest format.
+bool WriteMeshCache(char const* objPath,
+    std::span<std::string const> materialLibraries, MeshView mesh,
+    VertexLayoutOptions layoutOptions);
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,384 @@
+#include "assets/MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include <glm/glm.hpp>
+
+namespace Umbrella::Assets {
+
+namespace {
+
+    constexpr uint32_t unmapped = UINT32_MAX;
+
+    // FIFO cache simulated with timestamps: a vertex is cached while fewer
+    // than cacheSize misses happened since it was loaded. Bumping time by
+    // cacheSize + 1 flushes the whole cache.
+    class CacheSimulator {
+    public:
+        CacheSimulator(size_t numVertices, uint32_t cacheSize)
+            : m_cacheTime(numVertices, 0)
+            , m_cacheSize(cacheSize)
+            , m_time(cacheSize + 1)
+        {
+        }
+
+        bool Miss(uint32_t vertex)
+        {
+            if (m_time - m_cacheTime[vertex] <= m_cacheSize) {
+                return false;
+            }
+            m_cacheTime[vertex] = m_time++;
+            return true;
+        }
+
+        uint32_t MissTriangle(uint32_t const* triangle)
+        {
+            return Miss(triangle[0]) + Miss(triangle[1]) + Miss(triangle[2]);
+        }
+
+        void Flush() { m_time += m_cacheSize + 1; }
+
+    private:
+        std::vector<uint32_t> m_cacheTime;
+        uint32_t m_cacheSize;
+        uint32_t m_time;
+    };
+
+    size_t VertexCountOf(std::span<uint32_t const> indices)
+    {
+        return indices.empty() ? 0 : *std::ranges::max_element(indices) + 1;
+    }
+
+    glm::vec3 PositionOf(Vertex const& vertex)
+    {
+        return {vertex.x, vertex.y, vertex.z};
+    }
+
+} // namespace
+
+VertexCacheStats AnalyzeVertexCache(
+    std::span<uint32_t const> indices, uint32_t cacheSize)
+{
+    size_t numVertices = VertexCountOf(indices);
+    CacheSimulator cache(numVertices, cacheSize);
+    std::vector<bool> referenced(numVertices);
+
+    size_t misses = 0;
+    size_t numReferenced = 0;
+    for (uint32_t index : indices) {
+        misses += cache.Miss(index);
+        if (!referenced[index]) {
+            referenced[index] = true;
+            numReferenced++;
+        }
+    }
+
+    size_t numTriangles = indices.size() / 3;
+    return {
+        .acmr = numTriangles == 0
+            ? 0.0
+            : static_cast<double>(misses) / static_cast<double>(numTriangles),
+        .atvr = numReferenced == 0
+            ? 0.0
+            : static_cast<double>(misses) / static_cast<double>(numReferenced),
+    };
+}
+
+void OptimizeVertexCache(std::span<uint32_t> indices, size_t numVertices,
+    uint32_t cacheSize, std::vector<size_t>* clusterStarts)
+{
+    size_t numTriangles = indices.size() / 3;
+    if (numTriangles == 0) {
+        return;
+    }
+
+    // Triangles around each vertex, and how many of them are left to emit.
+    std::vector<uint32_t> live(numVertices, 0);
+    for (size_t i = 0; i < numTriangles * 3; i++) {
+        live[indices[i]]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(numVertices + 1, 0);
+    std::inclusive_scan(
+        live.begin(), live.end(), adjacencyOffsets.begin() + 1);
+    std::vector<uint32_t> adjacency(numTriangles * 3);
+    {
+        std::vector<uint32_t> cursor(
+            adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < numTriangles * 3; i++) {
+            adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<uint32_t> cacheTime(numVertices, 0);
+    std::vector<bool> emitted(numTriangles);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(numTriangles * 3);
+
+    uint32_t time = cacheSize + 1;
+    size_t nextUnvisited = 0;
+    int64_t fanning = indices[0];
+    while (fanning >= 0) {
+        // Emit every remaining triangle around the fanning vertex.
+        candidates.clear();
+        for (uint32_t a = adjacencyOffsets[fanning];
+            a < adjacencyOffsets[fanning + 1]; a++) {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+            for (size_t corner = 0; corner < 3; corner++) {
+                uint32_t vertex = indices[3 * triangle + corner];
+                output.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                live[vertex]--;
+                if (time - cacheTime[vertex] > cacheSize) {
+                    cacheTime[vertex] = time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // Prefer the oldest candidate that will still be cached once all of
+        // its remaining triangles have been emitted.
+        int64_t next = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t vertex : candidates) {
+            if (live[vertex] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            if (time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize) {
+                priority = time - cacheTime[vertex];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+
+        if (next == -1) {
+            if (clusterStarts && output.size() < numTriangles * 3) {
+                clusterStarts->push_back(output.size());
+            }
+            while (next == -1 && !deadEnd.empty()) {
+                uint32_t vertex = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[vertex] > 0) {
+                    next = vertex;
+                }
+            }
+            for (; next == -1 && nextUnvisited < numVertices; nextUnvisited++) {
+                if (live[nextUnvisited] > 0) {
+                    next = static_cast<int64_t>(nextUnvisited);
+                }
+            }
+        }
+
+        fanning = next;
+    }
+
+    std::ranges::copy(output, indices.begin());
+}
+
+void OptimizeOverdraw(std::span<uint32_t> indices,
+    std::span<Vertex const> vertices, std::span<size_t const> clusterStarts,
+    float threshold, uint32_t cacheSize)
+{
+    size_t numTriangles = indices.size() / 3;
+    if (numTriangles == 0) {
+        return;
+    }
+
+    std::vector<size_t> hardStarts = {0};
+    for (size_t start : clusterStarts) {
+        hardStarts.push_back(start / 3);
+    }
+    hardStarts.push_back(numTriangles);
+    std::ranges::sort(hardStarts);
+
+    // Split each cluster again wherever the triangles so far already reach
+    // the cache efficiency of the whole cluster, with a fresh cache for
+    // every piece.
+    CacheSimulator cache(vertices.size(), cacheSize);
+    std::vector<size_t> softStarts;
+    for (size_t h = 0; h + 1 < hardStarts.size(); h++) {
+        size_t begin = hardStarts[h];
+        size_t end = hardStarts[h + 1];
+        if (begin == end) {
+            continue;
+        }
+
+        cache.Flush();
+        size_t clusterMisses = 0;
+        for (size_t t = begin; t < end; t++) {
+            clusterMisses += cache.MissTriangle(&indices[3 * t]);
+        }
+        double targetAcmr = static_cast<double>(threshold)
+            * static_cast<double>(clusterMisses)
+            / static_cast<double>(end - begin);
+
+        softStarts.push_back(begin);
+        cache.Flush();
+        size_t misses = 0;
+        size_t count = 0;
+        for (size_t t = begin; t < end; t++) {
+            misses += cache.MissTriangle(&indices[3 * t]);
+            count++;
+            if (t + 1 < end
+                && static_cast<double>(misses) <= targetAcmr * count) {
+                softStarts.push_back(t + 1);
+                cache.Flush();
+                misses = 0;
+                count = 0;
+            }
+        }
+    }
+    softStarts.push_back(numTriangles);
+
+    // Area-weighted centroid and normal of every cluster and of the mesh.
+    struct Cluster {
+        size_t begin, end;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters;
+    std::vector<glm::vec3> clusterCentroids;
+    std::vector<glm::vec3> clusterNormals;
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c + 1 < softStarts.size(); c++) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = softStarts[c]; t < softStarts[c + 1]; t++) {
+            glm::vec3 p0 = PositionOf(vertices[indices[3 * t + 0]]);
+            glm::vec3 p1 = PositionOf(vertices[indices[3 * t + 1]]);
+            glm::vec3 p2 = PositionOf(vertices[indices[3 * t + 2]]);
+            glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = glm::length(cross);
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        meshCentroid += centroid;
+        meshArea += area;
+
+        clusters.push_back({softStarts[c], softStarts[c + 1], 0.0f});
+        clusterCentroids.push_back(area > 0.0f ? centroid / area : centroid);
+        clusterNormals.push_back(normal);
+    }
+    if (meshArea > 0.0f) {
+        meshCentroid /= meshArea;
+    }
+
+    // Clusters facing away from the mesh center are drawn first.
+    for (size_t c = 0; c < clusters.size(); c++) {
+        float normalLength = glm::length(clusterNormals[c]);
+        if (normalLength > 0.0f) {
+            clusters[c].sortKey = glm::dot(clusterCentroids[c] - meshCentroid,
+                clusterNormals[c] / normalLength);
+        }
+    }
+    std::ranges::stable_sort(clusters, std::ranges::greater {},
+        [](Cluster const& cluster) { return cluster.sortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(numTriangles * 3);
+    for (Cluster const& cluster : clusters) {
+        output.insert(output.end(), indices.begin() + 3 * cluster.begin,
+            indices.begin() + 3 * cluster.end);
+    }
+    std::ranges::copy(output, indices.begin());
+}
+
+void OptimizeVertexFetch(
+    std::span<uint32_t> indices, std::vector<Vertex>& vertices)
+{
+    std::vector<uint32_t> remap(vertices.size(), unmapped);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (uint32_t& index : indices) {
+        if (remap[index] == unmapped) {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices = std::move(reordered);
+}
+
+MeshOptimizeStats OptimizeMesh(MeshData& mesh, MeshOptimizeOptions options)
+{
+    // Stats cover LOD 0, which is what gets drawn up close.
+    auto lod0 = [&]() {
+        size_t count = mesh.lods.empty() ? mesh.indices.size()
+                                         : mesh.lods.front().indexCount;
+        return std::span<uint32_t const>(mesh.indices.data(), count);
+    };
+
+    MeshOptimizeStats stats;
+    stats.before = AnalyzeVertexCache(lod0(), options.cacheSize);
+
+    // Each range is optimized on its own, with its vertices renumbered
+    // densely so the per-vertex tables only cover what the range uses.
+    std::vector<uint32_t> globalToLocal(mesh.vertices.size(), unmapped);
+    std::vector<uint32_t> localToGlobal;
+    std::vector<Vertex> localVertices;
+    std::vector<size_t> clusterStarts;
+    auto optimizeRange = [&](uint32_t firstIndex, uint32_t indexCount,
+                             bool optimizeOverdraw) {
+        std::span<uint32_t> indices(
+            mesh.indices.data() + firstIndex, indexCount - indexCount % 3);
+        if (indices.empty()) {
+            return;
+        }
+
+        localToGlobal.clear();
+        localVertices.clear();
+        for (uint32_t& index : indices) {
+            if (globalToLocal[index] == unmapped) {
+                globalToLocal[index]
+                    = static_cast<uint32_t>(localToGlobal.size());
+                localToGlobal.push_back(index);
+                localVertices.push_back(mesh.vertices[index]);
+            }
+            index = globalToLocal[index];
+        }
+
+        clusterStarts.clear();
+        OptimizeVertexCache(indices, localToGlobal.size(), options.cacheSize,
+            &clusterStarts);
+        if (optimizeOverdraw) {
+            OptimizeOverdraw(indices, localVertices, clusterStarts,
+                options.overdrawThreshold, options.cacheSize);
+        }
+
+        for (uint32_t& index : indices) {
+            index = localToGlobal[index];
+        }
+        for (uint32_t global : localToGlobal) {
+            globalToLocal[global] = unmapped;
+        }
+    };
+
+    // Coarser LODs are drawn small on screen, where overdraw matters little.
+    uint32_t lod0Shapes = mesh.lods.empty()
+        ? static_cast<uint32_t>(mesh.shapes.size())
+        : mesh.lods.front().numShapes;
+    for (size_t s = 0; s < mesh.shapes.size(); s++) {
+        MeshShapeRange const& shape = mesh.shapes[s];
+        optimizeRange(shape.firstIndex, shape.indexCount,
+            options.optimizeOverdraw && s < lod0Shapes);
+    }
+
+    // LOD 0 comes first in the index buffer, so it gets the best fetch
+    // order.
+    OptimizeVertexFetch(mesh.indices, mesh.vertices);
+    stats.after = AnalyzeVertexCache(lod0(), options.cacheSize);
+    return stats;
+}
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "assets/Mesh.h"
+
+namespace Umbrella::Assets {
+
+// Post-transform vertex cache efficiency of an index buffer, measured with a
+// simulated FIFO cache. ACMR is cache misses per triangle (0.5 is the ideal
+// for a large regular mesh, 3 the worst); ATVR is misses per referenced
+// vertex (1 is ideal).
+struct VertexCacheStats {
+    double acmr {};
+    double atvr {};
+};
+
+VertexCacheStats AnalyzeVertexCache(
+    std::span<uint32_t const> indices, uint32_t cacheSize = 16);
+
+// Reorders the triangles of an index buffer for the post-transform vertex
+// cache with Tipsify (Sander, Nehab and Barczak 2007). The indices at which
+// the walk had to restart from scratch are appended to clusterStarts when it
+// is given; they are where triangles can be reordered without hurting the
+// cache much.
+void OptimizeVertexCache(std::span<uint32_t> indices, size_t numVertices,
+    uint32_t cacheSize = 16, std::vector<size_t>* clusterStarts = nullptr);
+
+// Reorders clusters of triangles so that the ones facing away from the
+// center of the mesh are drawn first, which lets early depth testing reject
+// more of what is drawn after them. Clusters are split further for as long
+// as their ACMR stays within threshold times that of the whole cluster.
+void OptimizeOverdraw(std::span<uint32_t> indices,
+    std::span<Vertex const> vertices, std::span<size_t const> clusterStarts,
+    float threshold = 1.05f, uint32_t cacheSize = 16);
+
+// Renumbers vertices in the order the index buffer first uses them, so
+// vertex fetch walks the vertex buffer mostly forward. Unreferenced
+// vertices are dropped.
+void OptimizeVertexFetch(
+    std::span<uint32_t> indices, std::vector<Vertex>& vertices);
+
+struct MeshOptimizeOptions {
+    bool optimizeOverdraw = true;
+    float overdrawThreshold = 1.05f;
+    uint32_t cacheSize = 16;
+};
+
+struct MeshOptimizeStats {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// Runs every stage above on each shape range of LOD 0, and the vertex cache
+// stage on those of every coarser LOD. Shape and LOD ranges keep their
+// place in the index buffer, so they stay valid.
+MeshOptimizeStats OptimizeMesh(
+    MeshData& mesh, MeshOptimizeOptions options = {});
+
+} // namespace Umbrella::Assets
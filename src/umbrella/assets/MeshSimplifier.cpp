@@ -0,0 +1,398 @@
+#include "assets/MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+
+#include <glm/glm.hpp>
+
+#include "util/Framework.h"
+
+namespace Umbrella::Assets {
+
+namespace {
+
+    // Sum of squared distances to a set of area-weighted planes.
+    struct Quadric {
+        double a00 {}, a11 {}, a22 {}, a01 {}, a02 {}, a12 {};
+        double b0 {}, b1 {}, b2 {};
+        double c {};
+        double weight {};
+
+        void AddPlane(glm::dvec3 n, double d, double w)
+        {
+            a00 += w * n.x * n.x;
+            a11 += w * n.y * n.y;
+            a22 += w * n.z * n.z;
+            a01 += w * n.x * n.y;
+            a02 += w * n.x * n.z;
+            a12 += w * n.y * n.z;
+            b0 += w * n.x * d;
+            b1 += w * n.y * d;
+            b2 += w * n.z * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        Quadric& operator+=(Quadric const& other)
+        {
+            a00 += other.a00;
+            a11 += other.a11;
+            a22 += other.a22;
+            a01 += other.a01;
+            a02 += other.a02;
+            a12 += other.a12;
+            b0 += other.b0;
+            b1 += other.b1;
+            b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+            return *this;
+        }
+
+        double Evaluate(glm::dvec3 p) const
+        {
+            double q = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return std::max(q, 0.0);
+        }
+    };
+
+    struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        // Mean squared distance of the merged vertex to its planes.
+        double cost;
+    };
+
+    // Gives vertices with the same position the same id.
+    std::vector<uint32_t> PositionIds(
+        std::span<glm::dvec3 const> positions, uint32_t& numPositions)
+    {
+        std::vector<uint32_t> order(positions.size());
+        std::iota(order.begin(), order.end(), 0u);
+        auto less = [&](uint32_t a, uint32_t b) {
+            glm::dvec3 pa = positions[a];
+            glm::dvec3 pb = positions[b];
+            return std::tie(pa.x, pa.y, pa.z) < std::tie(pb.x, pb.y, pb.z);
+        };
+        std::ranges::sort(order, less);
+
+        std::vector<uint32_t> ids(positions.size());
+        numPositions = 0;
+        for (size_t i = 0; i < order.size(); i++) {
+            if (i > 0 && positions[order[i]] != positions[order[i - 1]]) {
+                numPositions++;
+            }
+            ids[order[i]] = numPositions;
+        }
+        numPositions += positions.empty() ? 0 : 1;
+        return ids;
+    }
+
+    glm::dvec3 TriangleNormal(glm::dvec3 p0, glm::dvec3 p1, glm::dvec3 p2)
+    {
+        return glm::cross(p1 - p0, p2 - p0);
+    }
+
+} // namespace
+
+std::vector<uint32_t> SimplifyMesh(std::span<uint32_t const> indices,
+    std::span<Vertex const> vertices, size_t targetIndexCount,
+    float targetError, float* resultError)
+{
+    std::vector<uint32_t> result(
+        indices.begin(), indices.end() - indices.size() % 3);
+    size_t numVertices = vertices.size();
+
+    std::vector<glm::dvec3> positions(numVertices);
+    for (size_t v = 0; v < numVertices; v++) {
+        positions[v] = {vertices[v].x, vertices[v].y, vertices[v].z};
+    }
+    uint32_t numPositions;
+    std::vector<uint32_t> positionIds = PositionIds(positions, numPositions);
+
+    // A position is locked if it has several vertices (an attribute seam)
+    // or sits on an edge that does not have exactly two triangles.
+    std::vector<bool> locked(numPositions, false);
+    {
+        std::vector<uint32_t> wedges(numPositions, 0);
+        std::vector<bool> referenced(numVertices, false);
+        for (uint32_t index : result) {
+            if (!referenced[index]) {
+                referenced[index] = true;
+                wedges[positionIds[index]]++;
+            }
+        }
+        for (uint32_t p = 0; p < numPositions; p++) {
+            locked[p] = wedges[p] > 1;
+        }
+
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        edges.reserve(result.size());
+        for (size_t t = 0; t < result.size(); t += 3) {
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t a = positionIds[result[t + k]];
+                uint32_t b = positionIds[result[t + (k + 1) % 3]];
+                edges.push_back({std::min(a, b), std::max(a, b)});
+            }
+        }
+        std::ranges::sort(edges);
+        for (size_t e = 0; e < edges.size();) {
+            size_t run = e;
+            while (run < edges.size() && edges[run] == edges[e]) {
+                run++;
+            }
+            if (run - e != 2) {
+                locked[edges[e].first] = true;
+                locked[edges[e].second] = true;
+            }
+            e = run;
+        }
+    }
+
+    std::vector<Quadric> quadrics(numPositions);
+    for (size_t t = 0; t < result.size(); t += 3) {
+        glm::dvec3 p0 = positions[result[t + 0]];
+        glm::dvec3 n = TriangleNormal(
+            p0, positions[result[t + 1]], positions[result[t + 2]]);
+        double length = glm::length(n);
+        if (length == 0.0) {
+            continue;
+        }
+        n /= length;
+        for (size_t k = 0; k < 3; k++) {
+            quadrics[positionIds[result[t + k]]].AddPlane(
+                n, -glm::dot(n, p0), 0.5 * length);
+        }
+    }
+
+    double maxCost = static_cast<double>(targetError)
+        * static_cast<double>(targetError);
+    double worstCost = 0.0;
+
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> adjacencyOffsets;
+    std::vector<uint32_t> adjacency;
+    std::vector<uint32_t> remap(numVertices);
+    std::vector<bool> touched(numVertices);
+
+    auto collapseCost = [&](uint32_t from, uint32_t to) {
+        Quadric merged = quadrics[positionIds[from]];
+        merged += quadrics[positionIds[to]];
+        return merged.weight > 0.0
+            ? merged.Evaluate(positions[to]) / merged.weight
+            : 0.0;
+    };
+
+    // Moving from onto to must not turn any remaining triangle around.
+    auto flips = [&](uint32_t from, uint32_t to) {
+        for (uint32_t a = adjacencyOffsets[from];
+            a < adjacencyOffsets[from + 1]; a++) {
+            uint32_t const* triangle = &result[3 * adjacency[a]];
+            glm::dvec3 before[3], after[3];
+            bool removed = false;
+            for (size_t k = 0; k < 3; k++) {
+                removed |= positionIds[triangle[k]] == positionIds[to];
+                before[k] = positions[triangle[k]];
+                after[k] = triangle[k] == from ? positions[to] : before[k];
+            }
+            if (removed) {
+                continue;
+            }
+
+            glm::dvec3 n0 = TriangleNormal(before[0], before[1], before[2]);
+            glm::dvec3 n1 = TriangleNormal(after[0], after[1], after[2]);
+            double length0 = glm::length(n0);
+            if (length0 > 0.0
+                && glm::dot(n0, n1) <= 0.25 * length0 * glm::length(n1)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    while (result.size() > targetIndexCount) {
+        size_t numTriangles = result.size() / 3;
+
+        collapses.clear();
+        for (size_t t = 0; t < numTriangles; t++) {
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t v0 = result[3 * t + k];
+                uint32_t v1 = result[3 * t + (k + 1) % 3];
+                for (auto [from, to] : {std::pair(v0, v1), std::pair(v1, v0)}) {
+                    if (locked[positionIds[from]]) {
+                        continue;
+                    }
+                    double cost = collapseCost(from, to);
+                    if (cost <= maxCost) {
+                        collapses.push_back({from, to, cost});
+                    }
+                }
+            }
+        }
+        std::ranges::sort(collapses, {}, &Collapse::cost);
+
+        adjacencyOffsets.assign(numVertices + 1, 0);
+        for (uint32_t index : result) {
+            adjacencyOffsets[index + 1]++;
+        }
+        std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(),
+            adjacencyOffsets.begin());
+        adjacency.resize(result.size());
+        {
+            std::vector<uint32_t> cursor(
+                adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++) {
+                adjacency[cursor[result[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // Each collapse removes about two triangles. Collapses in one pass
+        // never share a one-ring, so their costs stay exact.
+        size_t wanted = (result.size() - targetIndexCount) / 6 + 1;
+        size_t done = 0;
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::fill(touched.begin(), touched.end(), false);
+        for (Collapse const& collapse : collapses) {
+            if (touched[collapse.from] || touched[collapse.to]
+                || flips(collapse.from, collapse.to)) {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[positionIds[collapse.to]]
+                += quadrics[positionIds[collapse.from]];
+            worstCost = std::max(worstCost, collapse.cost);
+
+            touched[collapse.to] = true;
+            for (uint32_t a = adjacencyOffsets[collapse.from];
+                a < adjacencyOffsets[collapse.from + 1]; a++) {
+                for (size_t k = 0; k < 3; k++) {
+                    touched[result[3 * adjacency[a] + k]] = true;
+                }
+            }
+
+            if (++done == wanted) {
+                break;
+            }
+        }
+        if (done == 0) {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t t = 0; t < numTriangles; t++) {
+            uint32_t a = remap[result[3 * t + 0]];
+            uint32_t b = remap[result[3 * t + 1]];
+            uint32_t c = remap[result[3 * t + 2]];
+            if (positionIds[a] == positionIds[b]
+                || positionIds[b] == positionIds[c]
+                || positionIds[a] == positionIds[c]) {
+                continue;
+            }
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (resultError) {
+        *resultError = static_cast<float>(std::sqrt(worstCost));
+    }
+    return result;
+}
+
+void BuildLodChain(MeshData& mesh, LodChainOptions options)
+{
+    if (mesh.lods.empty()) {
+        mesh.lods.push_back({
+            .firstIndex = 0,
+            .indexCount = narrow_into<uint32_t>(mesh.indices.size()),
+            .error = 0.0f,
+            .firstShape = 0,
+            .numShapes = narrow_into<uint32_t>(mesh.shapes.size()),
+        });
+    }
+
+    float maxError
+        = options.maxError * glm::length(mesh.bounds.max - mesh.bounds.min);
+
+    // Each shape range is simplified on its own, so no triangle ends up
+    // spanning two materials. Where ranges meet is an open border for
+    // both, which stays in place and keeps them stitched together.
+    struct Part {
+        uint32_t material;
+        std::vector<uint32_t> indices;
+    };
+    MeshLod const base = mesh.lods.front();
+    std::vector<Part> previous;
+    for (uint32_t s = base.firstShape; s < base.firstShape + base.numShapes;
+        s++) {
+        MeshShapeRange const& shape = mesh.shapes[s];
+        previous.push_back({
+            .material = shape.material,
+            .indices = {mesh.indices.begin() + shape.firstIndex,
+                mesh.indices.begin() + shape.firstIndex + shape.indexCount},
+        });
+    }
+    if (previous.empty()) {
+        previous.push_back({
+            .material = 0,
+            .indices = {mesh.indices.begin() + base.firstIndex,
+                mesh.indices.begin() + base.firstIndex + base.indexCount},
+        });
+    }
+
+    // Each LOD is simplified from the previous one, so errors add up.
+    float previousError = base.error;
+    size_t previousSize = base.indexCount;
+    while (mesh.lods.size() < options.maxLods) {
+        std::vector<Part> lod;
+        size_t lodSize = 0;
+        float error = 0.0f;
+        for (Part const& part : previous) {
+            size_t target = static_cast<size_t>(
+                                static_cast<float>(part.indices.size() / 3)
+                                * options.reduction)
+                * 3;
+            float partError = 0.0f;
+            std::vector<uint32_t> indices = SimplifyMesh(part.indices,
+                mesh.vertices, target, maxError - previousError, &partError);
+            if (indices.empty()) {
+                indices = part.indices;
+            }
+            error = std::max(error, partError);
+            lodSize += indices.size();
+            lod.push_back({part.material, std::move(indices)});
+        }
+        if (lodSize == 0 || lodSize * 10 > previousSize * 9) {
+            break;
+        }
+
+        previousError += error;
+        mesh.lods.push_back({
+            .firstIndex = narrow_into<uint32_t>(mesh.indices.size()),
+            .indexCount = narrow_into<uint32_t>(lodSize),
+            .error = previousError,
+            .firstShape = narrow_into<uint32_t>(mesh.shapes.size()),
+            .numShapes = narrow_into<uint32_t>(lod.size()),
+        });
+        for (Part const& part : lod) {
+            mesh.shapes.push_back({
+                .firstIndex = narrow_into<uint32_t>(mesh.indices.size()),
+                .indexCount = narrow_into<uint32_t>(part.indices.size()),
+                .material = part.material,
+            });
+            mesh.indices.insert(
+                mesh.indices.end(), part.indices.begin(), part.indices.end());
+        }
+        previous = std::move(lod);
+        previousSize = lodSize;
+    }
+}
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "assets/Mesh.h"
+
+namespace Umbrella::Assets {
+
+// Quadric error edge-collapse simplifier (Garland and Heckbert 1997).
+// Collapses edges until the index count drops to targetIndexCount or the
+// next collapse would move the surface further than targetError, in model
+// units. Vertices on open borders and on attribute seams (several vertices
+// sharing a position) stay in place, so the result has no new holes and no
+// torn texture coordinates. The largest error actually introduced is
+// written to resultError.
+std::vector<uint32_t> SimplifyMesh(std::span<uint32_t const> indices,
+    std::span<Vertex const> vertices, size_t targetIndexCount,
+    float targetError, float* resultError = nullptr);
+
+struct LodChainOptions {
+    uint32_t maxLods = 6;
+    // Each LOD aims for this fraction of the triangles of the one before.
+    float reduction = 0.5f;
+    // Largest error a LOD may have, relative to the bounds diagonal.
+    float maxError = 0.05f;
+};
+
+// Appends coarser LODs of LOD 0 to the mesh's index buffer, each split into
+// shape ranges with the materials of LOD 0. Stops early once
+// simplification no longer makes meaningful progress.
+void BuildLodChain(MeshData& mesh, LodChainOptions options = {});
+
+} // namespace Umbrella::Assets
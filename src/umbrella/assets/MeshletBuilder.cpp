@@ -0,0 +1,403 @@
+#include "assets/MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "assets/MeshOptimizer.h"
+#include "assets/VertexWelder.h"
+#include "util/Profiler.h"
+
+namespace Umbrella::Assets {
+
+namespace {
+
+    constexpr uint32_t unstamped = UINT32_MAX;
+
+    // Among triangles adding as many vertices, those with fewer others
+    // left around them go first, so meshlets fill in rather than leave
+    // slivers behind that later make meshlets of their own.
+    constexpr float liveWeight = 0.01f;
+
+    // Normals that spread this close to a right angle from the axis push
+    // the apex out towards infinity, and hardly ever cull anyway.
+    constexpr float minConeDot = 0.1f;
+
+    glm::vec3 PositionOf(Vertex const& vertex)
+    {
+        return {vertex.x, vertex.y, vertex.z};
+    }
+
+    // Geometric normal, following the counter-clockwise winding GL treats
+    // as front facing; zero for a degenerate triangle.
+    glm::vec3 TriangleNormal(
+        uint32_t const* triangle, std::span<Vertex const> vertices)
+    {
+        glm::vec3 a = PositionOf(vertices[triangle[0]]);
+        glm::vec3 b = PositionOf(vertices[triangle[1]]);
+        glm::vec3 c = PositionOf(vertices[triangle[2]]);
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        return length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    // The triangles touching each position, as compressed rows: those of
+    // position p are triangles[offsets[p]] up to triangles[offsets[p + 1]].
+    struct Adjacency {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+    };
+
+    void BuildAdjacency(std::span<uint32_t const> indices,
+        std::span<uint32_t const> positionOf, size_t numPositions,
+        Adjacency& adjacency)
+    {
+        adjacency.offsets.assign(numPositions + 1, 0);
+        for (uint32_t index : indices) {
+            adjacency.offsets[positionOf[index] + 1]++;
+        }
+        for (size_t p = 0; p < numPositions; p++) {
+            adjacency.offsets[p + 1] += adjacency.offsets[p];
+        }
+        adjacency.triangles.resize(indices.size());
+        std::vector<uint32_t> cursors(
+            adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            adjacency.triangles[cursors[positionOf[indices[i]]]++]
+                = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    // Grows meshlets over the triangles of one shape range and returns the
+    // range's indices in meshlet order, with the triangle count of each
+    // meshlet appended to sizes.
+    class MeshletGrower {
+    public:
+        MeshletGrower(std::span<Vertex const> vertices,
+            std::span<uint32_t const> positionOf, MeshletOptions options)
+            : m_vertices(vertices)
+            , m_positionOf(positionOf)
+            , m_options(options)
+            , m_vertexStamp(vertices.size(), unstamped)
+        {
+        }
+
+        std::vector<uint32_t> Grow(std::span<uint32_t const> indices,
+            size_t numPositions, std::vector<uint32_t>& sizes)
+        {
+            size_t numTriangles = indices.size() / 3;
+            m_indices = indices;
+            BuildAdjacency(indices, m_positionOf, numPositions, m_adjacency);
+            m_normals.resize(numTriangles);
+            for (size_t t = 0; t < numTriangles; t++) {
+                m_normals[t] = TriangleNormal(&indices[3 * t], m_vertices);
+            }
+            m_emitted.assign(numTriangles, 0);
+            m_candidateStamp.assign(numTriangles, unstamped);
+            m_live.resize(numPositions);
+            for (size_t p = 0; p < numPositions; p++) {
+                m_live[p] = m_adjacency.offsets[p + 1] - m_adjacency.offsets[p];
+            }
+
+            std::vector<uint32_t> output;
+            output.reserve(indices.size());
+            size_t cursor = 0;
+            uint32_t seed = unstamped;
+            while (true) {
+                // The next meshlet starts next to the last one, or where
+                // the incoming order, which OptimizeMesh() left walking
+                // across the surface, goes on when nothing is left there.
+                if (seed == unstamped) {
+                    while (cursor < numTriangles && m_emitted[cursor]) {
+                        cursor++;
+                    }
+                    if (cursor == numTriangles) {
+                        break;
+                    }
+                    seed = static_cast<uint32_t>(cursor);
+                }
+                size_t first = output.size();
+                seed = GrowOne(seed, output);
+                sizes.push_back(
+                    static_cast<uint32_t>((output.size() - first) / 3));
+            }
+            return output;
+        }
+
+    private:
+        // Returns the seed of the next meshlet: the triangle left next to
+        // this one that has the fewest others around it, so leftovers are
+        // picked up before they end up cut off.
+        uint32_t GrowOne(uint32_t seed, std::vector<uint32_t>& output)
+        {
+            m_stamp++;
+            m_numVertices = 0;
+            m_normalSum = glm::vec3(0.0f);
+            m_candidates.clear();
+            Add(seed, output);
+
+            uint32_t numTriangles = 1;
+            while (numTriangles < m_options.maxTriangles) {
+                float length = glm::length(m_normalSum);
+                glm::vec3 axis
+                    = length > 0.0f ? m_normalSum / length : glm::vec3(0.0f);
+
+                uint32_t best = unstamped;
+                float bestScore = std::numeric_limits<float>::max();
+                for (size_t c = 0; c < m_candidates.size();) {
+                    uint32_t triangle = m_candidates[c];
+                    if (m_emitted[triangle]) {
+                        m_candidates[c] = m_candidates.back();
+                        m_candidates.pop_back();
+                        continue;
+                    }
+                    c++;
+
+                    uint32_t newVertices = 0;
+                    for (int k = 0; k < 3; k++) {
+                        uint32_t vertex = m_indices[3 * triangle + k];
+                        newVertices += m_vertexStamp[vertex] != m_stamp;
+                    }
+                    if (m_numVertices + newVertices > m_options.maxVertices) {
+                        continue;
+                    }
+                    float score = static_cast<float>(newVertices)
+                        + m_options.coneWeight
+                            * (1.0f - glm::dot(m_normals[triangle], axis))
+                        + liveWeight * static_cast<float>(Live(triangle));
+                    if (score < bestScore) {
+                        bestScore = score;
+                        best = triangle;
+                    }
+                }
+                // Nothing left that touches the meshlet or fits in it.
+                if (best == unstamped) {
+                    break;
+                }
+                Add(best, output);
+                numTriangles++;
+            }
+
+            uint32_t next = unstamped;
+            uint32_t nextLive = std::numeric_limits<uint32_t>::max();
+            for (uint32_t triangle : m_candidates) {
+                if (m_emitted[triangle]) {
+                    continue;
+                }
+                uint32_t live = Live(triangle);
+                if (live < nextLive) {
+                    nextLive = live;
+                    next = triangle;
+                }
+            }
+            return next;
+        }
+
+        // Triangles not yet in a meshlet around the corners of triangle.
+        uint32_t Live(uint32_t triangle) const
+        {
+            uint32_t live = 0;
+            for (int k = 0; k < 3; k++) {
+                live += m_live[m_positionOf[m_indices[3 * triangle + k]]];
+            }
+            return live;
+        }
+
+        void Add(uint32_t triangle, std::vector<uint32_t>& output)
+        {
+            m_emitted[triangle] = 1;
+            m_normalSum += m_normals[triangle];
+            for (int k = 0; k < 3; k++) {
+                uint32_t vertex = m_indices[3 * triangle + k];
+                output.push_back(vertex);
+                if (m_vertexStamp[vertex] != m_stamp) {
+                    m_vertexStamp[vertex] = m_stamp;
+                    m_numVertices++;
+                }
+
+                uint32_t position = m_positionOf[vertex];
+                m_live[position]--;
+                for (uint32_t a = m_adjacency.offsets[position];
+                    a < m_adjacency.offsets[position + 1]; a++) {
+                    uint32_t neighbour = m_adjacency.triangles[a];
+                    if (!m_emitted[neighbour]
+                        && m_candidateStamp[neighbour] != m_stamp) {
+                        m_candidateStamp[neighbour] = m_stamp;
+                        m_candidates.push_back(neighbour);
+                    }
+                }
+            }
+        }
+
+        std::span<Vertex const> m_vertices;
+        std::span<uint32_t const> m_positionOf;
+        MeshletOptions m_options;
+        std::span<uint32_t const> m_indices;
+        Adjacency m_adjacency;
+        std::vector<glm::vec3> m_normals;
+        std::vector<uint8_t> m_emitted;
+        std::vector<uint32_t> m_live;
+
+        // Stamps tell which vertices and candidates belong to the meshlet
+        // being grown, so nothing has to be cleared between meshlets.
+        uint32_t m_stamp {};
+        std::vector<uint32_t> m_vertexStamp;
+        std::vector<uint32_t> m_candidateStamp;
+        uint32_t m_numVertices {};
+        glm::vec3 m_normalSum {};
+        std::vector<uint32_t> m_candidates;
+    };
+
+} // namespace
+
+Meshlet ComputeMeshletBounds(
+    std::span<uint32_t const> indices, std::span<Vertex const> vertices)
+{
+    Meshlet meshlet {
+        .firstIndex = 0,
+        .indexCount = static_cast<uint32_t>(indices.size()),
+        .shape = 0,
+        .numVertices = 0,
+        .center = glm::vec3(0.0f),
+        .radius = 0.0f,
+        .coneAxis = glm::vec3(0.0f, 0.0f, 1.0f),
+        .coneCutoff = 1.0f,
+        .coneApex = glm::vec3(0.0f),
+    };
+    if (indices.empty()) {
+        return meshlet;
+    }
+
+    // The sphere around the box of the vertices, shrunk to the furthest
+    // one.
+    std::vector<uint32_t> unique(indices.begin(), indices.end());
+    std::ranges::sort(unique);
+    unique.erase(std::ranges::unique(unique).begin(), unique.end());
+    meshlet.numVertices = static_cast<uint32_t>(unique.size());
+    glm::vec3 min = PositionOf(vertices[unique.front()]);
+    glm::vec3 max = min;
+    for (uint32_t index : unique) {
+        min = glm::min(min, PositionOf(vertices[index]));
+        max = glm::max(max, PositionOf(vertices[index]));
+    }
+    meshlet.center = 0.5f * (min + max);
+    for (uint32_t index : unique) {
+        meshlet.radius = std::max(meshlet.radius,
+            glm::length(PositionOf(vertices[index]) - meshlet.center));
+    }
+
+    // The cone's axis averages the triangle normals and opens as far as
+    // the one furthest from it.
+    size_t numTriangles = indices.size() / 3;
+    std::vector<glm::vec3> normals(numTriangles);
+    glm::vec3 normalSum(0.0f);
+    for (size_t t = 0; t < numTriangles; t++) {
+        normals[t] = TriangleNormal(&indices[3 * t], vertices);
+        normalSum += normals[t];
+    }
+    float sumLength = glm::length(normalSum);
+    if (sumLength <= 0.0f) {
+        return meshlet;
+    }
+    glm::vec3 axis = normalSum / sumLength;
+    float minDot = 1.0f;
+    for (glm::vec3 const& normal : normals) {
+        if (normal != glm::vec3(0.0f)) {
+            minDot = std::min(minDot, glm::dot(normal, axis));
+        }
+    }
+    if (minDot <= minConeDot) {
+        return meshlet;
+    }
+
+    // The apex is moved back along the axis until it lies behind the
+    // plane of every triangle. Any camera looking at it from inside the
+    // cone then sees the back of each of them.
+    float maxT = 0.0f;
+    for (size_t t = 0; t < numTriangles; t++) {
+        if (normals[t] == glm::vec3(0.0f)) {
+            continue;
+        }
+        glm::vec3 corner = PositionOf(vertices[indices[3 * t]]);
+        float offset = glm::dot(meshlet.center - corner, normals[t]);
+        maxT = std::max(maxT, offset / glm::dot(normals[t], axis));
+    }
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    meshlet.coneApex = meshlet.center - axis * maxT;
+    return meshlet;
+}
+
+MeshletStats BuildMeshlets(MeshData& mesh, MeshletOptions options)
+{
+    UMBRELLA_PROFILE_ZONE("Build meshlets");
+    mesh.meshlets.clear();
+
+    // Vertices split along seams share a position, which is what adjacency
+    // follows.
+    VertexWelder positions(mesh.vertices.size());
+    std::vector<uint32_t> positionOf(mesh.vertices.size());
+    for (size_t v = 0; v < mesh.vertices.size(); v++) {
+        Vertex const& vertex = mesh.vertices[v];
+        positionOf[v] = positions.Insert({vertex.x, vertex.y, vertex.z, 0.0f,
+            0.0f, 0.0f, 0.0f, 0.0f});
+    }
+    size_t numPositions = positions.Vertices().size();
+
+    // LOD 0, by shape range; a LOD without shape ranges counts as one.
+    MeshLod lod0 {
+        .firstIndex = 0,
+        .indexCount = static_cast<uint32_t>(mesh.indices.size()),
+        .error = 0.0f,
+        .firstShape = 0,
+        .numShapes = 0,
+    };
+    if (!mesh.lods.empty()) {
+        lod0 = mesh.lods.front();
+    }
+    std::vector<MeshShapeRange> ranges(mesh.shapes.begin() + lod0.firstShape,
+        mesh.shapes.begin() + lod0.firstShape + lod0.numShapes);
+    if (ranges.empty()) {
+        ranges.push_back({
+            .firstIndex = lod0.firstIndex,
+            .indexCount = lod0.indexCount,
+            .material = 0,
+        });
+    }
+
+    MeshletGrower grower(mesh.vertices, positionOf, options);
+    std::vector<uint32_t> sizes;
+    MeshletStats stats;
+    for (uint32_t s = 0; s < ranges.size(); s++) {
+        std::span<uint32_t> indices(mesh.indices.data() + ranges[s].firstIndex,
+            ranges[s].indexCount - ranges[s].indexCount % 3);
+        sizes.clear();
+        std::vector<uint32_t> grown
+            = grower.Grow(indices, numPositions, sizes);
+        std::ranges::copy(grown, indices.begin());
+
+        uint32_t firstIndex = ranges[s].firstIndex;
+        for (uint32_t size : sizes) {
+            Meshlet meshlet = ComputeMeshletBounds(
+                {mesh.indices.data() + firstIndex, 3 * size}, mesh.vertices);
+            meshlet.firstIndex = firstIndex;
+            meshlet.shape = s;
+            mesh.meshlets.push_back(meshlet);
+            firstIndex += 3 * size;
+
+            stats.numTriangles += size;
+            stats.numVertices += meshlet.numVertices;
+            stats.numWithoutCone += meshlet.coneCutoff >= 1.0f;
+        }
+    }
+    stats.numMeshlets = mesh.meshlets.size();
+
+    // Meshlets first use their vertices in a new order.
+    OptimizeVertexFetch(mesh.indices, mesh.vertices);
+    return stats;
+}
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "assets/Mesh.h"
+
+namespace Umbrella::Assets {
+
+struct MeshletOptions {
+    // Limits that also fit a mesh shader's output, should one ever draw
+    // them.
+    uint32_t maxVertices = 64;
+    uint32_t maxTriangles = 124;
+    // How much a triangle facing the way the meshlet already does counts,
+    // against one that adds fewer vertices. Higher weights make tighter
+    // normal cones, which cull more often, from meshlets with more
+    // vertices.
+    float coneWeight = 0.5f;
+};
+
+struct MeshletStats {
+    size_t numMeshlets {};
+    size_t numTriangles {};
+    size_t numVertices {};
+    // Meshlets whose normals spread too far to ever be culled as facing
+    // away.
+    size_t numWithoutCone {};
+
+    double AverageTriangles() const
+    {
+        return numMeshlets == 0 ? 0.0
+                                : static_cast<double>(numTriangles)
+                / static_cast<double>(numMeshlets);
+    }
+    double AverageVertices() const
+    {
+        return numMeshlets == 0 ? 0.0
+                                : static_cast<double>(numVertices)
+                / static_cast<double>(numMeshlets);
+    }
+};
+
+// Bounding sphere and normal cone of a run of triangles.
+Meshlet ComputeMeshletBounds(std::span<uint32_t const> indices,
+    std::span<Vertex const> vertices);
+
+// Splits every shape range of LOD 0 into meshlets and fills mesh.meshlets.
+// Each meshlet grows from a seed across shared edges and corners, taking
+// the triangle that adds the fewest vertices and bends its normal cone
+// least, so meshlets are compact patches facing one way. Triangles are
+// reordered within their shape range so that every meshlet is one
+// contiguous range; coarser LODs are left alone. Adjacency follows
+// positions, so meshlets grow across UV seams and hard edges too. Runs
+// after OptimizeMesh(), whose triangle order seeds the meshlets, and
+// renumbers vertices for fetch again once they are built.
+MeshletStats BuildMeshlets(MeshData& mesh, MeshletOptions options = {});
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,967 @@
+#include "assets/ObjImporter.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <set>
+#include <spanstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+#include "util/Parallel.h"
+#include "util/Profiler.h"
+#include "util/VirtualFileSystem.h"
+
+namespace Umbrella::Assets {
+
+namespace {
+
+    using tinyobj::real_t;
+
+    // Files smaller than this are not worth splitting across threads.
+    constexpr size_t minChunkSize = 256 * 1024;
+
+    // Marks an index component that is absent from the face, e.g. the
+    // texcoord in "1//2".
+    constexpr int noIndex = INT_MIN;
+
+    struct RawIndex {
+        int v, vt, vn;
+    };
+
+    struct FaceRecord {
+        uint32_t numVertices;
+        // Line of the face, relative to the start of its chunk.
+        uint32_t line;
+        // Attribute counts at the face, needed to resolve relative indices.
+        uint32_t numV, numVn, numVt;
+    };
+
+    enum class CommandType : uint8_t { UseMtl, MtlLib, Group, Object, Smooth };
+
+    // A state-changing line. These are rare, so they are replayed serially
+    // once all chunks are parsed.
+    struct Command {
+        CommandType type;
+        size_t numFaces;
+        size_t numIndices;
+        size_t line;
+        std::string_view args;
+    };
+
+    struct ObjChunk {
+        char const* begin {};
+        char const* end {};
+
+        std::vector<real_t> v, vn, vt, vc;
+
+        std::vector<RawIndex> indices;
+        std::vector<FaceRecord> faces;
+        std::vector<Command> commands;
+
+        size_t numLines {};
+        bool unsupported = false;
+    };
+
+    // A run of faces from one chunk that share material, smoothing group and
+    // shape.
+    struct Segment {
+        size_t chunk;
+        size_t faceBegin, faceEnd;
+        size_t indexBegin;
+        int material;
+        unsigned int smoothing;
+        size_t shape;
+    };
+
+    struct SegmentOutput {
+        tinyobj::mesh_t mesh;
+        std::string warn;
+        size_t errorLine = SIZE_MAX;
+        int greatestV = -1, greatestVn = -1, greatestVt = -1;
+    };
+
+    bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+    bool IsDigit(char c)
+    {
+        return static_cast<unsigned int>(c - '0') < 10u;
+    }
+
+    void SkipSpaces(char const*& token, char const* end)
+    {
+        while (token < end && IsSpace(*token)) {
+            token++;
+        }
+    }
+
+    char const* TokenEnd(char const* token, char const* end)
+    {
+        while (token < end && !IsSpace(*token)) {
+            token++;
+        }
+        return token;
+    }
+
+    char const* IndexEnd(char const* token, char const* end)
+    {
+        while (token < end && !IsSpace(*token) && *token != '/') {
+            token++;
+        }
+        return token;
+    }
+
+    // Bounded equivalent of atoi(), which must not run into the next line.
+    int ParseInt(char const* token, char const* end)
+    {
+        while (token < end
+            && (IsSpace(*token) || *token == '\v' || *token == '\f')) {
+            token++;
+        }
+
+        bool negative = false;
+        if (token < end && (*token == '+' || *token == '-')) {
+            negative = *token == '-';
+            token++;
+        }
+
+        int64_t value = 0;
+        while (token < end && IsDigit(*token)) {
+            value = value * 10 + (*token - '0');
+            token++;
+        }
+
+        return static_cast<int>(negative ? -value : value);
+    }
+
+    // Same algorithm as tinyobj's tryParseDouble(), so that every float comes
+    // out bit-identical to tinyobj::LoadObj.
+    bool TryParseDouble(char const* s, char const* sEnd, double* result)
+    {
+        if (s >= sEnd) {
+            return false;
+        }
+
+        double mantissa = 0.0;
+        int exponent = 0;
+
+        char sign = '+';
+        char expSign = '+';
+        char const* curr = s;
+
+        int read = 0;
+        bool endNotReached = false;
+        bool leadingDecimalDots = false;
+
+        if (*curr == '+' || *curr == '-') {
+            sign = *curr;
+            curr++;
+            if ((curr != sEnd) && (*curr == '.')) {
+                leadingDecimalDots = true;
+            }
+        } else if (IsDigit(*curr)) {
+        } else if (*curr == '.') {
+            leadingDecimalDots = true;
+        } else {
+            return false;
+        }
+
+        endNotReached = (curr != sEnd);
+        if (!leadingDecimalDots) {
+            while (endNotReached && IsDigit(*curr)) {
+                mantissa *= 10;
+                mantissa += static_cast<int>(*curr - 0x30);
+                curr++;
+                read++;
+                endNotReached = (curr != sEnd);
+            }
+
+            if (read == 0) {
+                return false;
+            }
+        }
+
+        if (endNotReached) {
+            if (*curr == '.') {
+                curr++;
+                read = 1;
+                endNotReached = (curr != sEnd);
+                while (endNotReached && IsDigit(*curr)) {
+                    static constexpr double powLut[] = {
+                        1.0,
+                        0.1,
+                        0.01,
+                        0.001,
+                        0.0001,
+                        0.00001,
+                        0.000001,
+                        0.0000001,
+                    };
+                    constexpr int lutEntries = sizeof powLut / sizeof powLut[0];
+
+                    mantissa += static_cast<int>(*curr - 0x30)
+                        * (read < lutEntries ? powLut[read]
+                                             : std::pow(10.0, -read));
+                    read++;
+                    curr++;
+                    endNotReached = (curr != sEnd);
+                }
+            }
+
+            if (endNotReached && (*curr == 'e' || *curr == 'E')) {
+                curr++;
+                endNotReached = (curr != sEnd);
+                if (endNotReached && (*curr == '+' || *curr == '-')) {
+                    expSign = *curr;
+                    curr++;
+                } else if (endNotReached && IsDigit(*curr)) {
+                } else {
+                    return false;
+                }
+
+                read = 0;
+                endNotReached = (curr != sEnd);
+                while (endNotReached && IsDigit(*curr)) {
+                    if (exponent > (INT_MAX / 10)) {
+                        return false;
+                    }
+                    exponent *= 10;
+                    exponent += static_cast<int>(*curr - 0x30);
+                    curr++;
+                    read++;
+                    endNotReached = (curr != sEnd);
+                }
+                exponent *= (expSign == '+' ? 1 : -1);
+                if (read == 0) {
+                    return false;
+                }
+            }
+        }
+
+        *result = (sign == '+' ? 1 : -1)
+            * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent),
+                              exponent)
+                        : mantissa);
+        return true;
+    }
+
+    real_t ParseReal(char const*& token, char const* end, double defaultValue)
+    {
+        SkipSpaces(token, end);
+        char const* tokenEnd = TokenEnd(token, end);
+        double value = defaultValue;
+        TryParseDouble(token, tokenEnd, &value);
+        token = tokenEnd;
+        return static_cast<real_t>(value);
+    }
+
+    bool ParseReal(char const*& token, char const* end, real_t& out)
+    {
+        SkipSpaces(token, end);
+        char const* tokenEnd = TokenEnd(token, end);
+        double value;
+        bool parsed = TryParseDouble(token, tokenEnd, &value);
+        if (parsed) {
+            out = static_cast<real_t>(value);
+        }
+        token = tokenEnd;
+        return parsed;
+    }
+
+    RawIndex ParseRawIndex(char const*& token, char const* end)
+    {
+        RawIndex index {.v = noIndex, .vt = noIndex, .vn = noIndex};
+
+        index.v = ParseInt(token, end);
+        token = IndexEnd(token, end);
+        if (token == end || *token != '/') {
+            return index;
+        }
+        token++;
+
+        if (token < end && *token == '/') {
+            token++;
+            index.vn = ParseInt(token, end);
+            token = IndexEnd(token, end);
+            return index;
+        }
+
+        index.vt = ParseInt(token, end);
+        token = IndexEnd(token, end);
+        if (token == end || *token != '/') {
+            return index;
+        }
+        token++;
+
+        index.vn = ParseInt(token, end);
+        token = IndexEnd(token, end);
+        return index;
+    }
+
+    bool StartsWith(char const* token, char const* end, std::string_view word)
+    {
+        return static_cast<size_t>(end - token) >= word.size()
+            && std::memcmp(token, word.data(), word.size()) == 0;
+    }
+
+    void ParseLine(ObjChunk& chunk, char const* token, char const* end)
+    {
+        SkipSpaces(token, end);
+        if (token == end || token[0] == '#') {
+            return;
+        }
+
+        auto charAt = [&](size_t i) -> char {
+            return token + i < end ? token[i] : '\0';
+        };
+
+        // vertex
+        if (token[0] == 'v' && IsSpace(charAt(1))) {
+            token += 2;
+            chunk.v.push_back(ParseReal(token, end, 0.0));
+            chunk.v.push_back(ParseReal(token, end, 0.0));
+            chunk.v.push_back(ParseReal(token, end, 0.0));
+
+            real_t r, g, b;
+            bool foundColor = ParseReal(token, end, r)
+                && ParseReal(token, end, g) && ParseReal(token, end, b);
+            if (!foundColor) {
+                // tinyobj::LoadObj falls back to white vertex colors.
+                r = g = b = 1.0f;
+            }
+            chunk.vc.push_back(r);
+            chunk.vc.push_back(g);
+            chunk.vc.push_back(b);
+            return;
+        }
+
+        // normal
+        if (token[0] == 'v' && charAt(1) == 'n' && IsSpace(charAt(2))) {
+            token += 3;
+            chunk.vn.push_back(ParseReal(token, end, 0.0));
+            chunk.vn.push_back(ParseReal(token, end, 0.0));
+            chunk.vn.push_back(ParseReal(token, end, 0.0));
+            return;
+        }
+
+        // texcoord
+        if (token[0] == 'v' && charAt(1) == 't' && IsSpace(charAt(2))) {
+            token += 3;
+            chunk.vt.push_back(ParseReal(token, end, 0.0));
+            chunk.vt.push_back(ParseReal(token, end, 0.0));
+            return;
+        }
+
+        // Skin weights, lines, points and tags are rare enough that they are
+        // left to tinyobj.
+        if ((token[0] == 'v' && charAt(1) == 'w' && IsSpace(charAt(2)))
+            || ((token[0] == 'l' || token[0] == 'p' || token[0] == 't')
+                && IsSpace(charAt(1)))) {
+            chunk.unsupported = true;
+            return;
+        }
+
+        // face
+        if (token[0] == 'f' && IsSpace(charAt(1))) {
+            token += 2;
+            SkipSpaces(token, end);
+
+            size_t firstIndex = chunk.indices.size();
+            while (token < end) {
+                chunk.indices.push_back(ParseRawIndex(token, end));
+                SkipSpaces(token, end);
+            }
+
+            size_t numVertices = chunk.indices.size() - firstIndex;
+            if (numVertices > 4) {
+                chunk.unsupported = true;
+                return;
+            }
+
+            chunk.faces.push_back({
+                .numVertices = static_cast<uint32_t>(numVertices),
+                .line = static_cast<uint32_t>(chunk.numLines),
+                .numV = static_cast<uint32_t>(chunk.v.size() / 3),
+                .numVn = static_cast<uint32_t>(chunk.vn.size() / 3),
+                .numVt = static_cast<uint32_t>(chunk.vt.size() / 2),
+            });
+            return;
+        }
+
+        auto pushCommand = [&](CommandType type, char const* args) {
+            chunk.commands.push_back({
+                .type = type,
+                .numFaces = chunk.faces.size(),
+                .numIndices = chunk.indices.size(),
+                .line = chunk.numLines,
+                .args = std::string_view(args, end - args),
+            });
+        };
+
+        if (StartsWith(token, end, "usemtl")) {
+            pushCommand(CommandType::UseMtl, token + 6);
+        } else if (StartsWith(token, end, "mtllib") && IsSpace(charAt(6))) {
+            pushCommand(CommandType::MtlLib, token + 7);
+        } else if (token[0] == 'g' && IsSpace(charAt(1))) {
+            pushCommand(CommandType::Group, token);
+        } else if (token[0] == 'o' && IsSpace(charAt(1))) {
+            pushCommand(CommandType::Object, token + 2);
+        } else if (token[0] == 's' && IsSpace(charAt(1))) {
+            pushCommand(CommandType::Smooth, token + 2);
+        }
+    }
+
+    void ParseChunk(ObjChunk& chunk)
+    {
+        // Lines end in "\n", "\r\n" or a lone "\r", like tinyobj's
+        // safeGetline().
+        char const* lineBegin = chunk.begin;
+        while (lineBegin < chunk.end) {
+            char const* lineEnd = lineBegin;
+            while (lineEnd < chunk.end && *lineEnd != '\n'
+                && *lineEnd != '\r') {
+                lineEnd++;
+            }
+
+            chunk.numLines++;
+            ParseLine(chunk, lineBegin, lineEnd);
+            if (chunk.unsupported) {
+                return;
+            }
+
+            lineBegin = lineEnd + 1;
+            if (lineEnd < chunk.end && *lineEnd == '\r'
+                && lineBegin < chunk.end && *lineBegin == '\n') {
+                lineBegin++;
+            }
+        }
+    }
+
+    // Mirrors tinyobj's fixIndex().
+    bool FixIndex(int idx, size_t count, bool allowZero, int& out,
+        bool& zeroFound)
+    {
+        if (idx == noIndex) {
+            out = -1;
+            return true;
+        }
+        if (idx > 0) {
+            out = idx - 1;
+            return true;
+        }
+        if (idx == 0) {
+            zeroFound = true;
+            out = -1;
+            return allowZero;
+        }
+
+        out = static_cast<int>(count) + idx;
+        return out >= 0;
+    }
+
+    void ExportSegment(Segment const& segment, ObjChunk const& chunk,
+        size_t vBase, size_t vnBase, size_t vtBase, size_t lineBase,
+        std::vector<real_t> const& v, SegmentOutput& output)
+    {
+        tinyobj::mesh_t& mesh = output.mesh;
+        size_t numFaces = segment.faceEnd - segment.faceBegin;
+        mesh.indices.reserve(3 * numFaces);
+        mesh.num_face_vertices.reserve(numFaces);
+        mesh.material_ids.reserve(numFaces);
+        mesh.smoothing_group_ids.reserve(numFaces);
+
+        auto pushTriangle = [&](tinyobj::index_t const& a,
+                                tinyobj::index_t const& b,
+                                tinyobj::index_t const& c) {
+            mesh.indices.push_back(a);
+            mesh.indices.push_back(b);
+            mesh.indices.push_back(c);
+            mesh.num_face_vertices.push_back(3);
+            mesh.material_ids.push_back(segment.material);
+            mesh.smoothing_group_ids.push_back(segment.smoothing);
+        };
+
+        size_t rawIndex = segment.indexBegin;
+        for (size_t f = segment.faceBegin; f < segment.faceEnd; f++) {
+            FaceRecord const& face = chunk.faces[f];
+            size_t globalLine = lineBase + face.line;
+
+            tinyobj::index_t idx[4];
+            for (uint32_t k = 0; k < face.numVertices; k++) {
+                RawIndex const& raw = chunk.indices[rawIndex + k];
+                bool zeroFound = false;
+                bool valid
+                    = FixIndex(raw.v, vBase + face.numV, false,
+                          idx[k].vertex_index, zeroFound)
+                    && FixIndex(raw.vt, vtBase + face.numVt, true,
+                        idx[k].texcoord_index, zeroFound)
+                    && FixIndex(raw.vn, vnBase + face.numVn, true,
+                        idx[k].normal_index, zeroFound);
+                if (zeroFound) {
+                    output.warn += "A zero value index found (will have a "
+                                   "value of -1 for normal and tex indices. "
+                                   "Line "
+                        + std::to_string(globalLine) + ").\n";
+                }
+                if (!valid) {
+                    output.errorLine = globalLine;
+                    return;
+                }
+
+                output.greatestV
+                    = std::max(output.greatestV, idx[k].vertex_index);
+                output.greatestVn
+                    = std::max(output.greatestVn, idx[k].normal_index);
+                output.greatestVt
+                    = std::max(output.greatestVt, idx[k].texcoord_index);
+            }
+            rawIndex += face.numVertices;
+
+            if (face.numVertices < 3) {
+                output.warn += "Degenerated face found\n.";
+                continue;
+            }
+
+            if (face.numVertices == 3) {
+                pushTriangle(idx[0], idx[1], idx[2]);
+                continue;
+            }
+
+            size_t vi0 = static_cast<size_t>(idx[0].vertex_index);
+            size_t vi1 = static_cast<size_t>(idx[1].vertex_index);
+            size_t vi2 = static_cast<size_t>(idx[2].vertex_index);
+            size_t vi3 = static_cast<size_t>(idx[3].vertex_index);
+            if ((3 * vi0 + 2) >= v.size() || (3 * vi1 + 2) >= v.size()
+                || (3 * vi2 + 2) >= v.size() || (3 * vi3 + 2) >= v.size()) {
+                output.warn += "Face with invalid vertex index found.\n";
+                continue;
+            }
+
+            // Split the quad along its shorter diagonal, exactly like tinyobj.
+            real_t e02x = v[vi2 * 3 + 0] - v[vi0 * 3 + 0];
+            real_t e02y = v[vi2 * 3 + 1] - v[vi0 * 3 + 1];
+            real_t e02z = v[vi2 * 3 + 2] - v[vi0 * 3 + 2];
+            real_t e13x = v[vi3 * 3 + 0] - v[vi1 * 3 + 0];
+            real_t e13y = v[vi3 * 3 + 1] - v[vi1 * 3 + 1];
+            real_t e13z = v[vi3 * 3 + 2] - v[vi1 * 3 + 2];
+            real_t sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+            real_t sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+            if (sqr02 < sqr13) {
+                pushTriangle(idx[0], idx[1], idx[2]);
+                pushTriangle(idx[0], idx[2], idx[3]);
+            } else {
+                pushTriangle(idx[0], idx[1], idx[3]);
+                pushTriangle(idx[1], idx[2], idx[3]);
+            }
+        }
+    }
+
+    void SplitString(std::string_view s, char delim, char escape,
+        std::vector<std::string>& elems)
+    {
+        std::string token;
+        bool escaping = false;
+        for (char ch : s) {
+            if (escaping) {
+                escaping = false;
+            } else if (ch == escape) {
+                escaping = true;
+                continue;
+            } else if (ch == delim) {
+                if (!token.empty()) {
+                    elems.push_back(token);
+                }
+                token.clear();
+                continue;
+            }
+            token += ch;
+        }
+        elems.push_back(token);
+    }
+
+    std::string ParseString(char const*& token, char const* end)
+    {
+        SkipSpaces(token, end);
+        char const* tokenEnd = TokenEnd(token, end);
+        std::string s(token, tokenEnd);
+        token = tokenEnd;
+        return s;
+    }
+
+    // Base directory for .mtl files, with the trailing separator tinyobj
+    // expects.
+    std::string MaterialBaseDir(char const* mtlBaseDir)
+    {
+        std::string baseDir = mtlBaseDir ? mtlBaseDir : "";
+        if (!baseDir.empty()) {
+#ifndef _WIN32
+            constexpr char dirSep = '/';
+#else
+            constexpr char dirSep = '\\';
+#endif
+            if (baseDir.back() != dirSep) {
+                baseDir += dirSep;
+            }
+        }
+        return baseDir;
+    }
+
+    // Loads .mtl files like tinyobj, but through the file system, and
+    // remembers which ones were read.
+    class RecordingMaterialReader : public tinyobj::MaterialReader {
+    public:
+        RecordingMaterialReader(
+            std::string const& baseDir, std::vector<std::string>& loadedPaths)
+            : m_baseDir(baseDir)
+            , m_loadedPaths(loadedPaths)
+        {
+        }
+
+        bool operator()(std::string const& matId,
+            std::vector<tinyobj::material_t>* materials,
+            std::map<std::string, int>* matMap, std::string* warn,
+            std::string* err) override
+        {
+            std::string path = m_baseDir + matId;
+            std::optional<Util::AssetFile> file
+                = Util::VirtualFileSystem::Instance().Open(path);
+            if (!file) {
+                if (warn) {
+                    *warn += "Material file [ " + matId
+                        + " ] not found in a path : " + m_baseDir + "\n";
+                }
+                return false;
+            }
+
+            std::ispanstream stream(std::span(file->Data(), file->Size()));
+            tinyobj::LoadMtl(matMap, materials, &stream, warn, err);
+            m_loadedPaths.push_back(path);
+            return true;
+        }
+
+    private:
+        std::string m_baseDir;
+        std::vector<std::string>& m_loadedPaths;
+    };
+
+    std::optional<ObjData> ImportObjFallback(
+        Util::AssetFile const& file, char const* mtlBaseDir)
+    {
+        std::ispanstream objStream(std::span(file.Data(), file.Size()));
+
+        ObjData data;
+        data.materialBaseDir = MaterialBaseDir(mtlBaseDir);
+        RecordingMaterialReader readMaterial(
+            data.materialBaseDir, data.materialLibraries);
+        std::string warn, err;
+        bool loaded = tinyobj::LoadObj(&data.attrib, &data.shapes,
+            &data.materials, &warn, &err, &objStream, &readMaterial);
+        if (!err.empty()) {
+            spdlog::error("ObjImporter error: {}", err);
+        }
+        if (!warn.empty()) {
+            spdlog::warn("ObjImporter warning: {}", warn);
+        }
+        if (!loaded) {
+            return {};
+        }
+        return data;
+    }
+
+} // namespace
+
+std::optional<ObjData> ImportObj(char const* objPath, char const* mtlBaseDir)
+{
+    UMBRELLA_PROFILE_ZONE("Import OBJ");
+    std::optional<Util::AssetFile> file
+        = Util::VirtualFileSystem::Instance().Open(objPath);
+    if (!file) {
+        spdlog::error("ObjImporter error: Cannot open file [{}]", objPath);
+        return {};
+    }
+
+    // Split the file into chunks that start right after a newline.
+    char const* fileBegin = file->Data();
+    char const* fileEnd = fileBegin + file->Size();
+    size_t numChunks = std::clamp<size_t>(
+        file->Size() / minChunkSize, 1, 4 * Util::WorkerCount());
+
+    std::vector<ObjChunk> chunks(numChunks);
+    char const* chunkBegin = fileBegin;
+    for (size_t c = 0; c < numChunks; c++) {
+        char const* chunkEnd = fileEnd;
+        if (c + 1 < numChunks) {
+            chunkEnd = std::max(
+                chunkBegin, fileBegin + file->Size() * (c + 1) / numChunks);
+            chunkEnd = std::find(chunkEnd, fileEnd, '\n');
+            chunkEnd = chunkEnd == fileEnd ? fileEnd : chunkEnd + 1;
+        }
+        chunks[c].begin = chunkBegin;
+        chunks[c].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    Util::ParallelFor(numChunks, [&](size_t c) { ParseChunk(chunks[c]); });
+
+    for (ObjChunk const& chunk : chunks) {
+        if (chunk.unsupported) {
+            spdlog::info("ObjImporter: {} needs the tinyobj fallback", objPath);
+            return ImportObjFallback(*file, mtlBaseDir);
+        }
+    }
+
+    // Prefix sums place every chunk inside the merged attribute arrays.
+    std::vector<size_t> vBase(numChunks), vnBase(numChunks),
+        vtBase(numChunks), lineBase(numChunks);
+    size_t numV = 0, numVn = 0, numVt = 0, numLines = 0;
+    for (size_t c = 0; c < numChunks; c++) {
+        vBase[c] = numV;
+        vnBase[c] = numVn;
+        vtBase[c] = numVt;
+        lineBase[c] = numLines;
+        numV += chunks[c].v.size() / 3;
+        numVn += chunks[c].vn.size() / 3;
+        numVt += chunks[c].vt.size() / 2;
+        numLines += chunks[c].numLines;
+    }
+
+    ObjData data;
+    tinyobj::attrib_t& attrib = data.attrib;
+    attrib.vertices.resize(3 * numV);
+    attrib.normals.resize(3 * numVn);
+    attrib.texcoords.resize(2 * numVt);
+    attrib.colors.resize(3 * numV);
+    Util::ParallelFor(numChunks, [&](size_t c) {
+        std::ranges::copy(chunks[c].v, attrib.vertices.begin() + 3 * vBase[c]);
+        std::ranges::copy(chunks[c].vn, attrib.normals.begin() + 3 * vnBase[c]);
+        std::ranges::copy(
+            chunks[c].vt, attrib.texcoords.begin() + 2 * vtBase[c]);
+        std::ranges::copy(chunks[c].vc, attrib.colors.begin() + 3 * vBase[c]);
+    });
+
+    // Replay the state-changing commands to assign every run of faces its
+    // shape, material and smoothing group.
+    std::string warn;
+    std::vector<Segment> segments;
+    std::vector<std::string> shapeNames(1);
+    std::string name;
+    int material = -1;
+    unsigned int smoothing = 0;
+    size_t facesSinceExport = 0;
+
+    data.materialBaseDir = MaterialBaseDir(mtlBaseDir);
+    RecordingMaterialReader readMaterial(
+        data.materialBaseDir, data.materialLibraries);
+    std::set<std::string> materialFilenames;
+    std::map<std::string, int> materialMap;
+
+    for (size_t c = 0; c < numChunks; c++) {
+        ObjChunk const& chunk = chunks[c];
+        size_t face = 0;
+        size_t index = 0;
+
+        auto emitFaces = [&](size_t faceEnd, size_t indexEnd) {
+            if (faceEnd > face) {
+                segments.push_back({
+                    .chunk = c,
+                    .faceBegin = face,
+                    .faceEnd = faceEnd,
+                    .indexBegin = index,
+                    .material = material,
+                    .smoothing = smoothing,
+                    .shape = shapeNames.size() - 1,
+                });
+                facesSinceExport += faceEnd - face;
+            }
+            face = faceEnd;
+            index = indexEnd;
+        };
+
+        for (Command const& command : chunk.commands) {
+            emitFaces(command.numFaces, command.numIndices);
+
+            char const* token = command.args.data();
+            char const* end = token + command.args.size();
+            size_t line = lineBase[c] + command.line;
+
+            switch (command.type) {
+            case CommandType::UseMtl: {
+                std::string materialName = ParseString(token, end);
+                int newMaterial = -1;
+                auto it = materialMap.find(materialName);
+                if (it != materialMap.end()) {
+                    newMaterial = it->second;
+                } else {
+                    warn += "material [ '" + materialName
+                        + "' ] not found in .mtl\n";
+                }
+                if (newMaterial != material) {
+                    facesSinceExport = 0;
+                    material = newMaterial;
+                }
+                break;
+            }
+            case CommandType::MtlLib: {
+                std::vector<std::string> filenames;
+                SplitString(command.args, ' ', '\\', filenames);
+                if (filenames.empty()) {
+                    warn += "Looks like empty filename for mtllib. Use "
+                            "default material (line "
+                        + std::to_string(line) + ".)\n";
+                    break;
+                }
+
+                bool found = false;
+                for (std::string const& filename : filenames) {
+                    if (materialFilenames.contains(filename)) {
+                        found = true;
+                        continue;
+                    }
+
+                    std::string mtlWarn, mtlErr;
+                    bool loaded = readMaterial(filename, &data.materials,
+                        &materialMap, &mtlWarn, &mtlErr);
+                    warn += mtlWarn;
+                    if (!mtlErr.empty()) {
+                        spdlog::error("ObjImporter error: {}", mtlErr);
+                    }
+                    if (loaded) {
+                        found = true;
+                        materialFilenames.insert(filename);
+                        break;
+                    }
+                }
+                if (!found) {
+                    warn += "Failed to load material file(s). Use default "
+                            "material.\n";
+                }
+                break;
+            }
+            case CommandType::Group: {
+                std::vector<std::string> names;
+                while (token < end) {
+                    names.push_back(ParseString(token, end));
+                    SkipSpaces(token, end);
+                }
+
+                // names[0] is the 'g' itself.
+                if (names.size() < 2) {
+                    warn += "Empty group name. line: " + std::to_string(line)
+                        + "\n";
+                    name = "";
+                } else {
+                    name = names[1];
+                    for (size_t i = 2; i < names.size(); i++) {
+                        name += " " + names[i];
+                    }
+                }
+                facesSinceExport = 0;
+                shapeNames.push_back(name);
+                break;
+            }
+            case CommandType::Object:
+                name = std::string(command.args);
+                facesSinceExport = 0;
+                shapeNames.push_back(name);
+                break;
+            case CommandType::Smooth: {
+                SkipSpaces(token, end);
+                if (token == end) {
+                    break;
+                }
+                if (StartsWith(token, end, "off")) {
+                    smoothing = 0;
+                } else {
+                    int smoothingId = ParseInt(token, end);
+                    smoothing = smoothingId < 0
+                        ? 0
+                        : static_cast<unsigned int>(smoothingId);
+                }
+                break;
+            }
+            }
+        }
+        emitFaces(chunk.faces.size(), chunk.indices.size());
+    }
+
+    // Triangulate every run of faces in parallel.
+    std::vector<SegmentOutput> outputs(segments.size());
+    Util::ParallelFor(segments.size(), [&](size_t s) {
+        size_t c = segments[s].chunk;
+        ExportSegment(segments[s], chunks[c], vBase[c], vnBase[c], vtBase[c],
+            lineBase[c], attrib.vertices, outputs[s]);
+    });
+
+    int greatestV = -1, greatestVn = -1, greatestVt = -1;
+    for (SegmentOutput const& output : outputs) {
+        warn += output.warn;
+        if (output.errorLine != SIZE_MAX) {
+            spdlog::error("ObjImporter error: Failed to parse `f' line (e.g. "
+                          "a zero value for vertex index or invalid relative "
+                          "vertex index). Line {}).",
+                output.errorLine);
+            return {};
+        }
+        greatestV = std::max(greatestV, output.greatestV);
+        greatestVn = std::max(greatestVn, output.greatestVn);
+        greatestVt = std::max(greatestVt, output.greatestVt);
+    }
+
+    if (std::cmp_greater_equal(greatestV, numV)) {
+        warn += "Vertex indices out of bounds (line " + std::to_string(numLines)
+            + ".)\n\n";
+    }
+    if (std::cmp_greater_equal(greatestVn, numVn)) {
+        warn += "Vertex normal indices out of bounds (line "
+            + std::to_string(numLines) + ".)\n\n";
+    }
+    if (std::cmp_greater_equal(greatestVt, numVt)) {
+        warn += "Vertex texcoord indices out of bounds (line "
+            + std::to_string(numLines) + ".)\n\n";
+    }
+
+    // Gather the triangulated runs into shapes. tinyobj keeps a shape when it
+    // has indices, and also keeps the last one when faces followed the last
+    // flush, even if they were all degenerate.
+    std::vector<tinyobj::shape_t> shapes(shapeNames.size());
+    for (size_t s = 0; s < segments.size(); s++) {
+        tinyobj::mesh_t& dst = shapes[segments[s].shape].mesh;
+        tinyobj::mesh_t& src = outputs[s].mesh;
+        if (dst.indices.empty()) {
+            dst = std::move(src);
+            continue;
+        }
+        dst.indices.insert(dst.indices.end(), src.indices.begin(),
+            src.indices.end());
+        dst.num_face_vertices.insert(dst.num_face_vertices.end(),
+            src.num_face_vertices.begin(), src.num_face_vertices.end());
+        dst.material_ids.insert(dst.material_ids.end(),
+            src.material_ids.begin(), src.material_ids.end());
+        dst.smoothing_group_ids.insert(dst.smoothing_group_ids.end(),
+            src.smoothing_group_ids.begin(), src.smoothing_group_ids.end());
+    }
+
+    for (size_t s = 0; s < shapes.size(); s++) {
+        bool isLast = s + 1 == shapes.size();
+        if (!shapes[s].mesh.indices.empty()
+            || (isLast && facesSinceExport > 0)) {
+            shapes[s].name = shapeNames[s];
+            data.shapes.push_back(std::move(shapes[s]));
+        }
+    }
+
+    if (!warn.empty()) {
+        spdlog::warn("ObjImporter warning: {}", warn);
+    }
+
+    return data;
+}
+
+} // namespace Umbrella::Assets
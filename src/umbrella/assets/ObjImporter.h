@@ -0,0 +1,31 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+namespace Umbrella::Assets {
+
+struct ObjData {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+
+    // Paths of the .mtl files that were read while loading.
+    std::vector<std::string> materialLibraries;
+    // What the .mtl files and the textures they name are relative to, with
+    // a trailing separator unless it is empty.
+    std::string materialBaseDir;
+};
+
+// Loads an OBJ asset, and the .mtl files it names, through the
+// VirtualFileSystem, parsing line-aligned chunks of it on all cores. The
+// result is identical to tinyobj::LoadObj with triangulation enabled; files
+// using features the fast path does not handle (lines, points, tags, skin
+// weights or polygons with more than four vertices) are handed to
+// tinyobj::LoadObj instead.
+std::optional<ObjData> ImportObj(char const* objPath, char const* mtlBaseDir);
+
+} // namespace Umbrella::Assets
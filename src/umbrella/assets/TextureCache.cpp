@@ -0,0 +1,260 @@
+#include "assets/TextureCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "assets/TextureCompressor.h"
+#include "util/Hash.h"
+#include "util/MappedFile.h"
+#include "util/Profiler.h"
+#include "util/VirtualFileSystem.h"
+
+namespace Umbrella::Assets {
+
+namespace {
+
+    constexpr char utexMagic[4] = {'U', 'T', 'E', 'X'};
+    constexpr uint32_t utexVersion = 1;
+    constexpr size_t utexAlignment = 16;
+
+    // On-disk layout: header, level table, then the blocks of every level,
+    // each starting on a 16-byte boundary. The size and write time of the
+    // source let an unchanged image be recognised without hashing it.
+    struct UTexHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t fileSize;
+        uint64_t sourceHash;
+        uint64_t sourceSize;
+        int64_t sourceWriteTime;
+
+        uint32_t format;
+        uint32_t numLevels;
+        uint64_t levelOffset;
+    };
+
+    struct UTexLevel {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    uint64_t AlignUp(uint64_t offset)
+    {
+        return (offset + utexAlignment - 1) & ~uint64_t(utexAlignment - 1);
+    }
+
+    char const* FormatName(TextureFormat format)
+    {
+        switch (format) {
+        case TextureFormat::Rgba8:
+            return "rgba8";
+        case TextureFormat::Bc1:
+            return "bc1";
+        case TextureFormat::Bc3:
+            return "bc3";
+        case TextureFormat::Bc7:
+            return "bc7";
+        }
+        return "unknown";
+    }
+
+    struct SourceStamp {
+        uint64_t size;
+        int64_t writeTime;
+    };
+
+    std::optional<SourceStamp> StampSource(char const* path)
+    {
+        std::optional<Util::AssetStamp> stamp
+            = Util::VirtualFileSystem::Instance().Stat(path);
+        if (!stamp) {
+            return {};
+        }
+        return SourceStamp {
+            .size = stamp->size,
+            .writeTime = stamp->writeTime,
+        };
+    }
+
+    std::optional<uint64_t> HashSource(char const* path)
+    {
+        std::optional<Util::AssetFile> file
+            = Util::VirtualFileSystem::Instance().Open(path);
+        if (!file) {
+            return {};
+        }
+        return Util::HashBytes(file->Data(), file->Size());
+    }
+
+} // namespace
+
+std::string TextureCachePath(char const* imagePath, TextureFormat format)
+{
+    std::filesystem::path path = std::filesystem::path("cache") / imagePath;
+    path.replace_extension(std::string(".") + FormatName(format) + ".utex");
+    return path.generic_string();
+}
+
+std::optional<Image> OpenTextureCache(
+    char const* imagePath, TextureFormat format)
+{
+    UMBRELLA_PROFILE_ZONE("Open texture cache");
+    std::string cachePath = TextureCachePath(imagePath, format);
+    std::optional<Util::MappedFile> file
+        = Util::MappedFile::Open(cachePath.c_str());
+    if (!file) {
+        return {};
+    }
+
+    UTexHeader header;
+    if (file->Size() < sizeof(header)) {
+        spdlog::warn("Texture cache {} is corrupt, rebuilding", cachePath);
+        return {};
+    }
+    std::memcpy(&header, file->Data(), sizeof(header));
+    if (std::memcmp(header.magic, utexMagic, sizeof(utexMagic)) != 0
+        || header.version != utexVersion || header.fileSize != file->Size()
+        || header.format != static_cast<uint32_t>(format)
+        || header.levelOffset % utexAlignment != 0
+        || header.levelOffset > header.fileSize
+        || header.numLevels
+            > (header.fileSize - header.levelOffset) / sizeof(UTexLevel)) {
+        spdlog::warn("Texture cache {} is corrupt or outdated, rebuilding",
+            cachePath);
+        return {};
+    }
+
+    std::optional<SourceStamp> stamp = StampSource(imagePath);
+    if (!stamp) {
+        return {};
+    }
+    if (stamp->size != header.sourceSize
+        || stamp->writeTime != header.sourceWriteTime) {
+        std::optional<uint64_t> sourceHash = HashSource(imagePath);
+        if (!sourceHash || *sourceHash != header.sourceHash) {
+            spdlog::info("Texture cache {} is stale, rebuilding", cachePath);
+            return {};
+        }
+    }
+
+    Image image {.format = format, .levels = {}};
+    std::vector<UTexLevel> levels(header.numLevels);
+    std::memcpy(levels.data(), file->Data() + header.levelOffset,
+        levels.size() * sizeof(UTexLevel));
+    for (UTexLevel const& level : levels) {
+        image.levels.push_back(
+            {.width = level.width, .height = level.height, .pixels = {}});
+        uint32_t l = static_cast<uint32_t>(image.levels.size() - 1);
+        if (level.offset > header.fileSize
+            || level.size > header.fileSize - level.offset
+            || level.size != image.RowBytes(l) * image.NumRows(l)) {
+            spdlog::warn("Texture cache {} is corrupt, rebuilding", cachePath);
+            return {};
+        }
+        char const* data = file->Data() + level.offset;
+        image.levels.back().pixels.assign(data, data + level.size);
+    }
+    return image;
+}
+
+bool WriteTextureCache(char const* imagePath, Image const& image)
+{
+    std::optional<SourceStamp> stamp = StampSource(imagePath);
+    std::optional<uint64_t> sourceHash = HashSource(imagePath);
+    if (!stamp || !sourceHash) {
+        return false;
+    }
+
+    UTexHeader header {};
+    std::memcpy(header.magic, utexMagic, sizeof(utexMagic));
+    header.version = utexVersion;
+    header.sourceHash = *sourceHash;
+    header.sourceSize = stamp->size;
+    header.sourceWriteTime = stamp->writeTime;
+    header.format = static_cast<uint32_t>(image.format);
+    header.numLevels = static_cast<uint32_t>(image.levels.size());
+    header.levelOffset = AlignUp(sizeof(UTexHeader));
+
+    std::vector<UTexLevel> levels;
+    uint64_t offset
+        = AlignUp(header.levelOffset + image.levels.size() * sizeof(UTexLevel));
+    for (ImageLevel const& level : image.levels) {
+        levels.push_back({
+            .width = level.width,
+            .height = level.height,
+            .offset = offset,
+            .size = level.pixels.size(),
+        });
+        offset = AlignUp(offset + level.pixels.size());
+    }
+    header.fileSize = levels.empty()
+        ? offset
+        : levels.back().offset + levels.back().size;
+
+    // Written next to the final file and renamed into place, like the mesh
+    // cache.
+    std::string cachePath = TextureCachePath(imagePath, image.format);
+    std::string tempPath = cachePath + ".tmp";
+    std::error_code error;
+    std::filesystem::create_directories(
+        std::filesystem::path(cachePath).parent_path(), error);
+
+    {
+        std::ofstream stream(tempPath, std::ios::out | std::ios::binary);
+        auto writeSection = [&](uint64_t sectionOffset, void const* bytes,
+                                size_t size) {
+            static constexpr char padding[utexAlignment] {};
+            stream.write(padding,
+                static_cast<std::streamsize>(sectionOffset - stream.tellp()));
+            stream.write(static_cast<char const*>(bytes),
+                static_cast<std::streamsize>(size));
+        };
+
+        stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        writeSection(header.levelOffset, levels.data(),
+            levels.size() * sizeof(UTexLevel));
+        for (size_t l = 0; l < levels.size(); l++) {
+            writeSection(levels[l].offset, image.levels[l].pixels.data(),
+                image.levels[l].pixels.size());
+        }
+        if (!stream) {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempPath, cachePath, error);
+    return !error;
+}
+
+std::optional<Image> LoadTexture(char const* imagePath, TextureFormat format)
+{
+    if (format != TextureFormat::Rgba8) {
+        std::optional<Image> cached = OpenTextureCache(imagePath, format);
+        if (cached) {
+            return cached;
+        }
+    }
+
+    std::optional<Image> image = LoadImage(imagePath);
+    if (!image) {
+        return {};
+    }
+    BuildMipChain(*image);
+    if (format == TextureFormat::Rgba8) {
+        return image;
+    }
+
+    Image compressed = CompressImage(*image, format);
+    if (!WriteTextureCache(imagePath, compressed)) {
+        spdlog::warn("Could not write the texture cache for {}", imagePath);
+    }
+    return compressed;
+}
+
+} // namespace Umbrella::Assets
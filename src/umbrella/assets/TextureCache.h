@@ -0,0 +1,28 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "assets/Image.h"
+
+namespace Umbrella::Assets {
+
+// Location of the .utex file baked from imagePath in format.
+std::string TextureCachePath(char const* imagePath, TextureFormat format);
+
+// Reads the baked mip chain of imagePath. Returns nothing when there is no
+// cache, when it is corrupt, or when the image no longer matches the
+// content hash it was baked from.
+std::optional<Image> OpenTextureCache(
+    char const* imagePath, TextureFormat format);
+
+// Bakes image into the cache for imagePath, keyed by a content hash of the
+// source image.
+bool WriteTextureCache(char const* imagePath, Image const& image);
+
+// The full mip chain of imagePath in format: from the cache when it is
+// current, otherwise decoded, mipmapped, compressed and cached. RGBA8 is
+// never cached, as decoding is about as fast as reading it back.
+std::optional<Image> LoadTexture(char const* imagePath, TextureFormat format);
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,649 @@
+#include "assets/TextureCompressor.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "util/Parallel.h"
+#include "util/Profiler.h"
+
+namespace Umbrella::Assets {
+
+namespace {
+
+    constexpr int bc7Weights[16]
+        = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    // Little-endian bit stream, as BC7 lays out its fields.
+    class BitWriter {
+    public:
+        explicit BitWriter(uint8_t* bytes)
+            : m_bytes(bytes)
+        {
+            std::fill(bytes, bytes + 16, uint8_t(0));
+        }
+
+        void Put(uint32_t value, uint32_t numBits)
+        {
+            for (uint32_t b = 0; b < numBits; b++, m_bit++) {
+                m_bytes[m_bit / 8] |= ((value >> b) & 1) << (m_bit % 8);
+            }
+        }
+
+    private:
+        uint8_t* m_bytes;
+        uint32_t m_bit {};
+    };
+
+    class BitReader {
+    public:
+        explicit BitReader(uint8_t const* bytes)
+            : m_bytes(bytes)
+        {
+        }
+
+        uint32_t Get(uint32_t numBits)
+        {
+            uint32_t value = 0;
+            for (uint32_t b = 0; b < numBits; b++, m_bit++) {
+                value |= uint32_t((m_bytes[m_bit / 8] >> (m_bit % 8)) & 1)
+                    << b;
+            }
+            return value;
+        }
+
+    private:
+        uint8_t const* m_bytes;
+        uint32_t m_bit {};
+    };
+
+    // Power iteration from the axis with the most variance. Returns zero
+    // for a block of one colour.
+    template <int N>
+    glm::vec<N, float> PrincipalAxis(
+        std::array<glm::vec<N, float>, 16> const& points,
+        glm::vec<N, float> mean)
+    {
+        glm::mat<N, N, float> covariance(0.0f);
+        for (glm::vec<N, float> const& point : points) {
+            covariance += glm::outerProduct(point - mean, point - mean);
+        }
+
+        int widest = 0;
+        for (int i = 1; i < N; i++) {
+            if (covariance[i][i] > covariance[widest][widest]) {
+                widest = i;
+            }
+        }
+        glm::vec<N, float> axis = covariance[widest];
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float length = glm::length(axis);
+            if (length < 1e-6f) {
+                return glm::vec<N, float>(0.0f);
+            }
+            axis = covariance * (axis / length);
+        }
+        float length = glm::length(axis);
+        return length < 1e-6f ? glm::vec<N, float>(0.0f) : axis / length;
+    }
+
+    // Endpoints at the extremes of the points along their principal axis.
+    template <int N>
+    std::pair<glm::vec<N, float>, glm::vec<N, float>> FitEndpoints(
+        std::array<glm::vec<N, float>, 16> const& points)
+    {
+        glm::vec<N, float> mean(0.0f);
+        for (glm::vec<N, float> const& point : points) {
+            mean += point;
+        }
+        mean /= 16.0f;
+
+        glm::vec<N, float> axis = PrincipalAxis<N>(points, mean);
+        float lowest = 0.0f;
+        float highest = 0.0f;
+        for (glm::vec<N, float> const& point : points) {
+            float t = glm::dot(point - mean, axis);
+            lowest = std::min(lowest, t);
+            highest = std::max(highest, t);
+        }
+        return {glm::clamp(mean + highest * axis, 0.0f, 255.0f),
+            glm::clamp(mean + lowest * axis, 0.0f, 255.0f)};
+    }
+
+    // Least-squares endpoints for fixed interpolation weights, where
+    // weights[i] is how much of the first endpoint texel i gets. Returns
+    // false when the weights cannot tell the endpoints apart.
+    template <int N>
+    bool RefineEndpoints(std::array<glm::vec<N, float>, 16> const& points,
+        float const weights[16], glm::vec<N, float>& first,
+        glm::vec<N, float>& second)
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        glm::vec<N, float> ax(0.0f), bx(0.0f);
+        for (int i = 0; i < 16; i++) {
+            float a = weights[i];
+            float b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax += a * points[i];
+            bx += b * points[i];
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f) {
+            return false;
+        }
+        first = glm::clamp((bb * ax - ab * bx) / determinant, 0.0f, 255.0f);
+        second = glm::clamp((aa * bx - ab * ax) / determinant, 0.0f, 255.0f);
+        return true;
+    }
+
+    uint16_t To565(glm::vec3 color)
+    {
+        auto quantize = [](float value, float max) {
+            return static_cast<uint32_t>(
+                std::clamp(std::round(value * max / 255.0f), 0.0f, max));
+        };
+        return static_cast<uint16_t>(quantize(color.r, 31.0f) << 11
+            | quantize(color.g, 63.0f) << 5 | quantize(color.b, 31.0f));
+    }
+
+    glm::ivec3 From565(uint16_t color)
+    {
+        int r = color >> 11 & 31;
+        int g = color >> 5 & 63;
+        int b = color & 31;
+        return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2};
+    }
+
+    // The four-colour mode palette.
+    std::array<glm::ivec3, 4> Bc1Palette(uint16_t c0, uint16_t c1)
+    {
+        glm::ivec3 p0 = From565(c0);
+        glm::ivec3 p1 = From565(c1);
+        return {p0, p1, (2 * p0 + p1) / 3, (p0 + 2 * p1) / 3};
+    }
+
+    template <int N> int SquaredDistance(glm::vec<N, int> a, glm::vec<N, int> b)
+    {
+        glm::vec<N, int> d = a - b;
+        int sum = 0;
+        for (int i = 0; i < N; i++) {
+            sum += d[i] * d[i];
+        }
+        return sum;
+    }
+
+    // Nearest palette entry for every texel; returns the total error.
+    template <int N, size_t P>
+    int PickIndices(std::array<glm::vec<N, int>, 16> const& texels,
+        std::array<glm::vec<N, int>, P> const& palette, uint8_t indices[16])
+    {
+        int error = 0;
+        for (int i = 0; i < 16; i++) {
+            int best = std::numeric_limits<int>::max();
+            for (size_t p = 0; p < P; p++) {
+                int distance = SquaredDistance<N>(texels[i], palette[p]);
+                if (distance < best) {
+                    best = distance;
+                    indices[i] = static_cast<uint8_t>(p);
+                }
+            }
+            error += best;
+        }
+        return error;
+    }
+
+    void EncodeColorBlock(uint8_t const texels[64], uint8_t block[8])
+    {
+        std::array<glm::vec3, 16> colors;
+        std::array<glm::ivec3, 16> exact;
+        for (int i = 0; i < 16; i++) {
+            exact[i] = {texels[4 * i], texels[4 * i + 1], texels[4 * i + 2]};
+            colors[i] = exact[i];
+        }
+
+        auto [first, second] = FitEndpoints<3>(colors);
+        uint16_t c0 = To565(first);
+        uint16_t c1 = To565(second);
+        uint8_t indices[16];
+        int error = PickIndices<3>(exact, Bc1Palette(c0, c1), indices);
+
+        constexpr float paletteWeights[4] = {1.0f, 0.0f, 2.0f / 3, 1.0f / 3};
+        float weights[16];
+        for (int i = 0; i < 16; i++) {
+            weights[i] = paletteWeights[indices[i]];
+        }
+        if (RefineEndpoints<3>(colors, weights, first, second)) {
+            uint16_t r0 = To565(first);
+            uint16_t r1 = To565(second);
+            uint8_t refined[16];
+            int refinedError
+                = PickIndices<3>(exact, Bc1Palette(r0, r1), refined);
+            if (refinedError < error) {
+                c0 = r0;
+                c1 = r1;
+                std::copy(refined, refined + 16, indices);
+            }
+        }
+
+        // c0 > c1 selects the four-colour mode. Swapping the endpoints
+        // swaps palette entries 0 and 1, and 2 and 3.
+        if (c0 < c1) {
+            std::swap(c0, c1);
+            for (uint8_t& index : indices) {
+                index ^= 1;
+            }
+        } else if (c0 == c1) {
+            std::fill(indices, indices + 16, uint8_t(0));
+        }
+
+        uint32_t bits = 0;
+        for (int i = 0; i < 16; i++) {
+            bits |= uint32_t(indices[i]) << (2 * i);
+        }
+        block[0] = static_cast<uint8_t>(c0);
+        block[1] = static_cast<uint8_t>(c0 >> 8);
+        block[2] = static_cast<uint8_t>(c1);
+        block[3] = static_cast<uint8_t>(c1 >> 8);
+        for (int b = 0; b < 4; b++) {
+            block[4 + b] = static_cast<uint8_t>(bits >> (8 * b));
+        }
+    }
+
+    std::array<int, 8> AlphaPalette(int a0, int a1)
+    {
+        std::array<int, 8> palette {a0, a1};
+        if (a0 > a1) {
+            for (int i = 2; i < 8; i++) {
+                palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+            }
+        } else {
+            for (int i = 2; i < 6; i++) {
+                palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+        return palette;
+    }
+
+    void EncodeAlphaBlock(uint8_t const texels[64], uint8_t block[8])
+    {
+        int a0 = 0;
+        int a1 = 255;
+        for (int i = 0; i < 16; i++) {
+            a0 = std::max<int>(a0, texels[4 * i + 3]);
+            a1 = std::min<int>(a1, texels[4 * i + 3]);
+        }
+
+        uint64_t bits = 0;
+        if (a0 != a1) {
+            std::array<int, 8> palette = AlphaPalette(a0, a1);
+            for (int i = 0; i < 16; i++) {
+                int alpha = texels[4 * i + 3];
+                uint64_t best = 0;
+                for (uint64_t p = 1; p < 8; p++) {
+                    if (std::abs(palette[p] - alpha)
+                        < std::abs(palette[best] - alpha)) {
+                        best = p;
+                    }
+                }
+                bits |= best << (3 * i);
+            }
+        }
+
+        block[0] = static_cast<uint8_t>(a0);
+        block[1] = static_cast<uint8_t>(a1);
+        for (int b = 0; b < 6; b++) {
+            block[2 + b] = static_cast<uint8_t>(bits >> (8 * b));
+        }
+    }
+
+    void DecodeColorBlock(
+        uint8_t const block[8], bool allowThreeColor, uint8_t texels[64])
+    {
+        uint16_t c0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+        uint16_t c1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+        std::array<glm::ivec4, 4> palette;
+        glm::ivec3 p0 = From565(c0);
+        glm::ivec3 p1 = From565(c1);
+        palette[0] = {p0, 255};
+        palette[1] = {p1, 255};
+        if (c0 > c1 || !allowThreeColor) {
+            palette[2] = {(2 * p0 + p1) / 3, 255};
+            palette[3] = {(p0 + 2 * p1) / 3, 255};
+        } else {
+            palette[2] = {(p0 + p1) / 2, 255};
+            palette[3] = glm::ivec4(0);
+        }
+
+        uint32_t bits = uint32_t(block[4]) | uint32_t(block[5]) << 8
+            | uint32_t(block[6]) << 16 | uint32_t(block[7]) << 24;
+        for (int i = 0; i < 16; i++) {
+            glm::ivec4 color = palette[bits >> (2 * i) & 3];
+            for (int c = 0; c < 4; c++) {
+                texels[4 * i + c] = static_cast<uint8_t>(color[c]);
+            }
+        }
+    }
+
+    void DecodeAlphaBlock(uint8_t const block[8], uint8_t texels[64])
+    {
+        std::array<int, 8> palette = AlphaPalette(block[0], block[1]);
+        uint64_t bits = 0;
+        for (int b = 0; b < 6; b++) {
+            bits |= uint64_t(block[2 + b]) << (8 * b);
+        }
+        for (int i = 0; i < 16; i++) {
+            texels[4 * i + 3]
+                = static_cast<uint8_t>(palette[bits >> (3 * i) & 7]);
+        }
+    }
+
+    // Mode 6 endpoints: 7 bits per channel and a p-bit each, which
+    // together make the 8-bit endpoint.
+    struct Bc7Endpoints {
+        glm::ivec4 quantized[2];
+        int pBits[2];
+
+        glm::ivec4 Endpoint(int e) const
+        {
+            return quantized[e] * 2 + pBits[e];
+        }
+    };
+
+    std::array<glm::ivec4, 16> Bc7Palette(Bc7Endpoints const& endpoints)
+    {
+        glm::ivec4 e0 = endpoints.Endpoint(0);
+        glm::ivec4 e1 = endpoints.Endpoint(1);
+        std::array<glm::ivec4, 16> palette;
+        for (int i = 0; i < 16; i++) {
+            palette[i]
+                = ((64 - bc7Weights[i]) * e0 + bc7Weights[i] * e1 + 32) >> 6;
+        }
+        return palette;
+    }
+
+    // Tries every p-bit pair for the endpoints and keeps the best.
+    int QuantizeBc7(std::array<glm::ivec4, 16> const& texels, glm::vec4 first,
+        glm::vec4 second, Bc7Endpoints& best, uint8_t indices[16])
+    {
+        int bestError = std::numeric_limits<int>::max();
+        for (int p = 0; p < 4; p++) {
+            Bc7Endpoints endpoints;
+            endpoints.pBits[0] = p & 1;
+            endpoints.pBits[1] = p >> 1;
+            glm::vec4 targets[2] = {first, second};
+            for (int e = 0; e < 2; e++) {
+                endpoints.quantized[e] = glm::clamp(
+                    glm::ivec4(glm::round(
+                        (targets[e] - float(endpoints.pBits[e])) / 2.0f)),
+                    0, 127);
+            }
+
+            uint8_t candidate[16];
+            int error
+                = PickIndices<4>(texels, Bc7Palette(endpoints), candidate);
+            if (error < bestError) {
+                bestError = error;
+                best = endpoints;
+                std::copy(candidate, candidate + 16, indices);
+            }
+        }
+        return bestError;
+    }
+
+    void Bc7Mode6(uint8_t const texels[64], uint8_t block[16])
+    {
+        std::array<glm::vec4, 16> colors;
+        std::array<glm::ivec4, 16> exact;
+        for (int i = 0; i < 16; i++) {
+            exact[i] = {texels[4 * i], texels[4 * i + 1], texels[4 * i + 2],
+                texels[4 * i + 3]};
+            colors[i] = exact[i];
+        }
+
+        auto [first, second] = FitEndpoints<4>(colors);
+        Bc7Endpoints endpoints;
+        uint8_t indices[16];
+        int error = QuantizeBc7(exact, first, second, endpoints, indices);
+
+        float weights[16];
+        for (int i = 0; i < 16; i++) {
+            weights[i] = float(64 - bc7Weights[indices[i]]) / 64.0f;
+        }
+        if (error > 0 && RefineEndpoints<4>(colors, weights, first, second)) {
+            Bc7Endpoints refined;
+            uint8_t refinedIndices[16];
+            if (QuantizeBc7(exact, first, second, refined, refinedIndices)
+                < error) {
+                endpoints = refined;
+                std::copy(refinedIndices, refinedIndices + 16, indices);
+            }
+        }
+
+        // The first index is stored without its top bit, which has to be
+        // zero; swapping the endpoints mirrors the indices.
+        if (indices[0] & 8) {
+            std::swap(endpoints.quantized[0], endpoints.quantized[1]);
+            std::swap(endpoints.pBits[0], endpoints.pBits[1]);
+            for (uint8_t& index : indices) {
+                index = static_cast<uint8_t>(15 - index);
+            }
+        }
+
+        BitWriter writer(block);
+        writer.Put(1 << 6, 7);
+        for (int c = 0; c < 4; c++) {
+            writer.Put(static_cast<uint32_t>(endpoints.quantized[0][c]), 7);
+            writer.Put(static_cast<uint32_t>(endpoints.quantized[1][c]), 7);
+        }
+        writer.Put(static_cast<uint32_t>(endpoints.pBits[0]), 1);
+        writer.Put(static_cast<uint32_t>(endpoints.pBits[1]), 1);
+        writer.Put(indices[0], 3);
+        for (int i = 1; i < 16; i++) {
+            writer.Put(indices[i], 4);
+        }
+    }
+
+    void DecodeBc7Block(uint8_t const block[16], uint8_t texels[64])
+    {
+        BitReader reader(block);
+        if (reader.Get(7) != 1 << 6) {
+            std::fill(texels, texels + 64, uint8_t(0));
+            return;
+        }
+
+        Bc7Endpoints endpoints;
+        for (int c = 0; c < 4; c++) {
+            endpoints.quantized[0][c] = static_cast<int>(reader.Get(7));
+            endpoints.quantized[1][c] = static_cast<int>(reader.Get(7));
+        }
+        endpoints.pBits[0] = static_cast<int>(reader.Get(1));
+        endpoints.pBits[1] = static_cast<int>(reader.Get(1));
+
+        std::array<glm::ivec4, 16> palette = Bc7Palette(endpoints);
+        for (int i = 0; i < 16; i++) {
+            glm::ivec4 color = palette[reader.Get(i == 0 ? 3 : 4)];
+            for (int c = 0; c < 4; c++) {
+                texels[4 * i + c] = static_cast<uint8_t>(color[c]);
+            }
+        }
+    }
+
+    // Every block row of every level, as the unit of parallel work.
+    struct BlockRow {
+        uint32_t level;
+        uint32_t row;
+    };
+
+    std::vector<BlockRow> BlockRows(Image const& image)
+    {
+        std::vector<BlockRow> rows;
+        for (uint32_t l = 0; l < image.levels.size(); l++) {
+            for (uint32_t r = 0; r < image.NumRows(l); r++) {
+                rows.push_back({l, r});
+            }
+        }
+        return rows;
+    }
+
+} // namespace
+
+void EncodeBc1Block(uint8_t const texels[64], uint8_t block[8])
+{
+    EncodeColorBlock(texels, block);
+}
+
+void EncodeBc3Block(uint8_t const texels[64], uint8_t block[16])
+{
+    EncodeAlphaBlock(texels, block);
+    EncodeColorBlock(texels, block + 8);
+}
+
+void EncodeBc7Block(uint8_t const texels[64], uint8_t block[16])
+{
+    Bc7Mode6(texels, block);
+}
+
+void DecodeBlock(TextureFormat format, uint8_t const* block,
+    uint8_t texels[64])
+{
+    switch (format) {
+    case TextureFormat::Rgba8:
+        std::copy(block, block + 4, texels);
+        break;
+    case TextureFormat::Bc1:
+        DecodeColorBlock(block, true, texels);
+        break;
+    case TextureFormat::Bc3:
+        DecodeColorBlock(block + 8, false, texels);
+        DecodeAlphaBlock(block, texels);
+        break;
+    case TextureFormat::Bc7:
+        DecodeBc7Block(block, texels);
+        break;
+    }
+}
+
+Image CompressImage(Image const& image, TextureFormat format)
+{
+    UMBRELLA_PROFILE_ZONE("Compress image");
+    Image result {.format = format, .levels = {}};
+    if (image.format != TextureFormat::Rgba8
+        || format == TextureFormat::Rgba8) {
+        return image;
+    }
+
+    for (ImageLevel const& level : image.levels) {
+        result.levels.push_back(
+            {.width = level.width, .height = level.height, .pixels = {}});
+    }
+    for (uint32_t l = 0; l < result.levels.size(); l++) {
+        result.levels[l].pixels.resize(
+            result.RowBytes(l) * result.NumRows(l));
+    }
+
+    uint32_t blockBytes = BytesPerBlock(format);
+    std::vector<BlockRow> rows = BlockRows(result);
+    Util::ParallelFor(rows.size(), [&](size_t i) {
+        ImageLevel const& source = image.levels[rows[i].level];
+        uint8_t* destination = result.levels[rows[i].level].pixels.data()
+            + rows[i].row * result.RowBytes(rows[i].level);
+        uint32_t blocksWide = (source.width + 3) / 4;
+        for (uint32_t bx = 0; bx < blocksWide; bx++) {
+            uint8_t texels[64];
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t sy = std::min(4 * rows[i].row + y, source.height - 1);
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t sx = std::min(4 * bx + x, source.width - 1);
+                    std::copy_n(
+                        source.pixels.data() + (size_t(sy) * source.width + sx)
+                            * 4,
+                        4, texels + 4 * (4 * y + x));
+                }
+            }
+
+            uint8_t* block = destination + bx * blockBytes;
+            switch (format) {
+            case TextureFormat::Bc1:
+                EncodeBc1Block(texels, block);
+                break;
+            case TextureFormat::Bc3:
+                EncodeBc3Block(texels, block);
+                break;
+            case TextureFormat::Bc7:
+                EncodeBc7Block(texels, block);
+                break;
+            case TextureFormat::Rgba8:
+                break;
+            }
+        }
+    });
+    return result;
+}
+
+Image DecompressImage(Image const& image)
+{
+    if (image.format == TextureFormat::Rgba8) {
+        return image;
+    }
+
+    Image result {.format = TextureFormat::Rgba8, .levels = {}};
+    for (ImageLevel const& level : image.levels) {
+        result.levels.push_back({
+            .width = level.width,
+            .height = level.height,
+            .pixels = std::vector<uint8_t>(
+                size_t(level.width) * level.height * 4),
+        });
+    }
+
+    uint32_t blockBytes = BytesPerBlock(image.format);
+    std::vector<BlockRow> rows = BlockRows(image);
+    Util::ParallelFor(rows.size(), [&](size_t i) {
+        ImageLevel& destination = result.levels[rows[i].level];
+        uint8_t const* source = image.levels[rows[i].level].pixels.data()
+            + rows[i].row * image.RowBytes(rows[i].level);
+        uint32_t blocksWide = (destination.width + 3) / 4;
+        for (uint32_t bx = 0; bx < blocksWide; bx++) {
+            uint8_t texels[64];
+            DecodeBlock(image.format, source + bx * blockBytes, texels);
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t dy = 4 * rows[i].row + y;
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t dx = 4 * bx + x;
+                    if (dx < destination.width && dy < destination.height) {
+                        std::copy_n(texels + 4 * (4 * y + x), 4,
+                            destination.pixels.data()
+                                + (size_t(dy) * destination.width + dx) * 4);
+                    }
+                }
+            }
+        }
+    });
+    return result;
+}
+
+double Psnr(ImageLevel const& a, ImageLevel const& b, bool withAlpha)
+{
+    size_t numTexels = size_t(a.width) * a.height;
+    int numChannels = withAlpha ? 4 : 3;
+    double sum = 0.0;
+    for (size_t t = 0; t < numTexels; t++) {
+        for (int c = 0; c < numChannels; c++) {
+            double d = double(a.pixels[4 * t + c]) - b.pixels[4 * t + c];
+            sum += d * d;
+        }
+    }
+    double mse = sum / double(numTexels * numChannels);
+    return mse == 0.0 ? std::numeric_limits<double>::infinity()
+                      : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+} // namespace Umbrella::Assets
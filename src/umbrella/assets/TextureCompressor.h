@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include "assets/Image.h"
+
+namespace Umbrella::Assets {
+
+// Block encoders, each taking the 16 RGBA8 texels of a 4x4 block in row
+// order.
+//
+// BC1 fits the colour endpoints along the principal axis of the block and
+// refines them with a least-squares pass. It always uses the four-colour
+// mode, so alpha is dropped.
+void EncodeBc1Block(uint8_t const texels[64], uint8_t block[8]);
+// BC3 is a BC1 colour block after an 8-value interpolated alpha block.
+void EncodeBc3Block(uint8_t const texels[64], uint8_t block[16]);
+// BC7 in mode 6 only: a single RGBA subset with 7-bit endpoints, per
+// endpoint p-bits and 4-bit indices. Every p-bit combination is tried.
+void EncodeBc7Block(uint8_t const texels[64], uint8_t block[16]);
+
+// Decodes a block back to 16 RGBA8 texels. The BC7 decoder only reads
+// mode 6, which is all the encoder writes; other modes decode to zero.
+void DecodeBlock(TextureFormat format, uint8_t const* block,
+    uint8_t texels[64]);
+
+// Encodes every level of an RGBA8 image. Block rows of all levels are
+// spread over the cores together, so small levels do not idle the workers.
+// Edge blocks repeat the last row and column.
+Image CompressImage(Image const& image, TextureFormat format);
+Image DecompressImage(Image const& image);
+
+// Peak signal-to-noise ratio between two RGBA8 levels of the same size, in
+// dB, over RGB or RGBA. Identical levels give infinity.
+double Psnr(ImageLevel const& a, ImageLevel const& b, bool withAlpha);
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,303 @@
+#include "assets/VertexLayout.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/packing.hpp>
+
+namespace Umbrella::Assets {
+
+namespace {
+
+    constexpr uint32_t FormatSize(AttribFormat format)
+    {
+        switch (format) {
+        case AttribFormat::Float32x3:
+            return 12;
+        case AttribFormat::Float32x2:
+        case AttribFormat::Unorm16x4:
+            return 8;
+        case AttribFormat::Float16x2:
+        case AttribFormat::Unorm16x2:
+        case AttribFormat::Octahedral10x3x2:
+            return 4;
+        }
+        return 0;
+    }
+
+    glm::vec2 SignNotZero(glm::vec2 v)
+    {
+        return {v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f};
+    }
+
+    glm::vec3 OctDecode(glm::vec2 e)
+    {
+        glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+        if (n.z < 0.0f) {
+            glm::vec2 folded
+                = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * SignNotZero(e);
+            n.x = folded.x;
+            n.y = folded.y;
+        }
+        return glm::normalize(n);
+    }
+
+    // Picks whichever of the four neighbouring 10-bit grid points decodes
+    // closest to n, rather than plain rounding.
+    uint32_t OctEncode(glm::vec3 n)
+    {
+        float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (sum == 0.0f) {
+            return glm::packSnorm3x10_1x2(glm::vec4(0.0f));
+        }
+        n /= sum;
+        glm::vec2 e(n.x, n.y);
+        if (n.z < 0.0f) {
+            e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * SignNotZero(e);
+        }
+
+        glm::vec3 target = glm::normalize(n);
+        glm::vec2 base = glm::floor(e * 511.0f);
+        uint32_t best = 0;
+        float bestDot = -std::numeric_limits<float>::max();
+        for (int i = 0; i < 4; i++) {
+            glm::vec2 candidate = glm::clamp(
+                (base + glm::vec2(i & 1, i >> 1)) / 511.0f, -1.0f, 1.0f);
+            uint32_t packed
+                = glm::packSnorm3x10_1x2(glm::vec4(candidate, 0.0f, 0.0f));
+            glm::vec4 unpacked = glm::unpackSnorm3x10_1x2(packed);
+            float dot = glm::dot(
+                OctDecode(glm::vec2(unpacked.x, unpacked.y)), target);
+            if (dot > bestDot) {
+                bestDot = dot;
+                best = packed;
+            }
+        }
+        return best;
+    }
+
+    glm::vec3 Extent(MeshBounds const& bounds)
+    {
+        return bounds.max - bounds.min;
+    }
+
+    template <typename T> void Store(std::byte* destination, T value)
+    {
+        std::memcpy(destination, &value, sizeof(value));
+    }
+
+    template <typename T> T Load(std::byte const* source)
+    {
+        T value;
+        std::memcpy(&value, source, sizeof(value));
+        return value;
+    }
+
+    void EncodeAttribute(std::byte* destination, AttribFormat format,
+        glm::vec4 value)
+    {
+        switch (format) {
+        case AttribFormat::Float32x3:
+            Store(destination, glm::vec3(value));
+            break;
+        case AttribFormat::Float32x2:
+            Store(destination, glm::vec2(value));
+            break;
+        case AttribFormat::Float16x2:
+            Store(destination, glm::packHalf2x16(glm::vec2(value)));
+            break;
+        case AttribFormat::Unorm16x2:
+            Store(destination, glm::packUnorm2x16(glm::vec2(value)));
+            break;
+        case AttribFormat::Unorm16x4:
+            Store(destination,
+                glm::packUnorm4x16(glm::vec4(glm::vec3(value), 0.0f)));
+            break;
+        case AttribFormat::Octahedral10x3x2:
+            Store(destination, OctEncode(glm::vec3(value)));
+            break;
+        }
+    }
+
+    glm::vec4 DecodeAttribute(std::byte const* source, AttribFormat format)
+    {
+        switch (format) {
+        case AttribFormat::Float32x3:
+            return glm::vec4(Load<glm::vec3>(source), 0.0f);
+        case AttribFormat::Float32x2:
+            return glm::vec4(Load<glm::vec2>(source), 0.0f, 0.0f);
+        case AttribFormat::Float16x2:
+            return glm::vec4(
+                glm::unpackHalf2x16(Load<uint32_t>(source)), 0.0f, 0.0f);
+        case AttribFormat::Unorm16x2:
+            return glm::vec4(
+                glm::unpackUnorm2x16(Load<uint32_t>(source)), 0.0f, 0.0f);
+        case AttribFormat::Unorm16x4:
+            return glm::unpackUnorm4x16(Load<uint64_t>(source));
+        case AttribFormat::Octahedral10x3x2: {
+            glm::vec4 e = glm::unpackSnorm3x10_1x2(Load<uint32_t>(source));
+            return glm::vec4(OctDecode(glm::vec2(e.x, e.y)), 0.0f);
+        }
+        }
+        return {};
+    }
+
+    VertexLayout PackLayout(
+        AttribFormat position, AttribFormat texCoord, AttribFormat normal)
+    {
+        VertexLayout layout {};
+        layout.position = {position, 0};
+        layout.texCoord = {texCoord, FormatSize(position)};
+        layout.normal = {normal, layout.texCoord.offset + FormatSize(texCoord)};
+        layout.stride = layout.normal.offset + FormatSize(normal);
+        return layout;
+    }
+
+} // namespace
+
+VertexLayout FullVertexLayout()
+{
+    return PackLayout(AttribFormat::Float32x3, AttribFormat::Float32x2,
+        AttribFormat::Float32x3);
+}
+
+bool IsWellFormed(VertexLayout const& layout)
+{
+    return std::ranges::all_of(
+        layout.Attributes(), [&](VertexAttribute const& attribute) {
+            uint32_t size = FormatSize(attribute.format);
+            return size > 0 && attribute.offset <= layout.stride
+                && size <= layout.stride - attribute.offset;
+        });
+}
+
+bool UnitTexCoords(std::span<MeshView const> meshes)
+{
+    return std::ranges::all_of(meshes, [](MeshView const& mesh) {
+        return std::ranges::all_of(mesh.vertices, [](Vertex const& vertex) {
+            return vertex.u >= 0.0f && vertex.u <= 1.0f && vertex.v >= 0.0f
+                && vertex.v <= 1.0f;
+        });
+    });
+}
+
+VertexLayout ChooseVertexLayout(
+    VertexLayoutOptions options, bool unitTexCoords)
+{
+    if (!options.compact) {
+        return FullVertexLayout();
+    }
+    return PackLayout(options.quantizePositions ? AttribFormat::Unorm16x4
+                                                : AttribFormat::Float32x3,
+        unitTexCoords ? AttribFormat::Unorm16x2 : AttribFormat::Float16x2,
+        AttribFormat::Octahedral10x3x2);
+}
+
+VertexLayout ChooseVertexLayout(MeshView mesh, VertexLayoutOptions options)
+{
+    return ChooseVertexLayout(std::span(&mesh, 1), options);
+}
+
+VertexLayout ChooseVertexLayout(
+    std::span<MeshView const> meshes, VertexLayoutOptions options)
+{
+    return ChooseVertexLayout(
+        options, !options.compact || UnitTexCoords(meshes));
+}
+
+std::vector<std::byte> EncodeVertices(std::span<Vertex const> vertices,
+    VertexLayout const& layout, MeshBounds const& bounds)
+{
+    glm::vec3 extent = Extent(bounds);
+    glm::vec3 inverseExtent(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+        extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+        extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+    bool quantized = layout.position.format == AttribFormat::Unorm16x4;
+
+    std::vector<std::byte> data(vertices.size() * layout.stride);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        Vertex const& vertex = vertices[i];
+        std::byte* destination = data.data() + i * layout.stride;
+
+        glm::vec3 position(vertex.x, vertex.y, vertex.z);
+        if (quantized) {
+            position = (position - bounds.min) * inverseExtent;
+        }
+        EncodeAttribute(destination + layout.position.offset,
+            layout.position.format, glm::vec4(position, 0.0f));
+        glm::vec4 texCoord(vertex.u, vertex.v, 0.0f, 0.0f);
+        glm::vec4 normal(vertex.nx, vertex.ny, vertex.nz, 0.0f);
+        EncodeAttribute(destination + layout.texCoord.offset,
+            layout.texCoord.format, texCoord);
+        EncodeAttribute(
+            destination + layout.normal.offset, layout.normal.format, normal);
+    }
+    return data;
+}
+
+Vertex DecodeVertex(std::byte const* data, VertexLayout const& layout,
+    MeshBounds const& bounds)
+{
+    glm::vec3 stored = DecodeAttribute(
+        data + layout.position.offset, layout.position.format);
+    glm::vec4 position
+        = DequantizeMatrix(layout, bounds) * glm::vec4(stored, 1.0f);
+    glm::vec4 texCoord = DecodeAttribute(
+        data + layout.texCoord.offset, layout.texCoord.format);
+    glm::vec4 normal
+        = DecodeAttribute(data + layout.normal.offset, layout.normal.format);
+
+    return {
+        .x = position.x,
+        .y = position.y,
+        .z = position.z,
+        .u = texCoord.x,
+        .v = texCoord.y,
+        .nx = normal.x,
+        .ny = normal.y,
+        .nz = normal.z,
+    };
+}
+
+glm::mat4 DequantizeMatrix(
+    VertexLayout const& layout, MeshBounds const& bounds)
+{
+    if (layout.position.format != AttribFormat::Unorm16x4) {
+        return glm::mat4(1.0f);
+    }
+    return glm::scale(glm::translate(glm::mat4(1.0f), bounds.min),
+        Extent(bounds));
+}
+
+IndexFormat ChooseIndexFormat(size_t numVertices)
+{
+    return numVertices <= size_t(std::numeric_limits<uint16_t>::max()) + 1
+        ? IndexFormat::Uint16
+        : IndexFormat::Uint32;
+}
+
+uint32_t IndexSize(IndexFormat format)
+{
+    return format == IndexFormat::Uint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+std::vector<std::byte> EncodeIndices(
+    std::span<uint32_t const> indices, IndexFormat format)
+{
+    if (format == IndexFormat::Uint32) {
+        auto bytes = std::as_bytes(indices);
+        return {bytes.begin(), bytes.end()};
+    }
+
+    std::vector<std::byte> data(indices.size() * sizeof(uint16_t));
+    for (size_t i = 0; i < indices.size(); i++) {
+        Store(data.data() + i * sizeof(uint16_t),
+            static_cast<uint16_t>(indices[i]));
+    }
+    return data;
+}
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "assets/Mesh.h"
+
+namespace Umbrella::Assets {
+
+enum class AttribFormat : uint8_t {
+    Float32x3 = 0,
+    Float32x2 = 1,
+    Float16x2 = 2,
+    Unorm16x2 = 3,
+    // xyz in [0, 1] relative to the mesh bounds, w is padding.
+    Unorm16x4 = 4,
+    // Octahedral normal in x and y of a 10:10:10:2 signed normalized word.
+    Octahedral10x3x2 = 5,
+};
+
+struct VertexAttribute {
+    AttribFormat format;
+    uint32_t offset;
+
+    bool operator==(VertexAttribute const&) const = default;
+};
+
+// Where and how each attribute of Vertex is stored in the VBO. Attribute
+// locations are fixed: 0 is position, 1 texture coordinates, 2 the normal.
+struct VertexLayout {
+    VertexAttribute position;
+    VertexAttribute texCoord;
+    VertexAttribute normal;
+    uint32_t stride;
+
+    std::array<VertexAttribute, 3> Attributes() const
+    {
+        return {position, texCoord, normal};
+    }
+
+    bool operator==(VertexLayout const&) const = default;
+};
+
+struct VertexLayoutOptions {
+    // Store texture coordinates and normals in 16 and 32 bits.
+    bool compact = true;
+    // Store positions as 16-bit fractions of the mesh bounds, to be scaled
+    // back with DequantizeMatrix.
+    bool quantizePositions = true;
+};
+
+// Full-precision layout, matching Vertex byte for byte.
+VertexLayout FullVertexLayout();
+
+// Whether every attribute has a known format and lies within the stride,
+// for layouts read back from disk.
+bool IsWellFormed(VertexLayout const& layout);
+
+// Whether every texture coordinate of the meshes lies in [0, 1].
+bool UnitTexCoords(std::span<MeshView const> meshes);
+
+// Texture coordinates use normalized 16 bits when they all lie in [0, 1]
+// and half floats otherwise.
+VertexLayout ChooseVertexLayout(
+    VertexLayoutOptions options, bool unitTexCoords);
+VertexLayout ChooseVertexLayout(MeshView mesh, VertexLayoutOptions options);
+
+// One layout that every mesh fits, so they can share a vertex buffer.
+VertexLayout ChooseVertexLayout(
+    std::span<MeshView const> meshes, VertexLayoutOptions options);
+
+std::vector<std::byte> EncodeVertices(std::span<Vertex const> vertices,
+    VertexLayout const& layout, MeshBounds const& bounds);
+
+Vertex DecodeVertex(std::byte const* data, VertexLayout const& layout,
+    MeshBounds const& bounds);
+
+// Maps the stored positions back into model space. Identity unless the
+// positions are quantized.
+glm::mat4 DequantizeMatrix(
+    VertexLayout const& layout, MeshBounds const& bounds);
+
+enum class IndexFormat : uint8_t {
+    Uint16 = 0,
+    Uint32 = 1,
+};
+
+// 16-bit indices whenever every vertex can be addressed with them.
+IndexFormat ChooseIndexFormat(size_t numVertices);
+uint32_t IndexSize(IndexFormat format);
+
+std::vector<std::byte> EncodeIndices(
+    std::span<uint32_t const> indices, IndexFormat format);
+
+// A mesh's vertices and indices as the GPU reads them, positions quantized
+// against the bounds of its MeshView.
+struct EncodedMesh {
+    VertexLayout layout;
+    IndexFormat indexFormat;
+    std::span<std::byte const> vertexData;
+    std::span<std::byte const> indexData;
+};
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,222 @@
+#include "assets/VertexWelder.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include "util/Hash.h"
+#include "util/Parallel.h"
+#include "util/Profiler.h"
+
+namespace Umbrella::Assets {
+
+namespace {
+
+    constexpr uint32_t emptySlot = UINT32_MAX;
+
+    // Blocks smaller than this are not worth welding on their own thread.
+    constexpr size_t minBlockSize = 64 * 1024;
+
+    uint32_t BitsOf(float value)
+    {
+        // -0.0 and 0.0 compare equal, so they must weld too.
+        uint32_t bits = std::bit_cast<uint32_t>(value);
+        return bits == 0x80000000u ? 0u : bits;
+    }
+
+    uint32_t CellOf(float value, float epsilon)
+    {
+        double scaled
+            = static_cast<double>(value) / static_cast<double>(epsilon);
+        auto cell = static_cast<int64_t>(std::floor(scaled + 0.5));
+        return static_cast<uint32_t>(cell) ^ static_cast<uint32_t>(cell >> 32);
+    }
+
+} // namespace
+
+VertexWelder::VertexWelder(size_t maxVertices, WeldOptions options)
+    : m_options(options)
+{
+    // Keep the load factor at or below 3/4 even if every vertex is unique.
+    size_t capacity = std::bit_ceil(
+        std::max<size_t>(16, maxVertices + maxVertices / 3 + 1));
+    m_slots.assign(capacity, {.tag = 0, .vertex = emptySlot});
+    m_mask = capacity - 1;
+}
+
+VertexWelder::WeldKey VertexWelder::KeyOf(Vertex const& vertex) const
+{
+    auto position = [&](float value) {
+        return m_options.positionEpsilon > 0.0f
+            ? CellOf(value, m_options.positionEpsilon)
+            : BitsOf(value);
+    };
+    auto normal = [&](float value) {
+        return m_options.normalEpsilon > 0.0f
+            ? CellOf(value, m_options.normalEpsilon)
+            : BitsOf(value);
+    };
+
+    return {{
+        position(vertex.x),
+        position(vertex.y),
+        position(vertex.z),
+        BitsOf(vertex.u),
+        BitsOf(vertex.v),
+        normal(vertex.nx),
+        normal(vertex.ny),
+        normal(vertex.nz),
+    }};
+}
+
+uint32_t VertexWelder::Insert(Vertex const& vertex)
+{
+    // Rehash if the caller inserted more vertices than announced.
+    if (4 * (m_vertices.size() + 1) > 3 * m_slots.size()) {
+        std::vector<Slot> oldSlots = std::move(m_slots);
+        m_slots.assign(2 * oldSlots.size(), {.tag = 0, .vertex = emptySlot});
+        m_mask = m_slots.size() - 1;
+        for (Slot const& slot : oldSlots) {
+            if (slot.vertex == emptySlot) {
+                continue;
+            }
+            WeldKey const& key = m_keys[slot.vertex];
+            size_t index = Util::HashBytes(&key, sizeof(key)) & m_mask;
+            while (m_slots[index].vertex != emptySlot) {
+                index = (index + 1) & m_mask;
+            }
+            m_slots[index] = slot;
+        }
+    }
+
+    WeldKey key = KeyOf(vertex);
+    uint64_t hash = Util::HashBytes(&key, sizeof(key));
+    auto tag = static_cast<uint32_t>(hash >> 32);
+
+    m_stats.numLookups++;
+    bool collided = false;
+    for (size_t index = hash & m_mask;; index = (index + 1) & m_mask) {
+        m_stats.numProbes++;
+        Slot& slot = m_slots[index];
+
+        if (slot.vertex == emptySlot) {
+            slot = {
+                .tag = tag,
+                .vertex = static_cast<uint32_t>(m_vertices.size()),
+            };
+            m_keys.push_back(key);
+            m_vertices.push_back(vertex);
+            m_stats.numCollisions += collided;
+            m_stats.peakTableBytes = std::max(m_stats.peakTableBytes,
+                m_slots.capacity() * sizeof(Slot)
+                    + m_keys.capacity() * sizeof(WeldKey));
+            return slot.vertex;
+        }
+
+        if (slot.tag == tag
+            && std::memcmp(&m_keys[slot.vertex], &key, sizeof(key)) == 0) {
+            m_stats.numCollisions += collided;
+            return slot.vertex;
+        }
+
+        collided = true;
+    }
+}
+
+WeldResult WeldVertices(std::span<Vertex const> corners,
+    std::span<size_t const> partitionStarts, WeldOptions options)
+{
+    UMBRELLA_PROFILE_ZONE("Weld vertices");
+    size_t numCorners = corners.size();
+    size_t blockSize = std::max(minBlockSize,
+        (numCorners + 4 * Util::WorkerCount() - 1) / (4 * Util::WorkerCount()));
+
+    // Cut the stream at every partition start and then into blocks.
+    std::vector<size_t> cuts(partitionStarts.begin(), partitionStarts.end());
+    cuts.push_back(0);
+    cuts.push_back(numCorners);
+    std::ranges::sort(cuts);
+    auto [duplicates, cutsEnd] = std::ranges::unique(cuts);
+    cuts.erase(duplicates, cutsEnd);
+
+    struct Partition {
+        size_t begin, end;
+        std::vector<Vertex> vertices {};
+        std::vector<uint32_t> remap {};
+        WeldStats stats {};
+    };
+    std::vector<Partition> partitions;
+    for (size_t c = 0; c + 1 < cuts.size(); c++) {
+        for (size_t begin = cuts[c]; begin < cuts[c + 1]; begin += blockSize) {
+            partitions.push_back({
+                .begin = begin,
+                .end = std::min(cuts[c + 1], begin + blockSize),
+            });
+        }
+    }
+
+    WeldResult result;
+    result.indices.resize(numCorners);
+
+    if (partitions.size() <= 1) {
+        VertexWelder welder(numCorners, options);
+        for (size_t i = 0; i < numCorners; i++) {
+            result.indices[i] = welder.Insert(corners[i]);
+        }
+        result.vertices = std::move(welder.Vertices());
+        result.stats = welder.Stats();
+        return result;
+    }
+
+    // Weld each partition on its own, writing partition-local indices.
+    Util::ParallelFor(partitions.size(), [&](size_t p) {
+        Partition& partition = partitions[p];
+        VertexWelder welder(partition.end - partition.begin, options);
+        for (size_t i = partition.begin; i < partition.end; i++) {
+            result.indices[i] = welder.Insert(corners[i]);
+        }
+        partition.vertices = std::move(welder.Vertices());
+        partition.stats = welder.Stats();
+    });
+
+    // Merge the partition vertices in stream order. A vertex first seen in
+    // an earlier partition keeps its earlier slot, which is what makes the
+    // result identical to a serial weld.
+    size_t numLocalVertices = 0;
+    for (Partition const& partition : partitions) {
+        numLocalVertices += partition.vertices.size();
+    }
+
+    VertexWelder merged(numLocalVertices, options);
+    for (Partition& partition : partitions) {
+        partition.remap.reserve(partition.vertices.size());
+        for (Vertex const& vertex : partition.vertices) {
+            partition.remap.push_back(merged.Insert(vertex));
+        }
+        partition.vertices = {};
+    }
+
+    Util::ParallelFor(partitions.size(), [&](size_t p) {
+        Partition const& partition = partitions[p];
+        for (size_t i = partition.begin; i < partition.end; i++) {
+            result.indices[i] = partition.remap[result.indices[i]];
+        }
+    });
+
+    result.vertices = std::move(merged.Vertices());
+
+    // Partition tables may all be alive at once, so the peak is reported as
+    // their sum plus the merge table.
+    result.stats = merged.Stats();
+    for (Partition const& partition : partitions) {
+        result.stats.numLookups += partition.stats.numLookups;
+        result.stats.numCollisions += partition.stats.numCollisions;
+        result.stats.numProbes += partition.stats.numProbes;
+        result.stats.peakTableBytes += partition.stats.peakTableBytes;
+    }
+
+    return result;
+}
+
+} // namespace Umbrella::Assets
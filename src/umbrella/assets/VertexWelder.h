@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "assets/Mesh.h"
+
+namespace Umbrella::Assets {
+
+struct WeldOptions {
+    // Vertices whose positions (or normals) land in the same cell of a grid
+    // with this spacing are welded together. Zero only welds vertices that
+    // are exactly equal.
+    float positionEpsilon = 0.0f;
+    float normalEpsilon = 0.0f;
+};
+
+struct WeldStats {
+    size_t numLookups {};
+    // Lookups that had to step over a slot holding a different vertex.
+    size_t numCollisions {};
+    size_t numProbes {};
+    size_t peakTableBytes {};
+};
+
+// Deduplicates vertices with an open-addressing hash table. The table is
+// sized up front from the number of vertices that will be inserted, so it
+// only rehashes if more than maxVertices unique vertices turn up.
+class VertexWelder {
+public:
+    explicit VertexWelder(size_t maxVertices, WeldOptions options = {});
+
+    // Returns the index of the welded vertex equal to vertex, adding it if
+    // this is the first time it is seen.
+    uint32_t Insert(Vertex const& vertex);
+
+    std::vector<Vertex>& Vertices() { return m_vertices; }
+    WeldStats const& Stats() const { return m_stats; }
+
+private:
+    struct WeldKey {
+        uint32_t words[8];
+    };
+
+    struct Slot {
+        uint32_t tag;
+        uint32_t vertex;
+    };
+
+    WeldKey KeyOf(Vertex const& vertex) const;
+
+    WeldOptions m_options;
+    std::vector<Slot> m_slots;
+    std::vector<WeldKey> m_keys;
+    std::vector<Vertex> m_vertices;
+    size_t m_mask {};
+    WeldStats m_stats;
+};
+
+struct WeldResult {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    WeldStats stats;
+};
+
+// Welds a stream of face corners into unique vertices and indices. The
+// stream is split at partitionStarts (e.g. shape boundaries) and into blocks,
+// which are welded on all cores and merged in order, so the result is the
+// same as welding the whole stream on one thread.
+WeldResult WeldVertices(std::span<Vertex const> corners,
+    std::span<size_t const> partitionStarts, WeldOptions options = {});
+
+} // namespace Umbrella::Assets
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include "gfx/Program.h"
+
+namespace Umbrella::Gfx {
+
+// Shadow cascades the block has room for; MAX_SHADOW_CASCADES in the
+// shaders.
+constexpr uint32_t frameShadowCascades = 4;
+
+// Per-frame camera constants, written once per frame into the stream
+// buffer and bound to the same uniform block binding for every program.
+// Matches the std140 FrameConstants block in the shaders.
+struct FrameConstants {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPosition;
+    // How fragments find their light cluster; see ClusterLookup.
+    glm::uvec4 clusterGrid;
+    glm::vec4 clusterScale;
+    // Towards the sun, and its colour times its intensity.
+    glm::vec4 sunDirection;
+    glm::vec4 sunColor;
+    // World space to each cascade's shadow map coordinates and depth.
+    glm::mat4 shadowMatrices[frameShadowCascades];
+    // The view depth each cascade ends at, and its world-space texel size.
+    glm::vec4 cascadeSplits;
+    glm::vec4 cascadeTexels;
+    // Cascades in use and the size of a shadow map texel.
+    glm::vec4 shadowParams;
+};
+
+constexpr GLuint frameConstantsBinding = 0;
+
+inline constexpr BlockMember frameConstantsMembers[] = {
+    {"FrameConstants.view", GL_FLOAT_MAT4, offsetof(FrameConstants, view)},
+    {"FrameConstants.projection", GL_FLOAT_MAT4,
+        offsetof(FrameConstants, projection)},
+    {"FrameConstants.viewProjection", GL_FLOAT_MAT4,
+        offsetof(FrameConstants, viewProjection)},
+    {"FrameConstants.cameraPosition", GL_FLOAT_VEC4,
+        offsetof(FrameConstants, cameraPosition)},
+    {"FrameConstants.clusterGrid", GL_UNSIGNED_INT_VEC4,
+        offsetof(FrameConstants, clusterGrid)},
+    {"FrameConstants.clusterScale", GL_FLOAT_VEC4,
+        offsetof(FrameConstants, clusterScale)},
+    {"FrameConstants.sunDirection", GL_FLOAT_VEC4,
+        offsetof(FrameConstants, sunDirection)},
+    {"FrameConstants.sunColor", GL_FLOAT_VEC4,
+        offsetof(FrameConstants, sunColor)},
+    {"FrameConstants.shadowMatrices[0]", GL_FLOAT_MAT4,
+        offsetof(FrameConstants, shadowMatrices)},
+    {"FrameConstants.cascadeSplits", GL_FLOAT_VEC4,
+        offsetof(FrameConstants, cascadeSplits)},
+    {"FrameConstants.cascadeTexels", GL_FLOAT_VEC4,
+        offsetof(FrameConstants, cascadeTexels)},
+    {"FrameConstants.shadowParams", GL_FLOAT_VEC4,
+        offsetof(FrameConstants, shadowParams)},
+};
+
+inline constexpr BlockLayout frameConstantsLayout {
+    .name = "FrameConstants",
+    .binding = frameConstantsBinding,
+    .size = sizeof(FrameConstants),
+    .members = frameConstantsMembers,
+};
+
+} // namespace Umbrella::Gfx
@@ -0,0 +1,100 @@
+#include "gfx/GpuProfiler.h"
+
+#include <spdlog/spdlog.h>
+
+namespace Umbrella::Gfx {
+
+GpuProfiler::GpuProfiler(uint32_t zonesPerFrame)
+{
+    for (Frame& frame : m_frames) {
+        frame.queries.resize(2 * zonesPerFrame);
+        glGenQueries(
+            static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+    }
+    m_track = Util::Profiler::Instance().AddTrack("GPU");
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (Frame& frame : m_frames) {
+        glDeleteQueries(
+            static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+    }
+}
+
+void GpuProfiler::ReadBack(Frame& frame)
+{
+    bool capturing = Util::Profiler::Capturing();
+    for (Zone const& zone : frame.zones) {
+        // A zone ends after everything nested in it, so once its end has
+        // arrived, so has its start.
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(frame.queries[zone.query + 1],
+            GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            if (++m_numDropped == 1) {
+                spdlog::warn("GPU profiler results arrived too late and "
+                             "were dropped");
+            }
+            continue;
+        }
+        if (!capturing) {
+            continue;
+        }
+
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(
+            frame.queries[zone.query], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(
+            frame.queries[zone.query + 1], GL_QUERY_RESULT, &end);
+        Clock::time_point start = Clock::time_point(
+            std::chrono::duration_cast<Clock::duration>(
+                std::chrono::nanoseconds(begin))
+            + frame.gpuToCpu);
+        Util::Profiler::Instance().AddTrackZone(m_track, zone.name, start,
+            start
+                + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::nanoseconds(end - begin)));
+    }
+    frame.zones.clear();
+    frame.numUsed = 0;
+}
+
+void GpuProfiler::BeginFrame()
+{
+    m_frame = (m_frame + 1) % numFrames;
+    Frame& frame = m_frames[m_frame];
+    ReadBack(frame);
+    if (!Util::Profiler::Capturing()) {
+        return;
+    }
+
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    frame.gpuToCpu = Clock::now().time_since_epoch()
+        - std::chrono::duration_cast<Clock::duration>(
+            std::chrono::nanoseconds(gpuNow));
+}
+
+std::optional<uint32_t> GpuProfiler::BeginZone(char const* name)
+{
+    Frame& frame = m_frames[m_frame];
+    if (!Util::Profiler::Capturing()
+        || frame.numUsed + 2 > frame.queries.size()) {
+        return {};
+    }
+    uint32_t query = frame.numUsed;
+    frame.numUsed += 2;
+    glQueryCounter(frame.queries[query], GL_TIMESTAMP);
+    frame.zones.push_back({name, query});
+    return query;
+}
+
+void GpuProfiler::EndZone(std::optional<uint32_t> zone)
+{
+    if (zone) {
+        glQueryCounter(m_frames[m_frame].queries[*zone + 1], GL_TIMESTAMP);
+    }
+}
+
+} // namespace Umbrella::Gfx
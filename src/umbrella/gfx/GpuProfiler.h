@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <glad/gl.h>
+
+#include "util/Profiler.h"
+
+namespace Umbrella::Gfx {
+
+// GPU zones for the profiler, from pairs of GL_TIMESTAMP queries. Every
+// frame in flight has a pool of queries of its own, read back when the
+// pool comes round again, frames later; results that have not arrived by
+// then are dropped rather than waited for. GPU timestamps are mapped onto
+// the CPU clock once per frame, so the zones line up with the CPU ones.
+// Nothing is recorded outside a capture.
+class GpuProfiler {
+public:
+    static constexpr uint32_t numFrames = 4;
+
+    explicit GpuProfiler(uint32_t zonesPerFrame = 32);
+    GpuProfiler(GpuProfiler const&) = delete;
+    GpuProfiler& operator=(GpuProfiler const&) = delete;
+    ~GpuProfiler();
+
+    // Call once per frame before any zone.
+    void BeginFrame();
+
+    // Returns nothing outside a capture or when the frame's pool is full.
+    // name has to outlive the frame.
+    std::optional<uint32_t> BeginZone(char const* name);
+    void EndZone(std::optional<uint32_t> zone);
+
+private:
+    using Clock = Util::Profiler::Clock;
+
+    struct Zone {
+        char const* name;
+        uint32_t query;
+    };
+
+    struct Frame {
+        std::vector<GLuint> queries;
+        std::vector<Zone> zones;
+        uint32_t numUsed {};
+        // CPU time minus GPU time, when the frame was recorded.
+        Clock::duration gpuToCpu {};
+    };
+
+    void ReadBack(Frame& frame);
+
+    std::array<Frame, numFrames> m_frames;
+    uint32_t m_frame {};
+    uint32_t m_track {};
+    uint32_t m_numDropped {};
+};
+
+// Records the GPU work submitted between construction and destruction.
+class GpuZone {
+public:
+    GpuZone(GpuProfiler& profiler, char const* name)
+        : m_profiler(profiler)
+        , m_zone(profiler.BeginZone(name))
+    {
+    }
+    GpuZone(GpuZone const&) = delete;
+    GpuZone& operator=(GpuZone const&) = delete;
+    ~GpuZone() { m_profiler.EndZone(m_zone); }
+
+private:
+    GpuProfiler& m_profiler;
+    std::optional<uint32_t> m_zone;
+};
+
+} // namespace Umbrella::Gfx
+
+#ifdef UMBRELLA_PROFILER
+#define UMBRELLA_PROFILE_GPU_ZONE(profiler, name)                             \
+    ::Umbrella::Gfx::GpuZone UMBRELLA_PROFILE_CONCAT(                         \
+        gpuZone, __LINE__)(profiler, name)
+#else
+#define UMBRELLA_PROFILE_GPU_ZONE(profiler, name) static_cast<void>(0)
+#endif
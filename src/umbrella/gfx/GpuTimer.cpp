@@ -0,0 +1,70 @@
+#include "gfx/GpuTimer.h"
+
+#include <algorithm>
+
+namespace Umbrella::Gfx {
+
+GpuTimer::GpuTimer(uint32_t numQueries)
+    : m_queries(std::max(numQueries, 1u))
+{
+    for (Query& query : m_queries) {
+        glGenQueries(1, &query.id);
+    }
+}
+
+GpuTimer::~GpuTimer()
+{
+    for (Query const& query : m_queries) {
+        glDeleteQueries(1, &query.id);
+    }
+}
+
+bool GpuTimer::Begin(uint32_t frame)
+{
+    Query& query = m_queries[m_next];
+    if (query.pending) {
+        return false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query.id);
+    query.frame = frame;
+    query.pending = true;
+    m_active = true;
+    return true;
+}
+
+void GpuTimer::End()
+{
+    if (!m_active) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    m_next = (m_next + 1) % static_cast<uint32_t>(m_queries.size());
+    m_active = false;
+}
+
+void GpuTimer::Collect(
+    std::vector<std::pair<uint32_t, double>>& results, bool wait)
+{
+    // Oldest first, so results come out in frame order.
+    for (size_t q = 0; q < m_queries.size(); q++) {
+        Query& query = m_queries[(m_next + q) % m_queries.size()];
+        if (!query.pending) {
+            continue;
+        }
+        if (!wait) {
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                // Later queries cannot have finished before this one.
+                break;
+            }
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &nanoseconds);
+        results.emplace_back(
+            query.frame, static_cast<double>(nanoseconds) / 1e6);
+        query.pending = false;
+    }
+}
+
+} // namespace Umbrella::Gfx
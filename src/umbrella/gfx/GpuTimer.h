@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glad/gl.h>
+
+namespace Umbrella::Gfx {
+
+// Times frames on the GPU with GL_TIME_ELAPSED queries. Results arrive a
+// few frames late, so the timer cycles through a ring of queries and only
+// reads those the driver reports available; it never stalls the pipeline
+// unless asked to.
+class GpuTimer {
+public:
+    explicit GpuTimer(uint32_t numQueries = 8);
+    GpuTimer(GpuTimer const&) = delete;
+    GpuTimer& operator=(GpuTimer const&) = delete;
+    ~GpuTimer();
+
+    // Returns false when every query is still in flight; the frame then
+    // goes untimed and End() does nothing.
+    bool Begin(uint32_t frame);
+    void End();
+
+    // Appends (frame, ms) for every query whose result has arrived. With
+    // wait, blocks until all of them have.
+    void Collect(
+        std::vector<std::pair<uint32_t, double>>& results, bool wait = false);
+
+private:
+    struct Query {
+        GLuint id {};
+        uint32_t frame {};
+        bool pending {};
+    };
+
+    std::vector<Query> m_queries;
+    uint32_t m_next {};
+    bool m_active {};
+};
+
+} // namespace Umbrella::Gfx
@@ -0,0 +1,52 @@
+#include "gfx/MaterialTable.h"
+
+#include <cstring>
+#include <string>
+
+namespace Umbrella::Gfx {
+
+MaterialTable::MaterialTable(std::span<Assets::MeshMaterial const> materials,
+    TextureStreamer& textures)
+    : m_textures(textures)
+{
+    for (Assets::MeshMaterial const& material : materials) {
+        m_constants.push_back({
+            .diffuse = material.diffuse,
+            .specular = material.specular,
+            .textureArray = -1,
+            .textureLayer = 0.0f,
+            .minLevel = 0.0f,
+            .padding = 0,
+        });
+
+        // Cached materials are read straight from the file, so the path
+        // may not be terminated.
+        std::string path(material.diffuseTexture,
+            strnlen(material.diffuseTexture, sizeof(material.diffuseTexture)));
+        std::optional<TextureId> texture;
+        if (!path.empty()) {
+            texture = m_textures.Request(path);
+            m_texturesFound &= texture.has_value();
+        }
+        m_diffuseTextures.push_back(texture);
+    }
+}
+
+void MaterialTable::Write(std::span<MaterialConstants> target) const
+{
+    for (size_t i = 0; i < m_constants.size(); i++) {
+        MaterialConstants constants = m_constants[i];
+        std::optional<TextureSlot> slot;
+        if (m_diffuseTextures[i]) {
+            slot = m_textures.Slot(*m_diffuseTextures[i]);
+        }
+        if (slot) {
+            constants.textureArray = static_cast<int32_t>(slot->array);
+            constants.textureLayer = static_cast<float>(slot->layer);
+            constants.minLevel = static_cast<float>(slot->minLevel);
+        }
+        target[i] = constants;
+    }
+}
+
+} // namespace Umbrella::Gfx
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "assets/Mesh.h"
+#include "gfx/TextureStreamer.h"
+
+namespace Umbrella::Gfx {
+
+// One material as the fragment shader reads it from its std430 Materials
+// buffer.
+struct MaterialConstants {
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    // Into the texture array samplers, or -1 while there is no texture to
+    // sample.
+    int32_t textureArray;
+    float textureLayer;
+    // Finest mip the texture has streamed in so far.
+    float minLevel;
+    uint32_t padding;
+};
+
+// The materials of a scene, indexed by draw records. Each texture they
+// name is requested once, however many materials use it, and the
+// constants point at wherever it has streamed in so far.
+class MaterialTable {
+public:
+    MaterialTable(std::span<Assets::MeshMaterial const> materials,
+        TextureStreamer& textures);
+
+    size_t Size() const { return m_constants.size(); }
+    // False when a material names a texture file that does not exist.
+    bool TexturesFound() const { return m_texturesFound; }
+
+    // Call after the streamer's Update(), so the slots match its arrays.
+    void Write(std::span<MaterialConstants> target) const;
+
+private:
+    TextureStreamer& m_textures;
+    std::vector<MaterialConstants> m_constants;
+    std::vector<std::optional<TextureId>> m_diffuseTextures;
+    bool m_texturesFound {true};
+};
+
+} // namespace Umbrella::Gfx
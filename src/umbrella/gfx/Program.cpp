@@ -0,0 +1,231 @@
+#include "gfx/Program.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+namespace Umbrella::Gfx {
+
+namespace {
+
+    template <size_t N>
+    std::array<GLint, N> ResourceProps(GLuint program, GLenum interface,
+        GLuint index, std::array<GLenum, N> const& props)
+    {
+        std::array<GLint, N> values {};
+        glGetProgramResourceiv(program, interface, index, GLsizei(N),
+            props.data(), GLsizei(N), nullptr, values.data());
+        return values;
+    }
+
+    std::string ResourceName(
+        GLuint program, GLenum interface, GLuint index, GLint nameLength)
+    {
+        std::string name(static_cast<size_t>(std::max(nameLength, 1)), '\0');
+        GLsizei length = 0;
+        glGetProgramResourceName(program, interface, index,
+            static_cast<GLsizei>(name.size()), &length, name.data());
+        name.resize(static_cast<size_t>(length));
+        return name;
+    }
+
+    GLuint NumResources(GLuint program, GLenum interface)
+    {
+        GLint count = 0;
+        glGetProgramInterfaceiv(
+            program, interface, GL_ACTIVE_RESOURCES, &count);
+        return static_cast<GLuint>(std::max(count, 0));
+    }
+
+    template <typename T>
+    T const* FindById(std::vector<T> const& resources, uint64_t id)
+    {
+        auto it = std::ranges::lower_bound(resources, id, {}, &T::id);
+        return it != resources.end() && it->id == id ? &*it : nullptr;
+    }
+
+} // namespace
+
+Program::Program(GLuint program)
+    : m_program(program)
+{
+    Reflect();
+}
+
+Program::Program(Program&& other) noexcept
+    : m_program(std::exchange(other.m_program, 0))
+    , m_uniforms(std::move(other.m_uniforms))
+    , m_uniformBlocks(std::move(other.m_uniformBlocks))
+    , m_inputs(std::move(other.m_inputs))
+{
+}
+
+Program& Program::operator=(Program&& other) noexcept
+{
+    if (this != &other) {
+        Release();
+        m_program = std::exchange(other.m_program, 0);
+        m_uniforms = std::move(other.m_uniforms);
+        m_uniformBlocks = std::move(other.m_uniformBlocks);
+        m_inputs = std::move(other.m_inputs);
+    }
+    return *this;
+}
+
+Program::~Program()
+{
+    Release();
+}
+
+void Program::Release()
+{
+    if (m_program) {
+        glDeleteProgram(m_program);
+        m_program = 0;
+    }
+}
+
+void Program::Reflect()
+{
+    for (GLuint i = 0; i < NumResources(m_program, GL_UNIFORM); i++) {
+        auto [nameLength, type, arraySize, location, blockIndex, offset]
+            = ResourceProps(m_program, GL_UNIFORM, i,
+                std::array<GLenum, 6> {GL_NAME_LENGTH, GL_TYPE,
+                    GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX, GL_OFFSET});
+        Uniform uniform {
+            .name = ResourceName(m_program, GL_UNIFORM, i, nameLength),
+            .id = 0,
+            .type = static_cast<GLenum>(type),
+            .arraySize = arraySize,
+            .location = location,
+            .blockIndex = blockIndex,
+            .offset = offset,
+        };
+        uniform.id = ShaderId(uniform.name);
+        m_uniforms.push_back(std::move(uniform));
+    }
+
+    for (GLuint i = 0; i < NumResources(m_program, GL_UNIFORM_BLOCK); i++) {
+        auto [nameLength, binding, dataSize] = ResourceProps(m_program,
+            GL_UNIFORM_BLOCK, i,
+            std::array<GLenum, 3> {
+                GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE});
+        UniformBlock block {
+            .name = ResourceName(m_program, GL_UNIFORM_BLOCK, i, nameLength),
+            .id = 0,
+            .index = i,
+            .binding = binding,
+            .dataSize = dataSize,
+        };
+        block.id = ShaderId(block.name);
+        m_uniformBlocks.push_back(std::move(block));
+    }
+
+    for (GLuint i = 0; i < NumResources(m_program, GL_PROGRAM_INPUT); i++) {
+        auto [nameLength, type, location] = ResourceProps(m_program,
+            GL_PROGRAM_INPUT, i,
+            std::array<GLenum, 3> {GL_NAME_LENGTH, GL_TYPE, GL_LOCATION});
+        Input input {
+            .name = ResourceName(m_program, GL_PROGRAM_INPUT, i, nameLength),
+            .id = 0,
+            .type = static_cast<GLenum>(type),
+            .location = location,
+        };
+        input.id = ShaderId(input.name);
+        m_inputs.push_back(std::move(input));
+    }
+
+    std::ranges::sort(m_uniforms, {}, &Uniform::id);
+    std::ranges::sort(m_uniformBlocks, {}, &UniformBlock::id);
+    std::ranges::sort(m_inputs, {}, &Input::id);
+}
+
+Program::Uniform const* Program::FindUniform(uint64_t id) const
+{
+    return FindById(m_uniforms, id);
+}
+
+Program::UniformBlock const* Program::FindUniformBlock(uint64_t id) const
+{
+    return FindById(m_uniformBlocks, id);
+}
+
+Program::Input const* Program::FindInput(uint64_t id) const
+{
+    return FindById(m_inputs, id);
+}
+
+GLint Program::UniformLocation(uint64_t id) const
+{
+    Uniform const* uniform = FindUniform(id);
+    return uniform ? uniform->location : -1;
+}
+
+bool Program::ValidateBlock(BlockLayout const& layout) const
+{
+    UniformBlock const* block = FindUniformBlock(ShaderId(layout.name));
+    if (!block) {
+        return true;
+    }
+
+    bool valid = true;
+    if (block->binding != static_cast<GLint>(layout.binding)) {
+        spdlog::error("Uniform block {} is bound to {} in the shader, {} in "
+                      "C++",
+            layout.name, block->binding, layout.binding);
+        valid = false;
+    }
+    if (block->dataSize != static_cast<GLint>(layout.size)) {
+        spdlog::error("Uniform block {} is {} bytes in the shader, {} in C++",
+            layout.name, block->dataSize, layout.size);
+        valid = false;
+    }
+
+    size_t numMembers = 0;
+    for (Uniform const& uniform : m_uniforms) {
+        numMembers += uniform.blockIndex == static_cast<GLint>(block->index);
+    }
+    if (numMembers != layout.members.size()) {
+        spdlog::error("Uniform block {} has {} members in the shader, {} in "
+                      "C++",
+            layout.name, numMembers, layout.members.size());
+        valid = false;
+    }
+
+    for (BlockMember const& member : layout.members) {
+        Uniform const* uniform = FindUniform(ShaderId(member.name));
+        if (!uniform
+            || uniform->blockIndex != static_cast<GLint>(block->index)) {
+            spdlog::error("{} is not a member of uniform block {}",
+                member.name, layout.name);
+            valid = false;
+        } else if (uniform->type != member.type
+            || uniform->offset != static_cast<GLint>(member.offset)) {
+            spdlog::error("{} is type {:#x} at offset {} in the shader, type "
+                          "{:#x} at offset {} in C++",
+                member.name, uniform->type, uniform->offset, member.type,
+                member.offset);
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+bool Program::ValidateInputs(std::span<InputBinding const> bindings) const
+{
+    bool valid = true;
+    for (InputBinding const& binding : bindings) {
+        Input const* input = FindInput(ShaderId(binding.name));
+        if (input && input->location != binding.location) {
+            spdlog::error("Vertex input {} is at location {} in the shader, "
+                          "{} in C++",
+                binding.name, input->location, binding.location);
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+} // namespace Umbrella::Gfx
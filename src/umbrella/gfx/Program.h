@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/gl.h>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Umbrella::Gfx {
+
+// FNV-1a of a resource name, so lookups can use an ID computed at compile
+// time instead of hashing a string every frame.
+constexpr uint64_t ShaderId(std::string_view name)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+    }
+    return hash;
+}
+
+// A member of a uniform block as the C++ side lays it out. Names are the
+// ones GL reports, i.e. "Block.member" when the block has an instance name.
+struct BlockMember {
+    std::string_view name;
+    GLenum type;
+    uint32_t offset;
+};
+
+struct BlockLayout {
+    std::string_view name;
+    GLuint binding;
+    size_t size;
+    std::span<BlockMember const> members;
+};
+
+// A vertex input and the attribute location the VAO feeds it from.
+struct InputBinding {
+    std::string_view name;
+    GLint location;
+};
+
+// A linked program and everything it exposes, reflected once at link time.
+class Program {
+public:
+    struct Uniform {
+        std::string name;
+        uint64_t id {};
+        GLenum type {};
+        GLint arraySize {};
+        // -1 for members of a uniform block, which have an offset instead.
+        GLint location {-1};
+        GLint blockIndex {-1};
+        GLint offset {-1};
+    };
+
+    struct UniformBlock {
+        std::string name;
+        uint64_t id {};
+        GLuint index {};
+        GLint binding {};
+        GLint dataSize {};
+    };
+
+    struct Input {
+        std::string name;
+        uint64_t id {};
+        GLenum type {};
+        GLint location {-1};
+    };
+
+    // Takes ownership of a linked program.
+    explicit Program(GLuint program);
+
+    Program(Program&& other) noexcept;
+    Program& operator=(Program&& other) noexcept;
+    Program(Program const&) = delete;
+    Program& operator=(Program const&) = delete;
+    ~Program();
+
+    GLuint Id() const { return m_program; }
+
+    // Lookups return nullptr for names that are not active.
+    Uniform const* FindUniform(uint64_t id) const;
+    UniformBlock const* FindUniformBlock(uint64_t id) const;
+    Input const* FindInput(uint64_t id) const;
+
+    // -1 when the uniform is not active, which glUniform* ignores.
+    GLint UniformLocation(uint64_t id) const;
+
+    std::span<Uniform const> Uniforms() const { return m_uniforms; }
+    std::span<UniformBlock const> UniformBlocks() const
+    {
+        return m_uniformBlocks;
+    }
+    std::span<Input const> Inputs() const { return m_inputs; }
+
+    // Logs every difference between the C++ layout and the shader's block
+    // and returns false if there was any. A block the program does not use
+    // passes.
+    bool ValidateBlock(BlockLayout const& layout) const;
+    bool ValidateInputs(std::span<InputBinding const> bindings) const;
+
+private:
+    void Reflect();
+    void Release();
+
+    GLuint m_program {};
+    // Sorted by id.
+    std::vector<Uniform> m_uniforms;
+    std::vector<UniformBlock> m_uniformBlocks;
+    std::vector<Input> m_inputs;
+};
+
+} // namespace Umbrella::Gfx
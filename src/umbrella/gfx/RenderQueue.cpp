@@ -0,0 +1,108 @@
+#include "gfx/RenderQueue.h"
+
+#include <algorithm>
+#include <array>
+
+namespace Umbrella::Gfx {
+
+namespace {
+
+    constexpr uint32_t programBits = 10;
+    constexpr uint32_t materialBits = 16;
+    constexpr uint32_t vertexArrayBits = 10;
+    constexpr uint32_t depthBits = 24;
+
+    constexpr uint64_t Field(uint64_t value, uint32_t bits, uint32_t shift)
+    {
+        return (value & ((uint64_t {1} << bits) - 1)) << shift;
+    }
+
+} // namespace
+
+uint64_t MakeDrawKey(DrawKeyFields const& fields)
+{
+    constexpr uint32_t maxDepth = (1u << depthBits) - 1;
+    float depth = std::clamp(fields.depth, 0.0f, 1.0f);
+    if (fields.pass == RenderPass::Transparent) {
+        depth = 1.0f - depth;
+    }
+    uint64_t quantized
+        = static_cast<uint64_t>(depth * static_cast<float>(maxDepth));
+
+    constexpr uint32_t vertexArrayShift = depthBits;
+    constexpr uint32_t materialShift = vertexArrayShift + vertexArrayBits;
+    constexpr uint32_t programShift = materialShift + materialBits;
+    constexpr uint32_t passShift = programShift + programBits;
+    return Field(static_cast<uint64_t>(fields.pass), 64 - passShift, passShift)
+        | Field(fields.program, programBits, programShift)
+        | Field(fields.material, materialBits, materialShift)
+        | Field(fields.vertexArray, vertexArrayBits, vertexArrayShift)
+        | Field(quantized, depthBits, 0);
+}
+
+void RenderQueue::Clear()
+{
+    m_items.clear();
+    m_order.clear();
+}
+
+void RenderQueue::Push(DrawItem const& item)
+{
+    m_order.push_back(static_cast<uint32_t>(m_items.size()));
+    m_items.push_back(item);
+}
+
+void RenderQueue::Sort()
+{
+    size_t count = m_items.size();
+    m_entries.resize(count);
+    m_scratch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        m_entries[i] = {m_items[i].key, static_cast<uint32_t>(i)};
+    }
+
+    // Eight passes of eight bits, least significant first. A byte every key
+    // shares, such as the pass or the high bits of small ids, is skipped.
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        std::array<uint32_t, 256> counts {};
+        for (Entry const& entry : m_entries) {
+            counts[(entry.key >> shift) & 0xff]++;
+        }
+        if (count == 0 || counts[(m_entries[0].key >> shift) & 0xff] == count) {
+            continue;
+        }
+        uint32_t offset = 0;
+        for (uint32_t& bucket : counts) {
+            uint32_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+        for (Entry const& entry : m_entries) {
+            m_scratch[counts[(entry.key >> shift) & 0xff]++] = entry;
+        }
+        m_entries.swap(m_scratch);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        m_order[i] = m_entries[i].item;
+    }
+}
+
+void RenderQueue::Submit(StateCache& state) const
+{
+    GlApi const& gl = state.Gl();
+    for (uint32_t index : m_order) {
+        DrawItem const& item = m_items[index];
+        state.SetFlags(item.flags);
+        state.UseProgram(item.program);
+        state.BindVertexArray(item.vertexArray);
+        for (size_t unit = 0; unit < item.textures.size(); unit++) {
+            state.BindTexture(static_cast<GLuint>(unit), item.textures[unit]);
+        }
+        gl.multiDrawElementsIndirect(item.mode, item.indexType,
+            reinterpret_cast<void const*>(item.indirectOffset),
+            item.drawCount, 0);
+    }
+}
+
+} // namespace Umbrella::Gfx
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glad/gl.h>
+
+#include "gfx/StateCache.h"
+
+namespace Umbrella::Gfx {
+
+enum class RenderPass : uint8_t {
+    Opaque = 0,
+    Transparent = 1,
+};
+
+// What a draw is sorted by, most significant first. Passes run in order;
+// within one, draws group by program, then material, then vertex array,
+// so each of those changes as rarely as possible, and finally by depth.
+struct DrawKeyFields {
+    RenderPass pass {};
+    // Only the low bits of each id make it into the key. Ids that collide
+    // cost a few extra state changes, never a wrong draw: the item carries
+    // the real names.
+    uint32_t program {};
+    uint32_t material {};
+    uint32_t vertexArray {};
+    // View depth scaled into [0, 1]. Opaque draws go front to back, so
+    // early depth tests reject more, and transparent ones back to front.
+    float depth {};
+};
+
+// 4 bits pass, 10 program, 16 material, 10 vertex array, 24 depth.
+uint64_t MakeDrawKey(DrawKeyFields const& fields);
+
+// One multi-draw-indirect call and the state it needs.
+struct DrawItem {
+    uint64_t key {};
+    GLuint program {};
+    GLuint vertexArray {};
+    // Bound to units 0 and up. Has to stay alive until Submit().
+    std::span<GLuint const> textures;
+    uint32_t flags {};
+    GLenum mode {GL_TRIANGLES};
+    GLenum indexType {GL_UNSIGNED_INT};
+    // Into the bound GL_DRAW_INDIRECT_BUFFER.
+    GLintptr indirectOffset {};
+    GLsizei drawCount {};
+};
+
+// Collects a frame's draws, sorts them by key with an LSD radix sort and
+// submits them through a StateCache, so state only changes between groups.
+class RenderQueue {
+public:
+    void Clear();
+    void Push(DrawItem const& item);
+    // Stable, so draws with equal keys keep the order they were pushed in.
+    void Sort();
+    // In key order once sorted, push order otherwise.
+    void Submit(StateCache& state) const;
+
+    std::span<DrawItem const> Items() const { return m_items; }
+    // Indices into Items() in submission order.
+    std::span<uint32_t const> Order() const { return m_order; }
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    std::vector<DrawItem> m_items;
+    std::vector<Entry> m_entries;
+    std::vector<Entry> m_scratch;
+    std::vector<uint32_t> m_order;
+};
+
+} // namespace Umbrella::Gfx
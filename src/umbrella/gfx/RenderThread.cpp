@@ -0,0 +1,99 @@
+#include "gfx/RenderThread.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "util/Profiler.h"
+
+namespace Umbrella::Gfx {
+
+RenderThread::RenderThread(uint32_t numPackets, RenderThreadHooks hooks)
+    : m_numPackets(std::clamp(numPackets, minPackets, maxPackets))
+    , m_hooks(std::move(hooks))
+{
+    for (uint32_t packet = 0; packet < m_numPackets; packet++) {
+        m_free.push_back(packet);
+    }
+    m_thread = std::thread([this]() { Loop(); });
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_queuedChanged.notify_one();
+    m_thread.join();
+}
+
+uint32_t RenderThread::Acquire()
+{
+    UMBRELLA_PROFILE_ZONE("Wait for packet");
+    std::unique_lock lock(m_mutex);
+    m_freeChanged.wait(lock, [this]() { return !m_free.empty(); });
+    uint32_t packet = m_free.front();
+    m_free.pop_front();
+    return packet;
+}
+
+void RenderThread::Submit(uint32_t packet)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_queued.push_back(packet);
+    }
+    m_queuedChanged.notify_one();
+}
+
+void RenderThread::Release(uint32_t packet)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_free.push_front(packet);
+    }
+    m_freeChanged.notify_all();
+}
+
+void RenderThread::Flush()
+{
+    UMBRELLA_PROFILE_ZONE("Flush render thread");
+    std::unique_lock lock(m_mutex);
+    m_freeChanged.wait(
+        lock, [this]() { return m_queued.empty() && !m_rendering; });
+}
+
+void RenderThread::Loop()
+{
+    Util::Profiler::Instance().SetThreadName("render");
+    if (m_hooks.begin) {
+        m_hooks.begin();
+    }
+
+    std::unique_lock lock(m_mutex);
+    while (true) {
+        m_queuedChanged.wait(
+            lock, [this]() { return !m_queued.empty() || m_stopping; });
+        if (m_queued.empty()) {
+            break;
+        }
+        uint32_t packet = m_queued.front();
+        m_queued.pop_front();
+        m_rendering = true;
+        lock.unlock();
+
+        m_hooks.render(packet);
+
+        lock.lock();
+        m_rendering = false;
+        m_free.push_back(packet);
+        m_freeChanged.notify_all();
+    }
+    lock.unlock();
+
+    if (m_hooks.end) {
+        m_hooks.end();
+    }
+}
+
+} // namespace Umbrella::Gfx
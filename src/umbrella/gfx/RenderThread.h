@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Umbrella::Gfx {
+
+// What the render thread runs. begin and end run on it before the first
+// frame and after the last, to take the GL context and hand it back.
+struct RenderThreadHooks {
+    std::function<void()> begin;
+    // Renders and presents the given packet.
+    std::function<void(uint32_t packet)> render;
+    std::function<void()> end;
+};
+
+// Submits frames on a thread of its own, from a fixed ring of packets the
+// caller owns. A packet is either free, being filled by the producing
+// thread, queued, or being rendered; the producer only ever writes the one
+// it acquired, and the render thread only reads the one it renders. With
+// two packets the producer builds frame N+1 while frame N is submitted,
+// for at most one frame of latency. A third lets it run one frame further
+// ahead, which hides uneven frames at the cost of another frame of latency.
+class RenderThread {
+public:
+    static constexpr uint32_t minPackets = 2;
+    static constexpr uint32_t maxPackets = 3;
+
+    RenderThread(uint32_t numPackets, RenderThreadHooks hooks);
+    RenderThread(RenderThread const&) = delete;
+    RenderThread& operator=(RenderThread const&) = delete;
+    // Renders everything submitted, then runs the end hook.
+    ~RenderThread();
+
+    // Blocks until a packet is free. Packets come round in order.
+    uint32_t Acquire();
+    // Queues an acquired packet for rendering.
+    void Submit(uint32_t packet);
+    // Hands back an acquired packet unrendered; it is the next acquired.
+    void Release(uint32_t packet);
+    // Blocks until every submitted packet has been rendered.
+    void Flush();
+
+    uint32_t NumPackets() const { return m_numPackets; }
+
+private:
+    void Loop();
+
+    uint32_t m_numPackets {};
+    RenderThreadHooks m_hooks;
+
+    std::mutex m_mutex;
+    std::condition_variable m_queuedChanged;
+    std::condition_variable m_freeChanged;
+    std::deque<uint32_t> m_free;
+    std::deque<uint32_t> m_queued;
+    bool m_rendering {};
+    bool m_stopping {};
+
+    std::thread m_thread;
+};
+
+} // namespace Umbrella::Gfx
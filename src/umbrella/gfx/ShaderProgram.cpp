@@ -1,57 +1,390 @@
 #include "gfx/ShaderProgram.h"
 
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <glad/gl.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
 #include <optional>
 #include <spdlog/spdlog.h>
 #include <string>
+#include <utility>
+
+#include "util/Hash.h"
+#include "util/MappedFile.h"
+#include "util/Profiler.h"
 
 namespace Umbrella::Gfx {
 
-std::optional<GLuint> CompileProgram(
-    std::string const& vsSource, std::string const& fsSource)
-{
-    GLint shadersOk = true;
+namespace {
+
+    // KHR_parallel_shader_compile and its ARB twin; the loader was generated
+    // without them.
+    constexpr GLenum completionStatus = 0x91B1;
+    using MaxShaderCompilerThreadsFn = void(GLAD_API_PTR*)(GLuint);
+
+    constexpr char programMagic[4] = {'U', 'P', 'R', 'G'};
+    constexpr uint32_t programVersion = 1;
+
+    struct ProgramCacheHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+    };
+
+    std::string WithDefines(
+        std::string const& source, std::span<std::string const> defines)
+    {
+        if (defines.empty()) {
+            return source;
+        }
+
+        // #version has to stay the first line.
+        size_t lineEnd = source.find('\n');
+        size_t insertAt = lineEnd == std::string::npos ? source.size()
+                                                       : lineEnd + 1;
+        std::string block = lineEnd == std::string::npos ? "\n" : "";
+        for (std::string const& define : defines) {
+            block += "#define " + define + "\n";
+        }
+        return std::string(source).insert(insertAt, block);
+    }
 
-    auto printErrorMsg = [](GLuint shader) -> void {
+    // Asks the driver to compile on as many threads as it likes. Returns
+    // false when it cannot compile in the background at all.
+    bool EnableParallelCompile()
+    {
+        GLint numExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+        char const* setter = nullptr;
+        for (GLint i = 0; i < numExtensions && !setter; i++) {
+            char const* name = reinterpret_cast<char const*>(
+                glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+            if (std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0) {
+                setter = "glMaxShaderCompilerThreadsKHR";
+            } else if (std::strcmp(name, "GL_ARB_parallel_shader_compile")
+                == 0) {
+                setter = "glMaxShaderCompilerThreadsARB";
+            }
+        }
+        if (!setter) {
+            return false;
+        }
+
+        auto maxThreads = reinterpret_cast<MaxShaderCompilerThreadsFn>(
+            glfwGetProcAddress(setter));
+        if (maxThreads) {
+            maxThreads(0xFFFFFFFF);
+        }
+        return true;
+    }
+
+    // Binaries are only good for the driver that produced them.
+    uint64_t DriverHash()
+    {
+        uint64_t hash = 0;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            char const* value
+                = reinterpret_cast<char const*>(glGetString(name));
+            size_t size = value ? std::strlen(value) + 1 : 0;
+            hash = Util::HashBytes(value, size, hash);
+        }
+        return hash;
+    }
+
+    uint64_t ProgramKey(
+        uint64_t driverHash, std::string const& vs, std::string const& fs)
+    {
+        uint64_t hash = driverHash;
+        for (std::string const* source : {&vs, &fs}) {
+            size_t size = source->size();
+            hash = Util::HashBytes(&size, sizeof(size), hash);
+            hash = Util::HashBytes(source->data(), size, hash);
+        }
+        return hash;
+    }
+
+    std::string ProgramCachePath(uint64_t key)
+    {
+        char name[16];
+        auto [end, error] = std::to_chars(name, name + sizeof(name), key, 16);
+        return "cache/shaders/" + std::string(name, end) + ".uprog";
+    }
+
+    // Returns a linked program, or nothing on a miss or when the driver
+    // rejects the binary.
+    std::optional<GLuint> LoadCachedProgram(
+        uint64_t key, uint32_t& numRejected)
+    {
+        std::string cachePath = ProgramCachePath(key);
+        std::optional<Util::MappedFile> file
+            = Util::MappedFile::Open(cachePath.c_str());
+        if (!file) {
+            return {};
+        }
+
+        ProgramCacheHeader header;
+        if (file->Size() < sizeof(header)) {
+            spdlog::warn("Shader cache {} is corrupt, recompiling", cachePath);
+            return {};
+        }
+        std::memcpy(&header, file->Data(), sizeof(header));
+        if (std::memcmp(header.magic, programMagic, sizeof(programMagic)) != 0
+            || header.version != programVersion || header.key != key
+            || header.binaryLength != file->Size() - sizeof(header)) {
+            spdlog::warn("Shader cache {} is corrupt or outdated, recompiling",
+                cachePath);
+            return {};
+        }
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.binaryFormat,
+            file->Data() + sizeof(header),
+            static_cast<GLsizei>(header.binaryLength));
+        GLint linked = false;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            spdlog::info(
+                "Shader cache {} was rejected by the driver, recompiling",
+                cachePath);
+            glDeleteProgram(program);
+            numRejected++;
+            return {};
+        }
+        return program;
+    }
+
+    bool WriteCachedProgram(GLuint program, uint64_t key)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return false;
+        }
+        std::vector<char> binary(static_cast<size_t>(length));
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        ProgramCacheHeader header {};
+        std::memcpy(header.magic, programMagic, sizeof(programMagic));
+        header.version = programVersion;
+        header.key = key;
+        header.binaryFormat = format;
+        header.binaryLength = static_cast<uint32_t>(length);
+
+        // Renamed into place, like the mesh cache.
+        std::string cachePath = ProgramCachePath(key);
+        std::string tempPath = cachePath + ".tmp";
+        std::error_code error;
+        std::filesystem::create_directories(
+            std::filesystem::path(cachePath).parent_path(), error);
+        {
+            std::ofstream stream(tempPath, std::ios::out | std::ios::binary);
+            stream.write(
+                reinterpret_cast<char const*>(&header), sizeof(header));
+            stream.write(binary.data(), length);
+            if (!stream) {
+                return false;
+            }
+        }
+        std::filesystem::rename(tempPath, cachePath, error);
+        return !error;
+    }
+
+    GLuint StartShader(GLenum stage, std::string const& source)
+    {
+        GLuint shader = glCreateShader(stage);
+        char const* sourceRaw = source.c_str();
+        glShaderSource(shader, 1, &sourceRaw, nullptr);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    void PrintShaderLog(GLuint shader)
+    {
         GLchar error[512];
         GLsizei errorLen = 0;
         glGetShaderInfoLog(shader, 512, &errorLen, error);
         spdlog::error("{}", error);
-    };
+    }
+
+    void PrintProgramLog(GLuint program)
+    {
+        GLchar error[512];
+        GLsizei errorLen = 0;
+        glGetProgramInfoLog(program, 512, &errorLen, error);
+        spdlog::error("{}", error);
+    }
+
+} // namespace
+
+ProgramBatch::ProgramBatch(
+    std::span<ProgramSource const> sources, bool useCache)
+    : m_start(std::chrono::steady_clock::now())
+{
+    // Drivers without binary formats cannot round-trip programs at all.
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    m_useCache = useCache && numFormats > 0;
+    m_stats.parallel = EnableParallelCompile();
 
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    char const* vsSourceRaw = vsSource.c_str();
-    glShaderSource(vertexShader, 1, &vsSourceRaw, nullptr);
-    glCompileShader(vertexShader);
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &shadersOk);
-    if (!shadersOk) {
-        printErrorMsg(vertexShader);
-        return {};
+    uint64_t driverHash = m_useCache ? DriverHash() : 0;
+    m_programs.reserve(sources.size());
+    for (ProgramSource const& source : sources) {
+        std::string vs = WithDefines(source.vsSource, source.defines);
+        std::string fs = WithDefines(source.fsSource, source.defines);
+
+        Pending pending;
+        if (m_useCache) {
+            pending.key = ProgramKey(driverHash, vs, fs);
+            std::optional<GLuint> cached
+                = LoadCachedProgram(pending.key, m_stats.cacheRejected);
+            if (cached) {
+                pending.program = *cached;
+                pending.fromCache = true;
+                pending.complete = true;
+                m_stats.cacheHits++;
+                m_programs.push_back(pending);
+                continue;
+            }
+        }
+
+        // No status queries here: any of them would wait for the compile.
+        pending.vertexShader = StartShader(GL_VERTEX_SHADER, vs);
+        pending.fragmentShader = StartShader(GL_FRAGMENT_SHADER, fs);
+        pending.program = glCreateProgram();
+        if (m_useCache) {
+            glProgramParameteri(
+                pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glAttachShader(pending.program, pending.vertexShader);
+        glAttachShader(pending.program, pending.fragmentShader);
+        glLinkProgram(pending.program);
+        m_stats.compiled++;
+        m_programs.push_back(pending);
     }
+}
 
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    char const* fsSourceRaw = fsSource.c_str();
-    glShaderSource(fragmentShader, 1, &fsSourceRaw, nullptr);
-    glCompileShader(fragmentShader);
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &shadersOk);
-    if (!shadersOk) {
-        printErrorMsg(fragmentShader);
-        return {};
+ProgramBatch::ProgramBatch(ProgramBatch&& other) noexcept
+    : m_programs(std::exchange(other.m_programs, {}))
+    , m_useCache(other.m_useCache)
+    , m_stats(other.m_stats)
+    , m_start(other.m_start)
+{
+}
+
+ProgramBatch& ProgramBatch::operator=(ProgramBatch&& other) noexcept
+{
+    if (this != &other) {
+        Release();
+        m_programs = std::exchange(other.m_programs, {});
+        m_useCache = other.m_useCache;
+        m_stats = other.m_stats;
+        m_start = other.m_start;
     }
+    return *this;
+}
 
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &shadersOk);
-    if (!shadersOk) {
-        return {};
+ProgramBatch::~ProgramBatch()
+{
+    Release();
+}
+
+void ProgramBatch::Release()
+{
+    for (Pending const& pending : m_programs) {
+        glDeleteShader(pending.vertexShader);
+        glDeleteShader(pending.fragmentShader);
+        glDeleteProgram(pending.program);
     }
+    m_programs.clear();
+}
+
+bool ProgramBatch::Poll()
+{
+    if (!m_stats.parallel) {
+        return true;
+    }
+
+    bool allComplete = true;
+    for (Pending& pending : m_programs) {
+        if (!pending.complete) {
+            GLint complete = false;
+            glGetProgramiv(pending.program, completionStatus, &complete);
+            pending.complete = complete;
+            allComplete &= pending.complete;
+        }
+    }
+    return allComplete;
+}
+
+std::vector<std::optional<Program>> ProgramBatch::Finish()
+{
+    UMBRELLA_PROFILE_ZONE("Finish programs");
+    std::vector<std::optional<Program>> programs;
+    programs.reserve(m_programs.size());
+    for (Pending& pending : m_programs) {
+        if (pending.fromCache) {
+            programs.emplace_back(std::exchange(pending.program, 0));
+            continue;
+        }
+
+        bool ok = true;
+        for (GLuint shader : {pending.vertexShader, pending.fragmentShader}) {
+            GLint compiled = false;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+            if (!compiled) {
+                PrintShaderLog(shader);
+                ok = false;
+            }
+        }
+        GLint linked = false;
+        glGetProgramiv(pending.program, GL_LINK_STATUS, &linked);
+        if (ok && !linked) {
+            PrintProgramLog(pending.program);
+        }
+        ok &= linked != 0;
+
+        glDetachShader(pending.program, pending.vertexShader);
+        glDetachShader(pending.program, pending.fragmentShader);
+        glDeleteShader(std::exchange(pending.vertexShader, 0));
+        glDeleteShader(std::exchange(pending.fragmentShader, 0));
+        if (!ok) {
+            glDeleteProgram(std::exchange(pending.program, 0));
+            programs.push_back({});
+            continue;
+        }
+
+        if (m_useCache && WriteCachedProgram(pending.program, pending.key)) {
+            m_stats.cacheWritten++;
+        }
+        programs.emplace_back(std::exchange(pending.program, 0));
+    }
+    m_programs.clear();
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    m_stats.ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - m_start)
+                     .count();
+    spdlog::info("Built {} shader programs in {:.1f} ms: {} from cache, {} "
+                 "compiled{}, {} cached binaries rejected",
+        programs.size(), m_stats.ms, m_stats.cacheHits, m_stats.compiled,
+        m_stats.parallel ? " in parallel" : "", m_stats.cacheRejected);
+    return programs;
+}
 
-    return shaderProgram;
+std::optional<Program> CompileProgram(std::string const& vsSource,
+    std::string const& fsSource, std::span<std::string const> defines)
+{
+    ProgramSource source {
+        .vsSource = vsSource,
+        .fsSource = fsSource,
+        .defines = {defines.begin(), defines.end()},
+    };
+    return std::move(ProgramBatch({&source, 1}).Finish().front());
 }
 
 } // namespace Umbrella::Gfx
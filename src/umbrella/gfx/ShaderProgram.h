@@ -1,12 +1,84 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <glad/gl.h>
 #include <optional>
+#include <span>
 #include <string>
+#include <vector>
+
+#include "gfx/Program.h"
 
 namespace Umbrella::Gfx {
 
-std::optional<GLuint> CompileProgram(
-    std::string const& vsSource, std::string const& fsSource);
+struct ProgramSource {
+    std::string vsSource;
+    std::string fsSource;
+    // Each define is inserted as "#define <define>" right after the #version
+    // line of both stages.
+    std::vector<std::string> defines;
+};
+
+struct ProgramBuildStats {
+    uint32_t cacheHits {};
+    uint32_t compiled {};
+    // Cached binaries the driver refused, e.g. after a driver update.
+    uint32_t cacheRejected {};
+    uint32_t cacheWritten {};
+    bool parallel {};
+    double ms {};
+};
+
+// Builds a set of programs together. Programs with a linked binary in
+// cache/shaders are loaded from it; the binary is keyed by the sources and
+// the GL vendor, renderer and version, so a driver change misses the cache
+// instead of loading an incompatible binary. The rest are compiled and
+// linked all at once, which lets a driver with
+// KHR_parallel_shader_compile work on them on its own threads while the
+// caller polls.
+class ProgramBatch {
+public:
+    explicit ProgramBatch(
+        std::span<ProgramSource const> sources, bool useCache = true);
+
+    ProgramBatch(ProgramBatch&& other) noexcept;
+    ProgramBatch& operator=(ProgramBatch&& other) noexcept;
+    ProgramBatch(ProgramBatch const&) = delete;
+    ProgramBatch& operator=(ProgramBatch const&) = delete;
+    ~ProgramBatch();
+
+    // True once every program has finished compiling and linking. Never
+    // blocks when the driver compiles in parallel; without that it reports
+    // true right away and Finish() does the waiting.
+    bool Poll();
+
+    // Waits for whatever is still compiling, reports errors, caches the
+    // new binaries and reflects every program. Programs that failed come
+    // back empty.
+    std::vector<std::optional<Program>> Finish();
+
+    ProgramBuildStats const& Stats() const { return m_stats; }
+
+private:
+    struct Pending {
+        GLuint program {};
+        GLuint vertexShader {};
+        GLuint fragmentShader {};
+        uint64_t key {};
+        bool fromCache {};
+        bool complete {};
+    };
+
+    void Release();
+
+    std::vector<Pending> m_programs;
+    bool m_useCache {};
+    ProgramBuildStats m_stats;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+std::optional<Program> CompileProgram(std::string const& vsSource,
+    std::string const& fsSource, std::span<std::string const> defines = {});
 
 } // namespace Umbrella::Gfx
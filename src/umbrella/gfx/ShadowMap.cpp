@@ -0,0 +1,139 @@
+#include "gfx/ShadowMap.h"
+
+#include <spdlog/spdlog.h>
+
+#include "util/Framework.h"
+
+namespace Umbrella::Gfx {
+
+std::unique_ptr<ShadowMap> ShadowMap::Create(
+    uint32_t resolution, uint32_t numCascades)
+{
+    std::unique_ptr<ShadowMap> shadowMap(new ShadowMap());
+    shadowMap->m_resolution = resolution;
+
+    GLsizei size = narrow_into<GLsizei>(resolution);
+    glGenTextures(1, &shadowMap->m_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap->m_texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, size, size,
+        narrow_into<GLsizei>(numCascades));
+    // Linear filtering with comparison gives 2x2 PCF for free. Outside the
+    // map everything is lit.
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(
+        GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(
+        GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    GLfloat const border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE,
+        GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    shadowMap->m_framebuffers.resize(numCascades);
+    glGenFramebuffers(narrow_into<GLsizei>(numCascades),
+        shadowMap->m_framebuffers.data());
+    bool complete = true;
+    for (uint32_t c = 0; c < numCascades; c++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, shadowMap->m_framebuffers[c]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+            shadowMap->m_texture, 0, narrow_into<GLint>(c));
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        complete &= glCheckFramebufferStatus(GL_FRAMEBUFFER)
+            == GL_FRAMEBUFFER_COMPLETE;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        spdlog::error("Could not create a {}x{} shadow map with {} cascades",
+            resolution, resolution, numCascades);
+        return {};
+    }
+
+    shadowMap->m_queries.resize(numCascades);
+    for (std::array<Query, queriesPerCascade>& queries :
+        shadowMap->m_queries) {
+        for (Query& query : queries) {
+            glGenQueries(2, query.ids.data());
+        }
+    }
+    shadowMap->m_nextQuery.resize(numCascades);
+    shadowMap->m_timings.resize(numCascades);
+    return shadowMap;
+}
+
+ShadowMap::~ShadowMap()
+{
+    for (std::array<Query, queriesPerCascade> const& queries : m_queries) {
+        for (Query const& query : queries) {
+            glDeleteQueries(2, query.ids.data());
+        }
+    }
+    glDeleteFramebuffers(
+        narrow_into<GLsizei>(m_framebuffers.size()), m_framebuffers.data());
+    glDeleteTextures(1, &m_texture);
+}
+
+void ShadowMap::BeginCascade(uint32_t cascade)
+{
+    // A cascade whose oldest render has not been read back yet goes
+    // untimed this time.
+    Query& query = m_queries[cascade][m_nextQuery[cascade]];
+    m_active = query.pending ? nullptr : &query;
+    if (m_active) {
+        glQueryCounter(query.ids[0], GL_TIMESTAMP);
+        m_nextQuery[cascade] = (m_nextQuery[cascade] + 1) % queriesPerCascade;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[cascade]);
+    GLsizei size = narrow_into<GLsizei>(m_resolution);
+    glViewport(0, 0, size, size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowMap::EndCascade()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (m_active) {
+        glQueryCounter(m_active->ids[1], GL_TIMESTAMP);
+        m_active->pending = true;
+        m_active = nullptr;
+    }
+}
+
+void ShadowMap::CollectTimings()
+{
+    for (size_t c = 0; c < m_queries.size(); c++) {
+        for (Query& query : m_queries[c]) {
+            if (!query.pending) {
+                continue;
+            }
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(
+                query.ids[1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                continue;
+            }
+            GLuint64 begin = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64v(query.ids[0], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(query.ids[1], GL_QUERY_RESULT, &end);
+            CascadeTiming& timing = m_timings[c];
+            timing.lastMs = static_cast<double>(end - begin) / 1e6;
+            timing.totalMs += timing.lastMs;
+            timing.timed++;
+            query.pending = false;
+        }
+    }
+}
+
+void ShadowMap::ResetTimings()
+{
+    for (CascadeTiming& timing : m_timings) {
+        timing = {};
+    }
+}
+
+} // namespace Umbrella::Gfx
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glad/gl.h>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace Umbrella::Gfx {
+
+// GPU time spent rendering one cascade.
+struct CascadeTiming {
+    uint64_t timed {};
+    double totalMs {};
+    double lastMs {};
+
+    double AverageMs() const
+    {
+        return timed == 0 ? 0.0 : totalMs / static_cast<double>(timed);
+    }
+};
+
+// Depth of every shadow cascade in one layer each of a 2D array texture,
+// sampled with hardware depth comparison. Renders into a layer are timed
+// with GL_TIMESTAMP pairs, which unlike GL_TIME_ELAPSED queries may sit
+// inside a frame that is being timed as a whole; results are read back
+// frames later, without waiting.
+class ShadowMap {
+public:
+    static std::unique_ptr<ShadowMap> Create(
+        uint32_t resolution, uint32_t numCascades);
+
+    ShadowMap(ShadowMap const&) = delete;
+    ShadowMap& operator=(ShadowMap const&) = delete;
+    ~ShadowMap();
+
+    GLuint Texture() const { return m_texture; }
+    uint32_t Resolution() const { return m_resolution; }
+
+    // Everything drawn until EndCascade() lands in the cascade's layer:
+    // binds its framebuffer and viewport and clears its depth. The caller
+    // restores its own viewport afterwards.
+    void BeginCascade(uint32_t cascade);
+    void EndCascade();
+
+    // Adds the timings that have arrived since the last call.
+    void CollectTimings();
+    std::span<CascadeTiming const> Timings() const { return m_timings; }
+    void ResetTimings();
+
+private:
+    // Renders of one cascade in flight at once, at most one per frame.
+    static constexpr uint32_t queriesPerCascade = 4;
+
+    struct Query {
+        std::array<GLuint, 2> ids {};
+        bool pending {};
+    };
+
+    ShadowMap() = default;
+
+    GLuint m_texture {};
+    uint32_t m_resolution {};
+    std::vector<GLuint> m_framebuffers;
+    std::vector<std::array<Query, queriesPerCascade>> m_queries;
+    std::vector<uint32_t> m_nextQuery;
+    std::vector<CascadeTiming> m_timings;
+    // The query of the cascade being rendered, if it is timed.
+    Query* m_active {};
+};
+
+} // namespace Umbrella::Gfx
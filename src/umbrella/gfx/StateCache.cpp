@@ -0,0 +1,108 @@
+#include "gfx/StateCache.h"
+
+namespace Umbrella::Gfx {
+
+namespace {
+
+    constexpr struct {
+        uint32_t flag;
+        GLenum capability;
+    } flagCapabilities[] = {
+        {static_cast<uint32_t>(RenderFlags::DepthTest), GL_DEPTH_TEST},
+        {static_cast<uint32_t>(RenderFlags::Blend), GL_BLEND},
+        {static_cast<uint32_t>(RenderFlags::CullFace), GL_CULL_FACE},
+    };
+
+} // namespace
+
+GlApi const& RealGl()
+{
+    // The GL entry points are only loaded once there is a context, so the
+    // table looks them up on every call rather than copying them now.
+    static GlApi const gl {
+        .useProgram = [](GLuint program) { glUseProgram(program); },
+        .bindVertexArray
+        = [](GLuint vertexArray) { glBindVertexArray(vertexArray); },
+        .bindTextureUnit =
+            [](GLuint unit, GLuint texture) {
+                glBindTextureUnit(unit, texture);
+            },
+        .enable = [](GLenum capability) { glEnable(capability); },
+        .disable = [](GLenum capability) { glDisable(capability); },
+        .multiDrawElementsIndirect =
+            [](GLenum mode, GLenum type, void const* indirect,
+                GLsizei drawCount, GLsizei stride) {
+                glMultiDrawElementsIndirect(
+                    mode, type, indirect, drawCount, stride);
+            },
+    };
+    return gl;
+}
+
+StateCache::StateCache(GlApi const& gl)
+    : m_gl(gl)
+{
+    Invalidate();
+}
+
+void StateCache::UseProgram(GLuint program)
+{
+    m_stats.requested++;
+    if (program != m_program) {
+        m_program = program;
+        m_gl.useProgram(program);
+        m_stats.issued++;
+    }
+}
+
+void StateCache::BindVertexArray(GLuint vertexArray)
+{
+    m_stats.requested++;
+    if (vertexArray != m_vertexArray) {
+        m_vertexArray = vertexArray;
+        m_gl.bindVertexArray(vertexArray);
+        m_stats.issued++;
+    }
+}
+
+void StateCache::BindTexture(GLuint unit, GLuint texture)
+{
+    m_stats.requested++;
+    if (unit >= numTextureUnits || texture != m_textures[unit]) {
+        if (unit < numTextureUnits) {
+            m_textures[unit] = texture;
+        }
+        m_gl.bindTextureUnit(unit, texture);
+        m_stats.issued++;
+    }
+}
+
+void StateCache::SetFlags(uint32_t flags)
+{
+    for (auto const& [flag, capability] : flagCapabilities) {
+        m_stats.requested++;
+        bool enabled = (flags & flag) != 0;
+        bool known = (m_knownFlags & flag) != 0;
+        if (known && enabled == ((m_flags & flag) != 0)) {
+            continue;
+        }
+        if (enabled) {
+            m_gl.enable(capability);
+        } else {
+            m_gl.disable(capability);
+        }
+        m_knownFlags |= flag;
+        m_flags = (m_flags & ~flag) | (flags & flag);
+        m_stats.issued++;
+    }
+}
+
+void StateCache::Invalidate()
+{
+    m_program = unknown;
+    m_vertexArray = unknown;
+    m_textures.fill(unknown);
+    m_knownFlags = 0;
+}
+
+} // namespace Umbrella::Gfx
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glad/gl.h>
+
+namespace Umbrella::Gfx {
+
+// The GL calls the state cache and render queue make. Going through a
+// table lets benchmarks count them against a mock without a context.
+struct GlApi {
+    void (*useProgram)(GLuint program);
+    void (*bindVertexArray)(GLuint vertexArray);
+    void (*bindTextureUnit)(GLuint unit, GLuint texture);
+    void (*enable)(GLenum capability);
+    void (*disable)(GLenum capability);
+    void (*multiDrawElementsIndirect)(GLenum mode, GLenum type,
+        void const* indirect, GLsizei drawCount, GLsizei stride);
+};
+
+// Forwards to the loaded GL functions.
+GlApi const& RealGl();
+
+// Fixed-function state a draw item can ask for. Draw items and SetFlags()
+// take a mask of them, as uint32_t.
+enum class RenderFlags : uint32_t {
+    DepthTest = 1 << 0,
+    Blend = 1 << 1,
+    CullFace = 1 << 2,
+};
+
+struct StateChangeStats {
+    // State changes asked for, and those that reached GL.
+    uint32_t requested {};
+    uint32_t issued {};
+
+    uint32_t Skipped() const { return requested - issued; }
+};
+
+// Remembers the state it last set and drops calls that would set it
+// again. Anything that changes the same state behind its back has to be
+// followed by Invalidate(), after which every piece of state counts as
+// unknown and the next call for it goes through.
+class StateCache {
+public:
+    static constexpr uint32_t numTextureUnits = 16;
+
+    explicit StateCache(GlApi const& gl = RealGl());
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vertexArray);
+    void BindTexture(GLuint unit, GLuint texture);
+    // Enables the flags that are set and disables the rest.
+    void SetFlags(uint32_t flags);
+
+    void Invalidate();
+
+    GlApi const& Gl() const { return m_gl; }
+    StateChangeStats const& Stats() const { return m_stats; }
+    void ResetStats() { m_stats = {}; }
+
+private:
+    static constexpr GLuint unknown = ~0u;
+
+    GlApi const& m_gl;
+    GLuint m_program {unknown};
+    GLuint m_vertexArray {unknown};
+    std::array<GLuint, numTextureUnits> m_textures {};
+    uint32_t m_flags {};
+    // Flags whose state is known.
+    uint32_t m_knownFlags {};
+    StateChangeStats m_stats;
+};
+
+} // namespace Umbrella::Gfx
@@ -0,0 +1,132 @@
+#include "gfx/StreamBuffer.h"
+
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+#include "util/Framework.h"
+
+namespace Umbrella::Gfx {
+
+std::optional<StreamBuffer> StreamBuffer::Create(
+    size_t bytesPerFrame, uint32_t numFrames)
+{
+    if (numFrames == 0 || numFrames > maxFrames) {
+        return {};
+    }
+
+    StreamBuffer stream;
+    stream.m_bytesPerFrame = bytesPerFrame;
+    stream.m_numFrames = numFrames;
+
+    // Coherent, so writes need no explicit flush before the draw.
+    constexpr GLbitfield flags
+        = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr size = narrow_into<GLsizeiptr>(bytesPerFrame * numFrames);
+    glGenBuffers(1, &stream.m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream.m_buffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+    stream.m_data = static_cast<std::byte*>(
+        glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (!stream.m_data) {
+        spdlog::error("Could not map a {} byte stream buffer", size);
+        return {};
+    }
+
+    // BeginFrame() advances before use, so the first frame gets region 0.
+    stream.m_frame = numFrames - 1;
+    return stream;
+}
+
+StreamBuffer::StreamBuffer(StreamBuffer&& other) noexcept
+    : m_buffer(std::exchange(other.m_buffer, 0))
+    , m_data(std::exchange(other.m_data, nullptr))
+    , m_bytesPerFrame(other.m_bytesPerFrame)
+    , m_numFrames(other.m_numFrames)
+    , m_frame(other.m_frame)
+    , m_used(other.m_used)
+    , m_fences(std::exchange(other.m_fences, {}))
+{
+}
+
+StreamBuffer& StreamBuffer::operator=(StreamBuffer&& other) noexcept
+{
+    if (this != &other) {
+        Release();
+        m_buffer = std::exchange(other.m_buffer, 0);
+        m_data = std::exchange(other.m_data, nullptr);
+        m_bytesPerFrame = other.m_bytesPerFrame;
+        m_numFrames = other.m_numFrames;
+        m_frame = other.m_frame;
+        m_used = other.m_used;
+        m_fences = std::exchange(other.m_fences, {});
+    }
+    return *this;
+}
+
+StreamBuffer::~StreamBuffer() { Release(); }
+
+void StreamBuffer::BeginFrame()
+{
+    m_frame = (m_frame + 1) % m_numFrames;
+    m_used = 0;
+
+    GLsync& fence = m_fences[m_frame];
+    if (!fence) {
+        return;
+    }
+    // Flush on the first wait so the fence is sure to be signaled.
+    GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true) {
+        GLenum status = glClientWaitSync(fence, waitFlags, 1'000'000);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED
+            || status == GL_WAIT_FAILED) {
+            break;
+        }
+        waitFlags = 0;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+std::optional<StreamBuffer::Allocation> StreamBuffer::Allocate(
+    size_t bytes, size_t alignment)
+{
+    size_t offset = (m_used + alignment - 1) / alignment * alignment;
+    if (offset + bytes > m_bytesPerFrame) {
+        return {};
+    }
+    m_used = offset + bytes;
+
+    size_t bufferOffset = m_frame * m_bytesPerFrame + offset;
+    return Allocation {
+        .data = m_data + bufferOffset,
+        .offset = narrow_into<GLintptr>(bufferOffset),
+    };
+}
+
+void StreamBuffer::EndFrame()
+{
+    m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::Release()
+{
+    for (GLsync& fence : m_fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (m_buffer) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &m_buffer);
+    }
+    m_buffer = 0;
+    m_data = nullptr;
+}
+
+} // namespace Umbrella::Gfx
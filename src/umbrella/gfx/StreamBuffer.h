@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <glad/gl.h>
+
+namespace Umbrella::Gfx {
+
+// A persistently mapped buffer split into one region per frame in flight.
+// The CPU writes the current frame's region while the GPU still reads the
+// previous ones; a fence per region keeps it from being overwritten early.
+class StreamBuffer {
+public:
+    static constexpr uint32_t maxFrames = 4;
+
+    static std::optional<StreamBuffer> Create(
+        size_t bytesPerFrame, uint32_t numFrames = 3);
+
+    StreamBuffer(StreamBuffer&& other) noexcept;
+    StreamBuffer& operator=(StreamBuffer&& other) noexcept;
+    StreamBuffer(StreamBuffer const&) = delete;
+    StreamBuffer& operator=(StreamBuffer const&) = delete;
+    ~StreamBuffer();
+
+    struct Allocation {
+        std::byte* data;
+        // Offset into Buffer(), for glBindBufferRange and indirect draws.
+        GLintptr offset;
+    };
+
+    // Moves on to the next region, waiting for the GPU to be done with it.
+    void BeginFrame();
+    // Returns nothing when the frame's region is full.
+    std::optional<Allocation> Allocate(size_t bytes, size_t alignment);
+    // Fences the region after the commands reading it were submitted.
+    void EndFrame();
+
+    GLuint Buffer() const { return m_buffer; }
+    size_t BytesPerFrame() const { return m_bytesPerFrame; }
+    // Allocated from the current frame's region so far.
+    size_t BytesUsed() const { return m_used; }
+
+private:
+    StreamBuffer() = default;
+    void Release();
+
+    GLuint m_buffer {};
+    std::byte* m_data {};
+    size_t m_bytesPerFrame {};
+    uint32_t m_numFrames {};
+    uint32_t m_frame {};
+    size_t m_used {};
+    std::array<GLsync, maxFrames> m_fences {};
+};
+
+} // namespace Umbrella::Gfx
@@ -0,0 +1,437 @@
+#include "gfx/TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+#include "assets/TextureCache.h"
+#include "util/Framework.h"
+#include "util/Profiler.h"
+#include "util/VirtualFileSystem.h"
+
+namespace Umbrella::Gfx {
+
+namespace {
+
+    // Keeps every staged block aligned for any pixel transfer.
+    constexpr size_t stagingAlignment = 256;
+
+    // From EXT_texture_compression_s3tc, which the loader was generated
+    // without.
+    constexpr GLenum compressedRgbS3tcDxt1 = 0x83F0;
+    constexpr GLenum compressedRgbaS3tcDxt5 = 0x83F3;
+
+    size_t AlignUp(size_t offset)
+    {
+        return (offset + stagingAlignment - 1) & ~(stagingAlignment - 1);
+    }
+
+    bool HasExtension(char const* extension)
+    {
+        GLint numExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+        for (GLint i = 0; i < numExtensions; i++) {
+            char const* name = reinterpret_cast<char const*>(
+                glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+            if (std::strcmp(name, extension) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    GLenum InternalFormat(Assets::TextureFormat format)
+    {
+        switch (format) {
+        case Assets::TextureFormat::Rgba8:
+            return GL_RGBA8;
+        case Assets::TextureFormat::Bc1:
+            return compressedRgbS3tcDxt1;
+        case Assets::TextureFormat::Bc3:
+            return compressedRgbaS3tcDxt5;
+        case Assets::TextureFormat::Bc7:
+            return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        }
+        return GL_RGBA8;
+    }
+
+} // namespace
+
+std::unique_ptr<TextureStreamer> TextureStreamer::Create(
+    TextureStreamerOptions options)
+{
+    bool s3tc = options.format == Assets::TextureFormat::Bc1
+        || options.format == Assets::TextureFormat::Bc3;
+    if (s3tc && !HasExtension("GL_EXT_texture_compression_s3tc")) {
+        spdlog::warn("No S3TC support, streaming textures uncompressed");
+        options.format = Assets::TextureFormat::Rgba8;
+    }
+    std::unique_ptr<TextureStreamer> streamer(new TextureStreamer(options));
+    streamer->m_internalFormat = InternalFormat(options.format);
+
+    constexpr GLbitfield flags
+        = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr size = narrow_into<GLsizeiptr>(options.stagingBytes);
+    glGenBuffers(1, &streamer->m_staging);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streamer->m_staging);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+    streamer->m_stagingData = static_cast<std::byte*>(
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!streamer->m_stagingData) {
+        spdlog::error("Could not map a {} byte texture staging buffer", size);
+        return {};
+    }
+
+    return streamer;
+}
+
+TextureStreamer::TextureStreamer(TextureStreamerOptions options)
+    : m_options(options)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    // Decode jobs have to finish before the state they use goes away.
+    Util::JobSystem::Instance().Wait(m_decodeJobs);
+
+    for (Fenced const& fenced : m_inFlight) {
+        glDeleteSync(fenced.fence);
+    }
+    glDeleteTextures(
+        narrow_into<GLsizei>(m_arrayTextures.size()), m_arrayTextures.data());
+    if (m_staging) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_staging);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &m_staging);
+    }
+}
+
+bool TextureStreamer::Exists(std::string_view path)
+{
+    return Util::VirtualFileSystem::Instance().Exists(path);
+}
+
+std::optional<TextureId> TextureStreamer::Request(std::string path)
+{
+    if (!Exists(path)) {
+        spdlog::error("Texture {} does not exist", path);
+        return {};
+    }
+    if (auto it = m_ids.find(path); it != m_ids.end()) {
+        return it->second;
+    }
+
+    TextureId id = static_cast<TextureId>(m_entries.size());
+    m_ids.emplace(path, id);
+    m_entries.push_back({.path = path, .requested = Clock::now()});
+    m_numPending++;
+    m_decodeJobs.push_back(Util::JobSystem::Instance().Schedule(
+        "Decode " + path, [this, id, path]() { Decode(id, path); }));
+    return id;
+}
+
+void TextureStreamer::Decode(TextureId id, std::string const& path)
+{
+    std::optional<Assets::Image> image
+        = Assets::LoadTexture(path.c_str(), m_options.format);
+
+    std::lock_guard lock(m_mutex);
+    m_decoded.push_back({id, std::move(image)});
+}
+
+double TextureStreamer::MsSince(Clock::time_point start) const
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+void TextureStreamer::Retire()
+{
+    while (!m_inFlight.empty()) {
+        GLenum status = glClientWaitSync(m_inFlight.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED
+            && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync(m_inFlight.front().fence);
+        m_inFlight.pop_front();
+    }
+}
+
+std::optional<size_t> TextureStreamer::Stage(size_t bytes)
+{
+    size_t size = AlignUp(bytes);
+    size_t capacity = m_options.stagingBytes;
+    bool empty = m_inFlight.empty() && !m_frameBegin;
+    if (empty) {
+        m_head = 0;
+    }
+    size_t tail = !m_inFlight.empty() ? m_inFlight.front().begin
+        : m_frameBegin                ? *m_frameBegin
+                                      : m_head;
+
+    // The used part runs from tail to head, wrapping around the end. Head
+    // never catches up with tail, so head == tail always means empty.
+    std::optional<size_t> offset;
+    if (empty || m_head >= tail) {
+        if (capacity - m_head >= size) {
+            offset = m_head;
+        } else if (tail > size) {
+            offset = 0;
+        }
+    } else if (tail - m_head > size) {
+        offset = m_head;
+    }
+
+    if (offset) {
+        if (!m_frameBegin) {
+            m_frameBegin = *offset;
+        }
+        m_head = *offset + size;
+    }
+    return offset;
+}
+
+std::optional<uint32_t> TextureStreamer::AllocateLayer(Entry& entry)
+{
+    TextureLoadStats const& stats = entry.stats;
+    auto sameSize = [&](ArrayInfo const& info) {
+        return info.width == stats.width && info.height == stats.height
+            && info.levels == stats.levels;
+    };
+    auto found = std::ranges::find_if(m_arrays, sameSize);
+    uint32_t array = static_cast<uint32_t>(found - m_arrays.begin());
+    if (found == m_arrays.end()) {
+        if (m_arrays.size() == maxArrays) {
+            return {};
+        }
+        m_arrays.push_back({
+            .width = stats.width,
+            .height = stats.height,
+            .levels = stats.levels,
+            .capacity = 0,
+            .numLayers = 0,
+        });
+        m_arrayTextures.push_back(0);
+    }
+    if (m_arrays[array].numLayers == m_arrays[array].capacity) {
+        Grow(array);
+    }
+    entry.layer = m_arrays[array].numLayers++;
+    return array;
+}
+
+void TextureStreamer::Grow(uint32_t array)
+{
+    // Immutable storage cannot grow in place, so the layers move into a
+    // new array twice the size. The copy runs on the GPU, after every
+    // upload already made into the old one.
+    ArrayInfo& info = m_arrays[array];
+    uint32_t capacity = info.capacity == 0
+        ? std::max(m_options.arrayLayers, 1u)
+        : 2 * info.capacity;
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, narrow_into<GLsizei>(info.levels),
+        m_internalFormat, narrow_into<GLsizei>(info.width),
+        narrow_into<GLsizei>(info.height), narrow_into<GLsizei>(capacity));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(
+        GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    GLuint& old = m_arrayTextures[array];
+    if (old != 0) {
+        for (uint32_t level = 0; level < info.levels; level++) {
+            GLint glLevel = narrow_into<GLint>(level);
+            glCopyImageSubData(old, GL_TEXTURE_2D_ARRAY, glLevel, 0, 0, 0,
+                texture, GL_TEXTURE_2D_ARRAY, glLevel, 0, 0, 0,
+                narrow_into<GLsizei>(std::max(info.width >> level, 1u)),
+                narrow_into<GLsizei>(std::max(info.height >> level, 1u)),
+                narrow_into<GLsizei>(info.numLayers));
+        }
+        glDeleteTextures(1, &old);
+    }
+    old = texture;
+    info.capacity = capacity;
+}
+
+bool TextureStreamer::UploadSome(Entry& entry, size_t& budget)
+{
+    Assets::Image const& image = *entry.image;
+    while (budget > 0) {
+        Assets::ImageLevel const& level = image.levels[entry.uploadLevel];
+        size_t rowBytes = image.RowBytes(entry.uploadLevel);
+        uint32_t numRows = image.NumRows(entry.uploadLevel);
+        uint32_t rows = std::min(numRows - entry.uploadRow,
+            static_cast<uint32_t>(std::max<size_t>(budget / rowBytes, 1)));
+
+        // Halve the band until it fits in the ring; give up for this frame
+        // once not even a single row does.
+        std::optional<size_t> offset;
+        for (; rows > 0 && !(offset = Stage(rows * rowBytes)); rows /= 2) {
+        }
+        if (!offset) {
+            return false;
+        }
+
+        size_t bytes = rows * rowBytes;
+        std::memcpy(m_stagingData + *offset,
+            level.pixels.data() + entry.uploadRow * rowBytes, bytes);
+
+        // Rows are block rows for block formats; the last band of a level
+        // may end in a partial block.
+        uint32_t blockDim = Assets::BlockDim(image.format);
+        uint32_t y = entry.uploadRow * blockDim;
+        uint32_t height = std::min(rows * blockDim, level.height - y);
+        GLint glLevel = narrow_into<GLint>(entry.uploadLevel);
+        void* source = reinterpret_cast<void*>(*offset);
+        GLint layer = narrow_into<GLint>(entry.layer);
+        if (image.format == Assets::TextureFormat::Rgba8) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, glLevel, 0,
+                narrow_into<GLint>(y), layer,
+                narrow_into<GLsizei>(level.width),
+                narrow_into<GLsizei>(height), 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                source);
+        } else {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, glLevel, 0,
+                narrow_into<GLint>(y), layer,
+                narrow_into<GLsizei>(level.width),
+                narrow_into<GLsizei>(height), 1, m_internalFormat,
+                narrow_into<GLsizei>(bytes), source);
+        }
+        budget -= std::min(budget, bytes);
+        entry.uploadRow += rows;
+        if (entry.uploadRow < numRows) {
+            continue;
+        }
+
+        // The level is complete, so sampling may start from it.
+        entry.visibleLevel = entry.uploadLevel;
+        if (!entry.visible) {
+            entry.visible = true;
+            entry.stats.firstMipMs = MsSince(entry.requested);
+        }
+        if (entry.uploadLevel == 0) {
+            entry.complete = true;
+            return true;
+        }
+        entry.uploadLevel--;
+        entry.uploadRow = 0;
+    }
+    return true;
+}
+
+void TextureStreamer::Update()
+{
+    UMBRELLA_PROFILE_ZONE("Stream textures");
+    Retire();
+
+    std::vector<Decoded> decoded;
+    {
+        std::lock_guard lock(m_mutex);
+        decoded.swap(m_decoded);
+    }
+    for (Decoded& result : decoded) {
+        Entry& entry = m_entries[result.id];
+        entry.stats.decodedMs = MsSince(entry.requested);
+        if (!result.image || result.image->levels.empty()) {
+            spdlog::error("Could not decode texture {}", entry.path);
+            entry.failed = true;
+            m_numPending--;
+            continue;
+        }
+
+        Assets::ImageLevel const& base = result.image->levels.front();
+        entry.stats.width = base.width;
+        entry.stats.height = base.height;
+        entry.stats.levels
+            = static_cast<uint32_t>(result.image->levels.size());
+        for (Assets::ImageLevel const& level : result.image->levels) {
+            entry.stats.bytes += level.pixels.size();
+        }
+        entry.array = AllocateLayer(entry);
+        if (!entry.array) {
+            spdlog::error("Texture {} needs more than {} texture arrays",
+                entry.path, maxArrays);
+            entry.failed = true;
+            m_numPending--;
+            continue;
+        }
+        entry.uploadLevel = entry.stats.levels - 1;
+        entry.image = std::move(result.image);
+    }
+
+    // Textures upload one after the other, in request order.
+    size_t budget = m_options.uploadBytesPerFrame;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_staging);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (Entry& entry : m_entries) {
+        if (!entry.image || entry.complete) {
+            continue;
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrayTextures[*entry.array]);
+        if (!UploadSome(entry, budget)) {
+            break;
+        }
+        if (entry.complete) {
+            entry.stats.completeMs = MsSince(entry.requested);
+            entry.image.reset();
+            m_numPending--;
+            spdlog::info("Streamed texture {} ({}x{}, {} mips, {} KiB): "
+                         "decoded after {:.1f} ms, first mip after {:.1f} "
+                         "ms, complete after {:.1f} ms",
+                entry.path, entry.stats.width, entry.stats.height,
+                entry.stats.levels, entry.stats.bytes / 1024,
+                entry.stats.decodedMs,
+                entry.stats.firstMipMs, entry.stats.completeMs);
+        }
+        if (budget == 0) {
+            break;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    UMBRELLA_PROFILE_COUNTER("Texture bytes uploaded",
+        m_options.uploadBytesPerFrame - budget);
+
+    if (m_frameBegin) {
+        m_inFlight.push_back({
+            .begin = *m_frameBegin,
+            .fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0),
+        });
+        m_frameBegin.reset();
+    }
+}
+
+std::optional<TextureSlot> TextureStreamer::Slot(TextureId id) const
+{
+    Entry const& entry = m_entries[id];
+    if (!entry.visible) {
+        return {};
+    }
+    return TextureSlot {
+        .array = *entry.array,
+        .layer = entry.layer,
+        .minLevel = entry.visibleLevel,
+    };
+}
+
+TextureLoadStats const& TextureStreamer::Stats(TextureId id) const
+{
+    return m_entries[id].stats;
+}
+
+bool TextureStreamer::Idle() const
+{
+    return m_numPending == 0;
+}
+
+} // namespace Umbrella::Gfx
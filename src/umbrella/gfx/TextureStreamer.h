@@ -0,0 +1,171 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <glad/gl.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "assets/Image.h"
+#include "util/JobSystem.h"
+
+namespace Umbrella::Gfx {
+
+using TextureId = uint32_t;
+
+struct TextureStreamerOptions {
+    // Size of the persistently mapped upload ring.
+    size_t stagingBytes = 16 << 20;
+    // Upload budget per Update(), so a large texture is spread over frames.
+    size_t uploadBytesPerFrame = 4 << 20;
+    // Layers a new texture array starts with. A full array doubles.
+    uint32_t arrayLayers = 4;
+    // Block formats are baked into the texture cache on first use. BC1 and
+    // BC3 fall back to RGBA8 when the driver has no S3TC.
+    Assets::TextureFormat format = Assets::TextureFormat::Bc7;
+};
+
+// Milliseconds from the request, for each stage of a texture's load.
+struct TextureLoadStats {
+    uint32_t width {};
+    uint32_t height {};
+    uint32_t levels {};
+    // Size of the whole mip chain in video memory.
+    size_t bytes {};
+    double decodedMs {};
+    // When the coarsest mip became visible, and when all of them were.
+    double firstMipMs {};
+    double completeMs {};
+};
+
+// Where a texture lives once its first mip has arrived.
+struct TextureSlot {
+    // Into TextureStreamer::Arrays().
+    uint32_t array {};
+    uint32_t layer {};
+    // Finest mip uploaded so far. Sampling has to stay at or above it, as
+    // the finer ones hold nothing yet.
+    uint32_t minLevel {};
+};
+
+// Loads textures without stalling the frame. Jobs decode the files,
+// build the mip chains and compress them, or read all of that back from
+// the texture cache; Update() copies them into a ring of persistently
+// mapped pixel unpack buffers and uploads from there into immutable
+// storage, coarsest mip first. Textures with the same size and mip count
+// share a 2D array texture, one layer each, so a single draw can sample
+// all of them. A layer's slot reports the finest mip uploaded so far, and
+// shaders clamp their LOD to it: a blurry version shows up almost at once
+// and sharpens as the rest streams in. Each frame's uploads are fenced, and
+// ring space is only reused once its fence has signalled; when the ring is
+// full, uploads wait for a later frame rather than for the GPU.
+class TextureStreamer {
+public:
+    // Distinct texture sizes, each an array, that can be streamed at once.
+    // Shaders declare this many array samplers.
+    static constexpr uint32_t maxArrays = 8;
+
+    static std::unique_ptr<TextureStreamer> Create(
+        TextureStreamerOptions options = {});
+
+    TextureStreamer(TextureStreamer const&) = delete;
+    TextureStreamer& operator=(TextureStreamer const&) = delete;
+    ~TextureStreamer();
+
+    // Whether Request() finds path, loose or in a mounted pack.
+    static bool Exists(std::string_view path);
+
+    // Returns nothing when the file does not exist. Requesting a path
+    // again returns the same texture. Decode errors show up later in the
+    // log, and the texture never gets a slot.
+    std::optional<TextureId> Request(std::string path);
+
+    // Call once per frame on the GL thread.
+    void Update();
+
+    // Nothing until the first mip of the texture arrives.
+    std::optional<TextureSlot> Slot(TextureId id) const;
+    // GL_TEXTURE_2D_ARRAY names. They change when an array grows, so they
+    // are only good until the next Update().
+    std::span<GLuint const> Arrays() const { return m_arrayTextures; }
+    TextureLoadStats const& Stats(TextureId id) const;
+    // True when nothing is left to decode or upload.
+    bool Idle() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::string path;
+        Clock::time_point requested;
+        std::optional<uint32_t> array {};
+        uint32_t layer {};
+        std::optional<Assets::Image> image {};
+        // Next level to upload, counting down, and the next row in it.
+        uint32_t uploadLevel {};
+        uint32_t uploadRow {};
+        bool failed {};
+        bool visible {};
+        bool complete {};
+        // Finest level uploaded so far, once visible.
+        uint32_t visibleLevel {};
+        TextureLoadStats stats {};
+    };
+
+    // Size every layer of an array shares.
+    struct ArrayInfo {
+        uint32_t width {};
+        uint32_t height {};
+        uint32_t levels {};
+        uint32_t capacity {};
+        uint32_t numLayers {};
+    };
+
+    struct Decoded {
+        TextureId id {};
+        std::optional<Assets::Image> image {};
+    };
+
+    struct Fenced {
+        size_t begin {};
+        GLsync fence {};
+    };
+
+    explicit TextureStreamer(TextureStreamerOptions options);
+    void Decode(TextureId id, std::string const& path);
+    void Retire();
+    std::optional<size_t> Stage(size_t bytes);
+    std::optional<uint32_t> AllocateLayer(Entry& entry);
+    void Grow(uint32_t array);
+    bool UploadSome(Entry& entry, size_t& budget);
+    double MsSince(Clock::time_point start) const;
+
+    TextureStreamerOptions m_options;
+    GLenum m_internalFormat {};
+    std::vector<Entry> m_entries;
+    std::unordered_map<std::string, TextureId> m_ids;
+    std::vector<ArrayInfo> m_arrays;
+    std::vector<GLuint> m_arrayTextures;
+    size_t m_numPending {};
+
+    GLuint m_staging {};
+    std::byte* m_stagingData {};
+    size_t m_head {};
+    // Start of this frame's uploads, which are not fenced yet.
+    std::optional<size_t> m_frameBegin;
+    std::deque<Fenced> m_inFlight;
+
+    std::vector<Util::JobHandle> m_decodeJobs;
+    std::mutex m_mutex;
+    std::vector<Decoded> m_decoded;
+};
+
+} // namespace Umbrella::Gfx
@@ -0,0 +1,55 @@
+#include "gfx/VertexAttribs.h"
+
+#include <cstdint>
+
+namespace Umbrella::Gfx {
+
+namespace {
+
+    struct AttribPointer {
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+    };
+
+    AttribPointer PointerOf(Assets::AttribFormat format)
+    {
+        switch (format) {
+        case Assets::AttribFormat::Float32x3:
+            return {3, GL_FLOAT, GL_FALSE};
+        case Assets::AttribFormat::Float32x2:
+            return {2, GL_FLOAT, GL_FALSE};
+        case Assets::AttribFormat::Float16x2:
+            return {2, GL_HALF_FLOAT, GL_FALSE};
+        case Assets::AttribFormat::Unorm16x2:
+            return {2, GL_UNSIGNED_SHORT, GL_TRUE};
+        case Assets::AttribFormat::Unorm16x4:
+            return {4, GL_UNSIGNED_SHORT, GL_TRUE};
+        case Assets::AttribFormat::Octahedral10x3x2:
+            return {4, GL_INT_2_10_10_10_REV, GL_TRUE};
+        }
+        return {};
+    }
+
+} // namespace
+
+void SetupVertexAttribs(Assets::VertexLayout const& layout)
+{
+    GLuint location = 0;
+    for (Assets::VertexAttribute const& attribute : layout.Attributes()) {
+        AttribPointer pointer = PointerOf(attribute.format);
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, pointer.size, pointer.type,
+            pointer.normalized, static_cast<GLsizei>(layout.stride),
+            reinterpret_cast<void*>(uintptr_t(attribute.offset)));
+        location++;
+    }
+}
+
+GLenum IndexType(Assets::IndexFormat format)
+{
+    return format == Assets::IndexFormat::Uint16 ? GL_UNSIGNED_SHORT
+                                                 : GL_UNSIGNED_INT;
+}
+
+} // namespace Umbrella::Gfx
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include "assets/VertexLayout.h"
+
+namespace Umbrella::Gfx {
+
+// Declares every attribute of layout on the bound VAO, reading from the
+// buffer bound to GL_ARRAY_BUFFER.
+void SetupVertexAttribs(Assets::VertexLayout const& layout);
+
+GLenum IndexType(Assets::IndexFormat format);
+
+} // namespace Umbrella::Gfx
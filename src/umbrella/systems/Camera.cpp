@@ -21,6 +21,7 @@ glm::vec3 DirectionFromEuler(double pitch, double yaw)
 Camera::Camera(glm::vec3 position)
     : m_position(position)
     , m_up(glm::vec3(0.0f, 1.0f, 0.0f))
+    , m_previousPosition(position)
 {
     m_pitch = 0.0f;
     m_yaw = -89.0f;
@@ -57,25 +58,27 @@ void Camera::ProcessKeys(int key, int action)
 
 void Camera::ProcessMouse(double x, double y)
 {
-    constexpr float mouseSens = 0.1f;
-
     if (firstMove) {
-        m_inputState.prevX = x;
-        m_inputState.prevY = y;
         firstMove = false;
     } else {
-        m_inputState.prevX = m_inputState.x;
-        m_inputState.prevY = m_inputState.y;
+        m_inputState.deltaX += x - m_inputState.x;
+        m_inputState.deltaY += m_inputState.y - y;
     }
     m_inputState.x = x;
     m_inputState.y = y;
+}
 
-    // Handle mouse movement
-    float deltaX = m_inputState.x - m_inputState.prevX;
-    float deltaY = m_inputState.prevY - m_inputState.y;
+void Camera::ApplyLook()
+{
+    constexpr float mouseSens = 0.1f;
 
-    m_pitch += mouseSens * deltaY;
-    m_yaw += mouseSens * deltaX;
+    if (m_inputState.deltaX == 0.0 && m_inputState.deltaY == 0.0) {
+        return;
+    }
+    m_pitch += mouseSens * static_cast<float>(m_inputState.deltaY);
+    m_yaw += mouseSens * static_cast<float>(m_inputState.deltaX);
+    m_inputState.deltaX = 0.0;
+    m_inputState.deltaY = 0.0;
 
     // Clamp Pitch to [-89.0f, 89.0f]
     m_pitch = std::clamp(m_pitch, -89.0f, 89.0f);
@@ -85,6 +88,20 @@ void Camera::ProcessMouse(double x, double y)
     m_direction = DirectionFromEuler(m_pitch, m_yaw);
 }
 
+CameraPose Camera::Pose() const
+{
+    return {.position = m_position, .pitch = m_pitch, .yaw = m_yaw};
+}
+
+void Camera::SetPose(CameraPose const& pose)
+{
+    m_position = pose.position;
+    m_previousPosition = pose.position;
+    m_pitch = std::clamp(pose.pitch, -89.0f, 89.0f);
+    m_yaw = std::fmod(pose.yaw, 360.0f);
+    m_direction = DirectionFromEuler(m_pitch, m_yaw);
+}
+
 void Camera::Tick(float dt)
 {
     constexpr float camSpeed = 25.0f;
@@ -109,7 +126,13 @@ void Camera::Tick(float dt)
     if (m_inputState.e) {
         posDelta += m_up;
     }
+    m_previousPosition = m_position;
     m_position += dt * camSpeed * posDelta;
 }
 
+glm::vec3 Camera::InterpolatedPosition(float alpha) const
+{
+    return glm::mix(m_previousPosition, m_position, alpha);
+}
+
 } // namespace Umbrella
@@ -3,6 +3,8 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include "systems/CameraPath.h"
+
 namespace Umbrella {
 
 class Camera {
@@ -10,8 +12,18 @@ public:
     explicit Camera(glm::vec3 position);
 
     void ProcessKeys(int key, int action);
+    // Only adds up the motion; ApplyLook() turns the camera once per frame,
+    // however many events arrived.
     void ProcessMouse(double x, double y);
+    void ApplyLook();
+    // One fixed simulation step.
     void Tick(float dt);
+    // Between the positions before and after the last Tick().
+    glm::vec3 InterpolatedPosition(float alpha) const;
+
+    // For replaying and recording camera paths.
+    CameraPose Pose() const;
+    void SetPose(CameraPose const& pose);
 
     glm::vec3 m_position;
     glm::vec3 m_up;
@@ -19,6 +31,7 @@ public:
 
 private:
     bool firstMove = true;
+    glm::vec3 m_previousPosition;
 
     // Euler Angles
     float m_pitch;
@@ -34,10 +47,11 @@ private:
         bool e {false};
 
         // mouse
-        double prevX {};
-        double prevY {};
         double x {};
         double y {};
+        // Motion since the last ApplyLook().
+        double deltaX {};
+        double deltaY {};
     } m_inputState;
 };
 
@@ -0,0 +1,149 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <glm/gtc/constants.hpp>
+#include <spdlog/spdlog.h>
+
+#include "util/File.h"
+
+namespace Umbrella {
+
+namespace {
+
+    glm::vec3 CatmullRom(glm::vec3 const& p0, glm::vec3 const& p1,
+        glm::vec3 const& p2, glm::vec3 const& p3, float t)
+    {
+        float t2 = t * t;
+        float t3 = t2 * t;
+        return 0.5f
+            * (2.0f * p1 + (p2 - p0) * t
+                + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2
+                + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+
+    float LerpAngle(float from, float to, float t)
+    {
+        float delta = std::remainder(to - from, 360.0f);
+        return from + delta * t;
+    }
+
+} // namespace
+
+CameraPath::CameraPath(std::vector<CameraKey> keys)
+    : m_keys(std::move(keys))
+{
+    std::ranges::stable_sort(m_keys, {}, &CameraKey::time);
+}
+
+std::optional<CameraPath> CameraPath::Load(char const* path)
+{
+    std::optional<std::string> text = Util::ReadFile(path);
+    if (!text) {
+        spdlog::error("Could not read camera path {}", path);
+        return {};
+    }
+
+    std::vector<CameraKey> keys;
+    std::istringstream lines(*text);
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(lines, line); lineNumber++) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        CameraKey key;
+        if (!(fields >> key.time >> key.pose.position.x >> key.pose.position.y
+                >> key.pose.position.z >> key.pose.pitch >> key.pose.yaw)) {
+            spdlog::warn("{}:{}: expected \"time x y z pitch yaw\"", path,
+                lineNumber);
+            continue;
+        }
+        keys.push_back(key);
+    }
+    if (keys.empty()) {
+        spdlog::error("Camera path {} has no keys", path);
+        return {};
+    }
+    return CameraPath(std::move(keys));
+}
+
+bool CameraPath::Save(char const* path) const
+{
+    std::ofstream stream(path);
+    stream << "# time x y z pitch yaw\n";
+    for (CameraKey const& key : m_keys) {
+        stream << key.time << ' ' << key.pose.position.x << ' '
+               << key.pose.position.y << ' ' << key.pose.position.z << ' '
+               << key.pose.pitch << ' ' << key.pose.yaw << '\n';
+    }
+    if (!stream) {
+        spdlog::error("Could not write camera path {}", path);
+        return false;
+    }
+    spdlog::info("Wrote {} camera keys to {}", m_keys.size(), path);
+    return true;
+}
+
+CameraPath CameraPath::Orbit(
+    glm::vec3 center, float radius, float height, float seconds)
+{
+    constexpr int numKeys = 64;
+
+    std::vector<CameraKey> keys;
+    for (int k = 0; k <= numKeys; k++) {
+        float turn = static_cast<float>(k) / numKeys;
+        float angle = turn * glm::two_pi<float>();
+        glm::vec3 position = center
+            + glm::vec3(radius * std::cos(angle), height,
+                radius * std::sin(angle));
+        glm::vec3 direction = glm::normalize(center - position);
+        keys.push_back({
+            .time = turn * seconds,
+            .pose = {
+                .position = position,
+                .pitch = glm::degrees(std::asin(direction.y)),
+                .yaw = glm::degrees(std::atan2(direction.z, direction.x)),
+            },
+        });
+    }
+    return CameraPath(std::move(keys));
+}
+
+CameraPose CameraPath::Sample(float time) const
+{
+    if (m_keys.empty()) {
+        return {};
+    }
+    if (time <= m_keys.front().time) {
+        return m_keys.front().pose;
+    }
+    if (time >= m_keys.back().time) {
+        return m_keys.back().pose;
+    }
+
+    auto next = std::ranges::upper_bound(m_keys, time, {}, &CameraKey::time);
+    size_t k1 = static_cast<size_t>(next - m_keys.begin());
+    size_t k0 = k1 - 1;
+    CameraKey const& a = m_keys[k0];
+    CameraKey const& b = m_keys[k1];
+    float span = b.time - a.time;
+    float t = span > 0.0f ? (time - a.time) / span : 1.0f;
+
+    // The ends repeat the first and last key.
+    glm::vec3 const& before = m_keys[k0 > 0 ? k0 - 1 : k0].pose.position;
+    glm::vec3 const& after
+        = m_keys[std::min(k1 + 1, m_keys.size() - 1)].pose.position;
+    return {
+        .position = CatmullRom(
+            before, a.pose.position, b.pose.position, after, t),
+        .pitch = a.pose.pitch + (b.pose.pitch - a.pose.pitch) * t,
+        .yaw = LerpAngle(a.pose.yaw, b.pose.yaw, t),
+    };
+}
+
+} // namespace Umbrella
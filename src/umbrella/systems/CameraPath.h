@@ -0,0 +1,60 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Umbrella {
+
+// Where the camera is and where it looks, in the Euler angles Camera uses,
+// in degrees.
+struct CameraPose {
+    glm::vec3 position {};
+    float pitch {};
+    float yaw {};
+};
+
+struct CameraKey {
+    // Seconds from the start of the path.
+    float time {};
+    CameraPose pose {};
+};
+
+// A camera flight through the scene, for replaying the same frames on
+// every run. Positions follow a Catmull-Rom spline through the keys and
+// angles are interpolated along the shorter way round.
+//
+// On disk it is a text file with one key per line, as
+// "time x y z pitch yaw"; lines starting with '#' are comments.
+class CameraPath {
+public:
+    CameraPath() = default;
+    explicit CameraPath(std::vector<CameraKey> keys);
+
+    // Returns nothing when the file cannot be read or has no valid keys.
+    static std::optional<CameraPath> Load(char const* path);
+    bool Save(char const* path) const;
+
+    // One turn around center in `seconds`, looking at it from `height`
+    // above.
+    static CameraPath Orbit(
+        glm::vec3 center, float radius, float height, float seconds);
+
+    // Keys have to be appended in time order.
+    void Append(CameraKey const& key) { m_keys.push_back(key); }
+
+    // Clamps to the first and last key outside the path.
+    CameraPose Sample(float time) const;
+    float Duration() const
+    {
+        return m_keys.empty() ? 0.0f : m_keys.back().time;
+    }
+    std::span<CameraKey const> Keys() const { return m_keys; }
+
+private:
+    std::vector<CameraKey> m_keys;
+};
+
+} // namespace Umbrella
@@ -0,0 +1,64 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace Umbrella {
+
+FixedTimestep::FixedTimestep(double stepSeconds, uint32_t maxSteps)
+    : m_step(std::max(stepSeconds, 1e-6))
+    , m_maxSteps(std::max(maxSteps, 1u))
+{
+}
+
+uint32_t FixedTimestep::Advance(double seconds)
+{
+    m_accumulated += std::max(seconds, 0.0);
+    uint32_t numSteps = 0;
+    while (m_accumulated >= m_step && numSteps < m_maxSteps) {
+        m_accumulated -= m_step;
+        numSteps++;
+    }
+    if (numSteps == m_maxSteps) {
+        m_accumulated = std::min(m_accumulated, m_step);
+    }
+    return numSteps;
+}
+
+FrameLimiter::FrameLimiter(double fps, double spinMs)
+    : m_spin(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::milli>(std::max(spinMs, 0.0))))
+{
+    if (fps > 0.0) {
+        m_period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / fps));
+    }
+}
+
+void FrameLimiter::Wait()
+{
+    if (m_period == Clock::duration::zero()) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    if (m_next < now) {
+        m_next = now;
+    } else {
+        SleepUntil(m_next, m_spin);
+    }
+    m_next += m_period;
+}
+
+void FrameLimiter::SleepUntil(
+    Clock::time_point deadline, Clock::duration spin)
+{
+    Clock::time_point sleepUntil = deadline - spin;
+    if (Clock::now() < sleepUntil) {
+        std::this_thread::sleep_until(sleepUntil);
+    }
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace Umbrella
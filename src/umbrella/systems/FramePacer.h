@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace Umbrella {
+
+enum class PresentMode : uint8_t {
+    // Swaps wait for the display, which paces the loop.
+    Vsync = 0,
+    // Swaps return at once; only the frame limiter, if any, paces the loop.
+    Uncapped = 1,
+};
+
+struct FramePacingOptions {
+    PresentMode presentMode = PresentMode::Vsync;
+    // Frames per second the limiter holds the loop to, or 0 for no limit.
+    double fpsLimit = 0.0;
+    // Simulation steps per second, whatever the frame rate.
+    double simulationRate = 120.0;
+    // After a hitch the simulation drops time beyond this many steps rather
+    // than spending the next frames catching up.
+    uint32_t maxStepsPerFrame = 8;
+    // The limiter sleeps until this close to the deadline and spins for the
+    // rest, since a sleep can overshoot by a scheduler tick.
+    double spinMs = 1.5;
+};
+
+// Runs the simulation in steps of a fixed length however long frames take.
+// Frames render between the last two steps, Alpha() of the way from the
+// older to the newer one, so motion stays smooth when the frame rate and
+// the step rate do not divide.
+class FixedTimestep {
+public:
+    FixedTimestep(double stepSeconds, uint32_t maxSteps);
+
+    // Adds the real time a frame took and returns how many steps to run.
+    uint32_t Advance(double seconds);
+
+    float Step() const { return static_cast<float>(m_step); }
+    float Alpha() const { return static_cast<float>(m_accumulated / m_step); }
+
+private:
+    double m_step {};
+    uint32_t m_maxSteps {};
+    double m_accumulated {};
+};
+
+// Holds a loop to a frame rate. It sleeps while the deadline is far and
+// spins through the last stretch, which is both accurate and cheap.
+class FrameLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // An fps of 0 never waits.
+    FrameLimiter(double fps, double spinMs);
+
+    // Blocks until the next frame is due. A frame that ran late starts the
+    // schedule over rather than letting the next ones rush to catch up.
+    void Wait();
+
+    static void SleepUntil(Clock::time_point deadline, Clock::duration spin);
+
+private:
+    Clock::duration m_period {};
+    Clock::duration m_spin {};
+    Clock::time_point m_next {};
+};
+
+} // namespace Umbrella
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "systems/LightClusters.h"
+#include "systems/OcclusionCulling.h"
+#include "systems/Scene.h"
+#include "systems/ShadowCascades.h"
+
+namespace Umbrella {
+
+// One shadow cascade as the frame sees it. Only cascades with
+// cascade.render set carry a caster list, in the same form as the view's.
+struct CascadePacket {
+    ShadowCascade cascade {};
+    std::vector<DrawCommand> commands;
+    std::vector<DrawRecord> records;
+    std::vector<glm::mat4> transforms;
+    DrawListStats stats {};
+    CascadeStats updates {};
+};
+
+// Everything needed to submit one frame, built on the main thread from the
+// camera and the scene. Once handed to the render thread the main thread
+// leaves it alone until it comes back, so neither side needs a lock.
+struct FramePacket {
+    uint32_t frame {};
+    // When the input the frame shows was read.
+    std::chrono::steady_clock::time_point inputTime {};
+    int width {};
+    int height {};
+    glm::mat4 view {1.0f};
+    glm::mat4 projection {1.0f};
+    glm::mat4 viewProjection {1.0f};
+    glm::vec3 cameraPosition {};
+    // Sized for the whole scene and written by BuildDrawList: only the
+    // first stats.numDraws commands and records and stats.numInstances
+    // transforms are in use.
+    std::vector<DrawCommand> commands;
+    std::vector<DrawRecord> records;
+    std::vector<glm::mat4> transforms;
+    DrawListStats stats {};
+    OcclusionStats occlusion {};
+    // Sized for the grid and written by BinLights, likewise: only the first
+    // lights.numIndices indices are in use.
+    std::vector<ClusterRange> clusters;
+    std::vector<uint32_t> lightIndices;
+    LightBinStats lights {};
+    ClusterLookup clusterLookup {};
+    DirectionalLight sun {};
+    std::vector<CascadePacket> cascades;
+};
+
+} // namespace Umbrella
@@ -0,0 +1,169 @@
+#include "FrameReport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+#include <spdlog/spdlog.h>
+
+namespace Umbrella {
+
+namespace {
+
+    struct Series {
+        char const* name;
+        Percentiles percentiles;
+        size_t count;
+    };
+
+    std::vector<Series> SummarizeSamples(std::span<FrameSample const> samples)
+    {
+        std::vector<double> cpu, frame, gpu;
+        for (FrameSample const& sample : samples) {
+            cpu.push_back(sample.cpuMs);
+            frame.push_back(sample.frameMs);
+            if (sample.gpuMs) {
+                gpu.push_back(*sample.gpuMs);
+            }
+        }
+        return {
+            {"cpuMs", ComputePercentiles(cpu), cpu.size()},
+            {"frameMs", ComputePercentiles(frame), frame.size()},
+            {"gpuMs", ComputePercentiles(gpu), gpu.size()},
+        };
+    }
+
+    std::string EscapeJson(std::string const& text)
+    {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+        }
+        return escaped;
+    }
+
+} // namespace
+
+Percentiles ComputePercentiles(std::vector<double> values)
+{
+    if (values.empty()) {
+        return {};
+    }
+    std::ranges::sort(values);
+    auto rank = [&](double percentile) {
+        size_t index = static_cast<size_t>(
+            std::ceil(percentile / 100.0 * static_cast<double>(values.size())));
+        return values[std::clamp<size_t>(index, 1, values.size()) - 1];
+    };
+    return {
+        .mean = std::accumulate(values.begin(), values.end(), 0.0)
+            / static_cast<double>(values.size()),
+        .min = values.front(),
+        .p50 = rank(50.0),
+        .p90 = rank(90.0),
+        .p95 = rank(95.0),
+        .p99 = rank(99.0),
+        .max = values.back(),
+    };
+}
+
+bool WriteFrameReportJson(char const* path, FrameReportInfo const& info,
+    std::span<FrameSample const> samples)
+{
+    std::ofstream stream(path);
+    stream << "{\n  \"renderer\": \"" << EscapeJson(info.renderer)
+           << "\",\n  \"version\": \"" << EscapeJson(info.version)
+           << "\",\n  \"width\": " << info.width
+           << ",\n  \"height\": " << info.height
+           << ",\n  \"instances\": " << info.numInstances
+           << ",\n  \"timeStep\": " << info.timeStep
+           << ",\n  \"framePackets\": " << info.framePackets
+           << ",\n  \"cameraPath\": \"" << EscapeJson(info.cameraPath)
+           << "\",\n  \"frames\": " << samples.size() << ",\n";
+
+    stream << "  \"summary\": {\n";
+    std::vector<Series> summary = SummarizeSamples(samples);
+    for (size_t s = 0; s < summary.size(); s++) {
+        Percentiles const& p = summary[s].percentiles;
+        stream << "    \"" << summary[s].name
+               << "\": {\"count\": " << summary[s].count
+               << ", \"mean\": " << p.mean << ", \"min\": " << p.min
+               << ", \"p50\": " << p.p50 << ", \"p90\": " << p.p90
+               << ", \"p95\": " << p.p95 << ", \"p99\": " << p.p99
+               << ", \"max\": " << p.max << "}"
+               << (s + 1 < summary.size() ? ",\n" : "\n");
+    }
+    stream << "  },\n";
+
+    stream << "  \"samples\": [\n";
+    for (size_t f = 0; f < samples.size(); f++) {
+        FrameSample const& sample = samples[f];
+        stream << "    {\"frame\": " << sample.frame
+               << ", \"cpuMs\": " << sample.cpuMs
+               << ", \"frameMs\": " << sample.frameMs << ", \"gpuMs\": ";
+        if (sample.gpuMs) {
+            stream << *sample.gpuMs;
+        } else {
+            stream << "null";
+        }
+        stream << ", \"draws\": " << sample.draws.numDraws
+               << ", \"instances\": " << sample.draws.numInstances
+               << ", \"culled\": " << sample.draws.numCulled
+               << ", \"occluded\": " << sample.draws.numOccluded
+               << ", \"triangles\": " << sample.draws.numTriangles << "}"
+               << (f + 1 < samples.size() ? ",\n" : "\n");
+    }
+    stream << "  ]\n}\n";
+
+    if (!stream) {
+        spdlog::error("Could not write the frame report to {}", path);
+        return false;
+    }
+    spdlog::info("Wrote {} frames to {}", samples.size(), path);
+    return true;
+}
+
+bool WriteFrameReportCsv(
+    char const* path, std::span<FrameSample const> samples)
+{
+    std::ofstream stream(path);
+    stream << "frame,cpu_ms,frame_ms,gpu_ms,draws,instances,culled,occluded,"
+              "triangles\n";
+    for (FrameSample const& sample : samples) {
+        stream << sample.frame << ',' << sample.cpuMs << ','
+               << sample.frameMs << ',';
+        if (sample.gpuMs) {
+            stream << *sample.gpuMs;
+        }
+        stream << ',' << sample.draws.numDraws << ','
+               << sample.draws.numInstances << ',' << sample.draws.numCulled
+               << ',' << sample.draws.numOccluded << ','
+               << sample.draws.numTriangles << '\n';
+    }
+
+    if (!stream) {
+        spdlog::error("Could not write the frame report to {}", path);
+        return false;
+    }
+    spdlog::info("Wrote {} frames to {}", samples.size(), path);
+    return true;
+}
+
+void LogFrameReport(std::span<FrameSample const> samples)
+{
+    spdlog::info("{:<8} {:>6} {:>8} {:>8} {:>8} {:>8} {:>8} {:>8}", "ms",
+        "count", "mean", "p50", "p90", "p95", "p99", "max");
+    for (Series const& series : SummarizeSamples(samples)) {
+        Percentiles const& p = series.percentiles;
+        spdlog::info(
+            "{:<8} {:>6} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f}",
+            series.name, series.count, p.mean, p.p50, p.p90, p.p95, p.p99,
+            p.max);
+    }
+}
+
+} // namespace Umbrella
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "systems/Scene.h"
+
+namespace Umbrella {
+
+// What one measured frame cost.
+struct FrameSample {
+    uint32_t frame {};
+    // What the frame cost the main thread: building it, and submitting it
+    // too when there is no render thread.
+    double cpuMs {};
+    // The whole frame, swap included.
+    double frameMs {};
+    // Missing when the driver had no timer query free for the frame.
+    std::optional<double> gpuMs {};
+    DrawListStats draws {};
+};
+
+struct Percentiles {
+    double mean {};
+    double min {};
+    double p50 {};
+    double p90 {};
+    double p95 {};
+    double p99 {};
+    double max {};
+};
+
+// Nearest-rank percentiles. Empty input gives all zeroes.
+Percentiles ComputePercentiles(std::vector<double> values);
+
+// Describes the run, so results from different machines and builds are not
+// compared by accident.
+struct FrameReportInfo {
+    std::string renderer;
+    std::string version;
+    int width {};
+    int height {};
+    size_t numInstances {};
+    double timeStep {};
+    // Packets between the main and render threads; 0 without a render
+    // thread.
+    uint32_t framePackets {};
+    std::string cameraPath;
+};
+
+// Writes the run description, percentiles of the CPU, frame and GPU times,
+// and every frame.
+bool WriteFrameReportJson(char const* path, FrameReportInfo const& info,
+    std::span<FrameSample const> samples);
+// One row per frame, for spreadsheets and plotting.
+bool WriteFrameReportCsv(
+    char const* path, std::span<FrameSample const> samples);
+void LogFrameReport(std::span<FrameSample const> samples);
+
+} // namespace Umbrella
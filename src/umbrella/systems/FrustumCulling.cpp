@@ -0,0 +1,166 @@
+#include "FrustumCulling.h"
+
+#include "util/Simd.h"
+
+namespace Umbrella {
+
+namespace {
+
+    // Shared by the scalar version and the tails of the SIMD ones.
+    void CullRange(Frustum const& frustum, BoundingSpheres const& spheres,
+        std::span<uint8_t> visible, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++) {
+            bool outside = false;
+            for (glm::vec4 const& plane : frustum.planes) {
+                float distance = spheres.x[i] * plane.x
+                    + spheres.y[i] * plane.y + spheres.z[i] * plane.z
+                    + plane.w;
+                outside |= distance < -spheres.radius[i];
+            }
+            visible[i] = outside ? 0 : 1;
+        }
+    }
+
+} // namespace
+
+Frustum ExtractFrustum(glm::mat4 const& viewProjection)
+{
+    // glm matrices are column-major, so row i is m[0][i] .. m[3][i].
+    auto row = [&](int i) {
+        return glm::vec4(viewProjection[0][i], viewProjection[1][i],
+            viewProjection[2][i], viewProjection[3][i]);
+    };
+
+    Frustum frustum {{
+        row(3) + row(0),
+        row(3) - row(0),
+        row(3) + row(1),
+        row(3) - row(1),
+        row(3) + row(2),
+        row(3) - row(2),
+    }};
+    for (glm::vec4& plane : frustum.planes) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) {
+            plane /= length;
+        }
+    }
+    return frustum;
+}
+
+void BoundingSpheres::Push(glm::vec3 center, float sphereRadius)
+{
+    x.push_back(center.x);
+    y.push_back(center.y);
+    z.push_back(center.z);
+    radius.push_back(sphereRadius);
+}
+
+void BoundingSpheres::Set(size_t i, glm::vec3 center, float sphereRadius)
+{
+    x[i] = center.x;
+    y[i] = center.y;
+    z[i] = center.z;
+    radius[i] = sphereRadius;
+}
+
+void BoundingSpheres::Clear()
+{
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+}
+
+void CullSpheresScalar(Frustum const& frustum, BoundingSpheres const& spheres,
+    std::span<uint8_t> visible)
+{
+    CullRange(frustum, spheres, visible, 0, spheres.Size());
+}
+
+void CullSpheresSse(Frustum const& frustum, BoundingSpheres const& spheres,
+    std::span<uint8_t> visible)
+{
+#ifdef UMBRELLA_X86
+    size_t count = spheres.Size();
+    size_t simdCount = count / 4 * 4;
+    __m128 const zero = _mm_setzero_ps();
+    for (size_t i = 0; i < simdCount; i += 4) {
+        __m128 x = _mm_loadu_ps(&spheres.x[i]);
+        __m128 y = _mm_loadu_ps(&spheres.y[i]);
+        __m128 z = _mm_loadu_ps(&spheres.z[i]);
+        __m128 negativeRadius
+            = _mm_sub_ps(zero, _mm_loadu_ps(&spheres.radius[i]));
+
+        __m128 outside = _mm_setzero_ps();
+        for (glm::vec4 const& plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)),
+                        _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                    _mm_mul_ps(z, _mm_set1_ps(plane.z))),
+                _mm_set1_ps(plane.w));
+            outside
+                = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (size_t k = 0; k < 4; k++) {
+            visible[i + k] = (mask >> k) & 1 ? 0 : 1;
+        }
+    }
+    CullRange(frustum, spheres, visible, simdCount, count);
+#else
+    CullSpheresScalar(frustum, spheres, visible);
+#endif
+}
+
+UMBRELLA_TARGET_AVX void CullSpheresAvx(Frustum const& frustum,
+    BoundingSpheres const& spheres, std::span<uint8_t> visible)
+{
+#ifdef UMBRELLA_X86
+    size_t count = spheres.Size();
+    size_t simdCount = count / 8 * 8;
+    __m256 const zero = _mm256_setzero_ps();
+    for (size_t i = 0; i < simdCount; i += 8) {
+        __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+        __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+        __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+        __m256 negativeRadius
+            = _mm256_sub_ps(zero, _mm256_loadu_ps(&spheres.radius[i]));
+
+        __m256 outside = _mm256_setzero_ps();
+        for (glm::vec4 const& plane : frustum.planes) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)),
+                        _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+                    _mm256_mul_ps(z, _mm256_set1_ps(plane.z))),
+                _mm256_set1_ps(plane.w));
+            outside = _mm256_or_ps(outside,
+                _mm256_cmp_ps(distance, negativeRadius, _CMP_LT_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(outside);
+        for (size_t k = 0; k < 8; k++) {
+            visible[i + k] = (mask >> k) & 1 ? 0 : 1;
+        }
+    }
+    CullRange(frustum, spheres, visible, simdCount, count);
+#else
+    CullSpheresScalar(frustum, spheres, visible);
+#endif
+}
+
+void CullSpheres(Frustum const& frustum, BoundingSpheres const& spheres,
+    std::span<uint8_t> visible)
+{
+    if (Util::HasAvx()) {
+        CullSpheresAvx(frustum, spheres, visible);
+    } else {
+        CullSpheresSse(frustum, spheres, visible);
+    }
+}
+
+} // namespace Umbrella
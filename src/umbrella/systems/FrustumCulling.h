@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Umbrella {
+
+// Six planes (left, right, bottom, top, near, far) with normals pointing
+// inwards, so a point p is inside when dot(plane.xyz, p) + plane.w >= 0.
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+};
+
+// Gribb and Hartmann's extraction from an OpenGL view-projection matrix.
+Frustum ExtractFrustum(glm::mat4 const& viewProjection);
+
+// Bounding spheres split into one array per component, so SIMD code can
+// load several spheres per instruction.
+struct BoundingSpheres {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+    size_t Size() const { return x.size(); }
+    void Push(glm::vec3 center, float sphereRadius);
+    void Set(size_t i, glm::vec3 center, float sphereRadius);
+    void Clear();
+};
+
+// Sets visible[i] to 1 when sphere i intersects the frustum and to 0
+// otherwise. visible must have room for every sphere. Every version gives
+// the same result as the scalar one, bit for bit: they do the same float
+// operations in the same order, only several spheres at a time.
+void CullSpheresScalar(Frustum const& frustum, BoundingSpheres const& spheres,
+    std::span<uint8_t> visible);
+// Four spheres per instruction. Falls back to the scalar version where SSE
+// is not available.
+void CullSpheresSse(Frustum const& frustum, BoundingSpheres const& spheres,
+    std::span<uint8_t> visible);
+// Eight spheres per instruction. Only call it when Util::HasAvx() is true.
+void CullSpheresAvx(Frustum const& frustum, BoundingSpheres const& spheres,
+    std::span<uint8_t> visible);
+
+// The widest version this CPU runs.
+void CullSpheres(Frustum const& frustum, BoundingSpheres const& spheres,
+    std::span<uint8_t> visible);
+
+} // namespace Umbrella
@@ -0,0 +1,367 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+#include "util/Parallel.h"
+#include "util/Profiler.h"
+#include "util/Simd.h"
+
+namespace Umbrella {
+
+namespace {
+
+    // The boxes of one slice.
+    struct SliceBoxes {
+        float const* minX;
+        float const* minY;
+        float const* minZ;
+        float const* maxX;
+        float const* maxY;
+        float const* maxZ;
+        size_t count;
+    };
+
+    // A view-space sphere, with its radius squared.
+    struct Sphere {
+        float x;
+        float y;
+        float z;
+        float radiusSquared;
+    };
+
+    // Sets bit i of hits when the sphere touches box i. hits has a word
+    // for every 64 boxes and starts out cleared.
+    using TestSphereFn = void (*)(SliceBoxes const&, Sphere, uint64_t*);
+
+    // Arvo's test: the squared distance from the centre to the box, summed
+    // over the axes the centre lies outside of. Shared by the scalar
+    // version and the tails of the SIMD ones.
+    void TestRange(SliceBoxes const& boxes, Sphere sphere, uint64_t* hits,
+        size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++) {
+            float dx = std::max(
+                std::max(boxes.minX[i] - sphere.x, sphere.x - boxes.maxX[i]),
+                0.0f);
+            float dy = std::max(
+                std::max(boxes.minY[i] - sphere.y, sphere.y - boxes.maxY[i]),
+                0.0f);
+            float dz = std::max(
+                std::max(boxes.minZ[i] - sphere.z, sphere.z - boxes.maxZ[i]),
+                0.0f);
+            float distanceSquared = dx * dx + dy * dy + dz * dz;
+            if (distanceSquared <= sphere.radiusSquared) {
+                hits[i / 64] |= uint64_t {1} << (i % 64);
+            }
+        }
+    }
+
+    void TestSphereScalar(
+        SliceBoxes const& boxes, Sphere sphere, uint64_t* hits)
+    {
+        TestRange(boxes, sphere, hits, 0, boxes.count);
+    }
+
+    void TestSphereSse(SliceBoxes const& boxes, Sphere sphere, uint64_t* hits)
+    {
+#ifdef UMBRELLA_X86
+        size_t simdCount = boxes.count / 4 * 4;
+        __m128 const zero = _mm_setzero_ps();
+        __m128 const x = _mm_set1_ps(sphere.x);
+        __m128 const y = _mm_set1_ps(sphere.y);
+        __m128 const z = _mm_set1_ps(sphere.z);
+        __m128 const radiusSquared = _mm_set1_ps(sphere.radiusSquared);
+        for (size_t i = 0; i < simdCount; i += 4) {
+            __m128 dx = _mm_max_ps(
+                _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(boxes.minX + i), x),
+                    _mm_sub_ps(x, _mm_loadu_ps(boxes.maxX + i))),
+                zero);
+            __m128 dy = _mm_max_ps(
+                _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(boxes.minY + i), y),
+                    _mm_sub_ps(y, _mm_loadu_ps(boxes.maxY + i))),
+                zero);
+            __m128 dz = _mm_max_ps(
+                _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(boxes.minZ + i), z),
+                    _mm_sub_ps(z, _mm_loadu_ps(boxes.maxZ + i))),
+                zero);
+            __m128 distanceSquared = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                _mm_mul_ps(dz, dz));
+
+            // Groups start at multiples of their width, so they never
+            // straddle two words.
+            int mask = _mm_movemask_ps(
+                _mm_cmple_ps(distanceSquared, radiusSquared));
+            hits[i / 64] |= static_cast<uint64_t>(mask) << (i % 64);
+        }
+        TestRange(boxes, sphere, hits, simdCount, boxes.count);
+#else
+        TestSphereScalar(boxes, sphere, hits);
+#endif
+    }
+
+    UMBRELLA_TARGET_AVX void TestSphereAvx(
+        SliceBoxes const& boxes, Sphere sphere, uint64_t* hits)
+    {
+#ifdef UMBRELLA_X86
+        size_t simdCount = boxes.count / 8 * 8;
+        __m256 const zero = _mm256_setzero_ps();
+        __m256 const x = _mm256_set1_ps(sphere.x);
+        __m256 const y = _mm256_set1_ps(sphere.y);
+        __m256 const z = _mm256_set1_ps(sphere.z);
+        __m256 const radiusSquared = _mm256_set1_ps(sphere.radiusSquared);
+        for (size_t i = 0; i < simdCount; i += 8) {
+            __m256 dx = _mm256_max_ps(
+                _mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(boxes.minX + i), x),
+                    _mm256_sub_ps(x, _mm256_loadu_ps(boxes.maxX + i))),
+                zero);
+            __m256 dy = _mm256_max_ps(
+                _mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(boxes.minY + i), y),
+                    _mm256_sub_ps(y, _mm256_loadu_ps(boxes.maxY + i))),
+                zero);
+            __m256 dz = _mm256_max_ps(
+                _mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(boxes.minZ + i), z),
+                    _mm256_sub_ps(z, _mm256_loadu_ps(boxes.maxZ + i))),
+                zero);
+            __m256 distanceSquared = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                _mm256_mul_ps(dz, dz));
+
+            int mask = _mm256_movemask_ps(
+                _mm256_cmp_ps(distanceSquared, radiusSquared, _CMP_LE_OQ));
+            hits[i / 64] |= static_cast<uint64_t>(mask) << (i % 64);
+        }
+        // The tail runs SSE code, which the compiler tail-calls without
+        // clearing the upper halves first; every call would then pay the
+        // AVX to SSE transition.
+        _mm256_zeroupper();
+        TestRange(boxes, sphere, hits, simdCount, boxes.count);
+#else
+        TestSphereScalar(boxes, sphere, hits);
+#endif
+    }
+
+    TestSphereFn SelectTest(LightBinMethod method)
+    {
+        switch (method) {
+        case LightBinMethod::Scalar:
+            return TestSphereScalar;
+        case LightBinMethod::Sse:
+            return TestSphereSse;
+        case LightBinMethod::Avx:
+        case LightBinMethod::Widest:
+            return Util::HasAvx() ? TestSphereAvx : TestSphereSse;
+        }
+        return TestSphereScalar;
+    }
+
+} // namespace
+
+LightClusters::LightClusters(LightClusterOptions options)
+    : m_options(options)
+{
+    m_options.tilesX = std::max(m_options.tilesX, 1u);
+    m_options.tilesY = std::max(m_options.tilesY, 1u);
+    m_options.slices = std::max(m_options.slices, 1u);
+}
+
+size_t LightClusters::NumClusters() const
+{
+    return size_t {m_options.tilesX} * m_options.tilesY * m_options.slices;
+}
+
+size_t LightClusters::MaxLightIndices() const
+{
+    return NumClusters() * m_options.maxLightsPerCluster;
+}
+
+void LightClusters::BuildBoxes(ClusterView const& view)
+{
+    glm::vec4 projection(
+        view.verticalFov, view.aspect, view.nearPlane, view.farPlane);
+    if (projection == m_boxesBuiltFor && !m_sliceDepths.empty()) {
+        return;
+    }
+    m_boxesBuiltFor = projection;
+
+    uint32_t slices = m_options.slices;
+    m_sliceDepths.resize(slices + 1);
+    float depthRatio = view.farPlane / view.nearPlane;
+    for (uint32_t k = 0; k <= slices; k++) {
+        m_sliceDepths[k] = view.nearPlane
+            * std::pow(depthRatio, static_cast<float>(k) / slices);
+    }
+
+    size_t numClusters = NumClusters();
+    for (std::vector<float>* bound : {&m_boxes.minX, &m_boxes.minY,
+             &m_boxes.minZ, &m_boxes.maxX, &m_boxes.maxY, &m_boxes.maxZ}) {
+        bound->resize(numClusters);
+    }
+
+    // A tile spans [ndc0, ndc1] of the screen, which at view distance d is
+    // ndc * d * halfHeight, times the aspect across. The tile's piece of a
+    // slice widens with depth, so its box is bounded by both of its ends.
+    float halfHeight = std::tan(0.5f * view.verticalFov);
+    float halfWidth = halfHeight * view.aspect;
+    size_t cluster = 0;
+    for (uint32_t z = 0; z < slices; z++) {
+        float nearDepth = m_sliceDepths[z];
+        float farDepth = m_sliceDepths[z + 1];
+        for (uint32_t y = 0; y < m_options.tilesY; y++) {
+            float y0 = -1.0f + 2.0f * static_cast<float>(y) / m_options.tilesY;
+            float y1
+                = -1.0f + 2.0f * static_cast<float>(y + 1) / m_options.tilesY;
+            for (uint32_t x = 0; x < m_options.tilesX; x++) {
+                float x0
+                    = -1.0f + 2.0f * static_cast<float>(x) / m_options.tilesX;
+                float x1 = -1.0f
+                    + 2.0f * static_cast<float>(x + 1) / m_options.tilesX;
+                m_boxes.minX[cluster] = std::min(x0 * nearDepth,
+                                            x0 * farDepth)
+                    * halfWidth;
+                m_boxes.maxX[cluster] = std::max(x1 * nearDepth,
+                                            x1 * farDepth)
+                    * halfWidth;
+                m_boxes.minY[cluster] = std::min(y0 * nearDepth,
+                                            y0 * farDepth)
+                    * halfHeight;
+                m_boxes.maxY[cluster] = std::max(y1 * nearDepth,
+                                            y1 * farDepth)
+                    * halfHeight;
+                // The camera looks down -z.
+                m_boxes.minZ[cluster] = -farDepth;
+                m_boxes.maxZ[cluster] = -nearDepth;
+                cluster++;
+            }
+        }
+    }
+}
+
+LightBinStats LightClusters::BinLights(ClusterView const& view,
+    std::span<PointLight const> lights, LightClusterTargets targets)
+{
+    UMBRELLA_PROFILE_ZONE("Bin lights");
+    auto start = std::chrono::steady_clock::now();
+    BuildBoxes(view);
+
+    size_t numLights = lights.size();
+    m_lightX.resize(numLights);
+    m_lightY.resize(numLights);
+    m_lightZ.resize(numLights);
+    m_lightRadius.resize(numLights);
+    for (size_t l = 0; l < numLights; l++) {
+        glm::vec4 position = view.view * glm::vec4(lights[l].position, 1.0f);
+        m_lightX[l] = position.x;
+        m_lightY[l] = position.y;
+        m_lightZ[l] = position.z;
+        m_lightRadius[l] = lights[l].radius;
+    }
+
+    size_t tilesPerSlice = size_t {m_options.tilesX} * m_options.tilesY;
+    m_clusterLights.resize(NumClusters());
+    m_sliceOverflow.assign(m_options.slices, 0);
+    TestSphereFn testSphere = SelectTest(m_options.method);
+
+    // Only lights whose depth range reaches the slice are tested against
+    // its boxes; those that are get appended to every cluster they touch.
+    auto binSlice = [&](size_t slice) {
+        size_t first = slice * tilesPerSlice;
+        SliceBoxes boxes {
+            .minX = m_boxes.minX.data() + first,
+            .minY = m_boxes.minY.data() + first,
+            .minZ = m_boxes.minZ.data() + first,
+            .maxX = m_boxes.maxX.data() + first,
+            .maxY = m_boxes.maxY.data() + first,
+            .maxZ = m_boxes.maxZ.data() + first,
+            .count = tilesPerSlice,
+        };
+        std::span<std::vector<uint32_t>> clusters {
+            m_clusterLights.data() + first, tilesPerSlice};
+        for (std::vector<uint32_t>& cluster : clusters) {
+            cluster.clear();
+        }
+
+        float nearDepth = m_sliceDepths[slice];
+        float farDepth = m_sliceDepths[slice + 1];
+        std::vector<uint64_t> hits((tilesPerSlice + 63) / 64);
+        uint32_t overflow = 0;
+        for (size_t l = 0; l < numLights; l++) {
+            float depth = -m_lightZ[l];
+            float radius = m_lightRadius[l];
+            if (depth + radius < nearDepth || depth - radius > farDepth) {
+                continue;
+            }
+            std::ranges::fill(hits, 0);
+            testSphere(boxes,
+                {m_lightX[l], m_lightY[l], m_lightZ[l], radius * radius},
+                hits.data());
+            for (size_t w = 0; w < hits.size(); w++) {
+                for (uint64_t bits = hits[w]; bits != 0; bits &= bits - 1) {
+                    std::vector<uint32_t>& cluster
+                        = clusters[w * 64 + std::countr_zero(bits)];
+                    if (cluster.size() < m_options.maxLightsPerCluster) {
+                        cluster.push_back(static_cast<uint32_t>(l));
+                    } else {
+                        overflow++;
+                    }
+                }
+            }
+        }
+        m_sliceOverflow[slice] = overflow;
+    };
+    if (m_options.parallel) {
+        Util::ParallelFor(m_options.slices, binSlice);
+    } else {
+        for (size_t slice = 0; slice < m_options.slices; slice++) {
+            binSlice(slice);
+        }
+    }
+
+    // Lists go out back to back, in cluster order.
+    LightBinStats stats {.numLights = static_cast<uint32_t>(numLights)};
+    std::vector<uint8_t> lightVisible(numLights);
+    uint32_t offset = 0;
+    for (size_t c = 0; c < m_clusterLights.size(); c++) {
+        std::vector<uint32_t> const& cluster = m_clusterLights[c];
+        uint32_t count = static_cast<uint32_t>(cluster.size());
+        targets.clusters[c] = {offset, count};
+        std::ranges::copy(cluster, targets.lightIndices.begin() + offset);
+        for (uint32_t light : cluster) {
+            lightVisible[light] = 1;
+        }
+        offset += count;
+        stats.nonEmptyClusters += count > 0 ? 1 : 0;
+        stats.maxPerCluster = std::max(stats.maxPerCluster, count);
+    }
+    stats.numIndices = offset;
+    stats.numVisible = static_cast<uint32_t>(std::ranges::count(
+        lightVisible, uint8_t {1}));
+    for (uint32_t overflow : m_sliceOverflow) {
+        stats.numOverflowed += overflow;
+    }
+    stats.binMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start)
+                      .count();
+    return stats;
+}
+
+ClusterLookup LightClusters::Lookup(ClusterView const& view,
+    float viewportWidth, float viewportHeight) const
+{
+    // slice = log(depth / near) * slices / log(far / near), which is where
+    // BuildBoxes puts the slice boundaries.
+    float slicesPerLog = static_cast<float>(m_options.slices)
+        / std::log(view.farPlane / view.nearPlane);
+    return {
+        .grid = glm::uvec4(m_options.tilesX, m_options.tilesY,
+            m_options.slices, 0u),
+        .scale = glm::vec4(view.nearPlane, slicesPerLog,
+            static_cast<float>(m_options.tilesX) / viewportWidth,
+            static_cast<float>(m_options.tilesY) / viewportHeight),
+    };
+}
+
+} // namespace Umbrella
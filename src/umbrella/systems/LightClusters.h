@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Umbrella {
+
+// Matches the std430 PointLight struct in the shaders.
+struct PointLight {
+    glm::vec3 position;
+    // Where the light's falloff reaches zero.
+    float radius;
+    glm::vec3 color;
+    float intensity;
+};
+
+// Where a cluster's lights start in the light index list and how many
+// there are; a uvec2 in the shaders.
+struct ClusterRange {
+    uint32_t offset;
+    uint32_t count;
+};
+
+// How a light's sphere is tested against the boxes of a slice. Every
+// version gives the same result as the scalar one, bit for bit.
+enum class LightBinMethod : uint8_t {
+    Scalar,
+    // Four clusters per instruction.
+    Sse,
+    // Eight clusters per instruction, where the CPU has AVX; SSE otherwise.
+    Avx,
+    // The widest version this CPU runs.
+    Widest,
+};
+
+struct LightClusterOptions {
+    uint32_t tilesX = 16;
+    uint32_t tilesY = 9;
+    // Slices grow exponentially with depth, so clusters stay roughly cubic
+    // from the near plane to the far one.
+    uint32_t slices = 24;
+    // Lights past this in one cluster are dropped and counted as overflow.
+    uint32_t maxLightsPerCluster = 128;
+    LightBinMethod method = LightBinMethod::Widest;
+    // Bins depth slices on all cores; each worker owns whole slices, so
+    // they never share a cluster.
+    bool parallel = true;
+};
+
+// The perspective camera lights are binned for.
+struct ClusterView {
+    glm::mat4 view;
+    float verticalFov;
+    float aspect;
+    float nearPlane;
+    float farPlane;
+};
+
+// Where BinLights writes, usually straight into a frame packet.
+struct LightClusterTargets {
+    std::span<ClusterRange> clusters;
+    std::span<uint32_t> lightIndices;
+};
+
+struct LightBinStats {
+    uint32_t numLights {};
+    // Lights that reached at least one cluster.
+    uint32_t numVisible {};
+    uint32_t numIndices {};
+    uint32_t nonEmptyClusters {};
+    uint32_t maxPerCluster {};
+    // Light and cluster pairs dropped for maxLightsPerCluster.
+    uint32_t numOverflowed {};
+    double binMs {};
+
+    // Over the clusters that have any lights at all.
+    double AverageLightsPerCluster() const
+    {
+        return nonEmptyClusters == 0
+            ? 0.0
+            : static_cast<double>(numIndices) / nonEmptyClusters;
+    }
+};
+
+// How a fragment shader finds its cluster; see Gfx::FrameConstants.
+struct ClusterLookup {
+    // Tiles across, tiles up and depth slices; w is unused.
+    glm::uvec4 grid;
+    // Near plane, slices per unit of log depth, and tiles per pixel across
+    // and up.
+    glm::vec4 scale;
+};
+
+// Splits the view frustum into a grid of tiles across the screen by
+// exponential depth slices, and lists for every cluster the point lights
+// whose sphere touches its view-space box. Cluster (x, y, z) is index
+// (z * tilesY + y) * tilesX + x, with tile (0, 0) at the bottom left.
+class LightClusters {
+public:
+    explicit LightClusters(LightClusterOptions options = {});
+
+    LightClusterOptions const& Options() const { return m_options; }
+    size_t NumClusters() const;
+    // Room the light index list needs when every cluster is full.
+    size_t MaxLightIndices() const;
+
+    // Clusters take their lights in order, so the output only depends on
+    // the lights and the view, not on the method or the thread count.
+    // targets must have room for NumClusters() ranges and
+    // MaxLightIndices() indices.
+    LightBinStats BinLights(ClusterView const& view,
+        std::span<PointLight const> lights, LightClusterTargets targets);
+
+    ClusterLookup Lookup(ClusterView const& view, float viewportWidth,
+        float viewportHeight) const;
+
+private:
+    // Cluster boxes in view space, one array per bound so the SIMD
+    // versions test several clusters of a slice at once. Rebuilt only when
+    // the projection changes.
+    struct ClusterBoxes {
+        std::vector<float> minX;
+        std::vector<float> minY;
+        std::vector<float> minZ;
+        std::vector<float> maxX;
+        std::vector<float> maxY;
+        std::vector<float> maxZ;
+    };
+
+    void BuildBoxes(ClusterView const& view);
+
+    LightClusterOptions m_options;
+    ClusterBoxes m_boxes;
+    // View-space distance to the near side of every slice, and one past.
+    std::vector<float> m_sliceDepths;
+    glm::vec4 m_boxesBuiltFor {};
+
+    // View-space light spheres, likewise split by component.
+    std::vector<float> m_lightX;
+    std::vector<float> m_lightY;
+    std::vector<float> m_lightZ;
+    std::vector<float> m_lightRadius;
+    // Each slice's lights per cluster, kept between calls for their
+    // storage.
+    std::vector<std::vector<uint32_t>> m_clusterLights;
+    std::vector<uint32_t> m_sliceOverflow;
+};
+
+} // namespace Umbrella
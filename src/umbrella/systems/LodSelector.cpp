@@ -0,0 +1,52 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Umbrella {
+
+float ProjectedError(float error, float distance, LodView const& view)
+{
+    float pixelsPerUnit = view.viewportHeight
+        / (2.0f * std::tan(0.5f * view.verticalFov) * distance);
+    return error * pixelsPerUnit;
+}
+
+LodSelector::LodSelector(LodSelectorOptions options)
+    : m_options(options)
+{
+}
+
+size_t LodSelector::Select(std::span<Assets::MeshLod const> lods,
+    glm::vec3 center, float radius, LodView const& view)
+{
+    if (lods.empty()) {
+        m_current = 0;
+        return m_current;
+    }
+
+    // Measure from the closest point of the bounding sphere, so the error
+    // is never underestimated.
+    float distance = std::max(
+        glm::length(center - view.cameraPosition) - radius, 1e-3f);
+    auto pixels = [&](size_t lod) {
+        return ProjectedError(lods[lod].error, distance, view);
+    };
+
+    // Refine as soon as the current LOD shows too much error, but coarsen
+    // only with some margin.
+    m_current = std::min(m_current, lods.size() - 1);
+    while (m_current > 0 && pixels(m_current) > m_options.maxPixelError) {
+        m_current--;
+    }
+    float coarsenError
+        = m_options.maxPixelError * (1.0f - m_options.hysteresis);
+    while (m_current + 1 < lods.size()
+        && pixels(m_current + 1) <= coarsenError) {
+        m_current++;
+    }
+
+    return m_current;
+}
+
+} // namespace Umbrella
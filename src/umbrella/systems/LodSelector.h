@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "assets/Mesh.h"
+
+namespace Umbrella {
+
+struct LodSelectorOptions {
+    // Largest error, in pixels, a LOD may show on screen.
+    float maxPixelError = 1.0f;
+    // A coarser LOD is only picked once its error is this fraction below
+    // maxPixelError, so a mesh sitting at the threshold does not pop back
+    // and forth every frame.
+    float hysteresis = 0.25f;
+};
+
+// What the error of a LOD is projected with.
+struct LodView {
+    glm::vec3 cameraPosition;
+    float verticalFov;
+    float viewportHeight;
+};
+
+// Turns a model-space error at the given distance into pixels.
+float ProjectedError(float error, float distance, LodView const& view);
+
+// Picks a LOD per frame for one mesh, remembering the previous pick.
+class LodSelector {
+public:
+    explicit LodSelector(LodSelectorOptions options = {});
+
+    // center and radius are the mesh's bounding sphere in world space.
+    size_t Select(std::span<Assets::MeshLod const> lods, glm::vec3 center,
+        float radius, LodView const& view);
+
+    size_t Current() const { return m_current; }
+
+private:
+    LodSelectorOptions m_options;
+    size_t m_current {};
+};
+
+} // namespace Umbrella
@@ -0,0 +1,60 @@
+#include "MeshletCulling.h"
+
+namespace Umbrella {
+
+MeshletView MeshletViewOf(glm::mat4 const& viewProjection,
+    glm::vec3 cameraPosition, glm::mat4 const& model)
+{
+    return {
+        .frustum = ExtractFrustum(viewProjection * model),
+        .cameraPosition
+        = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f)),
+    };
+}
+
+size_t CullMeshlets(std::span<Assets::Meshlet const> meshlets,
+    MeshletView const& view, MeshletCullingOptions const& options,
+    std::span<MeshletRun> runs, MeshletCullStats& stats)
+{
+    stats.numInstances++;
+    size_t numRuns = 0;
+    for (Assets::Meshlet const& meshlet : meshlets) {
+        stats.numMeshlets++;
+        stats.numTriangles += meshlet.indexCount / 3;
+
+        bool inside = true;
+        if (options.frustum) {
+            for (glm::vec4 const& plane : view.frustum.planes) {
+                inside &= glm::dot(glm::vec3(plane), meshlet.center) + plane.w
+                    >= -meshlet.radius;
+            }
+        }
+        if (!inside) {
+            stats.frustumCulled++;
+            stats.culledTriangles += meshlet.indexCount / 3;
+            continue;
+        }
+        if (options.cone && ConeCulled(meshlet, view.cameraPosition)) {
+            stats.coneCulled++;
+            stats.culledTriangles += meshlet.indexCount / 3;
+            continue;
+        }
+
+        if (numRuns > 0) {
+            MeshletRun& last = runs[numRuns - 1];
+            if (last.shape == meshlet.shape
+                && last.firstIndex + last.indexCount == meshlet.firstIndex) {
+                last.indexCount += meshlet.indexCount;
+                continue;
+            }
+        }
+        runs[numRuns++] = {
+            .firstIndex = meshlet.firstIndex,
+            .indexCount = meshlet.indexCount,
+            .shape = meshlet.shape,
+        };
+    }
+    return numRuns;
+}
+
+} // namespace Umbrella
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "assets/Mesh.h"
+#include "systems/FrustumCulling.h"
+
+namespace Umbrella {
+
+struct MeshletCullingOptions {
+    bool enabled = true;
+    // Instances drawn at LOD 0 that are culled meshlet by meshlet each
+    // frame; any more are drawn whole. Each one costs a command per run of
+    // meshlets it keeps, so this bounds the size of the draw list.
+    uint32_t maxInstances = 64;
+    bool frustum = true;
+    // Drops meshlets whose every triangle faces away from the camera.
+    bool cone = true;
+};
+
+struct MeshletCullStats {
+    uint32_t numInstances {};
+    uint32_t numMeshlets {};
+    uint32_t frustumCulled {};
+    uint32_t coneCulled {};
+    uint64_t numTriangles {};
+    uint64_t culledTriangles {};
+
+    double CulledFraction() const
+    {
+        return numTriangles == 0 ? 0.0
+                                 : static_cast<double>(culledTriangles)
+                / static_cast<double>(numTriangles);
+    }
+};
+
+// The camera in the model space of one instance, where meshlet bounds
+// are. Being behind a triangle's plane survives any affine transform, so
+// cones need no transforming for the test to stay exact.
+struct MeshletView {
+    Frustum frustum;
+    glm::vec3 cameraPosition;
+};
+
+MeshletView MeshletViewOf(glm::mat4 const& viewProjection,
+    glm::vec3 cameraPosition, glm::mat4 const& model);
+
+// Whether every triangle of the meshlet faces away from a camera at
+// cameraPosition.
+inline bool ConeCulled(Assets::Meshlet const& meshlet, glm::vec3 cameraPosition)
+{
+    glm::vec3 toApex = meshlet.coneApex - cameraPosition;
+    float distance = glm::length(toApex);
+    return glm::dot(toApex, meshlet.coneAxis)
+        > meshlet.coneCutoff * distance;
+}
+
+// Meshlets that follow one another in the index buffer, of one shape.
+struct MeshletRun {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t shape;
+};
+
+// Culls the meshlets of one instance and writes the ones it keeps as
+// runs, merging neighbours so each run is one draw. runs must have room
+// for a run per meshlet. Returns how many were written.
+size_t CullMeshlets(std::span<Assets::Meshlet const> meshlets,
+    MeshletView const& view, MeshletCullingOptions const& options,
+    std::span<MeshletRun> runs, MeshletCullStats& stats);
+
+} // namespace Umbrella
@@ -0,0 +1,364 @@
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "util/Parallel.h"
+#include "util/Simd.h"
+
+namespace Umbrella {
+
+namespace {
+
+    // Sample positions of a group of four pixels, relative to its first.
+    constexpr float pixelCenters[4] = {0.5f, 1.5f, 2.5f, 3.5f};
+
+    uint32_t RoundUp(uint32_t value, uint32_t multiple)
+    {
+        return std::max(1u, (value + multiple - 1) / multiple) * multiple;
+    }
+
+    double MsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+    }
+
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer(OcclusionOptions options)
+    : m_options(options)
+    , m_width(RoundUp(options.width, binWidth))
+    , m_height(RoundUp(options.height, binHeight))
+    , m_binsX(m_width / binWidth)
+    , m_binsY(m_height / binHeight)
+    , m_depth(size_t(m_width) * m_height, 1.0f)
+    , m_tileMax(size_t(m_width / tileSize) * (m_height / tileSize), 1.0f)
+    , m_binTriangles(size_t(m_binsX) * m_binsY)
+{
+}
+
+void OcclusionBuffer::Begin(glm::mat4 const& viewProjection)
+{
+    m_viewProjection = viewProjection;
+
+    // How far a unit sphere's box reaches in clip space, and how far it
+    // reaches towards the near plane.
+    m_extentScale = glm::abs(viewProjection[0]) + glm::abs(viewProjection[1])
+        + glm::abs(viewProjection[2]);
+    m_nearPlaneScale = 0.0f;
+    m_nearestZScale = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        glm::vec4 const& column = viewProjection[axis];
+        m_nearPlaneScale += std::abs(column.z + column.w);
+        // Depth grows with w under a perspective projection, so the nearest
+        // depth is at the corner with the smallest w. Where w does not
+        // change along an axis, take the side with the smaller z.
+        float side = column.w != 0.0f ? column.w : column.z;
+        m_nearestZScale += std::copysign(1.0f, side) * column.z;
+    }
+
+    std::ranges::fill(m_depth, 1.0f);
+    std::ranges::fill(m_tileMax, 1.0f);
+    m_triangles.clear();
+    for (std::vector<uint32_t>& triangles : m_binTriangles) {
+        triangles.clear();
+    }
+    m_stats = {};
+}
+
+void OcclusionBuffer::AddOccluder(std::span<glm::vec3 const> positions,
+    std::span<uint32_t const> indices, glm::mat4 const& model)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    glm::mat4 modelViewProjection = m_viewProjection * model;
+    m_clip.resize(positions.size());
+    for (size_t v = 0; v < positions.size(); v++) {
+        m_clip[v] = modelViewProjection * glm::vec4(positions[v], 1.0f);
+    }
+
+    float width = static_cast<float>(m_width);
+    float height = static_cast<float>(m_height);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        glm::vec3 screen[3];
+        bool clipped = false;
+        for (size_t k = 0; k < 3; k++) {
+            glm::vec4 clip = m_clip[indices[t + k]];
+            if (clip.w <= 0.0f || clip.z < -clip.w) {
+                clipped = true;
+                break;
+            }
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            screen[k] = {(0.5f * ndc.x + 0.5f) * width,
+                (0.5f * ndc.y + 0.5f) * height, 0.5f * ndc.z + 0.5f};
+        }
+        if (clipped) {
+            continue;
+        }
+
+        // Counter-clockwise triangles face the camera.
+        glm::vec3 v0 = screen[0], v1 = screen[1], v2 = screen[2];
+        float area = (v1.x - v0.x) * (v2.y - v0.y)
+            - (v2.x - v0.x) * (v1.y - v0.y);
+        if (!(area > 0.0f)) {
+            continue;
+        }
+
+        RasterTriangle triangle;
+        triangle.minX = std::max(0,
+            static_cast<int>(std::floor(std::min({v0.x, v1.x, v2.x}))));
+        triangle.minY = std::max(0,
+            static_cast<int>(std::floor(std::min({v0.y, v1.y, v2.y}))));
+        triangle.maxX = std::min(static_cast<int>(m_width) - 1,
+            static_cast<int>(std::floor(std::max({v0.x, v1.x, v2.x}))));
+        triangle.maxY = std::min(static_cast<int>(m_height) - 1,
+            static_cast<int>(std::floor(std::max({v0.y, v1.y, v2.y}))));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            continue;
+        }
+
+        glm::vec3 const* vertices[3] = {&v0, &v1, &v2};
+        for (int e = 0; e < 3; e++) {
+            glm::vec3 const& from = *vertices[e];
+            glm::vec3 const& to = *vertices[(e + 1) % 3];
+            triangle.a[e] = from.y - to.y;
+            triangle.b[e] = to.x - from.x;
+            triangle.c[e] = -(triangle.a[e] * from.x + triangle.b[e] * from.y);
+        }
+
+        triangle.za = ((v1.z - v0.z) * (v2.y - v0.y)
+                          - (v2.z - v0.z) * (v1.y - v0.y))
+            / area;
+        triangle.zb = ((v2.z - v0.z) * (v1.x - v0.x)
+                          - (v1.z - v0.z) * (v2.x - v0.x))
+            / area;
+        triangle.zc = v0.z - triangle.za * v0.x - triangle.zb * v0.y
+            + 0.5f * (std::abs(triangle.za) + std::abs(triangle.zb));
+
+        uint32_t index = static_cast<uint32_t>(m_triangles.size());
+        m_triangles.push_back(triangle);
+        for (int by = triangle.minY / static_cast<int>(binHeight);
+            by <= triangle.maxY / static_cast<int>(binHeight); by++) {
+            for (int bx = triangle.minX / static_cast<int>(binWidth);
+                bx <= triangle.maxX / static_cast<int>(binWidth); bx++) {
+                m_binTriangles[by * m_binsX + bx].push_back(index);
+            }
+        }
+    }
+
+    m_stats.occludersDrawn++;
+    m_stats.rasterMs += MsSince(start);
+}
+
+void OcclusionBuffer::Rasterize()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    uint32_t numBins = m_binsX * m_binsY;
+    if (m_options.parallel) {
+        Util::ParallelFor(numBins, [&](size_t bin) {
+            RasterizeBin(static_cast<uint32_t>(bin));
+        });
+    } else {
+        for (uint32_t bin = 0; bin < numBins; bin++) {
+            RasterizeBin(bin);
+        }
+    }
+
+    m_stats.trianglesRasterized = static_cast<uint32_t>(m_triangles.size());
+    m_stats.rasterMs += MsSince(start);
+}
+
+void OcclusionBuffer::RasterizeBin(uint32_t bin)
+{
+    int binX0 = static_cast<int>(bin % m_binsX * binWidth);
+    int binY0 = static_cast<int>(bin / m_binsX * binHeight);
+    int binX1 = binX0 + static_cast<int>(binWidth) - 1;
+    int binY1 = binY0 + static_cast<int>(binHeight) - 1;
+
+    for (uint32_t index : m_binTriangles[bin]) {
+        RasterTriangle const& triangle = m_triangles[index];
+        // Whole groups of four pixels; the edge functions reject the ones
+        // beyond the triangle.
+        int x0 = std::max(triangle.minX, binX0) & ~3;
+        int x1 = std::min(triangle.maxX, binX1);
+        int y0 = std::max(triangle.minY, binY0);
+        int y1 = std::min(triangle.maxY, binY1);
+
+        for (int y = y0; y <= y1; y++) {
+            float py = static_cast<float>(y) + 0.5f;
+            float* row = &m_depth[size_t(y) * m_width];
+#ifdef UMBRELLA_X86
+            if (m_options.simd) {
+                __m128 centers = _mm_loadu_ps(pixelCenters);
+                __m128 zero = _mm_setzero_ps();
+                __m128 pyv = _mm_set1_ps(py);
+                for (int x = x0; x <= x1; x += 4) {
+                    __m128 px = _mm_add_ps(
+                        _mm_set1_ps(static_cast<float>(x)), centers);
+                    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for (int e = 0; e < 3; e++) {
+                        __m128 edge = _mm_add_ps(
+                            _mm_add_ps(
+                                _mm_mul_ps(_mm_set1_ps(triangle.a[e]), px),
+                                _mm_mul_ps(_mm_set1_ps(triangle.b[e]), pyv)),
+                            _mm_set1_ps(triangle.c[e]));
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+                    }
+                    __m128 z = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.za), px),
+                            _mm_mul_ps(_mm_set1_ps(triangle.zb), pyv)),
+                        _mm_set1_ps(triangle.zc));
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(z, old);
+                    _mm_storeu_ps(row + x,
+                        _mm_or_ps(_mm_and_ps(inside, nearer),
+                            _mm_andnot_ps(inside, old)));
+                }
+                continue;
+            }
+#endif
+            for (int x = x0; x <= x1; x += 4) {
+                for (int k = 0; k < 4; k++) {
+                    float px = static_cast<float>(x) + pixelCenters[k];
+                    bool inside = true;
+                    for (int e = 0; e < 3; e++) {
+                        float edge = triangle.a[e] * px + triangle.b[e] * py
+                            + triangle.c[e];
+                        inside &= edge >= 0.0f;
+                    }
+                    float z = triangle.za * px + triangle.zb * py + triangle.zc;
+                    float& depth = row[x + k];
+                    if (inside) {
+                        depth = z < depth ? z : depth;
+                    }
+                }
+            }
+        }
+    }
+
+    // Bins are whole tiles, so each bin owns the tiles it covers.
+    uint32_t tilesX = m_width / tileSize;
+    for (int ty = binY0; ty <= binY1; ty += tileSize) {
+        for (int tx = binX0; tx <= binX1; tx += tileSize) {
+            float farthest = 0.0f;
+            for (int y = ty; y < ty + static_cast<int>(tileSize); y++) {
+                float const* row = &m_depth[size_t(y) * m_width + tx];
+                for (uint32_t x = 0; x < tileSize; x++) {
+                    farthest = std::max(farthest, row[x]);
+                }
+            }
+            m_tileMax[(ty / tileSize) * tilesX + tx / tileSize] = farthest;
+        }
+    }
+}
+
+OcclusionBuffer::SphereFootprint OcclusionBuffer::Footprint(
+    glm::vec3 center, float radius) const
+{
+    // Bound x / w and y / w over the sphere's box with interval arithmetic:
+    // one transform instead of eight corners, and a little looser, which is
+    // still conservative.
+    SphereFootprint footprint;
+    glm::vec4 clip = m_viewProjection * glm::vec4(center, 1.0f);
+    glm::vec4 extent = radius * m_extentScale;
+    float minW = clip.w - extent.w;
+    float maxW = clip.w + extent.w;
+    if (minW <= 0.0f || clip.z + clip.w - radius * m_nearPlaneScale < 0.0f) {
+        // Crosses the near plane; never occluded.
+        return footprint;
+    }
+
+    auto lowest = [&](float value, float valueExtent) {
+        float low = value - valueExtent;
+        return low / (low >= 0.0f ? maxW : minW);
+    };
+    auto highest = [&](float value, float valueExtent) {
+        float high = value + valueExtent;
+        return high / (high >= 0.0f ? minW : maxW);
+    };
+    float width = static_cast<float>(m_width);
+    float height = static_cast<float>(m_height);
+    glm::vec2 minScreen((0.5f * lowest(clip.x, extent.x) + 0.5f) * width,
+        (0.5f * lowest(clip.y, extent.y) + 0.5f) * height);
+    glm::vec2 maxScreen((0.5f * highest(clip.x, extent.x) + 0.5f) * width,
+        (0.5f * highest(clip.y, extent.y) + 0.5f) * height);
+    // z and w move together, so bounding them apart would be far too
+    // loose; see Begin().
+    float nearestZ = clip.z - radius * m_nearestZScale;
+    float nearest = 0.5f * nearestZ / minW + 0.5f;
+
+    // Every pixel the rectangle touches, not just those whose center it
+    // covers. Clamped first, since a sphere close to the camera's plane
+    // projects arbitrarily far.
+    glm::vec2 screenMax(width + 1.0f, height + 1.0f);
+    minScreen = glm::clamp(minScreen, glm::vec2(-1.0f), screenMax);
+    maxScreen = glm::clamp(maxScreen, glm::vec2(-1.0f), screenMax);
+    footprint.minX = std::max(0, static_cast<int>(std::floor(minScreen.x)));
+    footprint.minY = std::max(0, static_cast<int>(std::floor(minScreen.y)));
+    footprint.maxX = std::min(static_cast<int>(m_width) - 1,
+        static_cast<int>(std::floor(maxScreen.x)));
+    footprint.maxY = std::min(static_cast<int>(m_height) - 1,
+        static_cast<int>(std::floor(maxScreen.y)));
+    footprint.onScreen
+        = footprint.minX <= footprint.maxX && footprint.minY <= footprint.maxY;
+    footprint.nearestDepth = nearest;
+    return footprint;
+}
+
+bool OcclusionBuffer::IsOccluded(glm::vec3 center, float radius) const
+{
+    SphereFootprint footprint = Footprint(center, radius);
+    if (!footprint.onScreen) {
+        return false;
+    }
+
+    int tile = static_cast<int>(tileSize);
+    int tilesX = static_cast<int>(m_width / tileSize);
+    for (int ty = footprint.minY / tile; ty <= footprint.maxY / tile; ty++) {
+        for (int tx = footprint.minX / tile; tx <= footprint.maxX / tile;
+            tx++) {
+            // Every pixel of the tile is nearer than the sphere.
+            if (m_tileMax[ty * tilesX + tx] < footprint.nearestDepth) {
+                continue;
+            }
+
+            int y0 = std::max(footprint.minY, ty * tile);
+            int y1 = std::min(footprint.maxY, ty * tile + tile - 1);
+            int x0 = std::max(footprint.minX, tx * tile);
+            int x1 = std::min(footprint.maxX, tx * tile + tile - 1);
+            for (int y = y0; y <= y1; y++) {
+                float const* row = &m_depth[size_t(y) * m_width];
+                for (int x = x0; x <= x1; x++) {
+                    if (row[x] >= footprint.nearestDepth) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool OcclusionBuffer::IsOccludedReference(glm::vec3 center, float radius) const
+{
+    SphereFootprint footprint = Footprint(center, radius);
+    if (!footprint.onScreen) {
+        return false;
+    }
+
+    for (int y = footprint.minY; y <= footprint.maxY; y++) {
+        for (int x = footprint.minX; x <= footprint.maxX; x++) {
+            if (m_depth[size_t(y) * m_width + x] >= footprint.nearestDepth) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace Umbrella
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Umbrella {
+
+struct OcclusionOptions {
+    // Off unless asked for: on the stress scenes the pass costs several
+    // milliseconds a frame and hides a few percent of the instances.
+    bool enabled = false;
+    // Resolution of the depth buffer occluders are rasterized into. Rounded
+    // up to whole bins.
+    uint32_t width = 256;
+    uint32_t height = 128;
+    // The instances covering the most of the screen are drawn as occluders.
+    uint32_t maxOccluders = 16;
+    // Below this, summed over the occluders, a frame skips the pass: their
+    // bounding discs as a fraction of a square as tall as the screen.
+    // Smaller occluders cost more to rasterize than they hide.
+    float minOccluderCoverage = 0.25f;
+    // Rasterize four pixels per instruction; off for the scalar reference.
+    bool simd = true;
+    // Rasterize screen bins on every core.
+    bool parallel = true;
+};
+
+struct OcclusionStats {
+    uint32_t occludersDrawn {};
+    uint32_t trianglesRasterized {};
+    uint32_t objectsTested {};
+    uint32_t objectsRejected {};
+    double rasterMs {};
+    double testMs {};
+};
+
+// Low-resolution software depth buffer for occlusion culling, in the spirit
+// of masked occlusion culling: occluders are rasterized on the CPU, then
+// bounds are tested against the farthest depth of every 8x8 tile before
+// falling back to single pixels. Depth is NDC z mapped to [0, 1], cleared to
+// 1. Everything is conservative except for sampling at pixel centers: a
+// triangle that misses a pixel's center does not occlude it.
+class OcclusionBuffer {
+public:
+    static constexpr uint32_t tileSize = 8;
+    static constexpr uint32_t binWidth = 64;
+    static constexpr uint32_t binHeight = 32;
+
+    explicit OcclusionBuffer(OcclusionOptions options = {});
+
+    // Clears the buffer and the queued occluders.
+    void Begin(glm::mat4 const& viewProjection);
+    // Queues the front-facing triangles of an occluder. Triangles crossing
+    // the near plane are dropped, which only makes culling less aggressive.
+    void AddOccluder(std::span<glm::vec3 const> positions,
+        std::span<uint32_t const> indices, glm::mat4 const& model);
+    // Rasterizes the queued occluders and builds the tile hierarchy.
+    void Rasterize();
+
+    // True when the sphere is certainly hidden behind the occluders.
+    bool IsOccluded(glm::vec3 center, float radius) const;
+    // The same answer, found without the tile hierarchy.
+    bool IsOccludedReference(glm::vec3 center, float radius) const;
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    std::span<float const> Depth() const { return m_depth; }
+    OcclusionStats const& Stats() const { return m_stats; }
+
+private:
+    struct RasterTriangle {
+        // Edge functions a * x + b * y + c, positive inside.
+        glm::vec3 a, b, c;
+        // Depth plane, raised to the farthest depth within each pixel.
+        float za, zb, zc;
+        int minX, minY, maxX, maxY;
+    };
+
+    // Screen rectangle of pixels a sphere may touch, and its nearest depth.
+    struct SphereFootprint {
+        bool onScreen {};
+        int minX {}, minY {}, maxX {}, maxY {};
+        float nearestDepth {};
+    };
+
+    SphereFootprint Footprint(glm::vec3 center, float radius) const;
+    void RasterizeBin(uint32_t bin);
+
+    OcclusionOptions m_options;
+    uint32_t m_width {};
+    uint32_t m_height {};
+    uint32_t m_binsX {};
+    uint32_t m_binsY {};
+    glm::mat4 m_viewProjection {1.0f};
+    glm::vec4 m_extentScale {};
+    float m_nearPlaneScale {};
+    float m_nearestZScale {};
+
+    std::vector<float> m_depth;
+    // Farthest depth of every tile.
+    std::vector<float> m_tileMax;
+    std::vector<RasterTriangle> m_triangles;
+    std::vector<std::vector<uint32_t>> m_binTriangles;
+    std::vector<glm::vec4> m_clip;
+    OcclusionStats m_stats;
+};
+
+} // namespace Umbrella
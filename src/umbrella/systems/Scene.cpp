@@ -0,0 +1,487 @@
+#include "Scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+#include "util/Framework.h"
+#include "util/Profiler.h"
+
+namespace Umbrella {
+
+namespace {
+
+    // Marks instances that WriteDraws leaves to WriteMeshletDraws.
+    constexpr uint32_t meshletBucket = UINT32_MAX;
+
+    // Occluders use the coarsest LOD that stays this close to the mesh,
+    // relative to its bounds diagonal, so they barely stick out of it.
+    constexpr float occluderMaxError = 0.01f;
+
+    void BuildOccluder(Assets::MeshView mesh, SceneMesh& packed)
+    {
+        float maxError
+            = occluderMaxError * glm::length(mesh.bounds.max - mesh.bounds.min);
+        Assets::MeshLod lod = {
+            .firstIndex = 0,
+            .indexCount = narrow_into<uint32_t>(mesh.indices.size()),
+            .error = 0.0f,
+            .firstShape = 0,
+            .numShapes = 0,
+        };
+        for (Assets::MeshLod const& candidate : mesh.lods) {
+            if (candidate.error <= maxError) {
+                lod = candidate;
+            }
+        }
+
+        // Keep only the positions the LOD uses.
+        std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+        for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount;
+            i++) {
+            uint32_t& index = remap[mesh.indices[i]];
+            if (index == UINT32_MAX) {
+                Assets::Vertex const& vertex = mesh.vertices[mesh.indices[i]];
+                index = narrow_into<uint32_t>(packed.occluderPositions.size());
+                packed.occluderPositions.emplace_back(
+                    vertex.x, vertex.y, vertex.z);
+            }
+            packed.occluderIndices.push_back(index);
+        }
+    }
+
+} // namespace
+
+SceneGeometry PackSceneGeometry(std::span<Assets::MeshView const> meshes,
+    Assets::VertexLayoutOptions options,
+    std::span<std::optional<Assets::EncodedMesh> const> encoded)
+{
+    UMBRELLA_PROFILE_ZONE("Pack scene geometry");
+    auto encodedMesh = [&](size_t m) -> Assets::EncodedMesh const* {
+        return m < encoded.size() && encoded[m] ? &*encoded[m] : nullptr;
+    };
+
+    // An encoded mesh in either layout these options pick already tells
+    // whether its texture coordinates fit 16-bit fractions, so only the
+    // others have to be scanned.
+    Assets::VertexLayout const unitLayout
+        = Assets::ChooseVertexLayout(options, true);
+    Assets::VertexLayout const wideLayout
+        = Assets::ChooseVertexLayout(options, false);
+    bool unitTexCoords = true;
+    std::vector<Assets::MeshView> scanned;
+    size_t maxVertices = 0;
+    for (size_t m = 0; m < meshes.size(); m++) {
+        maxVertices = std::max(maxVertices, meshes[m].vertices.size());
+        Assets::EncodedMesh const* mesh = encodedMesh(m);
+        if (unitLayout == wideLayout) {
+            continue;
+        }
+        if (mesh && mesh->layout == wideLayout) {
+            unitTexCoords = false;
+        } else if (!mesh || mesh->layout != unitLayout) {
+            scanned.push_back(meshes[m]);
+        }
+    }
+
+    SceneGeometry geometry;
+    geometry.layout = unitTexCoords && Assets::UnitTexCoords(scanned)
+        ? unitLayout
+        : wideLayout;
+    geometry.indexFormat = Assets::ChooseIndexFormat(maxVertices);
+
+    size_t numVertices = 0;
+    size_t numIndices = 0;
+    for (size_t m = 0; m < meshes.size(); m++) {
+        Assets::MeshView const& mesh = meshes[m];
+        uint32_t firstMaterial
+            = narrow_into<uint32_t>(geometry.materials.size());
+        geometry.materials.insert(geometry.materials.end(),
+            mesh.materials.begin(), mesh.materials.end());
+        if (mesh.materials.empty()) {
+            geometry.materials.push_back(Assets::DefaultMaterial());
+        }
+
+        SceneMesh packed {
+            .baseVertex = narrow_into<int32_t>(numVertices),
+            .lods = {mesh.lods.begin(), mesh.lods.end()},
+            .shapes = {},
+            .meshlets = {},
+            .boundsCenter = 0.5f * (mesh.bounds.min + mesh.bounds.max),
+            .boundsRadius
+            = 0.5f * glm::length(mesh.bounds.max - mesh.bounds.min),
+            .dequantize
+            = Assets::DequantizeMatrix(geometry.layout, mesh.bounds),
+            .occluderPositions = {},
+            .occluderIndices = {},
+        };
+        if (packed.lods.empty()) {
+            packed.lods.push_back({
+                .firstIndex = 0,
+                .indexCount = narrow_into<uint32_t>(mesh.indices.size()),
+                .error = 0.0f,
+                .firstShape = 0,
+                .numShapes = 0,
+            });
+        }
+
+        // A LOD without shape ranges is drawn whole, with the first
+        // material.
+        for (Assets::MeshLod& lod : packed.lods) {
+            std::span<Assets::MeshShapeRange const> shapes;
+            if (lod.numShapes > 0) {
+                shapes = mesh.shapes.subspan(lod.firstShape, lod.numShapes);
+            }
+            Assets::MeshShapeRange whole {
+                .firstIndex = lod.firstIndex,
+                .indexCount = lod.indexCount,
+                .material = 0,
+            };
+            if (shapes.empty()) {
+                shapes = {&whole, 1};
+            }
+            lod.firstShape = narrow_into<uint32_t>(packed.shapes.size());
+            lod.numShapes = narrow_into<uint32_t>(shapes.size());
+            for (Assets::MeshShapeRange shape : shapes) {
+                shape.firstIndex += narrow_into<uint32_t>(numIndices);
+                shape.material += firstMaterial;
+                packed.shapes.push_back(shape);
+            }
+            lod.firstIndex += narrow_into<uint32_t>(numIndices);
+        }
+        for (Assets::Meshlet meshlet : mesh.meshlets) {
+            meshlet.firstIndex += narrow_into<uint32_t>(numIndices);
+            packed.meshlets.push_back(meshlet);
+        }
+        BuildOccluder(mesh, packed);
+        geometry.meshes.push_back(std::move(packed));
+
+        // Encoding is the fallback, for meshes that were just built or were
+        // baked in another layout or index format.
+        Assets::EncodedMesh const* stored = encodedMesh(m);
+        if (stored && stored->layout == geometry.layout) {
+            geometry.vertexData.insert(geometry.vertexData.end(),
+                stored->vertexData.begin(), stored->vertexData.end());
+        } else {
+            std::vector<std::byte> vertexData = Assets::EncodeVertices(
+                mesh.vertices, geometry.layout, mesh.bounds);
+            geometry.vertexData.insert(geometry.vertexData.end(),
+                vertexData.begin(), vertexData.end());
+        }
+        if (stored && stored->indexFormat == geometry.indexFormat) {
+            geometry.indexData.insert(geometry.indexData.end(),
+                stored->indexData.begin(), stored->indexData.end());
+        } else {
+            std::vector<std::byte> indexData
+                = Assets::EncodeIndices(mesh.indices, geometry.indexFormat);
+            geometry.indexData.insert(
+                geometry.indexData.end(), indexData.begin(), indexData.end());
+        }
+        numVertices += mesh.vertices.size();
+        numIndices += mesh.indices.size();
+    }
+    return geometry;
+}
+
+Scene::Scene(std::vector<SceneMesh> meshes, SceneOptions options)
+    : m_meshes(std::move(meshes))
+    , m_options(options)
+    , m_occlusion(options.occlusion)
+{
+    size_t maxMeshlets = 0;
+    for (SceneMesh const& mesh : m_meshes) {
+        m_firstBucket.push_back(m_numBuckets);
+        m_numBuckets += narrow_into<uint32_t>(mesh.lods.size());
+        m_maxDraws += narrow_into<uint32_t>(mesh.shapes.size());
+        maxMeshlets = std::max(maxMeshlets, mesh.meshlets.size());
+    }
+    if (m_options.meshlets.enabled) {
+        m_maxDraws += narrow_into<uint32_t>(
+            m_options.meshlets.maxInstances * maxMeshlets);
+        m_meshletRuns.resize(maxMeshlets);
+    }
+}
+
+uint32_t Scene::AddInstance(glm::mat4 const& transform, uint32_t mesh)
+{
+    uint32_t instance = narrow_into<uint32_t>(m_transforms.size());
+    m_transforms.push_back(transform);
+    m_instanceMeshes.push_back(mesh);
+    m_bounds.Push({}, -1.0f);
+    m_selectors.emplace_back(m_options.lod);
+    SetTransform(instance, transform);
+    return instance;
+}
+
+void Scene::SetTransform(uint32_t instance, glm::mat4 const& transform)
+{
+    m_transforms[instance] = transform;
+    // New instances have no bounds to move out of yet.
+    if (m_bounds.radius[instance] >= 0.0f) {
+        m_movedBounds.Push(
+            {m_bounds.x[instance], m_bounds.y[instance], m_bounds.z[instance]},
+            m_bounds.radius[instance]);
+    }
+
+    SceneMesh const& mesh = m_meshes[m_instanceMeshes[instance]];
+    float scale = std::max({glm::length(glm::vec3(transform[0])),
+        glm::length(glm::vec3(transform[1])),
+        glm::length(glm::vec3(transform[2]))});
+    m_bounds.Set(instance,
+        glm::vec3(transform * glm::vec4(mesh.boundsCenter, 1.0f)),
+        mesh.boundsRadius * scale);
+    m_movedBounds.Push(
+        {m_bounds.x[instance], m_bounds.y[instance], m_bounds.z[instance]},
+        m_bounds.radius[instance]);
+}
+
+DrawListStats Scene::BuildDrawList(
+    SceneView const& view, DrawListTargets targets)
+{
+    UMBRELLA_PROFILE_ZONE("Build draw list");
+    size_t numInstances = m_transforms.size();
+    m_visible.resize(numInstances);
+    m_instanceBuckets.resize(numInstances);
+    m_bucketCursors.assign(m_numBuckets, 0);
+    m_meshletInstances.clear();
+
+    DrawListStats stats;
+    CullSpheres(ExtractFrustum(view.viewProjection), m_bounds, m_visible);
+    stats.numCulled = narrow_into<uint32_t>(
+        numInstances - static_cast<size_t>(std::ranges::count(m_visible, 1)));
+    m_occlusionStats = {};
+    if (m_options.occlusion.enabled) {
+        CullOccluded(view, stats);
+    }
+
+    // Select LODs and count the instances of every (mesh, LOD) bucket.
+    for (size_t i = 0; i < numInstances; i++) {
+        if (!m_visible[i]) {
+            continue;
+        }
+
+        SceneMesh const& mesh = m_meshes[m_instanceMeshes[i]];
+        glm::vec3 center(m_bounds.x[i], m_bounds.y[i], m_bounds.z[i]);
+        size_t lod = m_selectors[i].Select(
+            mesh.lods, center, m_bounds.radius[i], view.lod);
+        stats.fullTriangles += mesh.lods.front().indexCount / 3;
+        if (lod == 0 && m_options.meshlets.enabled && !mesh.meshlets.empty()
+            && m_meshletInstances.size() < m_options.meshlets.maxInstances) {
+            m_instanceBuckets[i] = meshletBucket;
+            m_meshletInstances.push_back(static_cast<uint32_t>(i));
+            continue;
+        }
+
+        uint32_t bucket
+            = m_firstBucket[m_instanceMeshes[i]] + static_cast<uint32_t>(lod);
+        m_instanceBuckets[i] = bucket;
+        m_bucketCursors[bucket]++;
+        stats.numTriangles += mesh.lods[lod].indexCount / 3;
+    }
+
+    WriteDraws(m_visible, targets, stats);
+    WriteMeshletDraws(view, targets, stats);
+    return stats;
+}
+
+DrawListStats Scene::BuildCasterList(
+    CasterView const& view, DrawListTargets targets)
+{
+    UMBRELLA_PROFILE_ZONE("Build caster list");
+    size_t numInstances = m_transforms.size();
+    m_casterVisible.resize(numInstances);
+    m_instanceBuckets.resize(numInstances);
+    m_bucketCursors.assign(m_numBuckets, 0);
+
+    DrawListStats stats;
+    CullSpheres(
+        ExtractFrustum(view.viewProjection), m_bounds, m_casterVisible);
+    for (size_t i = 0; i < numInstances; i++) {
+        if (!m_casterVisible[i]) {
+            stats.numCulled++;
+            continue;
+        }
+
+        // LOD errors are in model space; the bounds carry the scale.
+        SceneMesh const& mesh = m_meshes[m_instanceMeshes[i]];
+        float scale = m_bounds.radius[i] / std::max(mesh.boundsRadius, 1e-6f);
+        size_t lod = 0;
+        while (lod + 1 < mesh.lods.size()
+            && mesh.lods[lod + 1].error * scale <= view.maxError) {
+            lod++;
+        }
+
+        uint32_t bucket
+            = m_firstBucket[m_instanceMeshes[i]] + static_cast<uint32_t>(lod);
+        m_instanceBuckets[i] = bucket;
+        m_bucketCursors[bucket]++;
+        stats.numTriangles += mesh.lods[lod].indexCount / 3;
+        stats.fullTriangles += mesh.lods.front().indexCount / 3;
+    }
+
+    WriteDraws(m_casterVisible, targets, stats);
+    return stats;
+}
+
+void Scene::WriteDraws(std::span<uint8_t const> visible,
+    DrawListTargets targets, DrawListStats& stats)
+{
+    // One command per shape range of every bucket in use; the bucket's
+    // cursor becomes where its transforms start.
+    size_t numInstances = m_transforms.size();
+    uint32_t firstInstance = 0;
+    for (uint32_t mesh = 0; mesh < m_meshes.size(); mesh++) {
+        SceneMesh const& sceneMesh = m_meshes[mesh];
+        for (uint32_t lod = 0; lod < sceneMesh.lods.size(); lod++) {
+            uint32_t& cursor = m_bucketCursors[m_firstBucket[mesh] + lod];
+            uint32_t count = cursor;
+            cursor = firstInstance;
+            if (count == 0) {
+                continue;
+            }
+
+            Assets::MeshLod const& range = sceneMesh.lods[lod];
+            for (uint32_t s = range.firstShape;
+                s < range.firstShape + range.numShapes; s++) {
+                Assets::MeshShapeRange const& shape = sceneMesh.shapes[s];
+                targets.commands[stats.numDraws] = {
+                    .count = shape.indexCount,
+                    .instanceCount = count,
+                    .firstIndex = shape.firstIndex,
+                    .baseVertex = sceneMesh.baseVertex,
+                    .baseInstance = firstInstance,
+                };
+                targets.records[stats.numDraws] = {
+                    .firstInstance = firstInstance,
+                    .mesh = mesh,
+                    .material = shape.material,
+                };
+                stats.numDraws++;
+            }
+            firstInstance += count;
+        }
+    }
+
+    for (size_t i = 0; i < numInstances; i++) {
+        if (!visible[i] || m_instanceBuckets[i] == meshletBucket) {
+            continue;
+        }
+        uint32_t slot = m_bucketCursors[m_instanceBuckets[i]]++;
+        targets.transforms[slot] = m_transforms[i];
+    }
+    stats.numInstances = firstInstance;
+}
+
+void Scene::WriteMeshletDraws(
+    SceneView const& view, DrawListTargets targets, DrawListStats& stats)
+{
+    UMBRELLA_PROFILE_ZONE("Cull meshlets");
+    // Each instance gets its own transform, shared by the commands of its
+    // runs, unless nothing of it is left.
+    uint32_t slot = stats.numInstances;
+    for (uint32_t i : m_meshletInstances) {
+        uint32_t meshIndex = m_instanceMeshes[i];
+        SceneMesh const& mesh = m_meshes[meshIndex];
+        uint64_t culledBefore = stats.meshlets.culledTriangles;
+        size_t numRuns = CullMeshlets(mesh.meshlets,
+            MeshletViewOf(
+                view.viewProjection, view.lod.cameraPosition, m_transforms[i]),
+            m_options.meshlets, m_meshletRuns, stats.meshlets);
+        stats.numTriangles += mesh.lods.front().indexCount / 3
+            - (stats.meshlets.culledTriangles - culledBefore);
+        if (numRuns == 0) {
+            continue;
+        }
+
+        uint32_t firstShape = mesh.lods.front().firstShape;
+        for (size_t r = 0; r < numRuns; r++) {
+            MeshletRun const& run = m_meshletRuns[r];
+            targets.commands[stats.numDraws] = {
+                .count = run.indexCount,
+                .instanceCount = 1,
+                .firstIndex = run.firstIndex,
+                .baseVertex = mesh.baseVertex,
+                .baseInstance = slot,
+            };
+            targets.records[stats.numDraws] = {
+                .firstInstance = slot,
+                .mesh = meshIndex,
+                .material = mesh.shapes[firstShape + run.shape].material,
+            };
+            stats.numDraws++;
+        }
+        targets.transforms[slot++] = m_transforms[i];
+    }
+    stats.numInstances = slot;
+}
+
+void Scene::CullOccluded(SceneView const& view, DrawListStats& stats)
+{
+    UMBRELLA_PROFILE_ZONE("Cull occluded");
+    // The visible instances that look biggest make the best occluders.
+    m_occluderCandidates.clear();
+    for (uint32_t i = 0; i < m_transforms.size(); i++) {
+        if (!m_visible[i]
+            || m_meshes[m_instanceMeshes[i]].occluderIndices.empty()) {
+            continue;
+        }
+        glm::vec3 center(m_bounds.x[i], m_bounds.y[i], m_bounds.z[i]);
+        float distance = glm::length(center - view.lod.cameraPosition);
+        m_occluderCandidates.emplace_back(
+            -m_bounds.radius[i] / std::max(distance, 1e-3f), i);
+    }
+    size_t numOccluders = std::min<size_t>(
+        m_options.occlusion.maxOccluders, m_occluderCandidates.size());
+    std::ranges::nth_element(m_occluderCandidates,
+        m_occluderCandidates.begin() + numOccluders);
+    m_occluderCandidates.resize(numOccluders);
+
+    // The score is the tangent of a bound's angular radius, so over that of
+    // half the field of view it is the radius of its disc in NDC.
+    float tanHalfFov = std::tan(0.5f * view.lod.verticalFov);
+    float coverage = 0.0f;
+    for (auto [score, i] : m_occluderCandidates) {
+        float radius = score / tanHalfFov;
+        coverage += 0.25f * glm::pi<float>() * radius * radius;
+    }
+    if (coverage < m_options.occlusion.minOccluderCoverage) {
+        return;
+    }
+
+    m_occlusion.Begin(view.viewProjection);
+    for (auto [score, i] : m_occluderCandidates) {
+        SceneMesh const& mesh = m_meshes[m_instanceMeshes[i]];
+        m_occlusion.AddOccluder(
+            mesh.occluderPositions, mesh.occluderIndices, m_transforms[i]);
+    }
+    m_occlusion.Rasterize();
+    m_occlusionStats = m_occlusion.Stats();
+
+    // Occluders are never hidden by themselves, so they are not tested.
+    for (auto [score, i] : m_occluderCandidates) {
+        m_visible[i] = 2;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < m_transforms.size(); i++) {
+        if (m_visible[i] != 1) {
+            continue;
+        }
+        m_occlusionStats.objectsTested++;
+        glm::vec3 center(m_bounds.x[i], m_bounds.y[i], m_bounds.z[i]);
+        if (m_occlusion.IsOccluded(center, m_bounds.radius[i])) {
+            m_visible[i] = 0;
+            m_occlusionStats.objectsRejected++;
+        }
+    }
+    for (auto [score, i] : m_occluderCandidates) {
+        m_visible[i] = 1;
+    }
+    m_occlusionStats.testMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start)
+                                  .count();
+    stats.numOccluded = m_occlusionStats.objectsRejected;
+}
+
+} // namespace Umbrella
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "assets/Mesh.h"
+#include "assets/VertexLayout.h"
+#include "systems/FrustumCulling.h"
+#include "systems/LodSelector.h"
+#include "systems/MeshletCulling.h"
+#include "systems/OcclusionCulling.h"
+
+namespace Umbrella {
+
+// A mesh packed into the scene's shared vertex and index buffers.
+struct SceneMesh {
+    int32_t baseVertex;
+    // LOD ranges, with firstIndex already pointing into the shared indices.
+    std::vector<Assets::MeshLod> lods;
+    // Shape ranges of every LOD, likewise, with their material an index
+    // into SceneGeometry::materials.
+    std::vector<Assets::MeshShapeRange> shapes;
+    // LOD 0 split into meshlets, likewise, with their shape an index into
+    // the shape ranges of LOD 0. Empty when the mesh was not split.
+    std::vector<Assets::Meshlet> meshlets;
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+    // Maps the stored positions of this mesh back into model space.
+    glm::mat4 dequantize;
+    // Coarse copy of the mesh rasterized when an instance is picked as an
+    // occluder.
+    std::vector<glm::vec3> occluderPositions;
+    std::vector<uint32_t> occluderIndices;
+};
+
+// Vertex and index data of every mesh of a scene, encoded in one layout so
+// that a single VAO draws all of them.
+struct SceneGeometry {
+    Assets::VertexLayout layout;
+    Assets::IndexFormat indexFormat;
+    std::vector<std::byte> vertexData;
+    std::vector<std::byte> indexData;
+    std::vector<SceneMesh> meshes;
+    // The materials of every mesh, one after the other.
+    std::vector<Assets::MeshMaterial> materials;
+};
+
+// Indices stay relative to their own mesh and are offset with baseVertex,
+// so 16-bit indices are used as long as every mesh fits them on its own.
+// Meshes with an encoded copy, such as those mapped from the mesh cache, are
+// appended as they are when it is in the scene's layout and index format,
+// and encoded from their vertices otherwise.
+SceneGeometry PackSceneGeometry(std::span<Assets::MeshView const> meshes,
+    Assets::VertexLayoutOptions options,
+    std::span<std::optional<Assets::EncodedMesh> const> encoded = {});
+
+// DrawElementsIndirectCommand, as glMultiDrawElementsIndirect reads it.
+struct DrawCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+// What the vertex shader looks up with gl_DrawID: where the draw's
+// instance transforms start, which mesh it draws and with what material.
+struct DrawRecord {
+    uint32_t firstInstance;
+    uint32_t mesh;
+    uint32_t material;
+};
+
+// Where BuildDrawList writes, usually straight into mapped GPU memory.
+struct DrawListTargets {
+    std::span<DrawCommand> commands;
+    std::span<DrawRecord> records;
+    std::span<glm::mat4> transforms;
+};
+
+struct DrawListStats {
+    uint32_t numDraws {};
+    uint32_t numInstances {};
+    // Instances outside the frustum, and inside it but behind occluders.
+    uint32_t numCulled {};
+    uint32_t numOccluded {};
+    uint64_t numTriangles {};
+    // Triangles the same instances have at LOD 0.
+    uint64_t fullTriangles {};
+    // Instances at LOD 0 culled meshlet by meshlet. The triangles of the
+    // meshlets they drop are not in numTriangles.
+    MeshletCullStats meshlets {};
+};
+
+struct SceneOptions {
+    LodSelectorOptions lod;
+    OcclusionOptions occlusion;
+    MeshletCullingOptions meshlets;
+};
+
+// The camera a draw list is built for.
+struct SceneView {
+    glm::mat4 viewProjection;
+    LodView lod;
+};
+
+// A shadow cascade, or any other view casters are drawn into.
+struct CasterView {
+    glm::mat4 viewProjection;
+    // Largest world-space error a caster's LOD may show, usually the size
+    // of a shadow map texel.
+    float maxError;
+};
+
+// Placed instances of the meshes of a SceneGeometry.
+class Scene {
+public:
+    explicit Scene(std::vector<SceneMesh> meshes, SceneOptions options = {});
+
+    uint32_t AddInstance(glm::mat4 const& transform, uint32_t mesh);
+    void SetTransform(uint32_t instance, glm::mat4 const& transform);
+
+    std::span<SceneMesh const> Meshes() const { return m_meshes; }
+    std::span<glm::mat4 const> Transforms() const { return m_transforms; }
+    // World-space bounding sphere of every instance.
+    BoundingSpheres const& Bounds() const { return m_bounds; }
+    size_t NumInstances() const { return m_transforms.size(); }
+    // Largest number of commands BuildDrawList can write: one per shape
+    // range of every LOD of every mesh, and one per meshlet of each
+    // instance culled meshlet by meshlet.
+    size_t MaxDraws() const { return m_maxDraws; }
+
+    // Culls instances outside the frustum or behind occluders, picks a LOD
+    // for the rest and writes one command per shape range of every mesh and
+    // LOD in use, with the transforms of its instances next to each other.
+    // The commands of one mesh and LOD share those transforms. Up to
+    // SceneOptions::meshlets.maxInstances instances at LOD 0 are instead
+    // culled meshlet by meshlet against the frustum and the camera, and
+    // draw what is left in one command per run of meshlets. targets must
+    // have room for MaxDraws() commands and records and for NumInstances()
+    // transforms.
+    DrawListStats BuildDrawList(SceneView const& view, DrawListTargets targets);
+
+    // Writes the draws of the instances inside the view like
+    // BuildDrawList, each with the coarsest LOD whose error stays below
+    // view.maxError. Neither occlusion nor the camera's LOD picks are
+    // involved, and Visibility() stays as the last BuildDrawList left it.
+    DrawListStats BuildCasterList(
+        CasterView const& view, DrawListTargets targets);
+
+    // The spheres instances moved out of and into since the last
+    // ClearMovedBounds(), new instances included, for invalidating whatever
+    // was cached over them.
+    BoundingSpheres const& MovedBounds() const { return m_movedBounds; }
+    void ClearMovedBounds() { m_movedBounds.Clear(); }
+
+    // Which instances the last BuildDrawList kept.
+    std::span<uint8_t const> Visibility() const { return m_visible; }
+    OcclusionStats const& LastOcclusionStats() const
+    {
+        return m_occlusionStats;
+    }
+    OcclusionBuffer const& Occlusion() const { return m_occlusion; }
+
+private:
+    void CullOccluded(SceneView const& view, DrawListStats& stats);
+    // Writes the commands of every bucket m_bucketCursors counts instances
+    // for, and the transforms of the instances marked in visible.
+    void WriteDraws(std::span<uint8_t const> visible, DrawListTargets targets,
+        DrawListStats& stats);
+    // Appends the draws of the instances in m_meshletInstances, after
+    // those WriteDraws wrote.
+    void WriteMeshletDraws(SceneView const& view, DrawListTargets targets,
+        DrawListStats& stats);
+
+    std::vector<SceneMesh> m_meshes;
+    // First (mesh, LOD) bucket of each mesh.
+    std::vector<uint32_t> m_firstBucket;
+    uint32_t m_numBuckets {};
+    uint32_t m_maxDraws {};
+
+    std::vector<glm::mat4> m_transforms;
+    std::vector<uint32_t> m_instanceMeshes;
+    // World-space bounding sphere of each instance.
+    BoundingSpheres m_bounds;
+    BoundingSpheres m_movedBounds;
+    std::vector<LodSelector> m_selectors;
+    SceneOptions m_options;
+
+    OcclusionBuffer m_occlusion;
+    OcclusionStats m_occlusionStats;
+    std::vector<std::pair<float, uint32_t>> m_occluderCandidates;
+
+    std::vector<uint8_t> m_visible;
+    std::vector<uint8_t> m_casterVisible;
+    std::vector<uint32_t> m_instanceBuckets;
+    std::vector<uint32_t> m_bucketCursors;
+    std::vector<uint32_t> m_meshletInstances;
+    std::vector<MeshletRun> m_meshletRuns;
+};
+
+} // namespace Umbrella
@@ -0,0 +1,168 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "util/Profiler.h"
+
+namespace Umbrella {
+
+namespace {
+
+    // Radii are rounded up to this, so float noise in the fit of an
+    // unchanged view never counts as a change.
+    constexpr float radiusStep = 1.0f / 64.0f;
+
+    // Looks from the origin along the light, so only the rotation matters;
+    // cascades translate on their own.
+    glm::mat4 LightView(glm::vec3 direction)
+    {
+        glm::vec3 up = std::abs(direction.y) > 0.99f
+            ? glm::vec3(1.0f, 0.0f, 0.0f)
+            : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::lookAt(glm::vec3(0.0f), -direction, up);
+    }
+
+    // The smallest sphere around the view frustum between view depths near
+    // and far. Its centre lies on the view axis, where the corners of both
+    // ends are equally far; with k the corners' distance from the axis per
+    // unit of depth, that is at depth (near + far)(1 + k^2) / 2, or the far
+    // end if that is further.
+    float SliceSphere(ShadowView const& view, float near, float far,
+        float& centerDepth)
+    {
+        float tanHalf = std::tan(0.5f * view.verticalFov);
+        float kSquared = tanHalf * tanHalf * (1.0f + view.aspect * view.aspect);
+        centerDepth = std::min(0.5f * (near + far) * (1.0f + kSquared), far);
+        float radius = std::sqrt((centerDepth - near) * (centerDepth - near)
+            + near * near * kSquared);
+        radius = std::max(radius,
+            std::sqrt((far - centerDepth) * (far - centerDepth)
+                + far * far * kSquared));
+        return std::ceil(radius / radiusStep) * radiusStep;
+    }
+
+} // namespace
+
+ShadowCascades::ShadowCascades(ShadowCascadeOptions options)
+    : m_options(options)
+{
+    m_options.numCascades
+        = std::clamp(m_options.numCascades, 1u, maxShadowCascades);
+    m_options.resolution = std::max(m_options.resolution, 1u);
+}
+
+std::span<ShadowCascade const> ShadowCascades::Update(
+    ShadowView const& view, DirectionalLight const& light,
+    CasterBounds const& casters)
+{
+    UMBRELLA_PROFILE_ZONE("Fit shadow cascades");
+    m_lightView = LightView(light.direction);
+    glm::mat4 viewToWorld = glm::inverse(view.view);
+    // The caster nearest the light; anything between it and a cascade can
+    // throw a shadow into it.
+    float casterMaxZ
+        = (m_lightView * glm::vec4(casters.center, 1.0f)).z + casters.radius;
+
+    uint32_t numCascades = m_options.numCascades;
+    float near = view.nearPlane;
+    float far = std::max(m_options.maxDistance, near);
+    float sliceNear = near;
+    for (uint32_t c = 0; c < numCascades; c++) {
+        // Practical split scheme: a blend of logarithmic splits, which keep
+        // texels per pixel even, and uniform ones.
+        float t = static_cast<float>(c + 1) / static_cast<float>(numCascades);
+        float sliceFar = m_options.splitLambda * near * std::pow(far / near, t)
+            + (1.0f - m_options.splitLambda) * (near + (far - near) * t);
+
+        float centerDepth = 0.0f;
+        float sliceRadius = SliceSphere(view, sliceNear, sliceFar, centerDepth);
+        glm::vec3 center = m_lightView * viewToWorld
+            * glm::vec4(0.0f, 0.0f, -centerDepth, 1.0f);
+
+        Fit& fit = m_fits[c];
+        CascadeStats& stats = m_stats[c];
+        stats.frames++;
+        bool covered = m_options.cache && fit.valid
+            && fit.lightDirection == light.direction
+            && fit.sliceRadius == sliceRadius
+            && std::abs(center.x - fit.center.x) + sliceRadius
+                <= fit.coverRadius
+            && std::abs(center.y - fit.center.y) + sliceRadius
+                <= fit.coverRadius
+            && center.z - sliceRadius >= fit.minZ
+            && std::max(center.z + sliceRadius, casterMaxZ) <= fit.maxZ;
+
+        ShadowCascade& cascade = m_cascades[c];
+        cascade.splitDepth = sliceFar;
+        cascade.render = !covered || fit.invalidated;
+        sliceNear = sliceFar;
+        if (covered) {
+            stats.invalidations += fit.invalidated ? 1 : 0;
+            stats.renders += fit.invalidated ? 1 : 0;
+            fit.invalidated = false;
+            continue;
+        }
+
+        // Snap the centre to whole texels across the light, so the
+        // cascade's texels land on the same spots of the world every time
+        // it is fitted.
+        float coverRadius = sliceRadius * (1.0f + m_options.cacheMargin);
+        float texelSize
+            = 2.0f * coverRadius / static_cast<float>(m_options.resolution);
+        center.x = std::floor(center.x / texelSize) * texelSize;
+        center.y = std::floor(center.y / texelSize) * texelSize;
+        fit = {
+            .lightDirection = light.direction,
+            .center = center,
+            .sliceRadius = sliceRadius,
+            .coverRadius = coverRadius,
+            .minZ = center.z - coverRadius,
+            .maxZ = std::max(center.z + coverRadius, casterMaxZ),
+            .valid = true,
+            .invalidated = false,
+        };
+        stats.renders++;
+        stats.refits++;
+
+        // Looking down -z, so the near plane is at -maxZ.
+        glm::mat4 projection = glm::ortho(center.x - coverRadius,
+            center.x + coverRadius, center.y - coverRadius,
+            center.y + coverRadius, -fit.maxZ, -fit.minZ);
+        cascade.viewProjection = projection * m_lightView;
+        cascade.texelSize = texelSize;
+    }
+    return Cascades();
+}
+
+void ShadowCascades::Invalidate(glm::vec3 center, float radius)
+{
+    glm::vec3 lightCenter = m_lightView * glm::vec4(center, 1.0f);
+    for (uint32_t c = 0; c < m_options.numCascades; c++) {
+        Fit& fit = m_fits[c];
+        if (!fit.valid) {
+            continue;
+        }
+        glm::vec3 low(fit.center.x - fit.coverRadius,
+            fit.center.y - fit.coverRadius, fit.minZ);
+        glm::vec3 high(fit.center.x + fit.coverRadius,
+            fit.center.y + fit.coverRadius, fit.maxZ);
+        glm::vec3 outside = glm::max(glm::max(low - lightCenter,
+                                         lightCenter - high),
+            glm::vec3(0.0f));
+        if (glm::dot(outside, outside) <= radius * radius) {
+            fit.invalidated = true;
+        }
+    }
+}
+
+void ShadowCascades::InvalidateAll()
+{
+    for (Fit& fit : m_fits) {
+        fit.valid = false;
+    }
+}
+
+} // namespace Umbrella
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include <glm/glm.hpp>
+
+namespace Umbrella {
+
+constexpr uint32_t maxShadowCascades = 4;
+
+// A light infinitely far away, like the sun.
+struct DirectionalLight {
+    // Unit vector from the scene towards the light.
+    glm::vec3 direction;
+    glm::vec3 color;
+    float intensity;
+};
+
+struct ShadowCascadeOptions {
+    uint32_t numCascades = maxShadowCascades;
+    // Texels across each cascade's shadow map.
+    uint32_t resolution = 2048;
+    // Nothing casts shadows past this view depth.
+    float maxDistance = 80.0f;
+    // How far the splits lean from uniform (0) to logarithmic (1).
+    float splitLambda = 0.8f;
+    // A cascade covers this fraction more than its slice of the view
+    // needs, so the camera can move that far before the cascade is fitted
+    // and rendered again. Zero re-renders it whenever its fit moves.
+    float cacheMargin = 0.15f;
+    // Off, every cascade is fitted and rendered every frame; the baseline
+    // caching is measured against.
+    bool cache = true;
+};
+
+// The perspective camera cascades are fitted to.
+struct ShadowView {
+    glm::mat4 view;
+    float verticalFov;
+    float aspect;
+    float nearPlane;
+};
+
+// Where anything that casts a shadow may be, in world space.
+struct CasterBounds {
+    glm::vec3 center;
+    float radius;
+};
+
+struct ShadowCascade {
+    // World space to the cascade's clip space.
+    glm::mat4 viewProjection {1.0f};
+    // View depth the cascade's slice of the view ends at.
+    float splitDepth {};
+    // World-space size of one shadow map texel.
+    float texelSize {};
+    // Set by Update() when the cascade has to be rendered this frame.
+    bool render {};
+};
+
+struct CascadeStats {
+    uint64_t frames {};
+    uint64_t renders {};
+    // Renders because the view left the cascade, and because something
+    // moved inside it.
+    uint64_t refits {};
+    uint64_t invalidations {};
+
+    double UpdateRate() const
+    {
+        return frames == 0 ? 0.0
+                           : static_cast<double>(renders)
+                / static_cast<double>(frames);
+    }
+};
+
+// Fits shadow cascades of a directional light to the view and keeps each
+// one until it has to be rendered again. A cascade is fitted to the
+// bounding sphere of its slice of the view frustum, which does not change
+// as the camera turns, and its centre snaps to whole texels, so its texels
+// stay put on the ground and shadow edges do not shimmer. The fit covers
+// cacheMargin more than the sphere; the cascade is only fitted and
+// rendered again once the sphere leaves it, the light turns, or something
+// moves inside it.
+class ShadowCascades {
+public:
+    explicit ShadowCascades(ShadowCascadeOptions options = {});
+
+    ShadowCascadeOptions const& Options() const { return m_options; }
+
+    // Refits the cascades that no longer cover the view and flags those
+    // to render this frame.
+    std::span<ShadowCascade const> Update(ShadowView const& view,
+        DirectionalLight const& light, CasterBounds const& casters);
+
+    // Something that casts shadows moved into or out of this sphere; the
+    // cascades it touches render again on the next Update().
+    void Invalidate(glm::vec3 center, float radius);
+    void InvalidateAll();
+
+    std::span<ShadowCascade const> Cascades() const
+    {
+        return {m_cascades.data(), m_options.numCascades};
+    }
+    std::span<CascadeStats const> Stats() const
+    {
+        return {m_stats.data(), m_options.numCascades};
+    }
+    void ResetStats() { m_stats = {}; }
+
+private:
+    // What a cascade was last rendered with, in the light's space.
+    struct Fit {
+        glm::vec3 lightDirection {};
+        glm::vec3 center {};
+        // Of the slice's sphere, and of the square the cascade covers.
+        float sliceRadius {};
+        float coverRadius {};
+        float minZ {};
+        float maxZ {};
+        bool valid {};
+        bool invalidated {};
+    };
+
+    ShadowCascadeOptions m_options;
+    glm::mat4 m_lightView {1.0f};
+    std::array<Fit, maxShadowCascades> m_fits {};
+    std::array<ShadowCascade, maxShadowCascades> m_cascades {};
+    std::array<CascadeStats, maxShadowCascades> m_stats {};
+};
+
+} // namespace Umbrella
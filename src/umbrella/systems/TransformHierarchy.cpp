@@ -0,0 +1,525 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "util/Parallel.h"
+#include "util/Profiler.h"
+#include "util/Simd.h"
+
+namespace Umbrella {
+
+namespace {
+
+    // Nodes of a parallel level are handed out in runs this long, a
+    // multiple of every SIMD width.
+    constexpr size_t chunkNodes = 4096;
+
+    struct NodeArrays {
+        float const* translationX;
+        float const* translationY;
+        float const* translationZ;
+        float const* rotationX;
+        float const* rotationY;
+        float const* rotationZ;
+        float const* rotationW;
+        float const* scale;
+        uint32_t const* parent;
+        uint8_t const* dirty;
+        glm::mat4* world;
+    };
+
+    // world = parent * local, column by column, in the order the SIMD
+    // versions add them up.
+    void Compose(NodeArrays const& nodes, size_t i, glm::mat4 const& local)
+    {
+        uint32_t parent = nodes.parent[i];
+        if (parent == noParent) {
+            nodes.world[i] = local;
+            return;
+        }
+        glm::mat4 const& p = nodes.world[parent];
+        glm::mat4& world = nodes.world[i];
+        for (int c = 0; c < 4; c++) {
+            world[c] = p[0] * local[c].x + p[1] * local[c].y
+                + p[2] * local[c].z + p[3] * local[c].w;
+        }
+    }
+
+    // Shared by the scalar version and the tails of the SIMD ones. The
+    // rotation is the usual unit quaternion one, with every term scaled.
+    void UpdateRange(NodeArrays const& nodes, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++) {
+            if (!nodes.dirty[i]) {
+                continue;
+            }
+            float x = nodes.rotationX[i];
+            float y = nodes.rotationY[i];
+            float z = nodes.rotationZ[i];
+            float w = nodes.rotationW[i];
+            float s = nodes.scale[i];
+            float xx = x * x;
+            float yy = y * y;
+            float zz = z * z;
+            float xy = x * y;
+            float xz = x * z;
+            float yz = y * z;
+            float wx = w * x;
+            float wy = w * y;
+            float wz = w * z;
+            glm::mat4 local(
+                (1.0f - 2.0f * (yy + zz)) * s, 2.0f * (xy + wz) * s,
+                2.0f * (xz - wy) * s, 0.0f,
+                2.0f * (xy - wz) * s, (1.0f - 2.0f * (xx + zz)) * s,
+                2.0f * (yz + wx) * s, 0.0f,
+                2.0f * (xz + wy) * s, 2.0f * (yz - wx) * s,
+                (1.0f - 2.0f * (xx + yy)) * s, 0.0f,
+                nodes.translationX[i], nodes.translationY[i],
+                nodes.translationZ[i], 1.0f);
+            Compose(nodes, i, local);
+        }
+    }
+
+    using UpdateFn = void (*)(NodeArrays const&, size_t, size_t);
+
+#ifdef UMBRELLA_X86
+    // Multiplies one node's local columns into its parent's world matrix
+    // and stores the result. Small enough to be inlined into the AVX
+    // version too, where it then runs VEX-encoded.
+    inline void ComposeSse(NodeArrays const& nodes, size_t i,
+        __m128 const (&columns)[4])
+    {
+        float* world = &nodes.world[i][0][0];
+        uint32_t parent = nodes.parent[i];
+        if (parent == noParent) {
+            for (int c = 0; c < 4; c++) {
+                _mm_storeu_ps(world + 4 * c, columns[c]);
+            }
+            return;
+        }
+        float const* p = &nodes.world[parent][0][0];
+        __m128 p0 = _mm_loadu_ps(p);
+        __m128 p1 = _mm_loadu_ps(p + 4);
+        __m128 p2 = _mm_loadu_ps(p + 8);
+        __m128 p3 = _mm_loadu_ps(p + 12);
+        for (int c = 0; c < 4; c++) {
+            __m128 l = columns[c];
+            __m128 sum = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(p0, _mm_shuffle_ps(l, l, 0x00)),
+                        _mm_mul_ps(p1, _mm_shuffle_ps(l, l, 0x55))),
+                    _mm_mul_ps(p2, _mm_shuffle_ps(l, l, 0xaa))),
+                _mm_mul_ps(p3, _mm_shuffle_ps(l, l, 0xff)));
+            _mm_storeu_ps(world + 4 * c, sum);
+        }
+    }
+
+    // Turns four nodes' matrices, one register per element, into one
+    // register per column of each node, and composes the dirty ones.
+    inline void ComposeFourSse(NodeArrays const& nodes, size_t i,
+        __m128 const (&elements)[12])
+    {
+        __m128 const zero = _mm_setzero_ps();
+        __m128 const one = _mm_set1_ps(1.0f);
+        __m128 columns[4][4];
+        for (int c = 0; c < 4; c++) {
+            __m128 a = elements[3 * c];
+            __m128 b = elements[3 * c + 1];
+            __m128 d = elements[3 * c + 2];
+            __m128 e = c == 3 ? one : zero;
+            _MM_TRANSPOSE4_PS(a, b, d, e);
+            columns[0][c] = a;
+            columns[1][c] = b;
+            columns[2][c] = d;
+            columns[3][c] = e;
+        }
+        for (size_t k = 0; k < 4; k++) {
+            if (nodes.dirty[i + k]) {
+                ComposeSse(nodes, i + k, columns[k]);
+            }
+        }
+    }
+#endif
+
+    void UpdateRangeSse(NodeArrays const& nodes, size_t begin, size_t end)
+    {
+#ifdef UMBRELLA_X86
+        size_t simdEnd = begin + (end - begin) / 4 * 4;
+        __m128 const one = _mm_set1_ps(1.0f);
+        __m128 const two = _mm_set1_ps(2.0f);
+        for (size_t i = begin; i < simdEnd; i += 4) {
+            uint32_t dirty;
+            std::memcpy(&dirty, nodes.dirty + i, sizeof(dirty));
+            if (dirty == 0) {
+                continue;
+            }
+            __m128 x = _mm_loadu_ps(nodes.rotationX + i);
+            __m128 y = _mm_loadu_ps(nodes.rotationY + i);
+            __m128 z = _mm_loadu_ps(nodes.rotationZ + i);
+            __m128 w = _mm_loadu_ps(nodes.rotationW + i);
+            __m128 s = _mm_loadu_ps(nodes.scale + i);
+            __m128 xx = _mm_mul_ps(x, x);
+            __m128 yy = _mm_mul_ps(y, y);
+            __m128 zz = _mm_mul_ps(z, z);
+            __m128 xy = _mm_mul_ps(x, y);
+            __m128 xz = _mm_mul_ps(x, z);
+            __m128 yz = _mm_mul_ps(y, z);
+            __m128 wx = _mm_mul_ps(w, x);
+            __m128 wy = _mm_mul_ps(w, y);
+            __m128 wz = _mm_mul_ps(w, z);
+            auto diagonal = [&](__m128 a, __m128 b) {
+                return _mm_mul_ps(
+                    _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(a, b))), s);
+            };
+            auto sum = [&](__m128 a, __m128 b) {
+                return _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(a, b)), s);
+            };
+            auto difference = [&](__m128 a, __m128 b) {
+                return _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(a, b)), s);
+            };
+            __m128 const elements[12] = {
+                diagonal(yy, zz),
+                sum(xy, wz),
+                difference(xz, wy),
+                difference(xy, wz),
+                diagonal(xx, zz),
+                sum(yz, wx),
+                sum(xz, wy),
+                difference(yz, wx),
+                diagonal(xx, yy),
+                _mm_loadu_ps(nodes.translationX + i),
+                _mm_loadu_ps(nodes.translationY + i),
+                _mm_loadu_ps(nodes.translationZ + i),
+            };
+            ComposeFourSse(nodes, i, elements);
+        }
+        UpdateRange(nodes, simdEnd, end);
+#else
+        UpdateRange(nodes, begin, end);
+#endif
+    }
+
+    // Builds the local matrices eight nodes at a time, then composes them
+    // four at a time like the SSE version: the multiply gathers a
+    // different parent per node, which 256-bit lanes do not help with.
+    UMBRELLA_TARGET_AVX void UpdateRangeAvx(
+        NodeArrays const& nodes, size_t begin, size_t end)
+    {
+#ifdef UMBRELLA_X86
+        size_t simdEnd = begin + (end - begin) / 8 * 8;
+        __m256 const one = _mm256_set1_ps(1.0f);
+        __m256 const two = _mm256_set1_ps(2.0f);
+        for (size_t i = begin; i < simdEnd; i += 8) {
+            uint64_t dirty;
+            std::memcpy(&dirty, nodes.dirty + i, sizeof(dirty));
+            if (dirty == 0) {
+                continue;
+            }
+            __m256 x = _mm256_loadu_ps(nodes.rotationX + i);
+            __m256 y = _mm256_loadu_ps(nodes.rotationY + i);
+            __m256 z = _mm256_loadu_ps(nodes.rotationZ + i);
+            __m256 w = _mm256_loadu_ps(nodes.rotationW + i);
+            __m256 s = _mm256_loadu_ps(nodes.scale + i);
+            __m256 xx = _mm256_mul_ps(x, x);
+            __m256 yy = _mm256_mul_ps(y, y);
+            __m256 zz = _mm256_mul_ps(z, z);
+            __m256 xy = _mm256_mul_ps(x, y);
+            __m256 xz = _mm256_mul_ps(x, z);
+            __m256 yz = _mm256_mul_ps(y, z);
+            __m256 wx = _mm256_mul_ps(w, x);
+            __m256 wy = _mm256_mul_ps(w, y);
+            __m256 wz = _mm256_mul_ps(w, z);
+            // Lambdas would not inherit the AVX target, so the terms are
+            // spelled out.
+            __m256 const elements[12] = {
+                _mm256_mul_ps(
+                    _mm256_sub_ps(
+                        one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))),
+                    s),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), s),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), s),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), s),
+                _mm256_mul_ps(
+                    _mm256_sub_ps(
+                        one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))),
+                    s),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), s),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), s),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), s),
+                _mm256_mul_ps(
+                    _mm256_sub_ps(
+                        one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))),
+                    s),
+                _mm256_loadu_ps(nodes.translationX + i),
+                _mm256_loadu_ps(nodes.translationY + i),
+                _mm256_loadu_ps(nodes.translationZ + i),
+            };
+            __m128 low[12];
+            __m128 high[12];
+            for (int e = 0; e < 12; e++) {
+                low[e] = _mm256_castps256_ps128(elements[e]);
+                high[e] = _mm256_extractf128_ps(elements[e], 1);
+            }
+            ComposeFourSse(nodes, i, low);
+            ComposeFourSse(nodes, i + 4, high);
+        }
+        // The tail runs SSE code; clear the upper halves first so the call
+        // does not pay the AVX to SSE transition.
+        _mm256_zeroupper();
+        UpdateRange(nodes, simdEnd, end);
+#else
+        UpdateRange(nodes, begin, end);
+#endif
+    }
+
+    UpdateFn SelectUpdate(TransformUpdateMethod method)
+    {
+        switch (method) {
+        case TransformUpdateMethod::Scalar:
+            return UpdateRange;
+        case TransformUpdateMethod::Sse:
+            return UpdateRangeSse;
+        case TransformUpdateMethod::Avx:
+        case TransformUpdateMethod::Widest:
+            return Util::HasAvx() ? UpdateRangeAvx : UpdateRangeSse;
+        }
+        return UpdateRange;
+    }
+
+    // Moves values[i] to values[newSlot[i]].
+    template <typename T>
+    void Permute(std::vector<T>& values, std::span<uint32_t const> newSlot)
+    {
+        std::vector<T> permuted(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            permuted[newSlot[i]] = values[i];
+        }
+        values.swap(permuted);
+    }
+
+} // namespace
+
+TransformHierarchy::TransformHierarchy(TransformHierarchyOptions options)
+    : m_options(options)
+    , m_levelStart {0}
+{
+}
+
+NodeId TransformHierarchy::AddNode(LocalTransform const& local, NodeId parent)
+{
+    NodeId node = static_cast<NodeId>(m_slotOf.size());
+    uint32_t slot = static_cast<uint32_t>(m_nodeAt.size());
+    uint32_t parentSlot = parent == noParent ? noParent : m_slotOf[parent];
+    uint32_t depth = parent == noParent ? 0 : m_depth[parentSlot] + 1;
+
+    // Appending in depth order only extends the last level, or starts the
+    // next one; anything else waits for Reorder().
+    if (m_ordered && !m_depth.empty() && depth < m_depth.back()) {
+        m_ordered = false;
+    }
+    if (m_ordered) {
+        if (depth + 1 == m_levelStart.size()) {
+            m_levelStart.push_back(m_levelStart.back() + 1);
+        } else {
+            m_levelStart.back()++;
+        }
+    }
+
+    m_translationX.push_back(local.translation.x);
+    m_translationY.push_back(local.translation.y);
+    m_translationZ.push_back(local.translation.z);
+    m_rotationX.push_back(local.rotation.x);
+    m_rotationY.push_back(local.rotation.y);
+    m_rotationZ.push_back(local.rotation.z);
+    m_rotationW.push_back(local.rotation.w);
+    m_scale.push_back(local.scale);
+    m_parent.push_back(parentSlot);
+    m_depth.push_back(depth);
+    m_dirty.push_back(1);
+    m_world.emplace_back(1.0f);
+    m_nodeAt.push_back(node);
+    m_slotOf.push_back(slot);
+    m_anyDirty = true;
+    return node;
+}
+
+void TransformHierarchy::SetLocal(NodeId node, LocalTransform const& local)
+{
+    uint32_t slot = m_slotOf[node];
+    m_translationX[slot] = local.translation.x;
+    m_translationY[slot] = local.translation.y;
+    m_translationZ[slot] = local.translation.z;
+    m_rotationX[slot] = local.rotation.x;
+    m_rotationY[slot] = local.rotation.y;
+    m_rotationZ[slot] = local.rotation.z;
+    m_rotationW[slot] = local.rotation.w;
+    m_scale[slot] = local.scale;
+    m_dirty[slot] = 1;
+    m_anyDirty = true;
+}
+
+LocalTransform TransformHierarchy::Local(NodeId node) const
+{
+    uint32_t slot = m_slotOf[node];
+    return {
+        .translation = {m_translationX[slot], m_translationY[slot],
+            m_translationZ[slot]},
+        .rotation = {m_rotationW[slot], m_rotationX[slot], m_rotationY[slot],
+            m_rotationZ[slot]},
+        .scale = m_scale[slot],
+    };
+}
+
+NodeId TransformHierarchy::Parent(NodeId node) const
+{
+    uint32_t parentSlot = m_parent[m_slotOf[node]];
+    return parentSlot == noParent ? noParent : m_nodeAt[parentSlot];
+}
+
+void TransformHierarchy::Reorder()
+{
+    UMBRELLA_PROFILE_ZONE("Reorder transforms");
+    // Breadth first: every level is one run, and children of one parent
+    // sit together in their parent's order, so a level reads its parents
+    // front to back.
+    size_t count = m_parent.size();
+    std::vector<uint32_t> childStart(count + 1, 0);
+    for (uint32_t parent : m_parent) {
+        if (parent != noParent) {
+            childStart[parent + 1]++;
+        }
+    }
+    for (size_t i = 1; i <= count; i++) {
+        childStart[i] += childStart[i - 1];
+    }
+    std::vector<uint32_t> children(childStart.back());
+    std::vector<uint32_t> nextChild(childStart.begin(), childStart.end() - 1);
+    std::vector<uint32_t> order;
+    order.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        if (m_parent[i] == noParent) {
+            order.push_back(i);
+        } else {
+            children[nextChild[m_parent[i]]++] = i;
+        }
+    }
+    for (size_t next = 0; next < order.size(); next++) {
+        uint32_t slot = order[next];
+        order.insert(order.end(), children.begin() + childStart[slot],
+            children.begin() + childStart[slot + 1]);
+    }
+    std::vector<uint32_t> newSlot(count);
+    for (size_t i = 0; i < count; i++) {
+        newSlot[order[i]] = static_cast<uint32_t>(i);
+    }
+
+    for (uint32_t& parent : m_parent) {
+        if (parent != noParent) {
+            parent = newSlot[parent];
+        }
+    }
+    Permute(m_translationX, newSlot);
+    Permute(m_translationY, newSlot);
+    Permute(m_translationZ, newSlot);
+    Permute(m_rotationX, newSlot);
+    Permute(m_rotationY, newSlot);
+    Permute(m_rotationZ, newSlot);
+    Permute(m_rotationW, newSlot);
+    Permute(m_scale, newSlot);
+    Permute(m_parent, newSlot);
+    Permute(m_depth, newSlot);
+    Permute(m_dirty, newSlot);
+    Permute(m_world, newSlot);
+    Permute(m_nodeAt, newSlot);
+    for (uint32_t& slot : m_slotOf) {
+        slot = newSlot[slot];
+    }
+
+    m_levelStart.assign(1, 0);
+    for (size_t i = 1; i < count; i++) {
+        if (m_depth[i] != m_depth[i - 1]) {
+            m_levelStart.push_back(i);
+        }
+    }
+    m_levelStart.push_back(count);
+    m_ordered = true;
+}
+
+TransformUpdateStats TransformHierarchy::Update()
+{
+    UMBRELLA_PROFILE_ZONE("Update transforms");
+    auto start = std::chrono::steady_clock::now();
+    if (!m_ordered) {
+        Reorder();
+    }
+    m_changed.clear();
+    TransformUpdateStats stats {
+        .numNodes = NumNodes(),
+        .numLevels = m_levelStart.size() - 1,
+    };
+    if (!m_anyDirty) {
+        return stats;
+    }
+
+    NodeArrays nodes {
+        .translationX = m_translationX.data(),
+        .translationY = m_translationY.data(),
+        .translationZ = m_translationZ.data(),
+        .rotationX = m_rotationX.data(),
+        .rotationY = m_rotationY.data(),
+        .rotationZ = m_rotationZ.data(),
+        .rotationW = m_rotationW.data(),
+        .scale = m_scale.data(),
+        .parent = m_parent.data(),
+        .dirty = m_dirty.data(),
+        .world = m_world.data(),
+    };
+    UpdateFn update = SelectUpdate(m_options.method);
+    for (size_t l = 0; l + 1 < m_levelStart.size(); l++) {
+        size_t begin = m_levelStart[l];
+        size_t end = m_levelStart[l + 1];
+        // Parents are final by now, dirty flag included.
+        if (l > 0) {
+            for (size_t i = begin; i < end; i++) {
+                m_dirty[i] |= m_dirty[m_parent[i]];
+            }
+        }
+        if (m_options.parallel && end - begin >= m_options.parallelMinNodes) {
+            Util::ParallelFor(
+                (end - begin + chunkNodes - 1) / chunkNodes, [&](size_t c) {
+                    size_t chunkBegin = begin + c * chunkNodes;
+                    size_t chunkEnd = std::min(chunkBegin + chunkNodes, end);
+                    update(nodes, chunkBegin, chunkEnd);
+                });
+        } else {
+            update(nodes, begin, end);
+        }
+    }
+
+    // Eight flags at a time, since most are usually clear.
+    size_t count = m_dirty.size();
+    for (size_t i = 0; i < count; i += 8) {
+        uint64_t dirty = 0;
+        size_t run = std::min<size_t>(8, count - i);
+        std::memcpy(&dirty, m_dirty.data() + i, run);
+        if (dirty == 0) {
+            continue;
+        }
+        for (size_t k = i; k < i + run; k++) {
+            if (m_dirty[k]) {
+                m_changed.push_back(m_nodeAt[k]);
+            }
+        }
+        std::memset(m_dirty.data() + i, 0, run);
+    }
+    m_anyDirty = false;
+    stats.numUpdated = m_changed.size();
+    stats.updateMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start)
+                         .count();
+    return stats;
+}
+
+} // namespace Umbrella
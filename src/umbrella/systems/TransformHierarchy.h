@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace Umbrella {
+
+using NodeId = uint32_t;
+constexpr NodeId noParent = std::numeric_limits<NodeId>::max();
+
+// Relative to the parent. Scale is uniform, so normals only need the
+// rotation, and the rotation is a unit quaternion.
+struct LocalTransform {
+    glm::vec3 translation {0.0f};
+    glm::quat rotation {1.0f, 0.0f, 0.0f, 0.0f};
+    float scale {1.0f};
+};
+
+// How world matrices are built. Every version gives the same matrices as
+// the scalar one, bit for bit.
+enum class TransformUpdateMethod : uint8_t {
+    Scalar,
+    // Local matrices of four nodes per instruction.
+    Sse,
+    // Eight nodes per instruction, where the CPU has AVX; SSE otherwise.
+    Avx,
+    // The widest version this CPU runs.
+    Widest,
+};
+
+struct TransformHierarchyOptions {
+    TransformUpdateMethod method = TransformUpdateMethod::Widest;
+    // Splits levels of at least parallelMinNodes nodes over all cores.
+    // Nodes of one level only read their parents, a level up, so workers
+    // never touch the same matrix.
+    bool parallel = true;
+    size_t parallelMinNodes = 16384;
+};
+
+struct TransformUpdateStats {
+    size_t numNodes {};
+    // Nodes whose world matrix was rebuilt: the dirty ones and everything
+    // below them.
+    size_t numUpdated {};
+    size_t numLevels {};
+    double updateMs {};
+};
+
+// Parent-relative transforms, kept as structure of arrays sorted by depth
+// in the hierarchy, so every parent comes before its children and each
+// level is one contiguous run. Changing a node marks it dirty; Update()
+// walks the levels top down, passes dirty flags on to children and
+// rebuilds world matrices for the dirty nodes only, several at a time.
+class TransformHierarchy {
+public:
+    explicit TransformHierarchy(TransformHierarchyOptions options = {});
+
+    // The parent must have been added before.
+    NodeId AddNode(LocalTransform const& local, NodeId parent = noParent);
+    void SetLocal(NodeId node, LocalTransform const& local);
+    LocalTransform Local(NodeId node) const;
+    NodeId Parent(NodeId node) const;
+    size_t NumNodes() const { return m_slotOf.size(); }
+
+    TransformUpdateStats Update();
+
+    // As of the last Update().
+    glm::mat4 const& World(NodeId node) const
+    {
+        return m_world[m_slotOf[node]];
+    }
+    // The nodes whose world matrix the last Update() rebuilt.
+    std::span<NodeId const> Changed() const { return m_changed; }
+
+private:
+    // Restores depth order after nodes were added out of it.
+    void Reorder();
+
+    TransformHierarchyOptions m_options;
+
+    // By slot, in depth order.
+    std::vector<float> m_translationX;
+    std::vector<float> m_translationY;
+    std::vector<float> m_translationZ;
+    std::vector<float> m_rotationX;
+    std::vector<float> m_rotationY;
+    std::vector<float> m_rotationZ;
+    std::vector<float> m_rotationW;
+    std::vector<float> m_scale;
+    // The parent's slot, or noParent.
+    std::vector<uint32_t> m_parent;
+    std::vector<uint32_t> m_depth;
+    std::vector<uint8_t> m_dirty;
+    std::vector<glm::mat4> m_world;
+    std::vector<NodeId> m_nodeAt;
+    // Where each level starts, with the end of the last one after it.
+    std::vector<size_t> m_levelStart;
+
+    std::vector<uint32_t> m_slotOf;
+    bool m_anyDirty {};
+    bool m_ordered = true;
+    std::vector<NodeId> m_changed;
+};
+
+} // namespace Umbrella
@@ -1,29 +1,26 @@
 #include "util/File.h"
 
-#include <fstream>
 #include <optional>
 #include <string>
+#include <string_view>
+
+#include "util/MappedFile.h"
 
 namespace Umbrella::Util {
 
 std::optional<std::string> ReadFile(char const* filePath)
 {
-    std::ifstream inputStream = std::ifstream(filePath, std::ios::in);
-    if (inputStream) {
-        std::string inputContents
-            = {std::istreambuf_iterator<char>(inputStream),
-                std::istreambuf_iterator<char>()};
-
-        // If present, remove the last empty line
-        size_t lastCharacterIdx = inputContents.length() - 1;
-        if (inputContents[lastCharacterIdx] == '\n') {
-            inputContents = inputContents.substr(0, lastCharacterIdx);
-        }
-
-        return inputContents;
+    std::optional<MappedFile> file = MappedFile::Open(filePath);
+    if (!file) {
+        return {};
     }
 
-    return {};
+    // If present, remove the last empty line
+    std::string_view contents = file->View();
+    if (contents.ends_with('\n')) {
+        contents.remove_suffix(1);
+    }
+    return std::string(contents);
 }
 
-} // namespace Umbrella::File
+} // namespace Umbrella::Util
@@ -5,6 +5,8 @@
 
 namespace Umbrella::Util {
 
+// Reads a text file from disk, without its last newline. Assets are read
+// through the VirtualFileSystem instead.
 std::optional<std::string> ReadFile(char const* filePath);
 
-} // namespace Umbrella::File
+} // namespace Umbrella::Util
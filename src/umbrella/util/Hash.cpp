@@ -0,0 +1,98 @@
+#include "util/Hash.h"
+
+#include <bit>
+#include <cstring>
+
+namespace Umbrella::Util {
+
+namespace {
+
+    constexpr uint64_t prime1 = 11400714785074694791ULL;
+    constexpr uint64_t prime2 = 14029467366897019727ULL;
+    constexpr uint64_t prime3 = 1609587929392839161ULL;
+    constexpr uint64_t prime4 = 9650029242287828579ULL;
+    constexpr uint64_t prime5 = 2870177450012600261ULL;
+
+    uint64_t Read64(unsigned char const* p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t Read32(unsigned char const* p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint64_t Round(uint64_t acc, uint64_t input)
+    {
+        acc += input * prime2;
+        acc = std::rotl(acc, 31);
+        return acc * prime1;
+    }
+
+    uint64_t MergeRound(uint64_t acc, uint64_t value)
+    {
+        acc ^= Round(0, value);
+        return acc * prime1 + prime4;
+    }
+
+} // namespace
+
+uint64_t HashBytes(void const* data, size_t size, uint64_t seed)
+{
+    auto const* p = static_cast<unsigned char const*>(data);
+    unsigned char const* end = p + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+        }
+
+        hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12)
+            + std::rotl(v4, 18);
+        hash = MergeRound(hash, v1);
+        hash = MergeRound(hash, v2);
+        hash = MergeRound(hash, v3);
+        hash = MergeRound(hash, v4);
+    } else {
+        hash = seed + prime5;
+    }
+
+    hash += static_cast<uint64_t>(size);
+
+    for (; p + 8 <= end; p += 8) {
+        hash ^= Round(0, Read64(p));
+        hash = std::rotl(hash, 27) * prime1 + prime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(Read32(p)) * prime1;
+        hash = std::rotl(hash, 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        hash ^= static_cast<uint64_t>(*p) * prime5;
+        hash = std::rotl(hash, 11) * prime1;
+    }
+
+    // Final avalanche.
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+} // namespace Umbrella::Util
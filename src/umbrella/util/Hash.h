@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Umbrella::Util {
+
+// 64-bit XXH64 hash of a byte range. Pass a previous result as the seed to
+// chain several ranges together.
+uint64_t HashBytes(void const* data, size_t size, uint64_t seed = 0);
+
+} // namespace Umbrella::Util
@@ -0,0 +1,223 @@
+#include "util/JobSystem.h"
+
+#include <algorithm>
+
+#include "util/Parallel.h"
+#include "util/Profiler.h"
+
+namespace Umbrella::Util {
+
+namespace {
+
+    // Which worker of which system the current thread is, so jobs it
+    // schedules land in its own deque.
+    thread_local JobSystem const* t_system = nullptr;
+    thread_local size_t t_worker = 0;
+
+} // namespace
+
+JobSystem& JobSystem::Instance()
+{
+    static JobSystem instance(std::max<size_t>(WorkerCount(), 2) - 1);
+    return instance;
+}
+
+JobSystem::JobSystem(size_t numWorkers)
+    : m_mainThread(std::this_thread::get_id())
+{
+    // Workers record into the profiler until they stop, so it has to be
+    // constructed first and destroyed last.
+    (void)Profiler::Instance();
+    for (size_t w = 0; w <= numWorkers; w++) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t w = 0; w < numWorkers; w++) {
+        m_workers.emplace_back(
+            [this, w](std::stop_token stop) { WorkerLoop(stop, w); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    for (std::jthread& worker : m_workers) {
+        worker.request_stop();
+    }
+    {
+        std::lock_guard lock(m_sleepMutex);
+        m_wake.notify_all();
+    }
+    m_workers.clear();
+}
+
+JobHandle JobSystem::Schedule(std::string name, std::function<void()> fn,
+    std::span<JobHandle const> dependencies, JobAffinity affinity)
+{
+    auto job = std::make_shared<Job>();
+    job->m_name = std::move(name);
+    job->m_fn = std::move(fn);
+    job->m_affinity = affinity;
+
+    // A dependency that finishes while this runs either sees the job in
+    // its dependents or was already finished; the extra pending count
+    // keeps the job from starting before every dependency is checked.
+    for (JobHandle const& dependency : dependencies) {
+        std::lock_guard lock(dependency->m_mutex);
+        if (!dependency->m_finished) {
+            job->m_pending++;
+            dependency->m_dependents.push_back(job);
+        }
+    }
+    if (--job->m_pending == 0) {
+        Enqueue(job);
+    }
+    return job;
+}
+
+void JobSystem::Enqueue(JobHandle job)
+{
+    if (job->m_affinity == JobAffinity::MainThread) {
+        {
+            std::lock_guard lock(m_mainQueue.mutex);
+            m_mainQueue.jobs.push_back(std::move(job));
+        }
+        std::lock_guard lock(m_sleepMutex);
+        m_jobFinished.notify_all();
+        return;
+    }
+
+    size_t index = t_system == this ? t_worker : m_queues.size() - 1;
+    {
+        std::lock_guard lock(m_queues[index]->mutex);
+        m_queues[index]->jobs.push_back(std::move(job));
+    }
+    m_numQueued++;
+    std::lock_guard lock(m_sleepMutex);
+    m_wake.notify_one();
+    m_jobFinished.notify_all();
+}
+
+JobHandle JobSystem::Pop(size_t index)
+{
+    // Newest first from our own deque, which is still warm in the cache.
+    if (index < m_queues.size()) {
+        Queue& own = *m_queues[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.jobs.empty()) {
+            JobHandle job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            m_numQueued--;
+            return job;
+        }
+    }
+
+    // Oldest first from everyone else, starting after ourselves so thieves
+    // spread over the victims.
+    for (size_t i = 1; i <= m_queues.size(); i++) {
+        size_t victim = (index + i) % m_queues.size();
+        if (victim == index) {
+            continue;
+        }
+        Queue& queue = *m_queues[victim];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            JobHandle job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            m_numQueued--;
+            return job;
+        }
+    }
+    return {};
+}
+
+void JobSystem::Run(JobHandle const& job)
+{
+    {
+        UMBRELLA_PROFILE_ZONE(job->m_name);
+        job->m_fn();
+        job->m_fn = nullptr;
+    }
+
+    std::vector<JobHandle> dependents;
+    {
+        std::lock_guard lock(job->m_mutex);
+        job->m_finished = true;
+        dependents.swap(job->m_dependents);
+    }
+    job->m_done.store(true, std::memory_order_release);
+    for (JobHandle& dependent : dependents) {
+        if (--dependent->m_pending == 0) {
+            Enqueue(std::move(dependent));
+        }
+    }
+
+    std::lock_guard lock(m_sleepMutex);
+    m_jobFinished.notify_all();
+}
+
+size_t JobSystem::RunMainThreadJobs()
+{
+    size_t numRun = 0;
+    while (true) {
+        JobHandle job;
+        {
+            std::lock_guard lock(m_mainQueue.mutex);
+            if (m_mainQueue.jobs.empty()) {
+                return numRun;
+            }
+            job = std::move(m_mainQueue.jobs.front());
+            m_mainQueue.jobs.pop_front();
+        }
+        Run(job);
+        numRun++;
+    }
+}
+
+bool JobSystem::RunOne()
+{
+    if (IsMainThread() && RunMainThreadJobs() > 0) {
+        return true;
+    }
+    JobHandle job = Pop(t_system == this ? t_worker : m_queues.size() - 1);
+    if (job) {
+        Run(job);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::Wait(std::span<JobHandle const> jobs)
+{
+    auto allDone = [&]() {
+        return std::ranges::all_of(
+            jobs, [](JobHandle const& job) { return job->Done(); });
+    };
+    while (!allDone()) {
+        if (RunOne()) {
+            continue;
+        }
+
+        // Nothing to help with: sleep until some job finishes or is queued.
+        // The timeout covers a wakeup racing with the checks above.
+        std::unique_lock lock(m_sleepMutex);
+        m_jobFinished.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+void JobSystem::WorkerLoop(std::stop_token stop, size_t index)
+{
+    t_system = this;
+    t_worker = index;
+    Profiler::Instance().SetThreadName("worker " + std::to_string(index));
+    while (!stop.stop_requested()) {
+        JobHandle job = Pop(index);
+        if (job) {
+            Run(job);
+            continue;
+        }
+
+        std::unique_lock lock(m_sleepMutex);
+        m_wake.wait(lock, stop, [&]() { return m_numQueued > 0; });
+    }
+}
+
+} // namespace Umbrella::Util
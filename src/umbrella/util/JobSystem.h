@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Umbrella::Util {
+
+enum class JobAffinity : uint8_t {
+    Any = 0,
+    // Only runs on the main thread, for work that needs the GL context.
+    MainThread = 1,
+};
+
+// A scheduled job. Jobs that depend on it are queued once it has finished.
+class Job {
+public:
+    bool Done() const { return m_done.load(std::memory_order_acquire); }
+    std::string const& Name() const { return m_name; }
+
+private:
+    friend class JobSystem;
+
+    std::string m_name;
+    std::function<void()> m_fn;
+    JobAffinity m_affinity {};
+    // Unfinished dependencies, plus one while the job is being scheduled.
+    std::atomic<uint32_t> m_pending {1};
+    std::atomic<bool> m_done {};
+    std::mutex m_mutex;
+    bool m_finished {};
+    std::vector<std::shared_ptr<Job>> m_dependents;
+};
+
+using JobHandle = std::shared_ptr<Job>;
+
+// Work-stealing job system. Every worker owns a deque: it pushes and pops
+// its own jobs at the back and steals from the front of the others' when
+// it runs dry. Threads that are not workers queue into a shared deque the
+// workers steal from as well. Main thread jobs go into a queue of their
+// own, which only the main thread drains, in RunMainThreadJobs() or while
+// it waits. Every job is a profiler zone named after it.
+class JobSystem {
+public:
+    // The shared instance, with one worker per core besides the main thread
+    // and at least one. The thread that first calls this is the main thread.
+    static JobSystem& Instance();
+
+    explicit JobSystem(size_t numWorkers);
+    JobSystem(JobSystem const&) = delete;
+    JobSystem& operator=(JobSystem const&) = delete;
+    ~JobSystem();
+
+    // Queues fn to run once every dependency has finished.
+    JobHandle Schedule(std::string name, std::function<void()> fn,
+        std::span<JobHandle const> dependencies = {},
+        JobAffinity affinity = JobAffinity::Any);
+
+    // Runs other jobs until the given ones have finished. On the main thread
+    // that includes main thread jobs, so waiting there on work that depends
+    // on GL jobs cannot deadlock.
+    void Wait(std::span<JobHandle const> jobs);
+    void Wait(JobHandle const& job) { Wait({&job, 1}); }
+
+    // Runs the main thread jobs that are ready. Returns how many ran.
+    size_t RunMainThreadJobs();
+
+    size_t NumWorkers() const { return m_workers.size(); }
+    bool IsMainThread() const
+    {
+        return std::this_thread::get_id() == m_mainThread;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    void WorkerLoop(std::stop_token stop, size_t index);
+    void Enqueue(JobHandle job);
+    JobHandle Pop(size_t index);
+    bool RunOne();
+    void Run(JobHandle const& job);
+
+    std::thread::id m_mainThread;
+    // One per worker, then the shared one for every other thread.
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    Queue m_mainQueue;
+    std::atomic<size_t> m_numQueued {};
+
+    std::mutex m_sleepMutex;
+    std::condition_variable_any m_wake;
+    std::condition_variable_any m_jobFinished;
+
+    std::vector<std::jthread> m_workers;
+};
+
+} // namespace Umbrella::Util
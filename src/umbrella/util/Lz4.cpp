@@ -0,0 +1,213 @@
+#include "util/Lz4.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Umbrella::Util {
+
+namespace {
+
+    constexpr size_t minMatch = 4;
+    // The block format ends in at least this many literals, and no match
+    // starts within the last matchStartLimit bytes.
+    constexpr size_t lastLiterals = 5;
+    constexpr size_t matchStartLimit = 12;
+    constexpr size_t maxOffset = 65535;
+    constexpr int hashBits = 14;
+
+    uint32_t Read32(unsigned char const* p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t HashSequence(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - hashBits);
+    }
+
+    unsigned char* WriteLength(unsigned char* op, size_t length)
+    {
+        for (; length >= 255; length -= 255) {
+            *op++ = 255;
+        }
+        *op++ = static_cast<unsigned char>(length);
+        return op;
+    }
+
+    unsigned char* WriteLiterals(unsigned char* op, unsigned char* token,
+        unsigned char const* literals, size_t numLiterals)
+    {
+        if (numLiterals >= 15) {
+            *token = 15 << 4;
+            op = WriteLength(op, numLiterals - 15);
+        } else {
+            *token = static_cast<unsigned char>(numLiterals << 4);
+        }
+        return std::copy_n(literals, numLiterals, op);
+    }
+
+    // Adds the extension bytes of a length whose token nibble was 15.
+    bool ReadLength(
+        unsigned char const*& ip, unsigned char const* end, size_t& length)
+    {
+        unsigned char byte;
+        do {
+            if (ip == end) {
+                return false;
+            }
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+} // namespace
+
+size_t Lz4Compress(std::span<std::byte const> src, std::span<std::byte> dst)
+{
+    auto const* base = reinterpret_cast<unsigned char const*>(src.data());
+    auto* out = reinterpret_cast<unsigned char*>(dst.data());
+    size_t size = src.size();
+
+    unsigned char* op = out;
+    size_t anchor = 0;
+    if (size > matchStartLimit) {
+        // Positions of the last sequence seen with each hash. Stale or
+        // colliding entries are caught by comparing the bytes.
+        std::vector<uint32_t> table(size_t(1) << hashBits);
+        size_t matchEnd = size - lastLiterals;
+        size_t lastStart = size - matchStartLimit;
+
+        size_t ip = 1;
+        size_t misses = 0;
+        while (ip <= lastStart) {
+            uint32_t sequence = Read32(base + ip);
+            uint32_t& slot = table[HashSequence(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(ip);
+            if (candidate >= ip || ip - candidate > maxOffset
+                || Read32(base + candidate) != sequence) {
+                // Incompressible stretches are skipped over faster the
+                // longer they get.
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            while (ip > anchor && candidate > 0
+                && base[ip - 1] == base[candidate - 1]) {
+                ip--;
+                candidate--;
+            }
+            size_t length = minMatch;
+            while (ip + length < matchEnd
+                && base[candidate + length] == base[ip + length]) {
+                length++;
+            }
+
+            unsigned char* token = op++;
+            op = WriteLiterals(op, token, base + anchor, ip - anchor);
+            size_t offset = ip - candidate;
+            *op++ = static_cast<unsigned char>(offset);
+            *op++ = static_cast<unsigned char>(offset >> 8);
+            size_t lengthCode = length - minMatch;
+            if (lengthCode >= 15) {
+                *token |= 15;
+                op = WriteLength(op, lengthCode - 15);
+            } else {
+                *token |= static_cast<unsigned char>(lengthCode);
+            }
+
+            ip += length;
+            anchor = ip;
+            // The match end is a likely start of the next one.
+            if (ip - 2 <= lastStart) {
+                table[HashSequence(Read32(base + ip - 2))]
+                    = static_cast<uint32_t>(ip - 2);
+            }
+        }
+    }
+
+    unsigned char* token = op++;
+    op = WriteLiterals(op, token, base + anchor, size - anchor);
+    return static_cast<size_t>(op - out);
+}
+
+bool Lz4Decompress(std::span<std::byte const> src, std::span<std::byte> dst)
+{
+    auto const* ip = reinterpret_cast<unsigned char const*>(src.data());
+    unsigned char const* srcEnd = ip + src.size();
+    auto* out = reinterpret_cast<unsigned char*>(dst.data());
+    unsigned char* op = out;
+    unsigned char* dstEnd = out + dst.size();
+
+    while (ip != srcEnd) {
+        unsigned char token = *ip++;
+
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15 && !ReadLength(ip, srcEnd, numLiterals)) {
+            return false;
+        }
+        if (numLiterals > size_t(srcEnd - ip)
+            || numLiterals > size_t(dstEnd - op)) {
+            return false;
+        }
+        // Short runs copy a fixed 16 bytes when both buffers have room past
+        // them, which compiles to two moves instead of a call.
+        if (numLiterals <= 16 && srcEnd - ip >= 16 && dstEnd - op >= 16) {
+            std::memcpy(op, ip, 16);
+        } else {
+            std::copy_n(ip, numLiterals, op);
+        }
+        ip += numLiterals;
+        op += numLiterals;
+
+        // The last sequence has literals only.
+        if (ip == srcEnd) {
+            return op == dstEnd;
+        }
+
+        if (srcEnd - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | size_t(ip[1]) << 8;
+        ip += 2;
+        if (offset == 0 || offset > size_t(op - out)) {
+            return false;
+        }
+        size_t length = (token & 15) + minMatch;
+        if ((token & 15) == 15 && !ReadLength(ip, srcEnd, length)) {
+            return false;
+        }
+        if (length > size_t(dstEnd - op)) {
+            return false;
+        }
+
+        // Overlapping matches repeat the last offset bytes. Copying whole
+        // periods keeps the source and destination apart, and each copy
+        // doubles what the next one can take. Matches at least 8 bytes back
+        // copy 8 at a time when there is room to overshoot; the bytes past
+        // the match are overwritten by what follows.
+        unsigned char const* match = op - offset;
+        if (offset >= 8 && size_t(dstEnd - op) >= length + 8) {
+            for (size_t i = 0; i < length; i += 8) {
+                std::memcpy(op + i, match + i, 8);
+            }
+            op += length;
+            continue;
+        }
+        for (size_t copied = 0; copied < length;) {
+            size_t chunk = std::min(copied + offset, length - copied);
+            std::memcpy(op + copied, match, chunk);
+            copied += chunk;
+        }
+        op += length;
+    }
+    return false;
+}
+
+} // namespace Umbrella::Util
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+namespace Umbrella::Util {
+
+// Largest size LZ4 can expand size bytes of incompressible input to.
+constexpr size_t Lz4CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// Compresses src as one LZ4 block, in the format of the reference
+// LZ4_compress_default(), with a greedy single-probe match finder. dst needs
+// Lz4CompressBound(src.size()) bytes. Returns how many were written.
+size_t Lz4Compress(std::span<std::byte const> src, std::span<std::byte> dst);
+
+// Decompresses one LZ4 block, which must fill dst exactly. Every read and
+// write is bounds checked, so corrupt input fails instead of overrunning.
+[[nodiscard]] bool Lz4Decompress(
+    std::span<std::byte const> src, std::span<std::byte> dst);
+
+} // namespace Umbrella::Util
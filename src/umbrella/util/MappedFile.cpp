@@ -0,0 +1,134 @@
+#include "util/MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Umbrella::Util {
+
+std::optional<MappedFile> MappedFile::Open(char const* filePath)
+{
+    MappedFile file;
+
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        return {};
+    }
+    file.m_fileHandle = fileHandle;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+        return {};
+    }
+    file.m_size = static_cast<size_t>(fileSize.QuadPart);
+
+    // Empty files cannot be mapped, but they are still valid files.
+    if (file.m_size == 0) {
+        return file;
+    }
+
+    HANDLE mappingHandle
+        = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) {
+        return {};
+    }
+    file.m_mappingHandle = mappingHandle;
+
+    void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        return {};
+    }
+    file.m_data = static_cast<char const*>(view);
+#else
+    int fd = open(filePath, O_RDONLY);
+    if (fd == -1) {
+        return {};
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        return {};
+    }
+    file.m_size = static_cast<size_t>(fileStat.st_size);
+
+    // Empty files cannot be mapped, but they are still valid files.
+    if (file.m_size == 0) {
+        close(fd);
+        return file;
+    }
+
+    void* view = mmap(nullptr, file.m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (view == MAP_FAILED) {
+        return {};
+    }
+    madvise(view, file.m_size, MADV_SEQUENTIAL);
+    file.m_data = static_cast<char const*>(view);
+#endif
+
+    return file;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0))
+#ifdef _WIN32
+    , m_fileHandle(std::exchange(other.m_fileHandle, nullptr))
+    , m_mappingHandle(std::exchange(other.m_mappingHandle, nullptr))
+#endif
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        Release();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+        m_fileHandle = std::exchange(other.m_fileHandle, nullptr);
+        m_mappingHandle = std::exchange(other.m_mappingHandle, nullptr);
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() { Release(); }
+
+void MappedFile::Release()
+{
+#ifdef _WIN32
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mappingHandle) {
+        CloseHandle(m_mappingHandle);
+    }
+    if (m_fileHandle) {
+        CloseHandle(m_fileHandle);
+    }
+    m_fileHandle = nullptr;
+    m_mappingHandle = nullptr;
+#else
+    if (m_data) {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+} // namespace Umbrella::Util
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+namespace Umbrella::Util {
+
+// Read-only memory mapping of a whole file. The mapping is released when the
+// MappedFile is destroyed, so views into Data() must not outlive it.
+class MappedFile {
+public:
+    static std::optional<MappedFile> Open(char const* filePath);
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    ~MappedFile();
+
+    char const* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+    std::string_view View() const { return {m_data, m_size}; }
+
+private:
+    MappedFile() = default;
+    void Release();
+
+    char const* m_data {};
+    size_t m_size {};
+#ifdef _WIN32
+    void* m_fileHandle {};
+    void* m_mappingHandle {};
+#endif
+};
+
+} // namespace Umbrella::Util
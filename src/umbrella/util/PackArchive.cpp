@@ -0,0 +1,342 @@
+#include "util/PackArchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <spdlog/spdlog.h>
+
+#include "util/Hash.h"
+#include "util/Lz4.h"
+#include "util/Parallel.h"
+#include "util/Profiler.h"
+
+namespace Umbrella::Util {
+
+namespace {
+
+    constexpr char upakMagic[4] = {'U', 'P', 'A', 'K'};
+    constexpr uint32_t upakVersion = 1;
+    // Blobs start on a cache line, so packed vertex data or pixels can be
+    // read in place as aligned arrays.
+    constexpr size_t upakAlignment = 64;
+
+    // On-disk layout: header, entry table sorted by path hash, path
+    // strings, then the file contents.
+    struct UPakHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t fileSize;
+        uint32_t numEntries;
+        uint32_t alignment;
+        uint64_t entryOffset;
+        uint64_t nameOffset;
+        uint64_t nameSize;
+    };
+
+    struct UPakEntry {
+        uint64_t pathHash;
+        uint64_t offset;
+        uint64_t storedSize;
+        uint64_t size;
+        int64_t writeTime;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t codec;
+        uint32_t padding;
+    };
+
+    uint64_t AlignUp(uint64_t offset)
+    {
+        return (offset + upakAlignment - 1) & ~uint64_t(upakAlignment - 1);
+    }
+
+    uint64_t HashPath(std::string_view path)
+    {
+        return HashBytes(path.data(), path.size());
+    }
+
+    // A file on its way into the pack, with its contents as they will be
+    // stored.
+    struct PackSource {
+        std::string path;
+        std::filesystem::path diskPath;
+        std::optional<MappedFile> file;
+        std::vector<std::byte> compressed;
+        int64_t writeTime {};
+        PackCodec codec {};
+        bool read {};
+
+        std::span<std::byte const> Stored() const
+        {
+            if (codec == PackCodec::Lz4) {
+                return compressed;
+            }
+            return {reinterpret_cast<std::byte const*>(file->Data()),
+                file->Size()};
+        }
+    };
+
+    bool Excluded(std::filesystem::path const& name, PackOptions const& options)
+    {
+        std::string fileName = name.filename().string();
+        return fileName.starts_with('.')
+            || std::ranges::find(options.exclude, fileName)
+            != options.exclude.end();
+    }
+
+} // namespace
+
+std::optional<PackArchive> PackArchive::Open(char const* packPath)
+{
+    UMBRELLA_PROFILE_ZONE("Open pack");
+    std::optional<MappedFile> file = MappedFile::Open(packPath);
+    if (!file) {
+        return {};
+    }
+
+    UPakHeader header;
+    if (file->Size() < sizeof(header)) {
+        spdlog::error("Pack {} is corrupt", packPath);
+        return {};
+    }
+    std::memcpy(&header, file->Data(), sizeof(header));
+    if (std::memcmp(header.magic, upakMagic, sizeof(upakMagic)) != 0
+        || header.version != upakVersion || header.fileSize != file->Size()
+        || header.alignment != upakAlignment
+        || header.entryOffset > header.fileSize
+        || header.numEntries
+            > (header.fileSize - header.entryOffset) / sizeof(UPakEntry)
+        || header.nameOffset > header.fileSize
+        || header.nameSize > header.fileSize - header.nameOffset) {
+        spdlog::error("Pack {} is corrupt or from another version", packPath);
+        return {};
+    }
+
+    std::vector<UPakEntry> entries(header.numEntries);
+    std::memcpy(entries.data(), file->Data() + header.entryOffset,
+        entries.size() * sizeof(UPakEntry));
+    char const* names = file->Data() + header.nameOffset;
+    auto const* bytes = reinterpret_cast<std::byte const*>(file->Data());
+
+    PackArchive archive(std::move(*file));
+    archive.m_entries.reserve(entries.size());
+    for (UPakEntry const& entry : entries) {
+        bool valid = uint64_t(entry.nameOffset) + entry.nameLength
+                <= header.nameSize
+            && entry.offset % upakAlignment == 0
+            && entry.offset <= header.fileSize
+            && entry.storedSize <= header.fileSize - entry.offset
+            && (entry.codec == uint32_t(PackCodec::Lz4)
+                || (entry.codec == uint32_t(PackCodec::None)
+                    && entry.storedSize == entry.size));
+        std::string_view path;
+        if (valid) {
+            path = {names + entry.nameOffset, entry.nameLength};
+            // Lookups binary search the hashes, so they must be sorted and
+            // belong to their paths.
+            valid = HashPath(path) == entry.pathHash
+                && (archive.m_entries.empty()
+                    || archive.m_entries.back().pathHash <= entry.pathHash);
+        }
+        if (!valid) {
+            spdlog::error("Pack {} has a corrupt index", packPath);
+            return {};
+        }
+        archive.m_entries.push_back({
+            .pathHash = entry.pathHash,
+            .path = path,
+            .size = entry.size,
+            .writeTime = entry.writeTime,
+            .codec = static_cast<PackCodec>(entry.codec),
+            .stored = {bytes + entry.offset, entry.storedSize},
+        });
+    }
+    return archive;
+}
+
+PackEntry const* PackArchive::Find(std::string_view path) const
+{
+    uint64_t hash = HashPath(path);
+    auto it = std::ranges::lower_bound(
+        m_entries, hash, {}, &PackEntry::pathHash);
+    for (; it != m_entries.end() && it->pathHash == hash; ++it) {
+        if (it->path == path) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+bool UnpackEntry(PackEntry const& entry, std::span<std::byte> dst)
+{
+    if (dst.size() != entry.size) {
+        return false;
+    }
+    switch (entry.codec) {
+    case PackCodec::None:
+        std::ranges::copy(entry.stored, dst.begin());
+        return true;
+    case PackCodec::Lz4:
+        return Lz4Decompress(entry.stored, dst);
+    }
+    return false;
+}
+
+std::optional<PackStats> WritePack(
+    char const* directory, char const* packPath, PackOptions const& options)
+{
+    UMBRELLA_PROFILE_ZONE("Write pack");
+    std::error_code error;
+    std::filesystem::path root(directory);
+    std::vector<PackSource> sources;
+    for (auto it = std::filesystem::recursive_directory_iterator(root, error);
+         !error && it != std::filesystem::recursive_directory_iterator();
+         it.increment(error)) {
+        if (Excluded(it->path(), options)) {
+            it.disable_recursion_pending();
+            continue;
+        }
+        // A pack written into the directory it packs must not include
+        // itself, or an older version of itself.
+        std::error_code sameError;
+        if (!it->is_regular_file()
+            || std::filesystem::equivalent(it->path(), packPath, sameError)) {
+            continue;
+        }
+        sources.push_back({
+            .path = it->path().lexically_relative(root).generic_string(),
+            .diskPath = it->path(),
+            .file = {},
+            .compressed = {},
+        });
+    }
+    if (error) {
+        spdlog::error("Could not list {}: {}", directory, error.message());
+        return {};
+    }
+    std::ranges::sort(sources, {}, &PackSource::path);
+
+    ParallelFor(sources.size(), [&](size_t i) {
+        PackSource& source = sources[i];
+        std::error_code timeError;
+        auto writeTime
+            = std::filesystem::last_write_time(source.diskPath, timeError);
+        source.file = MappedFile::Open(source.diskPath.string().c_str());
+        if (!source.file || timeError) {
+            return;
+        }
+        source.writeTime = writeTime.time_since_epoch().count();
+        source.read = true;
+        if (!options.compress || source.file->Size() == 0) {
+            return;
+        }
+
+        auto raw = std::span(
+            reinterpret_cast<std::byte const*>(source.file->Data()),
+            source.file->Size());
+        source.compressed.resize(Lz4CompressBound(raw.size()));
+        source.compressed.resize(Lz4Compress(raw, source.compressed));
+        if (static_cast<double>(source.compressed.size())
+            <= static_cast<double>(raw.size())
+                * (1.0 - static_cast<double>(options.minSaving))) {
+            source.codec = PackCodec::Lz4;
+        } else {
+            source.compressed = {};
+        }
+    });
+
+    PackStats stats {};
+    std::string names;
+    std::vector<UPakEntry> entries;
+    for (PackSource const& source : sources) {
+        if (!source.read) {
+            spdlog::error("Could not read {}", source.diskPath.string());
+            return {};
+        }
+        entries.push_back({
+            .pathHash = HashPath(source.path),
+            .offset = 0,
+            .storedSize = source.Stored().size(),
+            .size = source.file->Size(),
+            .writeTime = source.writeTime,
+            .nameOffset = static_cast<uint32_t>(names.size()),
+            .nameLength = static_cast<uint32_t>(source.path.size()),
+            .codec = static_cast<uint32_t>(source.codec),
+            .padding = 0,
+        });
+        names += source.path;
+
+        stats.numFiles++;
+        stats.numCompressed += source.codec != PackCodec::None;
+        stats.rawBytes += source.file->Size();
+        stats.storedBytes += source.Stored().size();
+    }
+
+    UPakHeader header {};
+    std::memcpy(header.magic, upakMagic, sizeof(upakMagic));
+    header.version = upakVersion;
+    header.numEntries = static_cast<uint32_t>(entries.size());
+    header.alignment = upakAlignment;
+    header.entryOffset = AlignUp(sizeof(UPakHeader));
+    header.nameOffset
+        = header.entryOffset + entries.size() * sizeof(UPakEntry);
+    header.nameSize = names.size();
+    uint64_t offset = header.nameOffset + header.nameSize;
+    for (UPakEntry& entry : entries) {
+        entry.offset = AlignUp(offset);
+        offset = entry.offset + entry.storedSize;
+    }
+    header.fileSize = offset;
+
+    // Blobs stay in path order, so the index is sorted on its own and a
+    // directory's files are read from neighbouring pages.
+    std::vector<size_t> order(entries.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::ranges::sort(order, [&](size_t a, size_t b) {
+        return entries[a].pathHash < entries[b].pathHash;
+    });
+    std::vector<UPakEntry> index;
+    for (size_t i : order) {
+        index.push_back(entries[i]);
+    }
+
+    // Written next to the final file and renamed into place, like the
+    // caches.
+    std::string tempPath = std::string(packPath) + ".tmp";
+    {
+        std::ofstream stream(tempPath, std::ios::out | std::ios::binary);
+        auto writeSection = [&](uint64_t sectionOffset, void const* bytes,
+                                size_t size) {
+            static constexpr char padding[upakAlignment] {};
+            stream.write(padding,
+                static_cast<std::streamsize>(sectionOffset - stream.tellp()));
+            stream.write(static_cast<char const*>(bytes),
+                static_cast<std::streamsize>(size));
+        };
+
+        stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        writeSection(header.entryOffset, index.data(),
+            index.size() * sizeof(UPakEntry));
+        writeSection(header.nameOffset, names.data(), names.size());
+        for (size_t i = 0; i < sources.size(); i++) {
+            std::span<std::byte const> stored = sources[i].Stored();
+            writeSection(entries[i].offset, stored.data(), stored.size());
+        }
+        if (!stream) {
+            return {};
+        }
+    }
+
+    std::filesystem::rename(tempPath, packPath, error);
+    if (error) {
+        return {};
+    }
+    stats.fileSize = header.fileSize;
+    return stats;
+}
+
+} // namespace Umbrella::Util
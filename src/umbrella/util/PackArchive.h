@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "util/MappedFile.h"
+
+namespace Umbrella::Util {
+
+enum class PackCodec : uint32_t {
+    None = 0,
+    Lz4 = 1,
+};
+
+// A file inside a pack. stored are its bytes as they are in the mapped
+// archive, compressed unless codec is None.
+struct PackEntry {
+    uint64_t pathHash;
+    std::string_view path;
+    uint64_t size;
+    int64_t writeTime;
+    PackCodec codec;
+    std::span<std::byte const> stored;
+};
+
+// A mapped .upak archive: an index of every file, sorted by path hash, and
+// their contents, each on a 64-byte boundary. Files that are not
+// compressed can be used in place.
+class PackArchive {
+public:
+    // Maps packPath. Returns nothing when it is missing or corrupt.
+    static std::optional<PackArchive> Open(char const* packPath);
+
+    // The entry with exactly this path, which uses '/' separators and is
+    // relative to the packed directory.
+    PackEntry const* Find(std::string_view path) const;
+
+    std::span<PackEntry const> Entries() const { return m_entries; }
+
+private:
+    explicit PackArchive(MappedFile file)
+        : m_file(std::move(file))
+    {
+    }
+
+    MappedFile m_file;
+    std::vector<PackEntry> m_entries;
+};
+
+// Decompresses entry into dst, which must hold entry.size bytes.
+[[nodiscard]] bool UnpackEntry(
+    PackEntry const& entry, std::span<std::byte> dst);
+
+struct PackOptions {
+    bool compress = true;
+    // Files are stored compressed only when that saves at least this
+    // fraction of them, since compressed files cost a copy to read.
+    float minSaving = 0.125f;
+    // Names of files and directories to leave out, such as the cache.
+    std::vector<std::string> exclude;
+};
+
+struct PackStats {
+    size_t numFiles {};
+    size_t numCompressed {};
+    uint64_t rawBytes {};
+    uint64_t storedBytes {};
+    uint64_t fileSize {};
+};
+
+// Packs every file below directory into packPath, compressing them on all
+// cores. Files keep their write time, so caches keyed by it stay valid
+// whether their sources are read loose or packed.
+std::optional<PackStats> WritePack(
+    char const* directory, char const* packPath, PackOptions const& options);
+
+} // namespace Umbrella::Util
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "util/JobSystem.h"
+
+namespace Umbrella::Util {
+
+inline size_t WorkerCount()
+{
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Calls fn(i) for every i in [0, count), spread over all cores as jobs.
+// Items are handed out one at a time, so uneven items still balance across
+// workers. Safe to call from inside a job: waiting runs other jobs.
+template <typename Fn> void ParallelFor(size_t count, Fn&& fn)
+{
+    size_t numWorkers = std::min(WorkerCount(), count);
+    if (numWorkers <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> nextItem = 0;
+    auto worker = [&]() {
+        for (size_t i = nextItem++; i < count; i = nextItem++) {
+            fn(i);
+        }
+    };
+
+    // The calling thread works too, instead of idling in Wait().
+    JobSystem& jobs = JobSystem::Instance();
+    std::vector<JobHandle> helpers;
+    helpers.reserve(numWorkers - 1);
+    for (size_t t = 1; t < numWorkers; t++) {
+        helpers.push_back(jobs.Schedule("ParallelFor", worker));
+    }
+    worker();
+    jobs.Wait(helpers);
+}
+
+} // namespace Umbrella::Util
@@ -0,0 +1,156 @@
+#include "util/Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include <spdlog/spdlog.h>
+
+namespace Umbrella::Util {
+
+namespace {
+
+    std::string EscapeJson(std::string_view text)
+    {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+        }
+        return escaped;
+    }
+
+} // namespace
+
+Profiler& Profiler::Instance()
+{
+    static Profiler instance;
+    return instance;
+}
+
+Profiler::ThreadBuffer& Profiler::LocalBuffer()
+{
+    if (!s_localBuffer) {
+        auto buffer = std::make_shared<ThreadBuffer>();
+        std::lock_guard lock(m_mutex);
+        buffer->track = AddTrackLocked(
+            "thread " + std::to_string(m_buffers.size()));
+        m_buffers.push_back(buffer);
+        s_localBuffer = std::move(buffer);
+    }
+    return *s_localBuffer;
+}
+
+uint32_t Profiler::AddTrackLocked(std::string name)
+{
+    m_trackNames.push_back(std::move(name));
+    return static_cast<uint32_t>(m_trackNames.size() - 1);
+}
+
+uint32_t Profiler::AddTrack(std::string name)
+{
+    std::lock_guard lock(m_mutex);
+    return AddTrackLocked(std::move(name));
+}
+
+void Profiler::SetThreadName(std::string name)
+{
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard lock(m_mutex);
+    m_trackNames[buffer.track] = std::move(name);
+}
+
+void Profiler::BeginCapture()
+{
+    std::lock_guard lock(m_mutex);
+    for (std::shared_ptr<ThreadBuffer> const& buffer : m_buffers) {
+        std::lock_guard bufferLock(buffer->mutex);
+        buffer->events.clear();
+    }
+    m_trackEvents.clear();
+    m_captureStart = Clock::now();
+    s_capturing.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::AddZone(
+    std::string_view name, Clock::time_point start, Clock::time_point end)
+{
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard lock(buffer.mutex);
+    buffer.events.push_back({std::string(name), buffer.track, 'X', start,
+        end - start, 0.0});
+}
+
+void Profiler::AddTrackZone(uint32_t track, std::string_view name,
+    Clock::time_point start, Clock::time_point end)
+{
+    std::lock_guard lock(m_mutex);
+    m_trackEvents.push_back(
+        {std::string(name), track, 'X', start, end - start, 0.0});
+}
+
+void Profiler::AddCounter(char const* name, double value)
+{
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard lock(buffer.mutex);
+    buffer.events.push_back(
+        {name, buffer.track, 'C', Clock::now(), {}, value});
+}
+
+bool Profiler::EndCapture(char const* path)
+{
+    s_capturing.store(false, std::memory_order_relaxed);
+
+    std::vector<Event> events;
+    std::vector<std::string> trackNames;
+    {
+        std::lock_guard lock(m_mutex);
+        for (std::shared_ptr<ThreadBuffer> const& buffer : m_buffers) {
+            std::lock_guard bufferLock(buffer->mutex);
+            std::ranges::move(buffer->events, std::back_inserter(events));
+            buffer->events.clear();
+        }
+        std::ranges::move(m_trackEvents, std::back_inserter(events));
+        m_trackEvents.clear();
+        trackNames = m_trackNames;
+    }
+    std::ranges::sort(events, {}, &Event::start);
+
+    auto us = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+
+    // Microseconds with nanosecond resolution, however long the capture.
+    std::ofstream stream(path);
+    stream << std::fixed << std::setprecision(3);
+    stream << "{\"traceEvents\":[\n";
+    for (size_t t = 0; t < trackNames.size(); t++) {
+        stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+               << t << ",\"args\":{\"name\":\"" << EscapeJson(trackNames[t])
+               << "\"}},\n";
+    }
+    for (Event const& event : events) {
+        stream << "{\"name\":\"" << EscapeJson(event.name) << "\",\"ph\":\""
+               << event.phase << "\",\"pid\":0,\"tid\":" << event.track
+               << ",\"ts\":" << us(event.start - m_captureStart);
+        if (event.phase == 'C') {
+            stream << ",\"args\":{\"value\":" << event.value << "}},\n";
+        } else {
+            stream << ",\"dur\":" << us(event.duration) << "},\n";
+        }
+    }
+    // Every event above ends in a comma; the process name closes the list.
+    stream << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+              "\"args\":{\"name\":\"Umbrella\"}}\n]}\n";
+
+    if (!stream) {
+        spdlog::error("Could not write the profile capture to {}", path);
+        return false;
+    }
+    spdlog::info("Wrote {} profile events to {}", events.size(), path);
+    return true;
+}
+
+} // namespace Umbrella::Util
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Umbrella::Util {
+
+// Collects CPU zones, GPU zones and counters while a capture runs, and
+// writes them as a Chrome trace for chrome://tracing or Perfetto. Every
+// thread records into a buffer of its own, so zones never contend. Outside
+// a capture a zone costs one relaxed load; builds without UMBRELLA_PROFILER
+// compile the macros below away entirely.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Profiler& Instance();
+
+    // Starts a new capture, dropping anything an earlier one recorded.
+    void BeginCapture();
+    // Writes the capture and stops recording.
+    bool EndCapture(char const* path);
+    static bool Capturing()
+    {
+        return s_capturing.load(std::memory_order_relaxed);
+    }
+
+    // Names the calling thread's track in captures.
+    void SetThreadName(std::string name);
+    // A track of its own for zones that do not run on a CPU thread, such
+    // as the GPU's.
+    uint32_t AddTrack(std::string name);
+
+    void AddZone(std::string_view name, Clock::time_point start,
+        Clock::time_point end);
+    void AddTrackZone(uint32_t track, std::string_view name,
+        Clock::time_point start, Clock::time_point end);
+    void AddCounter(char const* name, double value);
+
+private:
+    struct Event {
+        std::string name;
+        uint32_t track;
+        // 'X' for zones, 'C' for counters.
+        char phase;
+        Clock::time_point start;
+        Clock::duration duration;
+        double value;
+    };
+
+    struct ThreadBuffer {
+        uint32_t track {};
+        std::mutex mutex;
+        std::vector<Event> events;
+    };
+
+    ThreadBuffer& LocalBuffer();
+    uint32_t AddTrackLocked(std::string name);
+
+    static inline std::atomic<bool> s_capturing {};
+    static inline thread_local std::shared_ptr<ThreadBuffer> s_localBuffer;
+
+    std::mutex m_mutex;
+    // Outlive their threads, so a capture keeps what exited workers did.
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+    std::vector<std::string> m_trackNames;
+    std::vector<Event> m_trackEvents;
+    Clock::time_point m_captureStart;
+};
+
+// Records the time from construction to destruction as a zone on the
+// calling thread's track. name has to outlive the zone.
+class ProfileZone {
+public:
+    explicit ProfileZone(std::string_view name)
+        : m_name(name)
+    {
+        if (Profiler::Capturing()) {
+            m_active = true;
+            m_start = Profiler::Clock::now();
+        }
+    }
+    ProfileZone(ProfileZone const&) = delete;
+    ProfileZone& operator=(ProfileZone const&) = delete;
+    ~ProfileZone()
+    {
+        if (m_active) {
+            Profiler::Instance().AddZone(
+                m_name, m_start, Profiler::Clock::now());
+        }
+    }
+
+private:
+    std::string_view m_name;
+    bool m_active {};
+    Profiler::Clock::time_point m_start;
+};
+
+} // namespace Umbrella::Util
+
+#ifdef UMBRELLA_PROFILER
+#define UMBRELLA_PROFILE_CONCAT_INNER(a, b) a##b
+#define UMBRELLA_PROFILE_CONCAT(a, b) UMBRELLA_PROFILE_CONCAT_INNER(a, b)
+#define UMBRELLA_PROFILE_ZONE(name)                                           \
+    ::Umbrella::Util::ProfileZone UMBRELLA_PROFILE_CONCAT(                    \
+        profileZone, __LINE__)(name)
+#define UMBRELLA_PROFILE_COUNTER(name, value)                                 \
+    do {                                                                      \
+        if (::Umbrella::Util::Profiler::Capturing()) {                        \
+            ::Umbrella::Util::Profiler::Instance().AddCounter(                \
+                name, static_cast<double>(value));                            \
+        }                                                                     \
+    } while (false)
+#else
+#define UMBRELLA_PROFILE_ZONE(name) static_cast<void>(0)
+#define UMBRELLA_PROFILE_COUNTER(name, value) static_cast<void>(0)
+#endif
@@ -0,0 +1,29 @@
+#include "util/Simd.h"
+
+#if defined(UMBRELLA_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Umbrella::Util {
+
+bool HasAvx()
+{
+#if defined(UMBRELLA_X86) && (defined(__GNUC__) || defined(__clang__))
+    static bool const hasAvx = __builtin_cpu_supports("avx");
+    return hasAvx;
+#elif defined(UMBRELLA_X86) && defined(_MSC_VER)
+    // CPUID leaf 1 reports AVX in ecx bit 28, and OSXSAVE in bit 27; the OS
+    // must also save the upper halves of the ymm registers.
+    static bool const hasAvx = []() {
+        int info[4];
+        __cpuid(info, 1);
+        bool cpu = (info[2] & (1 << 28)) && (info[2] & (1 << 27));
+        return cpu && (_xgetbv(0) & 0x6) == 0x6;
+    }();
+    return hasAvx;
+#else
+    return false;
+#endif
+}
+
+} // namespace Umbrella::Util
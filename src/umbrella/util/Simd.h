@@ -0,0 +1,24 @@
+#pragma once
+
+// UMBRELLA_X86 is defined where the SSE and AVX intrinsics can be used.
+// SSE2 code may run anywhere it is defined; AVX code goes in functions
+// marked UMBRELLA_TARGET_AVX and only runs when HasAvx() is true.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)                \
+    || defined(_M_IX86)
+#define UMBRELLA_X86 1
+#include <immintrin.h>
+#endif
+
+// MSVC compiles any intrinsic; GCC and Clang need AVX enabled per function.
+#if defined(__GNUC__) || defined(__clang__)
+#define UMBRELLA_TARGET_AVX __attribute__((target("avx")))
+#else
+#define UMBRELLA_TARGET_AVX
+#endif
+
+namespace Umbrella::Util {
+
+// Whether both the CPU and the OS support AVX. Checked once.
+bool HasAvx();
+
+} // namespace Umbrella::Util
@@ -0,0 +1,198 @@
+#include "util/VirtualFileSystem.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <ranges>
+
+#include <spdlog/spdlog.h>
+
+#include "util/Profiler.h"
+
+namespace Umbrella::Util {
+
+namespace {
+
+    constexpr size_t pageSize = 4096;
+
+    // Asset paths use '/' and no "." or empty components, like the paths
+    // stored in packs.
+    std::string NormalizePath(std::string_view path)
+    {
+        std::string normalized;
+        normalized.reserve(path.size());
+        size_t begin = 0;
+        while (begin <= path.size()) {
+            size_t end = path.find_first_of("/\\", begin);
+            end = end == std::string_view::npos ? path.size() : end;
+            std::string_view component = path.substr(begin, end - begin);
+            if (!component.empty() && component != ".") {
+                if (!normalized.empty()) {
+                    normalized += '/';
+                }
+                normalized += component;
+            }
+            begin = end + 1;
+        }
+        return normalized;
+    }
+
+    std::string DiskPath(std::string const& directory, std::string const& path)
+    {
+        return directory.empty() ? path : directory + '/' + path;
+    }
+
+} // namespace
+
+VirtualFileSystem& VirtualFileSystem::Instance()
+{
+    static VirtualFileSystem instance;
+    [[maybe_unused]] static bool const mounted = instance.MountDirectory("");
+    return instance;
+}
+
+bool VirtualFileSystem::MountDirectory(std::string directory)
+{
+    while (directory.size() > 1
+        && (directory.back() == '/' || directory.back() == '\\')) {
+        directory.pop_back();
+    }
+    std::error_code error;
+    if (!std::filesystem::is_directory(
+            directory.empty() ? "." : directory, error)) {
+        spdlog::error("Cannot mount {}, it is not a directory", directory);
+        return false;
+    }
+
+    std::unique_lock lock(m_mutex);
+    m_mounts.push_back({.directory = std::move(directory), .pack = nullptr});
+    return true;
+}
+
+bool VirtualFileSystem::MountPack(char const* packPath)
+{
+    std::optional<PackArchive> pack = PackArchive::Open(packPath);
+    if (!pack) {
+        spdlog::error("Cannot mount {}", packPath);
+        return false;
+    }
+    spdlog::info("Mounted {} with {} files", packPath, pack->Entries().size());
+
+    std::unique_lock lock(m_mutex);
+    m_mounts.push_back({
+        .directory = {},
+        .pack = std::make_unique<PackArchive>(std::move(*pack)),
+    });
+    return true;
+}
+
+std::optional<AssetFile> VirtualFileSystem::Open(std::string_view path) const
+{
+    UMBRELLA_PROFILE_ZONE("Open asset");
+    std::string normalized = NormalizePath(path);
+    // Absolute paths name a file outside of every mount.
+    bool absolute = std::filesystem::path(path).is_absolute();
+
+    std::shared_lock lock(m_mutex);
+    for (Mount const& mount : m_mounts | std::views::reverse) {
+        AssetFile file;
+        if (!mount.pack) {
+            file.m_file = MappedFile::Open(absolute
+                    ? std::string(path).c_str()
+                    : DiskPath(mount.directory, normalized).c_str());
+            if (!file.m_file) {
+                continue;
+            }
+            file.m_data = file.m_file->Data();
+            file.m_size = file.m_file->Size();
+            return file;
+        }
+
+        PackEntry const* entry
+            = absolute ? nullptr : mount.pack->Find(normalized);
+        if (!entry) {
+            continue;
+        }
+        file.m_size = entry->size;
+        if (entry->codec == PackCodec::None) {
+            file.m_data = reinterpret_cast<char const*>(entry->stored.data());
+            return file;
+        }
+        file.m_buffer = std::make_unique_for_overwrite<std::byte[]>(
+            entry->size);
+        if (!UnpackEntry(*entry, {file.m_buffer.get(), entry->size})) {
+            spdlog::error("Packed file {} is corrupt", normalized);
+            return {};
+        }
+        file.m_data = reinterpret_cast<char const*>(file.m_buffer.get());
+        return file;
+    }
+    return {};
+}
+
+std::optional<AssetStamp> VirtualFileSystem::Stat(std::string_view path) const
+{
+    std::string normalized = NormalizePath(path);
+    bool absolute = std::filesystem::path(path).is_absolute();
+
+    std::shared_lock lock(m_mutex);
+    for (Mount const& mount : m_mounts | std::views::reverse) {
+        if (mount.pack) {
+            PackEntry const* entry
+                = absolute ? nullptr : mount.pack->Find(normalized);
+            if (entry) {
+                return AssetStamp {
+                    .size = entry->size,
+                    .writeTime = entry->writeTime,
+                };
+            }
+            continue;
+        }
+
+        std::string diskPath = absolute
+            ? std::string(path)
+            : DiskPath(mount.directory, normalized);
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(diskPath, error);
+        if (error) {
+            continue;
+        }
+        auto writeTime = std::filesystem::last_write_time(diskPath, error);
+        if (error) {
+            continue;
+        }
+        return AssetStamp {
+            .size = size,
+            .writeTime = writeTime.time_since_epoch().count(),
+        };
+    }
+    return {};
+}
+
+JobHandle VirtualFileSystem::ReadAsync(std::string path,
+    std::function<void(std::optional<AssetFile>)> onRead,
+    std::span<JobHandle const> dependencies) const
+{
+    return JobSystem::Instance().Schedule(
+        "Read asset",
+        [this, path = std::move(path), onRead = std::move(onRead)]() {
+            std::optional<AssetFile> file = Open(path);
+            if (file && !file->Copied()) {
+                for (size_t offset = 0; offset < file->Size();
+                     offset += pageSize) {
+                    static_cast<void>(*reinterpret_cast<char const volatile*>(
+                        file->Data() + offset));
+                }
+            }
+            onRead(std::move(file));
+        },
+        dependencies);
+}
+
+size_t VirtualFileSystem::NumMounts() const
+{
+    std::shared_lock lock(m_mutex);
+    return m_mounts.size();
+}
+
+} // namespace Umbrella::Util
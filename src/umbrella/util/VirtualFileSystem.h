@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "util/JobSystem.h"
+#include "util/MappedFile.h"
+#include "util/PackArchive.h"
+
+namespace Umbrella::Util {
+
+// The read-only contents of an asset. Loose files are mapped on their own
+// and stored pack entries are views into the mapped pack, so neither is
+// copied; only compressed entries are decompressed into a buffer.
+class AssetFile {
+public:
+    char const* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+    std::string_view View() const { return {m_data, m_size}; }
+    std::span<std::byte const> Bytes() const
+    {
+        return {reinterpret_cast<std::byte const*>(m_data), m_size};
+    }
+    // Whether the contents had to be copied out of their mapping.
+    bool Copied() const { return m_buffer != nullptr; }
+
+private:
+    friend class VirtualFileSystem;
+
+    AssetFile() = default;
+
+    std::optional<MappedFile> m_file;
+    std::unique_ptr<std::byte[]> m_buffer;
+    char const* m_data {};
+    size_t m_size {};
+};
+
+// What caches key an asset's contents on before falling back to hashing it.
+struct AssetStamp {
+    uint64_t size;
+    int64_t writeTime;
+};
+
+// Resolves asset paths such as "meshes/capsule.obj" against a stack of
+// mounted directories and .upak packs, the last mounted first; absolute
+// paths are read from disk as they are. Mounting is for startup, opening is
+// thread-safe, and packs stay mapped for as long as the file system lives,
+// which bounds the files opened from them.
+class VirtualFileSystem {
+public:
+    // The shared instance, which starts with the working directory mounted
+    // so loose assets are found until something else is.
+    static VirtualFileSystem& Instance();
+
+    VirtualFileSystem() = default;
+    VirtualFileSystem(VirtualFileSystem const&) = delete;
+    VirtualFileSystem& operator=(VirtualFileSystem const&) = delete;
+
+    [[nodiscard]] bool MountDirectory(std::string directory);
+    [[nodiscard]] bool MountPack(char const* packPath);
+
+    std::optional<AssetFile> Open(std::string_view path) const;
+    std::optional<AssetStamp> Stat(std::string_view path) const;
+    bool Exists(std::string_view path) const { return Stat(path).has_value(); }
+
+    // Opens path on a job and hands the result, or nothing when it is not
+    // found, to onRead there. Mapped pages are faulted in on the worker, so
+    // whatever runs after the returned job does not stall on the disk.
+    JobHandle ReadAsync(std::string path,
+        std::function<void(std::optional<AssetFile>)> onRead,
+        std::span<JobHandle const> dependencies = {}) const;
+
+    size_t NumMounts() const;
+
+private:
+    struct Mount {
+        std::string directory;
+        std::unique_ptr<PackArchive> pack;
+    };
+
+    mutable std::shared_mutex m_mutex;
+    std::vector<Mount> m_mounts;
+};
+
+} // namespace Umbrella::Util